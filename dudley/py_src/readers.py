@@ -37,7 +37,7 @@ some mesh handling
 __author__="Lutz Gross, l.gross@uq.edu.au, Joel Fenwick"
 
 from esys.pycad.gmsh import Design as GMSHDesign
-from .dudleycpp import ReadGmsh
+from .dudleycpp import ReadGmsh, ReadMesh
 
 def MakeDomain(design, integrationOrder=-1, reducedIntegrationOrder=-1,
                optimizeLabeling=True, useMacroElements=False):
@@ -79,3 +79,29 @@ def MakeDomain(design, integrationOrder=-1, reducedIntegrationOrder=-1,
     design.getTagMap().passToDomain(dom)
     return dom
 
+def ConvertMesh(inputFile, outputFile, numDim=None, optimize=True):
+    """
+    Converts a fly or gmsh mesh file into the dudley binary mesh format.
+    The binary file can be read by `ReadMesh` and `LoadMesh` on any number
+    of processes and is much faster to read than fly or gmsh files, so large
+    meshes should be converted once and the binary file used afterwards.
+
+    :param inputFile: name of the fly or gmsh (.msh) file to convert
+    :type inputFile: ``str``
+    :param outputFile: name of the binary mesh file to write
+    :type outputFile: ``str``
+    :param numDim: spatial dimensionality, required for gmsh files
+    :type numDim: ``int``
+    :param optimize: if set the labeling of the mesh nodes is optimized
+    :type optimize: ``bool``
+    :return: the domain read from the input file
+    :rtype: `Domain`
+    """
+    if inputFile.endswith(".msh"):
+        if numDim is None:
+            raise ValueError("The numDim argument is required in order to read .msh files.")
+        dom=ReadGmsh(inputFile, numDim, optimize=optimize)
+    else:
+        dom=ReadMesh(inputFile, optimize=optimize)
+    dom.writeBinary(outputFile)
+    return dom
@@ -94,6 +94,14 @@ inline void cleanupAndThrow(DudleyDomain* dom, string msg)
 
 Domain_ptr DudleyDomain::load(const string& fileName)
 {
+    // binary mesh files can be loaded on any number of ranks and are
+    // repartitioned if the number of ranks changed
+    {
+        JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
+        int numPieces = 0;
+        if (isBinaryMesh(mpiInfo, fileName, &numPieces))
+            return readBinary(mpiInfo, fileName, numPieces != mpiInfo->size);
+    }
 #ifdef ESYS_HAVE_NETCDF
     JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
     const string fName(mpiInfo->appendRankToFileName(fileName));
@@ -365,6 +373,14 @@ Domain_ptr DudleyDomain::load(const string& fileName)
 
 Domain_ptr DudleyDomain::load(const string& fileName)
 {
+    // binary mesh files can be loaded on any number of ranks and are
+    // repartitioned if the number of ranks changed
+    {
+        JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
+        int numPieces = 0;
+        if (isBinaryMesh(mpiInfo, fileName, &numPieces))
+            return readBinary(mpiInfo, fileName, numPieces != mpiInfo->size);
+    }
 #ifdef ESYS_HAVE_NETCDF
     JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
     const string fName(mpiInfo->appendRankToFileName(fileName));
@@ -2138,13 +2138,16 @@ void DudleyDomain::prepare(bool optimize)
         optimizeDOFDistribution(distribution);
         distributeByRankOfDOF(distribution);
     }
-    // the local labelling of the degrees of freedom is optimized
+    // the local labelling of the degrees of freedom is optimized and the
+    // nodes are put in space-filling curve order
     if (optimize) {
         optimizeDOFLabeling(distribution);
+        optimizeNodeOrdering();
     }
 
     // rearrange elements with the aim of bringing elements closer to memory
-    // locations of the nodes (distributed shared memory!):
+    // locations of the nodes (distributed shared memory!). If the nodes
+    // follow a space-filling curve so do the elements.
     optimizeElementOrdering();
 
     // create the global indices
@@ -97,7 +97,8 @@ public:
     /**
      \brief
      reads a mesh from a fly file. For MPI parallel runs fans out the mesh
-     to multiple processes.
+     to multiple processes. Files in the dudley binary mesh format are
+     passed on to readBinary().
      \param mpiInfo the MPI information structure
      \param fileName the name of the file
      \param optimize whether to optimize the node labels
@@ -105,6 +106,30 @@ public:
     static escript::Domain_ptr read(escript::JMPI mpiInfo,
                                     const std::string& filename, bool optimize);
 
+    /**
+     \brief
+     reads a mesh from a file in the dudley binary mesh format written by
+     writeBinary(). All ranks read their part of the file concurrently.
+     If the number of ranks differs from the number of ranks that wrote
+     the file the mesh is redistributed.
+     \param mpiInfo the MPI information structure
+     \param fileName the name of the file
+     \param optimize whether to optimize the node labels
+    */
+    static escript::Domain_ptr readBinary(escript::JMPI mpiInfo,
+                                          const std::string& fileName,
+                                          bool optimize = false);
+
+    /**
+     \brief
+     returns true if `fileName` is a file in the dudley binary mesh format
+     and sets numPieces to the number of ranks that wrote it. Must be called
+     on all ranks.
+    */
+    static bool isBinaryMesh(escript::JMPI mpiInfo,
+                             const std::string& fileName,
+                             int* numPieces = NULL);
+
     /**
      \brief
      reads a gmsh mesh file.
@@ -266,6 +291,15 @@ public:
     */
     void dump(const std::string& fileName) const;
 
+    /**
+     \brief
+     writes the mesh to a single file in the dudley binary mesh format.
+     All ranks write their part of the mesh concurrently and the file can
+     be read on any number of ranks using readBinary().
+     \param fileName Input - The name of the file
+    */
+    void writeBinary(const std::string& fileName) const;
+
     /**
      \brief
      Return the tag key for the given sample number.
@@ -726,6 +760,7 @@ private:
     void markNodes(std::vector<short>& mask, index_t offset) const;
     void optimizeDOFDistribution(IndexVector& distribution);
     void optimizeDOFLabeling(const IndexVector& distribution);
+    void optimizeNodeOrdering();
     void optimizeElementOrdering();
     void updateTagList();
     void printElementInfo(const ElementFile* e, const std::string& title,
@@ -0,0 +1,49 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "DudleyDomain.h"
+
+#include <escript/SpaceFillingCurve.h>
+
+namespace dudley {
+
+/// renumbers the local nodes along a Hilbert curve so nodes close in space
+/// are close in memory
+void DudleyDomain::optimizeNodeOrdering()
+{
+    const dim_t numNodes = m_nodes->getNumNodes();
+    if (numNodes < 2)
+        return;
+
+    IndexVector order;
+    escript::getHilbertOrder(getDim(), numNodes, m_nodes->Coordinates, order);
+
+    NodeFile* newNodeFile = new NodeFile(getDim(), m_mpiInfo);
+    newNodeFile->allocTable(numNodes);
+    newNodeFile->gather(&order[0], m_nodes);
+    delete m_nodes;
+    m_nodes = newNodeFile;
+
+    IndexVector newNode(numNodes);
+#pragma omp parallel for
+    for (index_t n = 0; n < numNodes; n++)
+        newNode[order[n]] = n;
+    relabelElementNodes(&newNode[0], 0);
+}
+
+} // namespace dudley
+
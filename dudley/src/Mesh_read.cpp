@@ -151,6 +151,10 @@ escript::Domain_ptr DudleyDomain::read(escript::JMPI mpiInfo,
                                        const std::string& filename,
                                        bool optimize)
 {
+    // meshes converted to the binary format are read directly by all ranks
+    if (isBinaryMesh(mpiInfo, filename))
+        return readBinary(mpiInfo, filename, optimize);
+
     dim_t numNodes = 0;
     int numDim = 0;
     std::string name, line, token;
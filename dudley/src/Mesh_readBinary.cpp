@@ -0,0 +1,118 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "DudleyDomain.h"
+
+#include <escript/BinaryMesh.h>
+
+using escript::IOError;
+using escript::binarymesh::Header;
+using escript::binarymesh::Reader;
+
+namespace dudley {
+
+namespace {
+
+/// identifies dudley binary mesh files
+const char* const MAGIC = "DUDBMESH";
+
+/// elements, face elements and points
+const int NUM_ELEMENT_TABLES = 3;
+
+ElementFile* readElementTable(Reader& reader, int table,
+                              escript::JMPI mpiInfo)
+{
+    const Header& header = reader.getHeader();
+    const ElementTypeId typeID = static_cast<ElementTypeId>(header.typeId[table]);
+    if (typeID < 0 || typeID >= Dudley_NoRef)
+        throw IOError("readBinary: Unidentified element type in binary mesh file");
+    ElementFile* out = new ElementFile(typeID, mpiInfo);
+    // decided on the global header so all ranks skip the collective reads
+    if (header.numElements[table] > 0
+            && header.numNodesPerElement[table] != out->numNodes) {
+        delete out;
+        throw IOError("readBinary: number of element nodes does not match element type");
+    }
+    const dim_t numEle = reader.getNumElements(table);
+    out->allocTable(numEle);
+    try {
+        reader.readElements(table, out->Id, out->Tag, out->Nodes);
+    } catch (IOError& e) {
+        delete out;
+        throw;
+    }
+
+    out->minColor = 0;
+    out->maxColor = numEle - 1;
+#pragma omp parallel for
+    for (index_t i = 0; i < numEle; i++) {
+        out->Owner[i] = mpiInfo->rank;
+        out->Color[i] = i;
+    }
+    out->updateTagList();
+    return out;
+}
+
+} // anonymous
+
+bool DudleyDomain::isBinaryMesh(escript::JMPI mpiInfo,
+                                const std::string& fileName, int* numPieces)
+{
+    return escript::binarymesh::isBinaryMesh(mpiInfo, fileName, MAGIC,
+                                             numPieces);
+}
+
+escript::Domain_ptr DudleyDomain::readBinary(escript::JMPI mpiInfo,
+                                             const std::string& fileName,
+                                             bool optimize)
+{
+    Reader reader(mpiInfo, fileName, MAGIC, NUM_ELEMENT_TABLES);
+
+    // allocate domain
+    DudleyDomain* domain = new DudleyDomain(reader.getName(),
+                                            reader.getHeader().numDim, mpiInfo);
+
+    try {
+        // read nodes. It doesn't matter that a rank has the wrong nodes for
+        // its elements, this is sorted out later.
+        NodeFile* nodes = domain->getNodes();
+        nodes->allocTable(reader.getNumNodes());
+        reader.readNodes(nodes->Id, nodes->globalDegreesOfFreedom, nodes->Tag,
+                         nodes->Coordinates);
+
+        // read element tables
+        domain->setElements(readElementTable(reader, 0, mpiInfo));
+        domain->setFaceElements(readElementTable(reader, 1, mpiInfo));
+        domain->setPoints(readElementTable(reader, 2, mpiInfo));
+    } catch (IOError& e) {
+        delete domain;
+        throw;
+    }
+    reader.close();
+
+    // get the name tags
+    const TagMap& tagMap = reader.getTagMap();
+    for (TagMap::const_iterator it = tagMap.begin(); it != tagMap.end(); it++)
+        domain->setTagMap(it->first, it->second);
+
+    domain->resolveNodeIds();
+    domain->prepare(optimize);
+    return domain->getPtr();
+}
+
+} // namespace dudley
+
@@ -0,0 +1,104 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "DudleyDomain.h"
+
+#include <escript/BinaryMesh.h>
+#include <escript/index.h>
+
+namespace dudley {
+
+namespace {
+
+/// identifies dudley binary mesh files
+const char* const MAGIC = "DUDBMESH";
+
+/// elements, face elements and points
+const int NUM_ELEMENT_TABLES = 3;
+
+/// returns the owned elements of `e` in the layout of the binary mesh
+/// format with the node Ids of the elements
+void packElements(const ElementFile* e, const NodeFile* nodes, int rank,
+                  IndexVector& id, std::vector<int32_t>& tag,
+                  IndexVector& elementNodes)
+{
+    id.clear();
+    tag.clear();
+    elementNodes.clear();
+    if (e == NULL)
+        return;
+    const int NN = e->numNodes;
+    for (index_t i = 0; i < e->numElements; i++) {
+        if (e->Owner[i] == rank) {
+            id.push_back(e->Id[i]);
+            tag.push_back(e->Tag[i]);
+            for (int j = 0; j < NN; j++)
+                elementNodes.push_back(nodes->Id[e->Nodes[INDEX2(j,i,NN)]]);
+        }
+    }
+}
+
+} // anonymous
+
+void DudleyDomain::writeBinary(const std::string& fileName) const
+{
+    const int rank = m_mpiInfo->rank;
+    const int numDim = getDim();
+    const ElementFile* tables[NUM_ELEMENT_TABLES] = {
+        m_elements, m_faceElements, m_points
+    };
+    const ElementTypeId defaultTypes[NUM_ELEMENT_TABLES] = {
+        Dudley_Tet4, Dudley_Tri3, Dudley_Point1
+    };
+    escript::binarymesh::Writer writer(m_mpiInfo, MAGIC, NUM_ELEMENT_TABLES,
+                                       numDim);
+
+    // every rank writes the nodes it owns and the elements it owns
+    IndexVector nodeId, nodeDOF;
+    std::vector<int32_t> nodeTag;
+    std::vector<double> nodeCoordinates;
+    const index_t firstNode = m_nodes->getFirstNode();
+    const index_t lastNode = m_nodes->getLastNode();
+    const index_t* globalNodesIndex = m_nodes->borrowGlobalNodesIndex();
+    for (index_t n = 0; n < m_nodes->getNumNodes(); n++) {
+        if (firstNode <= globalNodesIndex[n] && globalNodesIndex[n] < lastNode) {
+            nodeId.push_back(m_nodes->Id[n]);
+            nodeDOF.push_back(m_nodes->globalDegreesOfFreedom[n]);
+            nodeTag.push_back(m_nodes->Tag[n]);
+            for (int i = 0; i < numDim; i++)
+                nodeCoordinates.push_back(m_nodes->Coordinates[INDEX2(i,n,numDim)]);
+        }
+    }
+    writer.setNodes(nodeId, nodeDOF, nodeTag, nodeCoordinates);
+
+    for (int i = 0; i < NUM_ELEMENT_TABLES; i++) {
+        const ElementFile* e = tables[i];
+        IndexVector id, elementNodes;
+        std::vector<int32_t> tag;
+        packElements(e, m_nodes, rank, id, tag, elementNodes);
+        if (e != NULL) {
+            writer.setElements(i, e->etype, e->numNodes, id, tag,
+                               elementNodes);
+        } else {
+            writer.setElements(i, defaultTypes[i], 0, id, tag, elementNodes);
+        }
+    }
+    writer.write(fileName, m_name, m_tagMap);
+}
+
+} // namespace dudley
+
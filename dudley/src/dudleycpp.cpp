@@ -48,7 +48,7 @@ BOOST_PYTHON_MODULE(dudleycpp)
 
   def("ReadMesh", dudley::readMesh,
       (arg("fileName")="file.fly", arg("integrationOrder")=-1, arg("reducedIntegrationOrder")=-1, arg("optimize")=true)
-	,"Read a mesh from a fly file. For MPI parallel runs fan out the mesh to multiple processes.\n\n"
+	,"Read a mesh from a fly file or a binary mesh file written by ``writeBinary``. For MPI parallel runs fan out the mesh to multiple processes.\n\n"
 ":rtype: `Domain`\n:param fileName:\n:type fileName: ``string``\n"
 ":param integrationOrder: order of the quadrature scheme. Ignored.\n"
 ":type integrationOrder: ``int``\n"
@@ -80,6 +80,10 @@ BOOST_PYTHON_MODULE(dudleycpp)
 ":param full:\n:type full: ``bool``")
       .def("dump", &dudley::DudleyDomain::dump, args("fileName")
 ,"dumps the mesh to a file with the given name.")
+      .def("writeBinary", &dudley::DudleyDomain::writeBinary, args("fileName"),
+"Writes the mesh to a single file in the dudley binary mesh format. All "
+"processes write concurrently and the file can be loaded with `LoadMesh` "
+"or `ReadMesh` on any number of processes.")
       .def("getDescription", &dudley::DudleyDomain::getDescription,
 ":return: a description for this domain\n:rtype: ``string``")
       .def("getDim", &dudley::DudleyDomain::getDim,":rtype: ``int``")
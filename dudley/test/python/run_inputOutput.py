@@ -38,7 +38,7 @@ Test suite for input and output of meshes and data objects
 import esys.escriptcore.utestselect as unittest, sys
 from esys.escriptcore.testing import *
 from esys.escript import *
-from esys.dudley import Rectangle, Brick, LoadMesh, ReadMesh, ReadGmsh
+from esys.dudley import Rectangle, Brick, LoadMesh, ReadMesh, ReadGmsh, ConvertMesh
 import os as os
 
 try:
@@ -129,7 +129,6 @@ class Test_InputOutputOnDudley(unittest.TestCase):
      #    mydomain2=LoadMesh(dumpfile)
      #    self.domainsEqual(mydomain1, mydomain2)
 
-     @unittest.skipIf(getMPISizeWorld()>1, "number of MPI ranks > 1")
      def test_gmshTags(self):
         dom=ReadGmsh(os.path.join(DUDLEY_TEST_MESH_PATH, "tagtest.msh"),2)
         tags=dom.showTagNames().split(', ')
@@ -139,6 +138,35 @@ class Test_InputOutputOnDudley(unittest.TestCase):
         self.assertEqual(dom.getTag('tag3'),3,'error with tag3')
         self.assertRaises(ValueError, dom.getTag, 'tag4')
 
+     def test_gmshVersion1Tags(self):
+        # msh 1 files tag elements with the first of the two region fields
+        meshfile=os.path.join(DUDLEY_WORKDIR, "tempfile.tags_v1.msh")
+        if getMPIRankWorld()==0:
+            with open(meshfile, "w") as f:
+                f.write("$NOD\n4\n1 0 0 0\n2 1 0 0\n3 1 1 0\n4 0 1 0\n$ENDNOD\n")
+                f.write("$ELM\n2\n1 2 7 3 3 1 2 3\n2 2 7 3 3 1 3 4\n$ENDELM\n")
+        getMPIWorldMax(getMPIRankWorld())
+        dom=ReadGmsh(meshfile, 2)
+        self.assertEqual(Function(dom).getListOfTags(), [7])
+
+     def test_mesh_writeBinary_brick(self):
+        mydomain1 = Brick(n0=NE0, n1=NE1, n2=NE2, order=1, l0=1., l1=1., l2=1., optimize=False)
+        mydomain1.setTagMap("mytag", 42)
+        meshfile=os.path.join(DUDLEY_WORKDIR, "tempfile.mesh.bin")
+        mydomain1.writeBinary(meshfile)
+        mydomain2=LoadMesh(meshfile)
+        self.domainsEqual(mydomain1, mydomain2)
+        self.assertEqual(mydomain2.getTag("mytag"), 42)
+
+     def test_flyTags_converted(self):
+        meshfile=os.path.join(DUDLEY_WORKDIR, "tempfile.tagtest2.bin")
+        ConvertMesh(os.path.join(DUDLEY_TEST_MESH_PATH, "tagtest2.fly"), meshfile)
+        dom=ReadMesh(meshfile)
+        tags=sorted(dom.showTagNames().split(', '))
+        self.assertEqual(tags,sorted(['tag1', 'tag2', 'tag3', 'tag4', 'All']))
+        self.assertEqual(dom.getTag('tag1'),5,'error with tag1')
+        self.assertEqual(dom.getTag('All'),10,'error with All')
+
      def test_flyTags(self):
         dom=ReadMesh(os.path.join(DUDLEY_TEST_MESH_PATH, "tagtest2.fly"))
         tags=sorted(dom.showTagNames().split(', '))
@@ -60,7 +60,7 @@ class DataManager(object):
         dm.export()                         # write out data
     """
 
-    RESTART, SILO, VISIT, VTK = list(range(4))
+    RESTART, SILO, VISIT, VTK, HDF5 = list(range(5))
 
     def __init__(self, formats=[RESTART], work_dir=".", restart_prefix="restart", do_restart=True):
         """
@@ -70,7 +70,13 @@ class DataManager(object):
         Values are only written to disk when export() is called.
 
         :param formats: A list of export file formats to use. Allowed values
-                        are RESTART, SILO, VISIT, VTK.
+                        are RESTART, SILO, VISIT, VTK, HDF5. HDF5 stores all
+                        exported steps in a single file 'dataset.h5'.
+                        Unless VISIT is used the converted domain is reused
+                        while the domain does not change, so SILO files
+                        reference the mesh of the first exported file and
+                        unchanged Data is only written once to SILO and HDF5
+                        files.
         :param work_dir: top-level directory where files are exported to
         :param restart_prefix: prefix for restart directories. Will be used to
                                load restart files (if do_restart is True) and
@@ -81,6 +87,7 @@ class DataManager(object):
         self._md_schema=""
         self._data={}
         self._domain=None
+        self._dataset=None
         self._meshlabels=["","",""]
         self._meshunits=["","",""]
         self._stamp={}
@@ -233,7 +240,7 @@ class DataManager(object):
         """
         Executes the actual data export. Depending on the formats parameter
         used in the constructor all data added by addData() is written to disk
-        (RESTART,SILO,VTK) or made available through the VisIt simulation
+        (RESTART,SILO,VTK,HDF5) or made available through the VisIt simulation
         interface (VISIT).
         """
 
@@ -254,6 +261,10 @@ class DataManager(object):
                 if ds is None:
                     ds=self.__createDataset()
                 ds.saveVTK(nameprefix)
+            elif f == self.HDF5:
+                if ds is None:
+                    ds=self.__createDataset()
+                ds.saveHDF5(os.path.join(self._workdir, "dataset"), self._N>0)
             elif f == self.VISIT:
                 from esys.weipa.weipacpp import visitPublishData
                 if ds is None:
@@ -270,9 +281,22 @@ class DataManager(object):
 
     def __createDataset(self):
         from esys.weipa.weipacpp import EscriptDataset
-        from esys.weipa import createDataset
-
-        ds = createDataset(self._domain, **self._data)
+        from esys.weipa import createDataset, interpolateEscriptData
+
+        # the dataset handed to VisIt must not be modified afterwards
+        persistent = not self.VISIT in self._exportformats
+        if persistent and self._dataset is not None and \
+                self._dataset[0] == self._domain:
+            ds = self._dataset[1]
+            ds.clearData()
+            domain,data = interpolateEscriptData(self._domain, self._data)
+            for n,d in sorted(data.items()):
+                ds.addData(d, n, "")
+        else:
+            ds = createDataset(self._domain, **self._data)
+            ds.setPersistent(persistent)
+            if persistent:
+                self._dataset = (self._domain, ds)
         ds.setCycleAndTime(self._N, self._time)
         ds.setMetadataSchemaString(self._md_schema, self._metadata)
         ds.setMeshLabels(self._meshlabels[0], self._meshlabels[1], self._meshlabels[2])
@@ -0,0 +1,468 @@
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "BinaryMesh.h"
+#include "EsysException.h"
+#include "index.h"
+
+#include <algorithm>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace escript {
+
+namespace binarymesh {
+
+using DataTypes::dim_t;
+using DataTypes::index_t;
+using DataTypes::IndexVector;
+
+/// maximum number of bytes transferred by a single read or write call
+static const int64_t MAX_CHUNK = 1<<30;
+
+File::File(JMPI mpi) :
+    mpiInfo(mpi),
+    mappedData(NULL),
+    mappedSize(0),
+    isOpen(false)
+{
+}
+
+File::~File()
+{
+    close();
+}
+
+void File::open(const std::string& fileName, bool write)
+{
+    // there is nobody to share the file with on a single rank so the
+    // operating system may as well page it in directly
+    if (!write && mpiInfo->size == 1 && map(fileName)) {
+        isOpen = true;
+        return;
+    }
+
+    int error = 0;
+#ifdef ESYS_MPI
+    const int amode = (write ? MPI_MODE_CREATE | MPI_MODE_WRONLY
+                             : MPI_MODE_RDONLY);
+    if (write && mpiInfo->rank == 0) {
+        // truncate existing files
+        MPI_File_delete(const_cast<char*>(fileName.c_str()), MPI_INFO_NULL);
+    }
+    if (write)
+        MPI_Barrier(mpiInfo->comm);
+    error = MPI_File_open(mpiInfo->comm, const_cast<char*>(fileName.c_str()),
+                          amode, MPI_INFO_NULL, &fileHandle);
+    error = (error != MPI_SUCCESS);
+    // the file may be accessible on some ranks only so all ranks agree
+    // before throwing. A handle opened on a subset of the ranks cannot be
+    // closed collectively and is left to MPI_Finalize.
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+#else
+    fileHandle.open(fileName.c_str(), std::ios::binary | (write ?
+                    std::ios::out | std::ios::trunc : std::ios::in));
+    error = !fileHandle.is_open();
+#endif
+    if (error) {
+        std::stringstream ss;
+        ss << "Opening binary mesh file " << fileName << " for "
+           << (write ? "writing" : "reading") << " failed.";
+        throw IOError(ss.str());
+    }
+    isOpen = true;
+}
+
+bool File::map(const std::string& fileName)
+{
+#ifdef _WIN32
+    return false;
+#else
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, st.st_size, MADV_WILLNEED);
+    mappedData = static_cast<const char*>(data);
+    mappedSize = st.st_size;
+    return true;
+#endif
+}
+
+void File::close()
+{
+    if (mappedData) {
+#ifndef _WIN32
+        munmap(const_cast<char*>(mappedData), mappedSize);
+#endif
+        mappedData = NULL;
+        mappedSize = 0;
+        isOpen = false;
+    }
+    if (isOpen) {
+#ifdef ESYS_MPI
+        MPI_File_close(&fileHandle);
+#else
+        fileHandle.close();
+#endif
+        isOpen = false;
+    }
+}
+
+void File::readAt(int64_t offset, void* data, int64_t bytes)
+{
+    if (mappedData) {
+        if (offset < 0 || bytes < 0 || offset+bytes > mappedSize)
+            throw IOError("Error reading binary mesh file.");
+        if (bytes > 0)
+            memcpy(data, mappedData+offset, bytes);
+        return;
+    }
+
+    int error = 0;
+#ifdef ESYS_MPI
+    // all ranks need to take part in the same number of collective calls
+    int64_t numChunks = (bytes+MAX_CHUNK-1)/MAX_CHUNK;
+    MPI_Allreduce(MPI_IN_PLACE, &numChunks, 1, MPI_INT64_T, MPI_MAX,
+                  mpiInfo->comm);
+    char* ptr = static_cast<char*>(data);
+    for (int64_t i = 0; i < numChunks; i++) {
+        const int64_t start = std::min(i*MAX_CHUNK, bytes);
+        const int n = static_cast<int>(std::min(MAX_CHUNK, bytes-start));
+        MPI_Status status;
+        if (MPI_File_read_at_all(fileHandle, offset+start, ptr+start, n,
+                                 MPI_BYTE, &status) != MPI_SUCCESS) {
+            error = 1;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+#else
+    if (bytes > 0) {
+        fileHandle.seekg(offset);
+        fileHandle.read(static_cast<char*>(data), bytes);
+        error = !fileHandle.good();
+    }
+#endif
+    if (error)
+        throw IOError("Error reading binary mesh file.");
+}
+
+void File::writeAt(int64_t offset, const void* data, int64_t bytes)
+{
+    int error = 0;
+#ifdef ESYS_MPI
+    int64_t numChunks = (bytes+MAX_CHUNK-1)/MAX_CHUNK;
+    MPI_Allreduce(MPI_IN_PLACE, &numChunks, 1, MPI_INT64_T, MPI_MAX,
+                  mpiInfo->comm);
+    char* ptr = static_cast<char*>(const_cast<void*>(data));
+    for (int64_t i = 0; i < numChunks; i++) {
+        const int64_t start = std::min(i*MAX_CHUNK, bytes);
+        const int n = static_cast<int>(std::min(MAX_CHUNK, bytes-start));
+        MPI_Status status;
+        if (MPI_File_write_at_all(fileHandle, offset+start, ptr+start, n,
+                                  MPI_BYTE, &status) != MPI_SUCCESS) {
+            error = 1;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+#else
+    if (bytes > 0) {
+        fileHandle.seekp(offset);
+        fileHandle.write(static_cast<const char*>(data), bytes);
+        error = !fileHandle.good();
+    }
+#endif
+    if (error)
+        throw IOError("Error writing binary mesh file.");
+}
+
+Reader::Reader(JMPI mpi, const std::string& fileName, const char* id,
+               int numElementTables) :
+    mpiInfo(mpi),
+    file(mpi),
+    header(id, numElementTables)
+{
+    file.open(fileName, false);
+
+    // all ranks read the header, piece table, name and tags
+    memset(header.magic, 0, 8);
+    file.readAt(0, &header, sizeof(Header));
+    if (!header.isValid(id))
+        throw IOError("readBinary: not a binary mesh file of this domain type");
+    if (header.version > VERSION)
+        throw IOError("readBinary: unsupported binary mesh format version");
+    // as for dump files, index sizes have to match
+    if (header.indexSize != sizeof(index_t))
+        throw IOError("readBinary: size of index types at runtime differ from mesh file");
+    bool valid = (header.numPieces >= 1 && header.numDim >= 1
+            && header.numDim <= 3 && header.numNodes >= 0
+            && header.numElementTables == numElementTables
+            && header.nameLength >= 0 && header.numTags >= 0
+            && header.tagNamesLength >= 0);
+    for (int i = 0; i < numElementTables; i++) {
+        valid = valid && header.numElements[i] >= 0
+                      && header.numNodesPerElement[i] >= 0;
+    }
+    if (!valid)
+        throw IOError("readBinary: invalid binary mesh file header");
+
+    layout = Layout(header);
+    pieceTable.resize((numElementTables+1)*(header.numPieces+1));
+    file.readAt(layout.pieceTable, &pieceTable[0],
+                pieceTable.size()*sizeof(int64_t));
+    name.assign(header.nameLength, '\0');
+    file.readAt(layout.name, &name[0], header.nameLength);
+    std::vector<int32_t> tagKeys(header.numTags);
+    file.readAt(layout.tagKeys, tagKeys.data(),
+                header.numTags*sizeof(int32_t));
+    std::string tagNames(header.tagNamesLength, '\0');
+    file.readAt(layout.tagNames, &tagNames[0], header.tagNamesLength);
+
+    size_t pos = 0;
+    for (int i = 0; i < header.numTags; i++) {
+        const size_t end = tagNames.find('\0', pos);
+        if (end == std::string::npos)
+            throw IOError("readBinary: invalid tag names in binary mesh file");
+        tagMap[tagNames.substr(pos, end-pos)] = tagKeys[i];
+        pos = end+1;
+    }
+}
+
+std::pair<int64_t,int64_t> Reader::getRange(int table) const
+{
+    const int numPieces = header.numPieces;
+    if (numPieces == mpiInfo->size) {
+        return std::make_pair(
+                pieceTable[INDEX2(mpiInfo->rank,table,numPieces+1)],
+                pieceTable[INDEX2(mpiInfo->rank+1,table,numPieces+1)]);
+    }
+    const int64_t total = pieceTable[INDEX2(numPieces,table,numPieces+1)];
+    const int64_t chunk = total/mpiInfo->size;
+    const int64_t rest = total-chunk*mpiInfo->size;
+    const int64_t first = mpiInfo->rank*chunk + std::min<int64_t>(mpiInfo->rank, rest);
+    const int64_t last = first + chunk + (mpiInfo->rank < rest ? 1 : 0);
+    return std::make_pair(first, last);
+}
+
+dim_t Reader::getNumNodes() const
+{
+    const std::pair<int64_t,int64_t> range(getRange(0));
+    return range.second-range.first;
+}
+
+void Reader::readNodes(index_t* id, index_t* dof, int* tag,
+                       double* coordinates)
+{
+    const int numDim = header.numDim;
+    const int64_t first = getRange(0).first;
+    const dim_t numNodes = getNumNodes();
+    std::vector<int32_t> tags(numNodes);
+    file.readAt(layout.nodeId + first*sizeof(index_t), id,
+                numNodes*sizeof(index_t));
+    file.readAt(layout.nodeDOF + first*sizeof(index_t), dof,
+                numNodes*sizeof(index_t));
+    file.readAt(layout.nodeTag + first*sizeof(int32_t), tags.data(),
+                numNodes*sizeof(int32_t));
+    file.readAt(layout.nodeCoordinates + first*numDim*sizeof(double),
+                coordinates, numNodes*numDim*sizeof(double));
+#pragma omp parallel for
+    for (index_t i = 0; i < numNodes; i++)
+        tag[i] = tags[i];
+}
+
+dim_t Reader::getNumElements(int table) const
+{
+    const std::pair<int64_t,int64_t> range(getRange(table+1));
+    return range.second-range.first;
+}
+
+void Reader::readElements(int table, index_t* id, int* tag, index_t* nodes)
+{
+    const int NN = header.numNodesPerElement[table];
+    const int64_t first = getRange(table+1).first;
+    const dim_t numEle = getNumElements(table);
+    std::vector<int32_t> tags(numEle);
+    file.readAt(layout.elementId[table] + first*sizeof(index_t), id,
+                numEle*sizeof(index_t));
+    file.readAt(layout.elementTag[table] + first*sizeof(int32_t),
+                tags.data(), numEle*sizeof(int32_t));
+    file.readAt(layout.elementNodes[table] + first*NN*sizeof(index_t),
+                nodes, numEle*NN*sizeof(index_t));
+#pragma omp parallel for
+    for (index_t i = 0; i < numEle; i++)
+        tag[i] = tags[i];
+}
+
+Writer::Writer(JMPI mpi, const char* id, int numElementTables, int numDim) :
+    mpiInfo(mpi),
+    header(id, numElementTables)
+{
+    header.numDim = numDim;
+}
+
+void Writer::setOrders(int order, int reducedOrder)
+{
+    header.order = order;
+    header.reducedOrder = reducedOrder;
+}
+
+void Writer::setNodes(const IndexVector& id, const IndexVector& dof,
+                      const std::vector<int32_t>& tag,
+                      const std::vector<double>& coordinates)
+{
+    nodeId = id;
+    nodeDOF = dof;
+    nodeTag = tag;
+    nodeCoordinates = coordinates;
+}
+
+void Writer::setElements(int table, int typeId, int numNodesPerElement,
+                         const IndexVector& id,
+                         const std::vector<int32_t>& tag,
+                         const IndexVector& nodes)
+{
+    header.typeId[table] = typeId;
+    header.numNodesPerElement[table] = numNodesPerElement;
+    elementId[table] = id;
+    elementTag[table] = tag;
+    elementNodes[table] = nodes;
+}
+
+void Writer::write(const std::string& fileName, const std::string& name,
+                   const std::map<std::string,int>& tagMap)
+{
+    const int size = mpiInfo->size;
+    const int rank = mpiInfo->rank;
+    const int numDim = header.numDim;
+    const int numElementTables = header.numElementTables;
+    const int numTables = numElementTables+1;
+
+    // the piece table holds the offsets of the records of each rank
+    std::vector<int64_t> localCounts(numTables);
+    localCounts[0] = nodeId.size();
+    for (int i = 0; i < numElementTables; i++)
+        localCounts[i+1] = elementId[i].size();
+    std::vector<int64_t> counts(numTables*size);
+#ifdef ESYS_MPI
+    MPI_Allgather(&localCounts[0], numTables, MPI_INT64_T, &counts[0],
+                  numTables, MPI_INT64_T, mpiInfo->comm);
+#else
+    counts = localCounts;
+#endif
+    std::vector<int64_t> pieceTable(numTables*(size+1), 0);
+    for (int t = 0; t < numTables; t++) {
+        for (int p = 0; p < size; p++) {
+            pieceTable[INDEX2(p+1,t,size+1)] = pieceTable[INDEX2(p,t,size+1)]
+                                             + counts[INDEX2(t,p,numTables)];
+        }
+    }
+    std::vector<int64_t> offset(numTables);
+    for (int t = 0; t < numTables; t++)
+        offset[t] = pieceTable[INDEX2(rank,t,size+1)];
+
+    header.numPieces = size;
+    header.nameLength = name.length();
+    header.numTags = tagMap.size();
+    header.numNodes = pieceTable[INDEX2(size,0,size+1)];
+    for (int i = 0; i < numElementTables; i++)
+        header.numElements[i] = pieceTable[INDEX2(size,i+1,size+1)];
+    std::vector<int32_t> tagKeys;
+    std::string tagNames;
+    std::map<std::string,int>::const_iterator it;
+    for (it = tagMap.begin(); it != tagMap.end(); it++) {
+        tagKeys.push_back(it->second);
+        tagNames.append(it->first);
+        tagNames.push_back('\0');
+    }
+    header.tagNamesLength = tagNames.length();
+    const Layout layout(header);
+
+    File file(mpiInfo);
+    file.open(fileName, true);
+
+    // the header, name and tags are written by the first rank
+    const bool master = (rank == 0);
+    file.writeAt(0, &header, master ? sizeof(Header) : 0);
+    file.writeAt(layout.pieceTable, &pieceTable[0],
+                 master ? pieceTable.size()*sizeof(int64_t) : 0);
+    file.writeAt(layout.name, name.c_str(), master ? header.nameLength : 0);
+    file.writeAt(layout.tagKeys, tagKeys.empty() ? NULL : &tagKeys[0],
+                 master ? tagKeys.size()*sizeof(int32_t) : 0);
+    file.writeAt(layout.tagNames, tagNames.c_str(),
+                 master ? header.tagNamesLength : 0);
+
+    // all ranks write their pieces of the node and element tables
+    file.writeAt(layout.nodeId + offset[0]*sizeof(index_t), nodeId.data(),
+                 nodeId.size()*sizeof(index_t));
+    file.writeAt(layout.nodeDOF + offset[0]*sizeof(index_t), nodeDOF.data(),
+                 nodeDOF.size()*sizeof(index_t));
+    file.writeAt(layout.nodeTag + offset[0]*sizeof(int32_t), nodeTag.data(),
+                 nodeTag.size()*sizeof(int32_t));
+    file.writeAt(layout.nodeCoordinates + offset[0]*numDim*sizeof(double),
+                 nodeCoordinates.data(), nodeCoordinates.size()*sizeof(double));
+    for (int i = 0; i < numElementTables; i++) {
+        const int NN = header.numNodesPerElement[i];
+        file.writeAt(layout.elementId[i] + offset[i+1]*sizeof(index_t),
+                     elementId[i].data(), elementId[i].size()*sizeof(index_t));
+        file.writeAt(layout.elementTag[i] + offset[i+1]*sizeof(int32_t),
+                     elementTag[i].data(), elementTag[i].size()*sizeof(int32_t));
+        file.writeAt(layout.elementNodes[i] + offset[i+1]*NN*sizeof(index_t),
+                     elementNodes[i].data(),
+                     elementNodes[i].size()*sizeof(index_t));
+    }
+    file.close();
+}
+
+bool isBinaryMesh(JMPI mpiInfo, const std::string& fileName, const char* id,
+                  int* numPieces)
+{
+    int result[2] = { 0, 0 };
+    if (mpiInfo->rank == 0) {
+        std::ifstream f(fileName.c_str(), std::ios::binary);
+        Header header(id, 0);
+        if (f.is_open()) {
+            memset(header.magic, 0, 8);
+            f.read(reinterpret_cast<char*>(&header), sizeof(Header));
+            result[0] = (f.good() && header.isValid(id));
+            result[1] = header.numPieces;
+        }
+    }
+#ifdef ESYS_MPI
+    MPI_Bcast(result, 2, MPI_INT, 0, mpiInfo->comm);
+#endif
+    if (numPieces)
+        *numPieces = result[1];
+    return result[0];
+}
+
+} // namespace binarymesh
+
+} // namespace escript
+
@@ -0,0 +1,295 @@
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+/*
+  Layout of the binary mesh format of the unstructured domains (finley,
+  dudley) which is written and read collectively by all ranks:
+
+    Header          fixed size, see below. The magic string identifies the
+                    domain the file was written by.
+    piece table     (numPieces+1) offsets for the nodes and each of the
+                    numElementTables element tables, i.e.
+                    (numElementTables+1)*(numPieces+1) int64 values.
+                    Piece p of a table holds the records written by rank p.
+    name            nameLength bytes
+    tag keys        numTags int32 values
+    tag names       tagNamesLength bytes, names separated by '\0'
+    nodes           Id[numNodes], globalDOF[numNodes], Tag[numNodes],
+                    Coordinates[numNodes*numDim]
+    element tables  Id[numElements], Tag[numElements],
+                    Nodes[numElements*numNodesPerElement] (node Ids)
+
+  Every array starts at an offset which is a multiple of 8 bytes. Ids use
+  index_t (indexSize bytes), tags int32 and coordinates double in native
+  byte order.
+
+  On a single rank the file is memory mapped for reading where supported,
+  otherwise all ranks access it with collective MPI-IO.
+*/
+
+#ifndef __ESCRIPT_BINARYMESH_H__
+#define __ESCRIPT_BINARYMESH_H__
+
+#include "system_dep.h"
+#include "DataTypes.h"
+#include "EsysMPI.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace escript {
+
+namespace binarymesh {
+
+/// maximum number of element tables a file can hold
+static const int MAX_ELEMENT_TABLES = 4;
+
+/// format version written by this implementation
+static const int32_t VERSION = 1;
+
+struct Header
+{
+    /// creates the header of a file with `numTables` element tables whose
+    /// format is identified by the 8 character string `id`
+    Header(const char* id, int numTables)
+    {
+        memset(this, 0, sizeof(Header));
+        memcpy(magic, id, 8);
+        version = VERSION;
+        indexSize = sizeof(DataTypes::index_t);
+        numElementTables = numTables;
+    }
+
+    /// returns true if the magic string matches `id`
+    bool isValid(const char* id) const { return memcmp(magic, id, 8) == 0; }
+
+    char magic[8];
+    int32_t version;
+    int32_t indexSize;
+    int32_t numDim;
+    int32_t order;
+    int32_t reducedOrder;
+    int32_t numPieces;
+    int32_t nameLength;
+    int32_t numTags;
+    int32_t tagNamesLength;
+    int32_t typeId[MAX_ELEMENT_TABLES];
+    int32_t numNodesPerElement[MAX_ELEMENT_TABLES];
+    int32_t numElementTables;
+    int64_t numNodes;
+    int64_t numElements[MAX_ELEMENT_TABLES];
+};
+
+/// byte offsets of the arrays in a binary mesh file
+struct Layout
+{
+    Layout() { memset(this, 0, sizeof(Layout)); }
+
+    Layout(const Header& h)
+    {
+        int64_t pos = sizeof(Header);
+        pieceTable = pos;
+        pos = align(pos + (h.numElementTables+1)*(h.numPieces+1)*sizeof(int64_t));
+        name = pos;
+        pos = align(pos + h.nameLength);
+        tagKeys = pos;
+        pos = align(pos + h.numTags*sizeof(int32_t));
+        tagNames = pos;
+        pos = align(pos + h.tagNamesLength);
+        nodeId = pos;
+        pos = align(pos + h.numNodes*h.indexSize);
+        nodeDOF = pos;
+        pos = align(pos + h.numNodes*h.indexSize);
+        nodeTag = pos;
+        pos = align(pos + h.numNodes*sizeof(int32_t));
+        nodeCoordinates = pos;
+        pos = align(pos + h.numNodes*h.numDim*sizeof(double));
+        for (int i = 0; i < MAX_ELEMENT_TABLES; i++) {
+            if (i >= h.numElementTables) {
+                elementId[i] = elementTag[i] = elementNodes[i] = pos;
+                continue;
+            }
+            elementId[i] = pos;
+            pos = align(pos + h.numElements[i]*h.indexSize);
+            elementTag[i] = pos;
+            pos = align(pos + h.numElements[i]*sizeof(int32_t));
+            elementNodes[i] = pos;
+            pos = align(pos + h.numElements[i]*h.numNodesPerElement[i]*h.indexSize);
+        }
+        fileSize = pos;
+    }
+
+    static int64_t align(int64_t pos) { return (pos+7) & ~int64_t(7); }
+
+    int64_t pieceTable;
+    int64_t name;
+    int64_t tagKeys;
+    int64_t tagNames;
+    int64_t nodeId;
+    int64_t nodeDOF;
+    int64_t nodeTag;
+    int64_t nodeCoordinates;
+    int64_t elementId[MAX_ELEMENT_TABLES];
+    int64_t elementTag[MAX_ELEMENT_TABLES];
+    int64_t elementNodes[MAX_ELEMENT_TABLES];
+    int64_t fileSize;
+};
+
+/// A file which is opened by all ranks of a communicator. With MPI, reads
+/// and writes are collective MPI-IO operations, i.e. all ranks must call
+/// them in the same order but may pass different offsets and sizes
+/// (including zero). Files opened for reading on a single rank are memory
+/// mapped if possible.
+class ESCRIPT_DLL_API File
+{
+public:
+    File(JMPI mpiInfo);
+    ~File();
+
+    /// opens the file for reading or writing. Throws an IOError on all ranks
+    /// if the file could not be opened.
+    void open(const std::string& fileName, bool write);
+
+    void close();
+
+    void readAt(int64_t offset, void* data, int64_t bytes);
+
+    void writeAt(int64_t offset, const void* data, int64_t bytes);
+
+private:
+    /// maps the file into memory, returns false if that is not possible
+    bool map(const std::string& fileName);
+
+    JMPI mpiInfo;
+#ifdef ESYS_MPI
+    MPI_File fileHandle;
+#else
+    std::fstream fileHandle;
+#endif
+    const char* mappedData;
+    int64_t mappedSize;
+    bool isOpen;
+};
+
+/// Reads the part of a binary mesh file assigned to this rank. If the file
+/// was written by the same number of ranks every rank reads the piece it
+/// wrote, otherwise the records of each table are split evenly. Element
+/// node references are node Ids, i.e. the domain still has to resolve them.
+class ESCRIPT_DLL_API Reader
+{
+public:
+    /// opens `fileName` and reads the header, piece table, name and tags on
+    /// all ranks. Throws an IOError on all ranks if the file is not a binary
+    /// mesh identified by `id` with `numElementTables` element tables.
+    Reader(JMPI mpiInfo, const std::string& fileName, const char* id,
+           int numElementTables);
+
+    const Header& getHeader() const { return header; }
+
+    const std::string& getName() const { return name; }
+
+    /// returns the tag names and keys stored in the file
+    const std::map<std::string,int>& getTagMap() const { return tagMap; }
+
+    /// returns the number of nodes read by this rank
+    DataTypes::dim_t getNumNodes() const;
+
+    /// reads the nodes of this rank into arrays of getNumNodes() entries
+    /// (getNumNodes()*numDim for the coordinates)
+    void readNodes(DataTypes::index_t* id, DataTypes::index_t* dof, int* tag,
+                   double* coordinates);
+
+    /// returns the number of elements of `table` read by this rank
+    DataTypes::dim_t getNumElements(int table) const;
+
+    /// reads the elements of `table` of this rank into arrays of
+    /// getNumElements() entries (times the number of nodes per element for
+    /// `nodes`)
+    void readElements(int table, DataTypes::index_t* id, int* tag,
+                      DataTypes::index_t* nodes);
+
+    void close() { file.close(); }
+
+private:
+    std::pair<int64_t,int64_t> getRange(int table) const;
+
+    JMPI mpiInfo;
+    File file;
+    Header header;
+    Layout layout;
+    std::vector<int64_t> pieceTable;
+    std::string name;
+    std::map<std::string,int> tagMap;
+};
+
+/// Collects the records owned by this rank and writes them collectively as
+/// pieces of a single binary mesh file.
+class ESCRIPT_DLL_API Writer
+{
+public:
+    /// creates a writer for files identified by `id` with
+    /// `numElementTables` element tables
+    Writer(JMPI mpiInfo, const char* id, int numElementTables, int numDim);
+
+    /// stores the integration orders of the domain in the header
+    void setOrders(int order, int reducedOrder);
+
+    /// sets the nodes owned by this rank
+    void setNodes(const DataTypes::IndexVector& id,
+                  const DataTypes::IndexVector& dof,
+                  const std::vector<int32_t>& tag,
+                  const std::vector<double>& coordinates);
+
+    /// sets the element type and the elements of `table` owned by this rank.
+    /// `nodes` holds numNodesPerElement node Ids per element.
+    void setElements(int table, int typeId, int numNodesPerElement,
+                     const DataTypes::IndexVector& id,
+                     const std::vector<int32_t>& tag,
+                     const DataTypes::IndexVector& nodes);
+
+    /// writes the file. Must be called on all ranks.
+    void write(const std::string& fileName, const std::string& name,
+               const std::map<std::string,int>& tagMap);
+
+private:
+    JMPI mpiInfo;
+    Header header;
+    DataTypes::IndexVector nodeId;
+    DataTypes::IndexVector nodeDOF;
+    std::vector<int32_t> nodeTag;
+    std::vector<double> nodeCoordinates;
+    DataTypes::IndexVector elementId[MAX_ELEMENT_TABLES];
+    std::vector<int32_t> elementTag[MAX_ELEMENT_TABLES];
+    DataTypes::IndexVector elementNodes[MAX_ELEMENT_TABLES];
+};
+
+/// returns true if `fileName` is a binary mesh file identified by `id` and
+/// sets numPieces to the number of ranks that wrote it. Must be called on
+/// all ranks.
+ESCRIPT_DLL_API
+bool isBinaryMesh(JMPI mpiInfo, const std::string& fileName, const char* id,
+                  int* numPieces = NULL);
+
+} // namespace binarymesh
+
+} // namespace escript
+
+#endif // __ESCRIPT_BINARYMESH_H__
+
@@ -49,6 +49,7 @@ EscriptParams::EscriptParams()
 #endif
     tooManyLevels = 9;	// this is fairly arbitrary
     tooManyLines = 80;
+    sumFactorization = 1;
 
     // now populate feature set
 #ifdef ESYS_HAVE_CUDA
@@ -60,6 +61,9 @@ EscriptParams::EscriptParams()
 #ifdef ESYS_HAVE_FINLEY
     features.insert("finley");
 #endif
+#ifdef ESYS_HAVE_HDF5
+    features.insert("hdf5");
+#endif
 #ifdef ESYS_HAVE_LAPACK
     features.insert("lapack");
 #endif
@@ -140,6 +144,8 @@ int EscriptParams::getInt(const std::string& name, int sentinel) const
         return tooManyLevels;
     else if (name == "TOO_MANY_LINES")
         return tooManyLines;
+    else if (name == "SUM_FACTORIZATION")
+        return sumFactorization;
 
     return sentinel;
 }
@@ -159,6 +165,8 @@ EscriptParams::setInt(const std::string& name, int value)
         tooManyLevels = value;
     else if (name == "TOO_MANY_LINES")
         tooManyLines = value;
+    else if (name == "SUM_FACTORIZATION")
+        sumFactorization = value;
     else
         throw ValueError("Invalid parameter name - "+name);
 }
@@ -172,6 +180,7 @@ bp::list EscriptParams::listEscriptParams() const
    l.append(bp::make_tuple("RESOLVE_COLLECTIVE", resolveCollective, "(TESTING ONLY) {0.1} Collective operations will resolve their data."));
    l.append(bp::make_tuple("TOO_MANY_LEVELS", tooManyLevels, "(TESTING ONLY) maximum levels allowed in an expression."));
    l.append(bp::make_tuple("TOO_MANY_LINES", tooManyLines, "Maximum number of lines to output when printing data before printing a summary instead."));
+   l.append(bp::make_tuple("SUM_FACTORIZATION", sumFactorization, "(TESTING ONLY) {0,1} finley uses sum factorization for tensor product elements."));
    return l;
 }
 
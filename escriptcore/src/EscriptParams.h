@@ -45,6 +45,7 @@ public:
     inline int getResolveCollective() const { return resolveCollective; }
     inline int getTooManyLevels() const { return tooManyLevels; }
     inline int getTooManyLines() const { return tooManyLines; }
+    inline int getSumFactorization() const { return sumFactorization; }
 
     bool hasFeature(const std::string& name) const;
     boost::python::list listFeatures() const;
@@ -59,6 +60,7 @@ private:
     int resolveCollective;
     int tooManyLevels;
     int tooManyLines;
+    int sumFactorization;
 };
 
 
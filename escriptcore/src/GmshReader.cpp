@@ -0,0 +1,1164 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+/*
+   Parallel reader for Gmsh mesh files.
+
+   ASCII files: every rank reads a contiguous byte range of the file and
+   collects the lines starting in that range. The section markers ($Nodes,
+   $Elements, ...) found by all ranks are exchanged so every rank knows
+   which of its lines belong to which section. For msh 4 files the entity
+   blocks are resolved by passing the state of the current block from rank
+   to rank. The lines are then parsed by OpenMP threads.
+
+   Binary msh 4.1 files: the first rank walks the block headers which only
+   requires seeking over the data. Every rank then reads a contiguous range
+   of node and element records.
+
+   Finally, nodes and elements are redistributed by their Ids.
+*/
+
+#include "GmshReader.h"
+#include "EsysException.h"
+#include "RankExchange.h"
+#include "index.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+namespace escript {
+
+using DataTypes::dim_t;
+using DataTypes::index_t;
+using DataTypes::IndexVector;
+
+namespace {
+
+/// a block of nodes or elements in a msh 4 file
+struct Block
+{
+    /// ASCII: line of the block header in its section,
+    /// binary: file offset of the block data
+    int64_t position;
+    int64_t numRecords;
+    /// index of the first record of the block in its section
+    int64_t firstRecord;
+    int64_t entityTag;
+    /// element type of element blocks
+    int64_t type;
+};
+
+/// number of int64 values in a Block
+const int BLOCK_SIZE = sizeof(Block)/sizeof(int64_t);
+
+/// the lines starting in a byte range of a text file
+struct TextChunk
+{
+    /// returns a pointer to the `i`-th line
+    const char* line(size_t i) const { return &buffer[lines[i]-start]; }
+
+    /// file offset of buffer[0]
+    int64_t start;
+    /// file contents, terminated by '\0'
+    std::vector<char> buffer;
+    /// file offsets of the line starts
+    std::vector<int64_t> lines;
+};
+
+/// section marker line, e.g. "$Nodes"
+struct Marker
+{
+    int64_t offset;
+    /// offset of the line following the marker
+    int64_t next;
+    char name[32];
+};
+
+/// a section of an ASCII file with the lines of this rank
+struct Section
+{
+    Section() : contentStart(-1), contentEnd(-1), first(0), count(0),
+                globalFirst(0) {}
+
+    bool found() const { return contentStart >= 0; }
+
+    int64_t contentStart;
+    int64_t contentEnd;
+    /// first local line and number of local lines in the section
+    size_t first;
+    size_t count;
+    /// index of the first local line within the section
+    int64_t globalFirst;
+};
+
+/// throws an IOError on all ranks if `msg` is not empty on any rank. The
+/// message of the lowest rank with an error is used.
+void checkError(const JMPI& mpiInfo, const std::string& msg)
+{
+    int errorRank = (msg.empty() ? mpiInfo->size : mpiInfo->rank);
+#ifdef ESYS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &errorRank, 1, MPI_INT, MPI_MIN,
+                  mpiInfo->comm);
+#endif
+    if (errorRank == mpiInfo->size)
+        return;
+    std::string errorMsg(msg);
+#ifdef ESYS_MPI
+    int length = msg.length();
+    MPI_Bcast(&length, 1, MPI_INT, errorRank, mpiInfo->comm);
+    errorMsg.resize(length);
+    MPI_Bcast(&errorMsg[0], length, MPI_CHAR, errorRank, mpiInfo->comm);
+#endif
+    throw IOError(errorMsg);
+}
+
+/// broadcasts `values` from the first rank
+template<typename T>
+void broadcast(const JMPI& mpiInfo, std::vector<T>& values)
+{
+#ifdef ESYS_MPI
+    int length = values.size()*sizeof(T);
+    MPI_Bcast(&length, 1, MPI_INT, 0, mpiInfo->comm);
+    values.resize(length/sizeof(T));
+    MPI_Bcast(values.data(), length, MPI_BYTE, 0, mpiInfo->comm);
+#endif
+}
+
+/// returns the distribution of `ids` over the ranks in contiguous ranges
+IndexVector getIdDistribution(const JMPI& mpiInfo, const IndexVector& ids)
+{
+    // stores (-min, max)
+    index_t range[2] = { -DataTypes::index_t_max(), DataTypes::index_t_min() };
+    for (size_t i = 0; i < ids.size(); i++) {
+        range[0] = std::max(range[0], -ids[i]);
+        range[1] = std::max(range[1], ids[i]);
+    }
+#ifdef ESYS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_DIM_T, MPI_MAX, mpiInfo->comm);
+#endif
+    IndexVector distribution(mpiInfo->size+1);
+    mpiInfo->setDistribution(-range[0], range[1], &distribution[0]);
+    return distribution;
+}
+
+/// reads the lines starting in the byte range [lo,hi) of a file
+std::string readTextChunk(const std::string& filename, int64_t fileSize,
+                          int64_t lo, int64_t hi, TextChunk& chunk)
+{
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    if (!f.is_open())
+        return "readGmsh: opening file " + filename + " for reading failed.";
+
+    // include the byte before the range to tell whether a line starts at lo
+    const int64_t begin = std::max<int64_t>(lo-1, 0);
+    std::vector<char>& buffer = chunk.buffer;
+    chunk.start = begin;
+    buffer.resize(hi-begin);
+    f.seekg(begin);
+    f.read(buffer.data(), hi-begin);
+    // complete the last line
+    if (hi > lo && buffer.back() != '\n') {
+        const int64_t pieceSize = 4096;
+        for (int64_t pos = hi; pos < fileSize; pos += pieceSize) {
+            const int64_t n = std::min(pieceSize, fileSize-pos);
+            const size_t old = buffer.size();
+            buffer.resize(old+n);
+            f.read(&buffer[old], n);
+            const char* nl = static_cast<const char*>(
+                                    memchr(&buffer[old], '\n', n));
+            if (nl != NULL) {
+                buffer.resize(nl-buffer.data()+1);
+                break;
+            }
+        }
+    }
+    if (!f)
+        return "readGmsh: error reading file " + filename;
+    buffer.push_back('\0');
+
+    // find line starts, every thread scans a part of the range
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+#endif
+    std::vector<std::vector<int64_t> > lineStarts(numThreads);
+    const char* data = buffer.data();
+#pragma omp parallel for schedule(static,1)
+    for (int t = 0; t < numThreads; t++) {
+        const int64_t a = lo + (hi-lo)*t/numThreads;
+        const int64_t b = lo + (hi-lo)*(t+1)/numThreads;
+        if (a == b)
+            continue;
+        if (a == 0 || data[a-1-begin] == '\n')
+            lineStarts[t].push_back(a);
+        // a newline at offset q in [a,b-1) starts a line at q+1 < b
+        const char* q = data+(a-begin);
+        const char* last = data+(b-1-begin);
+        while (q < last && (q = static_cast<const char*>(
+                                memchr(q, '\n', last-q))) != NULL) {
+            lineStarts[t].push_back(begin+(q-data)+1);
+            q++;
+        }
+    }
+    chunk.lines.clear();
+    for (int t = 0; t < numThreads; t++)
+        chunk.lines.insert(chunk.lines.end(), lineStarts[t].begin(),
+                           lineStarts[t].end());
+    return std::string();
+}
+
+/// returns true if the marker is "$<name>"
+inline bool isMarker(const Marker& m, const char* name)
+{
+    return !strcmp(m.name, name);
+}
+
+/// sets the content range of the section with one of the marker names and
+/// the local lines in the section
+void findSection(const std::vector<Marker>& markers, const char* name1,
+                 const char* name2, const char* name3, int64_t fileSize,
+                 const TextChunk& chunk, Section& section)
+{
+    for (size_t i = 0; i < markers.size(); i++) {
+        const Marker& m = markers[i];
+        if (isMarker(m, name1) || (name2 && isMarker(m, name2))
+                || (name3 && isMarker(m, name3))) {
+            section.contentStart = m.next;
+            section.contentEnd = (i+1 < markers.size() ?
+                                    markers[i+1].offset : fileSize);
+            std::vector<int64_t>::const_iterator a = std::lower_bound(
+                    chunk.lines.begin(), chunk.lines.end(),
+                    section.contentStart);
+            std::vector<int64_t>::const_iterator b = std::lower_bound(
+                    a, chunk.lines.end(), section.contentEnd);
+            section.first = a-chunk.lines.begin();
+            section.count = b-a;
+            return;
+        }
+    }
+}
+
+/// parses the physical names from `f` which is positioned after the
+/// $PhysicalNames marker. The names are appended to `names` as
+/// "tag name\n".
+std::string readPhysicalNames(std::istream& f, std::string& names)
+{
+    std::string line;
+    std::getline(f, line);
+    const int numNames = atoi(line.c_str());
+    std::stringstream ss;
+    for (int i = 0; i < numNames; i++) {
+        if (!std::getline(f, line))
+            return "readGmsh: early EOF while reading physical names";
+        int dim, tag;
+        const size_t q0 = line.find('"');
+        const size_t q1 = line.rfind('"');
+        if (sscanf(line.c_str(), "%d %d", &dim, &tag) != 2
+                || q0 == std::string::npos || q1 == q0)
+            return "readGmsh: illegal physical name '" + line + "'";
+        ss << tag << ' ' << line.substr(q0+1, q1-q0-1) << '\n';
+    }
+    names = ss.str();
+    return std::string();
+}
+
+void setPhysicalNames(const std::string& names, GmshMeshData& data)
+{
+    std::stringstream ss(names);
+    std::string line;
+    while (std::getline(ss, line)) {
+        const size_t space = line.find(' ');
+        data.physicalNames.push_back(std::make_pair(
+                    atoi(line.substr(0, space).c_str()),
+                    line.substr(space+1)));
+    }
+}
+
+/// returns the first number on the line at `offset`
+int64_t readCount(std::ifstream& f, int64_t offset, int field)
+{
+    std::string line;
+    f.clear();
+    f.seekg(offset);
+    std::getline(f, line);
+    std::stringstream ss(line);
+    int64_t value = -1;
+    for (int i = 0; i <= field; i++)
+        ss >> value;
+    return value;
+}
+
+/// determines the blocks of a msh 4 section which have records on this
+/// rank. The state of the current block is passed from rank to rank.
+std::string getBlocks(const JMPI& mpiInfo, const TextChunk& chunk,
+                      const Section& section, bool nodes, double version,
+                      std::vector<Block>& blocks)
+{
+    std::string errorMsg;
+    // lines per record, node tags and coordinates are listed separately in
+    // msh 4.1 files
+    const int linesPerRecord = (nodes && version >= 4.1 ? 2 : 1);
+    // next header line, next record, current block
+    int64_t state[2+BLOCK_SIZE] = { 1, 0, -1, 0, 0, 0, 0 };
+#ifdef ESYS_MPI
+    const int tag = mpiInfo->counter();
+    if (mpiInfo->rank > 0) {
+        MPI_Status status;
+        MPI_Recv(state, 2+BLOCK_SIZE, MPI_INT64_T, mpiInfo->rank-1, tag,
+                 mpiInfo->comm, &status);
+    }
+#endif
+    blocks.clear();
+    if (state[2] >= 0) {
+        Block b;
+        memcpy(&b, &state[2], sizeof(Block));
+        blocks.push_back(b);
+    }
+    const int64_t globalEnd = section.globalFirst + section.count;
+    while (state[0] >= section.globalFirst && state[0] < globalEnd) {
+        const char* s = chunk.line(section.first + state[0] -
+                                   section.globalFirst);
+        long values[4];
+        if (sscanf(s, "%ld %ld %ld %ld", &values[0], &values[1], &values[2],
+                   &values[3]) != 4) {
+            errorMsg = "readGmsh: malformed mesh file (broken block header)";
+            state[0] = -1;
+            break;
+        }
+        // entity dimension and tag are swapped in msh 4.0 files
+        Block b;
+        b.position = state[0];
+        b.numRecords = values[3];
+        b.firstRecord = state[1];
+        b.entityTag = (version >= 4.1 ? values[1] : values[0]);
+        b.type = values[2];
+        if (nodes && b.type != 0) {
+            errorMsg = "readGmsh: parametric node coordinates are not supported";
+            state[0] = -1;
+            break;
+        }
+        blocks.push_back(b);
+        memcpy(&state[2], &b, sizeof(Block));
+        state[0] += 1 + b.numRecords*linesPerRecord;
+        state[1] += b.numRecords;
+    }
+#ifdef ESYS_MPI
+    if (mpiInfo->rank < mpiInfo->size-1) {
+        MPI_Send(state, 2+BLOCK_SIZE, MPI_INT64_T, mpiInfo->rank+1, tag,
+                 mpiInfo->comm);
+    }
+    mpiInfo->incCounter();
+#endif
+    return errorMsg;
+}
+
+/// returns the position of `line` within its block and the block index or
+/// -1 if the line is a block header
+inline int64_t getBlockLine(const std::vector<Block>& blocks, int64_t line,
+                            size_t& blockIndex)
+{
+    while (blockIndex+1 < blocks.size()
+            && blocks[blockIndex+1].position <= line)
+        blockIndex++;
+    return line - blocks[blockIndex].position - 1;
+}
+
+/// parses the node records of an ASCII file into `data`
+void parseAsciiNodes(const JMPI& mpiInfo, const TextChunk& chunk,
+                     const Section& section, int numDim, double version,
+                     int64_t numNodes, GmshMeshData& data)
+{
+    std::string errorMsg;
+    // local lines holding the Ids and coordinates of nodes
+    std::vector<size_t> idLines, coordLines;
+    // node record index of the lines for msh 4.1 files
+    IndexVector idRecords, coordRecords;
+    if (version < 4.) {
+        for (size_t i = 0; i < section.count; i++) {
+            if (section.globalFirst+i > 0)
+                idLines.push_back(section.first+i);
+        }
+        coordLines = idLines;
+    } else {
+        std::vector<Block> blocks;
+        errorMsg = getBlocks(mpiInfo, chunk, section, true, version, blocks);
+        size_t b = 0;
+        for (size_t i = 0; i < section.count && errorMsg.empty(); i++) {
+            const int64_t line = section.globalFirst+i;
+            if (line == 0)
+                continue;
+            if (blocks.empty() || line < blocks[0].position) {
+                errorMsg = "readGmsh: malformed mesh file (broken node section)";
+                break;
+            }
+            const int64_t pos = getBlockLine(blocks, line, b);
+            const Block& block = blocks[b];
+            if (pos < 0) {
+                continue;
+            } else if (version < 4.1) {
+                idLines.push_back(section.first+i);
+                coordLines.push_back(section.first+i);
+            } else if (pos < block.numRecords) {
+                idLines.push_back(section.first+i);
+                idRecords.push_back(block.firstRecord+pos);
+            } else if (pos < 2*block.numRecords) {
+                coordLines.push_back(section.first+i);
+                coordRecords.push_back(block.firstRecord+pos-block.numRecords);
+            } else {
+                errorMsg = "readGmsh: malformed mesh file (broken node section)";
+            }
+        }
+    }
+    checkError(mpiInfo, errorMsg);
+
+    // Id and coordinates of a node are on the same line except for msh 4.1
+    // files where the coordinates of a block follow its Ids
+    const bool sameLine = (version < 4.1);
+    const dim_t numIds = idLines.size();
+    const dim_t numCoords = coordLines.size();
+    IndexVector ids(numIds);
+    std::vector<double> coords(numCoords*numDim);
+    int numErrors = 0;
+#pragma omp parallel for reduction(+:numErrors)
+    for (index_t i = 0; i < numIds; i++) {
+        const char* s = chunk.line(idLines[i]);
+        char* end;
+        ids[i] = strtol(s, &end, 10);
+        if (end == s)
+            numErrors++;
+    }
+#pragma omp parallel for reduction(+:numErrors)
+    for (index_t i = 0; i < numCoords; i++) {
+        const char* s = chunk.line(coordLines[i]);
+        char* end;
+        if (sameLine) {
+            strtol(s, &end, 10);
+            s = end;
+        }
+        for (int j = 0; j < numDim; j++) {
+            coords[INDEX2(j,i,numDim)] = strtod(s, &end);
+            if (end == s)
+                numErrors++;
+            s = end;
+        }
+    }
+    if (numErrors > 0)
+        errorMsg = "readGmsh: malformed mesh file (broken node section)";
+    checkError(mpiInfo, errorMsg);
+
+    if (sameLine) {
+        data.nodeId.swap(ids);
+        data.nodeCoordinates.swap(coords);
+        return;
+    }
+
+    // bring Ids and coordinates of a node together on the rank owning the
+    // node record
+    IndexVector distribution(mpiInfo->size+1);
+    mpiInfo->setDistribution(0, numNodes-1, &distribution[0]);
+    std::vector<int> idDest(numIds), coordDest(numCoords);
+    for (index_t i = 0; i < numIds; i++) {
+        if (idRecords[i] >= numNodes) {
+            errorMsg = "readGmsh: malformed mesh file (too many nodes)";
+            break;
+        }
+        idDest[i] = RankExchange::getOwner(distribution, idRecords[i]);
+    }
+    for (index_t i = 0; i < numCoords; i++) {
+        if (coordRecords[i] >= numNodes) {
+            errorMsg = "readGmsh: malformed mesh file (too many nodes)";
+            break;
+        }
+        coordDest[i] = RankExchange::getOwner(distribution, coordRecords[i]);
+    }
+    checkError(mpiInfo, errorMsg);
+    IndexVector recvIds, recvIdRecords, recvCoordRecords;
+    std::vector<double> recvCoords;
+    {
+        RankExchange exchange(mpiInfo, idDest);
+        exchange.forward(ids.data(), 1, recvIds);
+        exchange.forward(idRecords.data(), 1, recvIdRecords);
+    }
+    {
+        RankExchange exchange(mpiInfo, coordDest);
+        exchange.forward(coords.data(), numDim, recvCoords);
+        exchange.forward(coordRecords.data(), 1, recvCoordRecords);
+    }
+    const index_t firstRecord = distribution[mpiInfo->rank];
+    const dim_t myNumNodes = distribution[mpiInfo->rank+1]-firstRecord;
+    if (recvIds.size() != (size_t)myNumNodes
+            || recvCoordRecords.size() != (size_t)myNumNodes)
+        errorMsg = "readGmsh: malformed mesh file (broken node section)";
+    checkError(mpiInfo, errorMsg);
+    data.nodeId.resize(myNumNodes);
+    data.nodeCoordinates.resize(myNumNodes*numDim);
+#pragma omp parallel for
+    for (index_t i = 0; i < myNumNodes; i++) {
+        data.nodeId[recvIdRecords[i]-firstRecord] = recvIds[i];
+        const index_t k = recvCoordRecords[i]-firstRecord;
+        for (int j = 0; j < numDim; j++)
+            data.nodeCoordinates[INDEX2(j,k,numDim)] =
+                recvCoords[INDEX2(j,i,numDim)];
+    }
+}
+
+/// parses the element records of an ASCII file into `data`
+void parseAsciiElements(const JMPI& mpiInfo, const TextChunk& chunk,
+                        const Section& section, double version,
+                        const std::string& filename, GmshMeshData& data)
+{
+    std::string errorMsg;
+    std::vector<size_t> lines;
+    // msh 4 files: element type, entity tag and record index of the lines
+    std::vector<int> types, tags;
+    IndexVector records;
+    if (version < 4.) {
+        for (size_t i = 0; i < section.count; i++) {
+            if (section.globalFirst+i > 0) {
+                lines.push_back(section.first+i);
+                records.push_back(section.globalFirst+i-1);
+            }
+        }
+    } else {
+        std::vector<Block> blocks;
+        errorMsg = getBlocks(mpiInfo, chunk, section, false, version, blocks);
+        size_t b = 0;
+        for (size_t i = 0; i < section.count && errorMsg.empty(); i++) {
+            const int64_t line = section.globalFirst+i;
+            if (line == 0)
+                continue;
+            if (blocks.empty() || line < blocks[0].position) {
+                errorMsg = "readGmsh: malformed mesh file (broken element section)";
+                break;
+            }
+            const int64_t pos = getBlockLine(blocks, line, b);
+            const Block& block = blocks[b];
+            if (pos < 0) {
+                continue;
+            } else if (pos < block.numRecords) {
+                lines.push_back(section.first+i);
+                types.push_back(block.type);
+                tags.push_back(block.entityTag);
+                records.push_back(block.firstRecord+pos);
+            } else {
+                errorMsg = "readGmsh: malformed mesh file (broken element section)";
+            }
+        }
+    }
+    checkError(mpiInfo, errorMsg);
+
+    const dim_t numElements = lines.size();
+    data.elementId.resize(numElements);
+    data.elementType.resize(numElements);
+    data.elementPhysicalTag.resize(numElements);
+    data.elementEntityTag.resize(numElements);
+    data.elementRecord.swap(records);
+    data.elementNodesOffset.resize(numElements+1);
+
+    // first pass: element types
+    int numErrors = 0;
+#pragma omp parallel for reduction(+:numErrors)
+    for (index_t e = 0; e < numElements; e++) {
+        int type;
+        if (version < 4.) {
+            const char* s = chunk.line(lines[e]);
+            char* end;
+            strtol(s, &end, 10);
+            s = end;
+            type = strtol(s, &end, 10);
+            if (end == s)
+                numErrors++;
+        } else {
+            type = types[e];
+        }
+        data.elementType[e] = type;
+        data.elementNodesOffset[e+1] = getGmshNumNodes(type);
+    }
+    if (numErrors > 0)
+        errorMsg = "readGmsh: malformed mesh file (broken element section)";
+    data.elementNodesOffset[0] = 0;
+    for (index_t e = 0; e < numElements && errorMsg.empty(); e++) {
+        if (data.elementNodesOffset[e+1] < 0) {
+            std::stringstream ss;
+            ss << "readGmsh: Unexpected gmsh element type "
+               << data.elementType[e] << " in mesh file " << filename;
+            errorMsg = ss.str();
+        }
+        data.elementNodesOffset[e+1] += data.elementNodesOffset[e];
+    }
+    checkError(mpiInfo, errorMsg);
+
+    // second pass: Ids, tags and nodes
+    data.elementNodes.resize(data.elementNodesOffset[numElements]);
+#pragma omp parallel for reduction(+:numErrors)
+    for (index_t e = 0; e < numElements; e++) {
+        const char* s = chunk.line(lines[e]);
+        char* end;
+        const int numNodes = data.elementNodesOffset[e+1] -
+                             data.elementNodesOffset[e];
+        data.elementId[e] = strtol(s, &end, 10);
+        if (end == s)
+            numErrors++;
+        s = end;
+        if (version < 4.) {
+            // element type
+            strtol(s, &end, 10);
+            s = end;
+        }
+        if (version <= 1.0) {
+            // physical tag, elementary tag, number of nodes
+            data.elementPhysicalTag[e] = strtol(s, &end, 10);
+            s = end;
+            data.elementEntityTag[e] = strtol(s, &end, 10);
+            s = end;
+            if (strtol(s, &end, 10) != numNodes)
+                numErrors++;
+            s = end;
+        } else if (version < 4.) {
+            // number of tags followed by the tags. A second tag is the
+            // elementary entity, further tags are ignored.
+            const int numTags = strtol(s, &end, 10);
+            s = end;
+            data.elementPhysicalTag[e] = 1;
+            for (int j = 0; j < numTags; j++) {
+                const int tag = strtol(s, &end, 10);
+                s = end;
+                if (j == 0)
+                    data.elementPhysicalTag[e] = tag;
+                else if (j == 1)
+                    data.elementEntityTag[e] = tag;
+            }
+            if (numTags < 2)
+                data.elementEntityTag[e] = data.elementPhysicalTag[e];
+        } else {
+            data.elementPhysicalTag[e] = tags[e];
+            data.elementEntityTag[e] = tags[e];
+        }
+        for (index_t j = data.elementNodesOffset[e];
+                j < data.elementNodesOffset[e+1]; j++) {
+            data.elementNodes[j] = strtol(s, &end, 10);
+            if (end == s)
+                numErrors++;
+            s = end;
+        }
+    }
+    if (numErrors > 0)
+        errorMsg = "readGmsh: malformed mesh file (broken element section)";
+    checkError(mpiInfo, errorMsg);
+}
+
+/// reads an ASCII file
+void readAscii(const JMPI& mpiInfo, const std::string& filename, int numDim,
+               double version, int64_t fileSize, GmshMeshData& data)
+{
+    const int rank = mpiInfo->rank;
+    const int size = mpiInfo->size;
+    TextChunk chunk;
+    std::string errorMsg = readTextChunk(filename, fileSize,
+                                         fileSize*rank/size,
+                                         fileSize*(rank+1)/size, chunk);
+    checkError(mpiInfo, errorMsg);
+
+    // collect the section markers of all ranks
+    std::vector<Marker> markers;
+    for (size_t i = 0; i < chunk.lines.size(); i++) {
+        const char* s = chunk.line(i);
+        if (s[0] != '$')
+            continue;
+        Marker m;
+        memset(&m, 0, sizeof(Marker));
+        m.offset = chunk.lines[i];
+        m.next = m.offset + (strchr(s, '\n') ? strchr(s, '\n')-s+1 : strlen(s));
+        for (int j = 0; j < 31 && s[j+1] > ' '; j++)
+            m.name[j] = s[j+1];
+        markers.push_back(m);
+    }
+#ifdef ESYS_MPI
+    {
+        int myCount = markers.size()*sizeof(Marker);
+        std::vector<int> counts(size), offsets(size+1, 0);
+        MPI_Allgather(&myCount, 1, MPI_INT, &counts[0], 1, MPI_INT,
+                      mpiInfo->comm);
+        for (int p = 0; p < size; p++)
+            offsets[p+1] = offsets[p] + counts[p];
+        std::vector<Marker> allMarkers(offsets[size]/sizeof(Marker));
+        MPI_Allgatherv(markers.data(), myCount, MPI_BYTE, allMarkers.data(),
+                       &counts[0], &offsets[0], MPI_BYTE, mpiInfo->comm);
+        markers.swap(allMarkers);
+    }
+#endif
+
+    Section nodeSection, elementSection, nameSection;
+    findSection(markers, "Nodes", "NOD", "NOE", fileSize, chunk, nodeSection);
+    findSection(markers, "Elements", "ELM", NULL, fileSize, chunk,
+                elementSection);
+    findSection(markers, "PhysicalNames", NULL, NULL, fileSize, chunk,
+                nameSection);
+    if (!nodeSection.found())
+        throw IOError("EOF before nodes section found");
+    if (!elementSection.found())
+        throw IOError("EOF before elements section found");
+    int64_t offsets[2] = { 0, 0 };
+#ifdef ESYS_MPI
+    int64_t localCounts[2] = { (int64_t)nodeSection.count,
+                               (int64_t)elementSection.count };
+    MPI_Exscan(localCounts, offsets, 2, MPI_INT64_T, MPI_SUM, mpiInfo->comm);
+    if (rank == 0)
+        offsets[0] = offsets[1] = 0;
+#endif
+    nodeSection.globalFirst = offsets[0];
+    elementSection.globalFirst = offsets[1];
+
+    // the first rank reads the physical names and the section headers
+    std::string names;
+    std::vector<int64_t> counts(2, -1);
+    if (rank == 0) {
+        std::ifstream f(filename.c_str(), std::ios::binary);
+        if (nameSection.found()) {
+            f.seekg(nameSection.contentStart);
+            errorMsg = readPhysicalNames(f, names);
+        }
+        // the number of nodes or elements is the second entry in msh 4 files
+        counts[0] = readCount(f, nodeSection.contentStart, version < 4. ? 0 : 1);
+        counts[1] = readCount(f, elementSection.contentStart, version < 4. ? 0 : 1);
+    }
+    checkError(mpiInfo, errorMsg);
+    std::vector<char> nameBuffer(names.begin(), names.end());
+    broadcast(mpiInfo, nameBuffer);
+    broadcast(mpiInfo, counts);
+    setPhysicalNames(std::string(nameBuffer.begin(), nameBuffer.end()), data);
+
+    parseAsciiNodes(mpiInfo, chunk, nodeSection, numDim, version, counts[0],
+                    data);
+    parseAsciiElements(mpiInfo, chunk, elementSection, version, filename,
+                       data);
+}
+
+/// reads `count` values of type T at `offset`
+template<typename T>
+bool readAt(std::ifstream& f, int64_t offset, T* values, int64_t count)
+{
+    if (count == 0)
+        return true;
+    f.seekg(offset);
+    f.read(reinterpret_cast<char*>(values), count*sizeof(T));
+    return f.good();
+}
+
+/// skips to the line following "$End<name>"
+bool skipSection(std::ifstream& f, const std::string& name)
+{
+    const std::string endMarker("$End" + name);
+    std::vector<char> buffer(1<<16);
+    std::streamoff pos = f.tellg();
+    while (f) {
+        f.read(buffer.data(), buffer.size());
+        const std::streamsize n = f.gcount();
+        if (n <= 0)
+            break;
+        std::vector<char>::iterator it = std::search(buffer.begin(),
+                buffer.begin()+n, endMarker.begin(), endMarker.end());
+        if (it != buffer.begin()+n) {
+            f.clear();
+            f.seekg(pos + (it-buffer.begin()));
+            std::string line;
+            std::getline(f, line);
+            return true;
+        }
+        // the marker may span two reads
+        if (n < (std::streamsize)endMarker.length())
+            break;
+        pos += n - endMarker.length();
+        f.clear();
+        f.seekg(pos);
+    }
+    return false;
+}
+
+/// walks the block headers of the binary $Nodes or $Elements section at the
+/// current position of `f`
+std::string getBinaryBlocks(std::ifstream& f, bool nodes,
+                            std::vector<Block>& blocks)
+{
+    uint64_t header[4];
+    f.read(reinterpret_cast<char*>(header), sizeof(header));
+    int64_t record = 0;
+    for (uint64_t b = 0; b < header[0] && f.good(); b++) {
+        // entity dimension, entity tag, parametric flag / element type,
+        // number of records
+        int32_t values[3];
+        uint64_t numRecords;
+        f.read(reinterpret_cast<char*>(values), sizeof(values));
+        f.read(reinterpret_cast<char*>(&numRecords), sizeof(numRecords));
+        Block block;
+        block.position = f.tellg();
+        block.numRecords = numRecords;
+        block.firstRecord = record;
+        block.entityTag = values[1];
+        block.type = values[2];
+        int64_t recordSize;
+        if (nodes) {
+            if (block.type != 0)
+                return "readGmsh: parametric node coordinates are not supported";
+            // tags followed by coordinates
+            recordSize = sizeof(uint64_t) + 3*sizeof(double);
+        } else {
+            const int numNodes = getGmshNumNodes(block.type);
+            if (numNodes < 0) {
+                std::stringstream ss;
+                ss << "readGmsh: Unexpected gmsh element type " << block.type;
+                return ss.str();
+            }
+            recordSize = (1+numNodes)*sizeof(uint64_t);
+        }
+        blocks.push_back(block);
+        record += numRecords;
+        f.seekg(block.position + numRecords*recordSize);
+    }
+    if (!f.good() || record != (int64_t)header[1])
+        return "readGmsh: early EOF while reading binary mesh file";
+    return std::string();
+}
+
+/// reads a binary msh 4.1 file
+void readBinary(const JMPI& mpiInfo, const std::string& filename, int numDim,
+                GmshMeshData& data)
+{
+    std::string errorMsg, names;
+    std::vector<Block> nodeBlocks, elementBlocks;
+    if (mpiInfo->rank == 0) {
+        std::ifstream f(filename.c_str(), std::ios::binary);
+        std::string line;
+        // $MeshFormat, version line, endianness check
+        std::getline(f, line);
+        std::getline(f, line);
+        int32_t one = 0;
+        f.read(reinterpret_cast<char*>(&one), sizeof(one));
+        if (one != 1)
+            errorMsg = "readGmsh: binary mesh files with different byte order are not supported";
+        while (errorMsg.empty() && std::getline(f, line)) {
+            if (line.empty() || line[0] != '$')
+                continue;
+            std::string name(line.substr(1));
+            name.erase(name.find_last_not_of(" \r")+1);
+            if (name.compare(0, 3, "End") == 0) {
+                continue;
+            } else if (name == "PhysicalNames") {
+                errorMsg = readPhysicalNames(f, names);
+            } else if (name == "Nodes") {
+                errorMsg = getBinaryBlocks(f, true, nodeBlocks);
+            } else if (name == "Elements") {
+                errorMsg = getBinaryBlocks(f, false, elementBlocks);
+            } else if (!skipSection(f, name)) {
+                errorMsg = "readGmsh: early EOF while reading binary mesh file";
+            }
+        }
+        if (errorMsg.empty() && nodeBlocks.empty())
+            errorMsg = "EOF before nodes section found";
+        else if (errorMsg.empty() && elementBlocks.empty())
+            errorMsg = "EOF before elements section found";
+    }
+    checkError(mpiInfo, errorMsg);
+    std::vector<char> nameBuffer(names.begin(), names.end());
+    broadcast(mpiInfo, nameBuffer);
+    broadcast(mpiInfo, nodeBlocks);
+    broadcast(mpiInfo, elementBlocks);
+    setPhysicalNames(std::string(nameBuffer.begin(), nameBuffer.end()), data);
+
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    // every rank reads a contiguous range of node records
+    const Block& lastNodeBlock = nodeBlocks.back();
+    IndexVector distribution(mpiInfo->size+1);
+    mpiInfo->setDistribution(0, lastNodeBlock.firstRecord +
+                             lastNodeBlock.numRecords-1, &distribution[0]);
+    int64_t first = distribution[mpiInfo->rank];
+    int64_t last = distribution[mpiInfo->rank+1];
+    std::vector<uint64_t> tags;
+    std::vector<double> coords;
+    for (size_t b = 0; b < nodeBlocks.size() && errorMsg.empty(); b++) {
+        const Block& block = nodeBlocks[b];
+        const int64_t s = std::max(first, block.firstRecord);
+        const int64_t e = std::min(last, block.firstRecord+block.numRecords);
+        if (s >= e)
+            continue;
+        const int64_t n = e-s;
+        tags.resize(n);
+        coords.resize(3*n);
+        if (!readAt(f, block.position + (s-block.firstRecord)*sizeof(uint64_t),
+                    tags.data(), n)
+                || !readAt(f, block.position + block.numRecords*sizeof(uint64_t)
+                           + (s-block.firstRecord)*3*sizeof(double),
+                           coords.data(), 3*n)) {
+            errorMsg = "readGmsh: error reading binary mesh file";
+            break;
+        }
+        const size_t offset = data.nodeId.size();
+        data.nodeId.resize(offset+n);
+        data.nodeCoordinates.resize((offset+n)*numDim);
+#pragma omp parallel for
+        for (index_t i = 0; i < n; i++) {
+            data.nodeId[offset+i] = tags[i];
+            for (int j = 0; j < numDim; j++)
+                data.nodeCoordinates[INDEX2(j,offset+i,numDim)] = coords[3*i+j];
+        }
+    }
+    checkError(mpiInfo, errorMsg);
+
+    // element records
+    const Block& lastElementBlock = elementBlocks.back();
+    mpiInfo->setDistribution(0, lastElementBlock.firstRecord +
+                             lastElementBlock.numRecords-1, &distribution[0]);
+    first = distribution[mpiInfo->rank];
+    last = distribution[mpiInfo->rank+1];
+    data.elementNodesOffset.assign(1, 0);
+    std::vector<uint64_t> values;
+    for (size_t b = 0; b < elementBlocks.size() && errorMsg.empty(); b++) {
+        const Block& block = elementBlocks[b];
+        const int64_t s = std::max(first, block.firstRecord);
+        const int64_t e = std::min(last, block.firstRecord+block.numRecords);
+        if (s >= e)
+            continue;
+        const int64_t n = e-s;
+        const int numNodes = getGmshNumNodes(block.type);
+        values.resize(n*(1+numNodes));
+        if (!readAt(f, block.position + (s-block.firstRecord)*(1+numNodes)*
+                    sizeof(uint64_t), values.data(), n*(1+numNodes))) {
+            errorMsg = "readGmsh: error reading binary mesh file";
+            break;
+        }
+        const size_t offset = data.elementId.size();
+        const index_t nodeOffset = data.elementNodesOffset.back();
+        data.elementId.resize(offset+n);
+        data.elementType.resize(offset+n, block.type);
+        data.elementPhysicalTag.resize(offset+n, block.entityTag);
+        data.elementEntityTag.resize(offset+n, block.entityTag);
+        data.elementRecord.resize(offset+n);
+        data.elementNodesOffset.resize(offset+n+1);
+        data.elementNodes.resize(nodeOffset+n*numNodes);
+#pragma omp parallel for
+        for (index_t i = 0; i < n; i++) {
+            data.elementId[offset+i] = values[i*(1+numNodes)];
+            data.elementRecord[offset+i] = s+i;
+            data.elementNodesOffset[offset+i+1] = nodeOffset+(i+1)*numNodes;
+            for (int j = 0; j < numNodes; j++)
+                data.elementNodes[nodeOffset+i*numNodes+j] =
+                    values[i*(1+numNodes)+1+j];
+        }
+    }
+    checkError(mpiInfo, errorMsg);
+}
+
+/// redistributes nodes and elements by their Ids
+void distributeById(const JMPI& mpiInfo, int numDim, const GmshMeshData& in,
+                    GmshMeshData& out)
+{
+    out.version = in.version;
+    out.physicalNames = in.physicalNames;
+
+    // nodes, sorted by Id
+    {
+        const IndexVector distribution(getIdDistribution(mpiInfo, in.nodeId));
+        const dim_t numNodes = in.nodeId.size();
+        std::vector<int> dest(numNodes);
+#pragma omp parallel for
+        for (index_t i = 0; i < numNodes; i++)
+            dest[i] = RankExchange::getOwner(distribution, in.nodeId[i]);
+        RankExchange exchange(mpiInfo, dest);
+        IndexVector ids;
+        std::vector<double> coords;
+        exchange.forward(in.nodeId.data(), 1, ids);
+        exchange.forward(in.nodeCoordinates.data(), numDim, coords);
+        const dim_t n = ids.size();
+        std::vector<std::pair<index_t,index_t> > order(n);
+#pragma omp parallel for
+        for (index_t i = 0; i < n; i++)
+            order[i] = std::make_pair(ids[i], i);
+        std::sort(order.begin(), order.end());
+        out.nodeId.resize(n);
+        out.nodeCoordinates.resize(n*numDim);
+#pragma omp parallel for
+        for (index_t i = 0; i < n; i++) {
+            out.nodeId[i] = order[i].first;
+            for (int j = 0; j < numDim; j++)
+                out.nodeCoordinates[INDEX2(j,i,numDim)] =
+                    coords[INDEX2(j,order[i].second,numDim)];
+        }
+    }
+
+    // elements
+    {
+        const IndexVector distribution(getIdDistribution(mpiInfo, in.elementId));
+        const dim_t numElements = in.elementId.size();
+        std::vector<int> dest(numElements);
+        IndexVector numNodes(numElements);
+#pragma omp parallel for
+        for (index_t e = 0; e < numElements; e++) {
+            dest[e] = RankExchange::getOwner(distribution, in.elementId[e]);
+            numNodes[e] = in.elementNodesOffset[e+1]-in.elementNodesOffset[e];
+        }
+        IndexVector recvNumNodes;
+        {
+            RankExchange exchange(mpiInfo, dest);
+            exchange.forward(in.elementId.data(), 1, out.elementId);
+            exchange.forward(in.elementType.data(), 1, out.elementType);
+            exchange.forward(in.elementPhysicalTag.data(), 1,
+                             out.elementPhysicalTag);
+            exchange.forward(in.elementEntityTag.data(), 1, out.elementEntityTag);
+            exchange.forward(in.elementRecord.data(), 1, out.elementRecord);
+            exchange.forward(numNodes.data(), 1, recvNumNodes);
+        }
+        const dim_t n = out.elementId.size();
+        out.elementNodesOffset.resize(n+1);
+        out.elementNodesOffset[0] = 0;
+        for (index_t e = 0; e < n; e++)
+            out.elementNodesOffset[e+1] = out.elementNodesOffset[e] +
+                                          recvNumNodes[e];
+
+        // the nodes of an element are sent to the same rank as the element
+        // and arrive in the same order
+        std::vector<int> nodeDest(in.elementNodes.size());
+#pragma omp parallel for
+        for (index_t e = 0; e < numElements; e++)
+            for (index_t j = in.elementNodesOffset[e];
+                    j < in.elementNodesOffset[e+1]; j++)
+                nodeDest[j] = dest[e];
+        RankExchange exchange(mpiInfo, nodeDest);
+        exchange.forward(in.elementNodes.data(), 1, out.elementNodes);
+    }
+}
+
+} // anonymous namespace
+
+int getGmshNumNodes(int gmshType)
+{
+    switch (gmshType) {
+        case 1: return 2;   // line order 1
+        case 2: return 3;   // triangle order 1
+        case 3: return 4;   // quadrilateral order 1
+        case 4: return 4;   // tetrahedron order 1
+        case 5: return 8;   // hexahedron order 1
+        case 8: return 3;   // line order 2
+        case 9: return 6;   // triangle order 2
+        case 10: return 9;  // quadrilateral order 2
+        case 11: return 10; // tetrahedron order 2
+        case 15: return 1;  // point
+        case 16: return 8;  // quadrilateral order 2 (serendipity)
+        case 17: return 20; // hexahedron order 2 (serendipity)
+        default: return -1;
+    }
+}
+
+void readGmshFile(JMPI mpiInfo, const std::string& filename, int numDim,
+                  GmshMeshData& data)
+{
+    // the first rank determines the format
+    std::string errorMsg;
+    // version, file type (0=ASCII, 1=binary), data size, file size
+    double format[4] = { 1.0, 0., sizeof(double), 0. };
+    if (mpiInfo->rank == 0) {
+        std::ifstream f(filename.c_str(), std::ios::binary);
+        if (!f.is_open()) {
+            errorMsg = "readGmsh: opening file " + filename + " for reading failed.";
+        } else {
+            std::string line;
+            std::getline(f, line);
+            // msh 1 files have no $MeshFormat section
+            if (line.compare(0, 11, "$MeshFormat") == 0) {
+                std::getline(f, line);
+                if (sscanf(line.c_str(), "%lf %lf %lf", &format[0], &format[1],
+                           &format[2]) != 3)
+                    errorMsg = "readGmsh: malformed mesh file ($MeshFormat)";
+            }
+            f.seekg(0, std::ios::end);
+            format[3] = f.tellg();
+        }
+        if (errorMsg.empty() && format[1] != 0. &&
+                (format[0] < 4.1 || format[2] != sizeof(uint64_t)))
+            errorMsg = "readGmsh: binary mesh files are only supported for msh format 4.1";
+    }
+    checkError(mpiInfo, errorMsg);
+#ifdef ESYS_MPI
+    MPI_Bcast(format, 4, MPI_DOUBLE, 0, mpiInfo->comm);
+#endif
+    GmshMeshData local;
+    local.version = format[0];
+    if (format[1] == 0.) {
+        readAscii(mpiInfo, filename, numDim, format[0],
+                  static_cast<int64_t>(format[3]), local);
+    } else {
+        readBinary(mpiInfo, filename, numDim, local);
+    }
+    distributeById(mpiInfo, numDim, local, data);
+}
+
+void getGmshNodeTags(JMPI mpiInfo, const GmshMeshData& data,
+                     std::vector<int>& nodeTags)
+{
+    // send (node Id, element record, element tag) to the rank owning the
+    // node. The nodes are distributed by Id in readGmshFile().
+    const IndexVector distribution(getIdDistribution(mpiInfo, data.nodeId));
+    const dim_t numElements = data.elementId.size();
+    const dim_t numEntries = data.elementNodes.size();
+    std::vector<int> dest(numEntries);
+    IndexVector entries(3*numEntries);
+#pragma omp parallel for
+    for (index_t e = 0; e < numElements; e++) {
+        for (index_t j = data.elementNodesOffset[e];
+                j < data.elementNodesOffset[e+1]; j++) {
+            dest[j] = RankExchange::getOwner(distribution, data.elementNodes[j]);
+            entries[3*j] = data.elementNodes[j];
+            entries[3*j+1] = data.elementRecord[e];
+            entries[3*j+2] = data.elementPhysicalTag[e];
+        }
+    }
+    IndexVector received;
+    {
+        RankExchange exchange(mpiInfo, dest);
+        exchange.forward(entries.data(), 3, received);
+    }
+
+    // the first element in file order with a non-zero tag tags the node
+    std::string errorMsg;
+    const dim_t numNodes = data.nodeId.size();
+    IndexVector firstRecord(numNodes, DataTypes::index_t_max());
+    nodeTags.assign(numNodes, -1);
+    for (size_t i = 0; i < received.size(); i += 3) {
+        const index_t id = received[i];
+        IndexVector::const_iterator it = std::lower_bound(
+                data.nodeId.begin(), data.nodeId.end(), id);
+        if (it == data.nodeId.end() || *it != id) {
+            std::stringstream ss;
+            ss << "readGmsh: element contains unknown node (node " << id
+               << ")";
+            errorMsg = ss.str();
+            break;
+        }
+        const index_t k = it - data.nodeId.begin();
+        if (received[i+2] != 0 && received[i+1] < firstRecord[k]) {
+            firstRecord[k] = received[i+1];
+            nodeTags[k] = received[i+2];
+        }
+    }
+    checkError(mpiInfo, errorMsg);
+}
+
+} // namespace escript
+
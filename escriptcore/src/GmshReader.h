@@ -0,0 +1,102 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __ESCRIPT_GMSHREADER_H__
+#define __ESCRIPT_GMSHREADER_H__
+
+#include "system_dep.h"
+#include "DataTypes.h"
+#include "EsysMPI.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace escript {
+
+/**
+    \brief
+    Nodes and elements of a Gmsh mesh file as returned by readGmshFile().
+
+    The nodes are distributed over the ranks by their Id and are sorted by
+    Id on each rank. Elements are distributed by their Id as well. Node and
+    element Ids are the ones used in the file.
+*/
+struct GmshMeshData
+{
+    /// version of the msh format, e.g. 2.2 or 4.1
+    double version;
+
+    /// (tag, name) pairs of the $PhysicalNames section
+    std::vector<std::pair<int, std::string> > physicalNames;
+
+    DataTypes::IndexVector nodeId;
+    /// numDim coordinates per node
+    std::vector<double> nodeCoordinates;
+
+    DataTypes::IndexVector elementId;
+    /// Gmsh element type, e.g. 4 for 4-node tetrahedra
+    std::vector<int> elementType;
+    /// first tag of an element in msh 1 and 2 files (physical entity),
+    /// the entity tag of the element block in msh 4 files
+    std::vector<int> elementPhysicalTag;
+    /// second tag of an element in msh 1 and 2 files (elementary entity)
+    /// or the physical tag if there is none
+    std::vector<int> elementEntityTag;
+    /// position of an element in the $Elements section
+    DataTypes::IndexVector elementRecord;
+    /// the node Ids of element e in Gmsh order are
+    /// elementNodes[elementNodesOffset[e]:elementNodesOffset[e+1]]
+    DataTypes::IndexVector elementNodesOffset;
+    DataTypes::IndexVector elementNodes;
+};
+
+/// returns the number of nodes of the Gmsh element type `gmshType` or -1 if
+/// the element type is not supported
+ESCRIPT_DLL_API
+int getGmshNumNodes(int gmshType);
+
+/**
+    \brief
+    reads the Gmsh mesh file `filename` on all ranks of `mpiInfo`.
+
+    Every rank parses a contiguous byte range of the file (ASCII msh 1, 2
+    and 4 files) or a contiguous range of the node and element records
+    (binary msh 4.1 files) using OpenMP threads. The nodes and elements are
+    then redistributed by their Ids. Only the first `numDim` coordinates of
+    the nodes are kept. Throws an IOError on all ranks if the file is
+    malformed.
+*/
+ESCRIPT_DLL_API
+void readGmshFile(JMPI mpiInfo, const std::string& filename, int numDim,
+                  GmshMeshData& data);
+
+/**
+    \brief
+    returns the physical tag of the first element in file order with a
+    non-zero physical tag that references a node for all nodes of `data`,
+    or -1 if there is no such element. Throws an IOError on all ranks if an
+    element references a node that is not defined.
+*/
+ESCRIPT_DLL_API
+void getGmshNodeTags(JMPI mpiInfo, const GmshMeshData& data,
+                     std::vector<int>& nodeTags);
+
+} // namespace escript
+
+#endif // __ESCRIPT_GMSHREADER_H__
+
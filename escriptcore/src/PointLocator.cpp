@@ -0,0 +1,268 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "PointLocator.h"
+#include "EsysException.h"
+#include "index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace escript {
+
+using DataTypes::dim_t;
+using DataTypes::index_t;
+using DataTypes::IndexVector;
+
+/// upper limit for the number of cells in one direction
+static const int MAX_CELLS = 1<<20;
+
+/// relative enlargement of the element bounding boxes
+static const double BOX_TOLERANCE = 1e-8;
+
+PointLocator::PointLocator(int dim, dim_t numNodes, const double* coords,
+                           dim_t numElements, int numElementNodes,
+                           const index_t* elementNodes) :
+    numDim(dim),
+    coordinates(coords)
+{
+    if (numDim < 1 || numDim > 3)
+        throw ValueError("PointLocator: only 1, 2 and 3 dimensions are supported.");
+
+    // bounding box of the nodes
+    double maxX[3];
+    for (int j = 0; j < 3; j++) {
+        origin[j] = (j < numDim && numNodes > 0 ?
+                        std::numeric_limits<double>::max() : 0.);
+        maxX[j] = (j < numDim && numNodes > 0 ?
+                        -std::numeric_limits<double>::max() : 0.);
+    }
+#pragma omp parallel
+    {
+        double localMin[3], localMax[3];
+        for (int j = 0; j < numDim; j++) {
+            localMin[j] = origin[j];
+            localMax[j] = maxX[j];
+        }
+#pragma omp for
+        for (index_t n = 0; n < numNodes; n++) {
+            for (int j = 0; j < numDim; j++) {
+                localMin[j] = std::min(localMin[j], coords[INDEX2(j, n, numDim)]);
+                localMax[j] = std::max(localMax[j], coords[INDEX2(j, n, numDim)]);
+            }
+        }
+#pragma omp critical
+        for (int j = 0; j < numDim; j++) {
+            origin[j] = std::min(origin[j], localMin[j]);
+            maxX[j] = std::max(maxX[j], localMax[j]);
+        }
+    }
+
+    // choose the cell size for roughly one element per cell
+    double volume = 1.;
+    double diameter = 0.;
+    int numExtended = 0;
+    for (int j = 0; j < numDim; j++) {
+        const double extent = maxX[j]-origin[j];
+        if (extent > 0.) {
+            volume *= extent;
+            numExtended++;
+        }
+        diameter = std::max(diameter, extent);
+    }
+    const double target = static_cast<double>(std::max(numElements, dim_t(1)));
+    const double h = (numExtended > 0 ?
+                        std::pow(volume/target, 1./numExtended) : 1.);
+    for (int j = 0; j < 3; j++) {
+        const double extent = (j < numDim ? maxX[j]-origin[j] : 0.);
+        if (extent > 0.) {
+            numCells[j] = static_cast<int>(std::min(std::ceil(extent/h),
+                                            static_cast<double>(MAX_CELLS)));
+            numCells[j] = std::max(numCells[j], 1);
+            cellSize[j] = extent/numCells[j];
+        } else {
+            numCells[j] = 1;
+            cellSize[j] = 1.;
+        }
+    }
+    const dim_t totalCells = dim_t(numCells[0])*numCells[1]*numCells[2];
+
+    // sort the nodes into the cells keeping them in ascending order
+    IndexVector nodeCell(numNodes);
+#pragma omp parallel for
+    for (index_t n = 0; n < numNodes; n++) {
+        const double* x = &coords[INDEX2(0, n, numDim)];
+        nodeCell[n] = INDEX3(getCell(x, 0), getCell(x, 1), getCell(x, 2),
+                             numCells[0], numCells[1]);
+    }
+    nodeOffset.assign(totalCells+1, 0);
+    for (index_t n = 0; n < numNodes; n++)
+        nodeOffset[nodeCell[n]+1]++;
+    for (index_t c = 0; c < totalCells; c++)
+        nodeOffset[c+1] += nodeOffset[c];
+    cellNodes.resize(numNodes);
+    IndexVector pos(nodeOffset.begin(), nodeOffset.end()-1);
+    for (index_t n = 0; n < numNodes; n++)
+        cellNodes[pos[nodeCell[n]]++] = n;
+
+    // element bounding boxes and the range of cells they overlap
+    const double eps = BOX_TOLERANCE*diameter;
+    boxes.resize(2*numDim*numElements);
+    std::vector<int> cellRange(6*numElements);
+#pragma omp parallel for
+    for (index_t e = 0; e < numElements; e++) {
+        double* box = &boxes[INDEX2(0, e, 2*numDim)];
+        for (int j = 0; j < numDim; j++) {
+            box[j] = std::numeric_limits<double>::max();
+            box[numDim+j] = -std::numeric_limits<double>::max();
+        }
+        for (int i = 0; i < numElementNodes; i++) {
+            const index_t n = elementNodes[INDEX2(i, e, numElementNodes)];
+            for (int j = 0; j < numDim; j++) {
+                box[j] = std::min(box[j], coords[INDEX2(j, n, numDim)]);
+                box[numDim+j] = std::max(box[numDim+j], coords[INDEX2(j, n, numDim)]);
+            }
+        }
+        double lo[3] = { 0., 0., 0. }, hi[3] = { 0., 0., 0. };
+        for (int j = 0; j < numDim; j++) {
+            box[j] -= eps;
+            box[numDim+j] += eps;
+            lo[j] = box[j];
+            hi[j] = box[numDim+j];
+        }
+        for (int j = 0; j < 3; j++) {
+            cellRange[INDEX2(j, e, 6)] = getCell(lo, j);
+            cellRange[INDEX2(3+j, e, 6)] = getCell(hi, j);
+        }
+    }
+
+    // sort the elements into the cells they overlap
+    elementOffset.assign(totalCells+1, 0);
+    for (index_t e = 0; e < numElements; e++) {
+        const int* r = &cellRange[INDEX2(0, e, 6)];
+        for (int i2 = r[2]; i2 <= r[5]; i2++)
+            for (int i1 = r[1]; i1 <= r[4]; i1++)
+                for (int i0 = r[0]; i0 <= r[3]; i0++)
+                    elementOffset[INDEX3(i0, i1, i2, numCells[0], numCells[1])+1]++;
+    }
+    for (index_t c = 0; c < totalCells; c++)
+        elementOffset[c+1] += elementOffset[c];
+    cellElements.resize(elementOffset[totalCells]);
+    pos.assign(elementOffset.begin(), elementOffset.end()-1);
+    for (index_t e = 0; e < numElements; e++) {
+        const int* r = &cellRange[INDEX2(0, e, 6)];
+        for (int i2 = r[2]; i2 <= r[5]; i2++)
+            for (int i1 = r[1]; i1 <= r[4]; i1++)
+                for (int i0 = r[0]; i0 <= r[3]; i0++)
+                    cellElements[pos[INDEX3(i0, i1, i2, numCells[0], numCells[1])]++] = e;
+    }
+}
+
+int PointLocator::getCell(const double* x, int d) const
+{
+    if (d >= numDim)
+        return 0;
+    const double c = std::floor((x[d]-origin[d])/cellSize[d]);
+    return static_cast<int>(std::max(0., std::min(c, numCells[d]-1.)));
+}
+
+index_t PointLocator::getClosestNode(const double* x, double* dist2) const
+{
+    index_t best = -1;
+    double bestDist = std::numeric_limits<double>::max();
+    if (cellNodes.empty()) {
+        if (dist2)
+            *dist2 = bestDist;
+        return best;
+    }
+
+    int c[3];
+    double minSize = std::numeric_limits<double>::max();
+    // squared distance of x to the grid, nodes in cells with Chebyshev
+    // distance r+1 from the cell of x are at least
+    // sqrt(outside + (r*minSize)^2) away
+    double outside = 0.;
+    int maxRing = 0;
+    for (int j = 0; j < 3; j++) {
+        c[j] = getCell(x, j);
+        maxRing = std::max(maxRing, numCells[j]);
+        if (j < numDim) {
+            minSize = std::min(minSize, cellSize[j]);
+            const double p = std::max(origin[j],
+                        std::min(x[j], origin[j]+numCells[j]*cellSize[j]));
+            outside += (x[j]-p)*(x[j]-p);
+        }
+    }
+
+    for (int r = 0; r <= maxRing; r++) {
+        const int lo2 = std::max(c[2]-r, 0), hi2 = std::min(c[2]+r, numCells[2]-1);
+        const int lo1 = std::max(c[1]-r, 0), hi1 = std::min(c[1]+r, numCells[1]-1);
+        const int lo0 = std::max(c[0]-r, 0), hi0 = std::min(c[0]+r, numCells[0]-1);
+        for (int i2 = lo2; i2 <= hi2; i2++) {
+            for (int i1 = lo1; i1 <= hi1; i1++) {
+                for (int i0 = lo0; i0 <= hi0; i0++) {
+                    // only the cells on the ring
+                    if (std::max(std::abs(i0-c[0]), std::max(std::abs(i1-c[1]),
+                                    std::abs(i2-c[2]))) != r)
+                        continue;
+                    const index_t cell = INDEX3(i0, i1, i2, numCells[0], numCells[1]);
+                    for (index_t k = nodeOffset[cell]; k < nodeOffset[cell+1]; k++) {
+                        const index_t n = cellNodes[k];
+                        double d = 0.;
+                        for (int j = 0; j < numDim; j++) {
+                            const double D = coordinates[INDEX2(j, n, numDim)]-x[j];
+                            d += D*D;
+                        }
+                        if (d < bestDist || (d == bestDist && n < best)) {
+                            bestDist = d;
+                            best = n;
+                        }
+                    }
+                }
+            }
+        }
+        const double bound = r*minSize;
+        if (best >= 0 && outside + bound*bound > bestDist)
+            break;
+    }
+    if (dist2)
+        *dist2 = bestDist;
+    return best;
+}
+
+void PointLocator::getCandidateElements(const double* x,
+                                        std::vector<index_t>& elements) const
+{
+    elements.clear();
+    if (cellElements.empty())
+        return;
+    const index_t cell = INDEX3(getCell(x, 0), getCell(x, 1), getCell(x, 2),
+                                numCells[0], numCells[1]);
+    for (index_t k = elementOffset[cell]; k < elementOffset[cell+1]; k++) {
+        const index_t e = cellElements[k];
+        const double* box = &boxes[INDEX2(0, e, 2*numDim)];
+        bool inside = true;
+        for (int j = 0; j < numDim && inside; j++)
+            inside = (box[j] <= x[j] && x[j] <= box[numDim+j]);
+        if (inside)
+            elements.push_back(e);
+    }
+}
+
+} // namespace escript
+
@@ -0,0 +1,105 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __ESCRIPT_POINTLOCATOR_H__
+#define __ESCRIPT_POINTLOCATOR_H__
+
+#include "system_dep.h"
+#include "DataTypes.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace escript {
+
+/**
+    \brief
+    Spatial index over the nodes and elements of an unstructured mesh.
+
+    Nodes and element bounding boxes are binned into a uniform grid of
+    cells covering the bounding box of the nodes with roughly one element
+    per cell. The index supports closest node queries and returns the
+    elements whose bounding box contains a point so that domains can
+    locate points in elements using their shape functions.
+
+    The node coordinates are referenced, not copied, so the index must be
+    rebuilt when the coordinates change or are deallocated.
+*/
+class ESCRIPT_DLL_API PointLocator
+{
+public:
+    /**
+       \brief
+       builds the index.
+       \param numDim spatial dimension (1, 2 or 3)
+       \param numNodes number of nodes
+       \param coordinates node coordinates, coordinates[INDEX2(j,n,numDim)]
+       \param numElements number of elements
+       \param numElementNodes number of nodes per element
+       \param elementNodes local node indices of the elements,
+                           elementNodes[INDEX2(j,e,numElementNodes)]
+    */
+    PointLocator(int numDim, DataTypes::dim_t numNodes,
+                 const double* coordinates, DataTypes::dim_t numElements,
+                 int numElementNodes, const DataTypes::index_t* elementNodes);
+
+    /**
+       \brief
+       returns the index of the node closest to `x` or -1 if there are no
+       nodes. Of several nodes with the same distance the one with the
+       smallest index is returned. If `dist2` is given it is set to the
+       squared distance.
+    */
+    DataTypes::index_t getClosestNode(const double* x,
+                                      double* dist2 = NULL) const;
+
+    /**
+       \brief
+       returns the elements whose (slightly enlarged) bounding box contains
+       `x` in ascending order
+    */
+    void getCandidateElements(const double* x,
+                              std::vector<DataTypes::index_t>& elements) const;
+
+private:
+    /// returns the cell index of `x` in direction `d` clamped to the grid
+    int getCell(const double* x, int d) const;
+
+    int numDim;
+    const double* coordinates;
+    double origin[3];
+    double cellSize[3];
+    int numCells[3];
+    /// nodes in cell c are cellNodes[nodeOffset[c]:nodeOffset[c+1]]
+    DataTypes::IndexVector nodeOffset;
+    DataTypes::IndexVector cellNodes;
+    /// elements overlapping cell c are
+    /// cellElements[elementOffset[c]:elementOffset[c+1]]
+    DataTypes::IndexVector elementOffset;
+    DataTypes::IndexVector cellElements;
+    /// bounding box of element e is [boxes[INDEX2(j,e,2*numDim)],
+    /// boxes[INDEX2(numDim+j,e,2*numDim)]] in direction j
+    std::vector<double> boxes;
+};
+
+typedef boost::shared_ptr<PointLocator> PointLocator_ptr;
+
+} // namespace escript
+
+#endif // __ESCRIPT_POINTLOCATOR_H__
+
@@ -0,0 +1,61 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "RankExchange.h"
+
+namespace escript {
+
+using DataTypes::dim_t;
+using DataTypes::index_t;
+using DataTypes::IndexVector;
+
+RankExchange::RankExchange(JMPI mpi, const std::vector<int>& destRank) :
+    mpiInfo(mpi)
+{
+    const int size = mpiInfo->size;
+    const dim_t numEntries = destRank.size();
+    IndexVector sendCount(size, 0);
+    for (index_t i = 0; i < numEntries; i++) {
+        if (destRank[i] >= 0)
+            sendCount[destRank[i]]++;
+    }
+    sendOffset.assign(size+1, 0);
+    for (int p = 0; p < size; p++)
+        sendOffset[p+1] = sendOffset[p]+sendCount[p];
+
+    // sort the entries by destination rank keeping their relative order
+    order.resize(sendOffset[size]);
+    IndexVector pos(sendOffset.begin(), sendOffset.end()-1);
+    for (index_t i = 0; i < numEntries; i++) {
+        if (destRank[i] >= 0)
+            order[pos[destRank[i]]++] = i;
+    }
+
+    IndexVector recvCount(size, 0);
+#ifdef ESYS_MPI
+    MPI_Alltoall(&sendCount[0], 1, MPI_DIM_T, &recvCount[0], 1, MPI_DIM_T,
+                 mpiInfo->comm);
+#else
+    recvCount[0] = sendCount[0];
+#endif
+    recvOffset.assign(size+1, 0);
+    for (int p = 0; p < size; p++)
+        recvOffset[p+1] = recvOffset[p]+recvCount[p];
+}
+
+} // namespace escript
+
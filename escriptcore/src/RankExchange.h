@@ -0,0 +1,167 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+/*
+  RankExchange sends values attached to local entries to the ranks owning
+  them and returns replies to the originating entries. It replaces passing
+  full buffers around all ranks in a circle by a sparse exchange between the
+  ranks that actually reference each other's entries (distributed directory).
+  It is also used to redistribute entries read in parallel to their owners.
+*/
+
+#ifndef __ESCRIPT_RANKEXCHANGE_H__
+#define __ESCRIPT_RANKEXCHANGE_H__
+
+#include "system_dep.h"
+#include "DataTypes.h"
+#include "EsysMPI.h"
+#include "index.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace escript {
+
+class ESCRIPT_DLL_API RankExchange
+{
+public:
+    /// sets up the exchange pattern. destRank[i] is the rank entry i is sent
+    /// to or -1 if the entry does not take part. The number of entries per
+    /// rank pair is exchanged, this is the only collective operation.
+    RankExchange(JMPI mpiInfo, const std::vector<int>& destRank);
+
+    /// returns the number of entries received from all ranks (including the
+    /// local rank)
+    DataTypes::dim_t getNumReceived() const { return recvOffset.back(); }
+
+    /// sends `blockSize` values per local entry from `in` to the destination
+    /// ranks. The values received are stored in `out` grouped by source rank
+    /// in ascending order.
+    template<typename T>
+    void forward(const T* in, int blockSize, std::vector<T>& out) const;
+
+    /// sends `blockSize` values per received entry back to the source ranks
+    /// where they are stored in `out` at the position of the originating
+    /// entry. Entries that did not take part are left unchanged.
+    template<typename T>
+    void backward(const std::vector<T>& in, int blockSize, T* out) const;
+
+    /// returns the rank owning `id` for a distribution of ids as created by
+    /// JMPI::setDistribution() or -1 if `id` is outside the distribution
+    static int getOwner(const DataTypes::IndexVector& distribution,
+                        DataTypes::index_t id)
+    {
+        if (id < distribution.front() || id >= distribution.back())
+            return -1;
+        return std::upper_bound(distribution.begin(), distribution.end(), id)
+                - distribution.begin() - 1;
+    }
+
+private:
+    template<typename T>
+    void exchange(const T* sendBuf, const DataTypes::IndexVector& sendOff,
+                  T* recvBuf, const DataTypes::IndexVector& recvOff,
+                  int blockSize) const;
+
+    JMPI mpiInfo;
+    /// local entries in the order they are sent
+    DataTypes::IndexVector order;
+    /// offsets of the entries sent to each rank in `order`
+    DataTypes::IndexVector sendOffset;
+    /// offsets of the entries received from each rank
+    DataTypes::IndexVector recvOffset;
+};
+
+template<typename T>
+void RankExchange::forward(const T* in, int blockSize, std::vector<T>& out) const
+{
+    const DataTypes::dim_t numSend = order.size();
+    std::vector<T> sendBuf(numSend*blockSize);
+#pragma omp parallel for
+    for (DataTypes::index_t i = 0; i < numSend; i++)
+        for (int j = 0; j < blockSize; j++)
+            sendBuf[INDEX2(j,i,blockSize)] = in[INDEX2(j,order[i],blockSize)];
+    out.resize(getNumReceived()*blockSize);
+    exchange(sendBuf.empty() ? NULL : &sendBuf[0], sendOffset,
+             out.empty() ? NULL : &out[0], recvOffset, blockSize);
+}
+
+template<typename T>
+void RankExchange::backward(const std::vector<T>& in, int blockSize, T* out) const
+{
+    const DataTypes::dim_t numRecv = order.size();
+    std::vector<T> recvBuf(numRecv*blockSize);
+    exchange(in.empty() ? NULL : &in[0], recvOffset,
+             recvBuf.empty() ? NULL : &recvBuf[0], sendOffset, blockSize);
+#pragma omp parallel for
+    for (DataTypes::index_t i = 0; i < numRecv; i++)
+        for (int j = 0; j < blockSize; j++)
+            out[INDEX2(j,order[i],blockSize)] = recvBuf[INDEX2(j,i,blockSize)];
+}
+
+template<typename T>
+void RankExchange::exchange(const T* sendBuf,
+                            const DataTypes::IndexVector& sendOff, T* recvBuf,
+                            const DataTypes::IndexVector& recvOff,
+                            int blockSize) const
+{
+    const int myRank = mpiInfo->rank;
+    // entries for the local rank are copied directly
+    const DataTypes::dim_t numLocal = sendOff[myRank+1]-sendOff[myRank];
+    if (numLocal > 0) {
+        memcpy(&recvBuf[recvOff[myRank]*blockSize],
+               &sendBuf[sendOff[myRank]*blockSize],
+               numLocal*blockSize*sizeof(T));
+    }
+#ifdef ESYS_MPI
+    std::vector<MPI_Request> mpi_requests;
+    mpi_requests.reserve(2*mpiInfo->size);
+    for (int p = 0; p < mpiInfo->size; p++) {
+        const DataTypes::dim_t n = recvOff[p+1]-recvOff[p];
+        if (p != myRank && n > 0) {
+            mpi_requests.push_back(MPI_Request());
+            MPI_Irecv(&recvBuf[recvOff[p]*blockSize], n*blockSize*sizeof(T),
+                      MPI_BYTE, p, mpiInfo->counter()+p, mpiInfo->comm,
+                      &mpi_requests.back());
+        }
+    }
+    for (int p = 0; p < mpiInfo->size; p++) {
+        const DataTypes::dim_t n = sendOff[p+1]-sendOff[p];
+        if (p != myRank && n > 0) {
+            mpi_requests.push_back(MPI_Request());
+            MPI_Isend(&sendBuf[sendOff[p]*blockSize], n*blockSize*sizeof(T),
+                      MPI_BYTE, p, mpiInfo->counter()+myRank, mpiInfo->comm,
+                      &mpi_requests.back());
+        }
+    }
+    mpiInfo->incCounter(mpiInfo->size);
+    if (!mpi_requests.empty()) {
+        std::vector<MPI_Status> mpi_stati(mpi_requests.size());
+        MPI_Waitall(mpi_requests.size(), &mpi_requests[0], &mpi_stati[0]);
+    }
+#endif
+}
+
+typedef boost::shared_ptr<RankExchange> RankExchange_ptr;
+
+} // namespace escript
+
+#endif // __ESCRIPT_RANKEXCHANGE_H__
+
@@ -0,0 +1,260 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include "SpaceFillingCurve.h"
+#include "EsysException.h"
+#include "index.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace escript {
+
+using DataTypes::dim_t;
+using DataTypes::index_t;
+
+namespace {
+
+/// number of bits per coordinate so that all bits fit into 64-bit keys
+inline int bitsPerCoordinate(int numDim)
+{
+    return (numDim == 1 ? 32 : (numDim == 2 ? 31 : 21));
+}
+
+/// returns the Hilbert index of the integer point x using `bits` bits per
+/// coordinate. See J. Skilling, "Programming the Hilbert curve",
+/// AIP Conf. Proc. 707 (2004), 381-387.
+uint64_t hilbertIndex(uint32_t* x, int numDim, int bits)
+{
+    const uint32_t M = 1U << (bits-1);
+    // inverse undo
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        const uint32_t P = Q-1;
+        for (int i = 0; i < numDim; i++) {
+            if (x[i] & Q) {
+                x[0] ^= P;
+            } else {
+                const uint32_t t = (x[0]^x[i]) & P;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    // Gray encode
+    for (int i = 1; i < numDim; i++)
+        x[i] ^= x[i-1];
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        if (x[numDim-1] & Q)
+            t ^= Q-1;
+    }
+    for (int i = 0; i < numDim; i++)
+        x[i] ^= t;
+
+    // interleave the transposed bits
+    uint64_t key = 0;
+    for (int b = bits-1; b >= 0; b--) {
+        for (int i = 0; i < numDim; i++)
+            key = (key << 1) | ((x[i] >> b) & 1);
+    }
+    return key;
+}
+
+/// returns the bounding box of the points
+void getBoundingBox(int numDim, dim_t numPoints, const double* coords,
+                    double* minX, double* maxX)
+{
+    for (int j = 0; j < numDim; j++) {
+        minX[j] = std::numeric_limits<double>::max();
+        maxX[j] = -std::numeric_limits<double>::max();
+    }
+#pragma omp parallel
+    {
+        double localMin[3], localMax[3];
+        for (int j = 0; j < numDim; j++) {
+            localMin[j] = std::numeric_limits<double>::max();
+            localMax[j] = -std::numeric_limits<double>::max();
+        }
+#pragma omp for
+        for (index_t i = 0; i < numPoints; i++) {
+            for (int j = 0; j < numDim; j++) {
+                localMin[j] = std::min(localMin[j], coords[INDEX2(j, i, numDim)]);
+                localMax[j] = std::max(localMax[j], coords[INDEX2(j, i, numDim)]);
+            }
+        }
+#pragma omp critical
+        for (int j = 0; j < numDim; j++) {
+            minX[j] = std::min(minX[j], localMin[j]);
+            maxX[j] = std::max(maxX[j], localMax[j]);
+        }
+    }
+}
+
+} // anonymous namespace
+
+void getHilbertKeys(int numDim, dim_t numPoints, const double* coords,
+                    const double* minX, const double* maxX,
+                    std::vector<uint64_t>& keys)
+{
+    if (numDim < 1 || numDim > 3)
+        throw ValueError("getHilbertKeys: only 1, 2 and 3 dimensions are supported.");
+
+    const int bits = bitsPerCoordinate(numDim);
+    const double maxCoord = static_cast<double>((uint64_t(1) << bits) - 1);
+    double scale[3];
+    for (int j = 0; j < numDim; j++) {
+        const double extent = maxX[j]-minX[j];
+        scale[j] = (extent > 0. ? maxCoord/extent : 0.);
+    }
+
+    keys.resize(numPoints);
+#pragma omp parallel for
+    for (index_t i = 0; i < numPoints; i++) {
+        uint32_t x[3];
+        for (int j = 0; j < numDim; j++) {
+            double c = (coords[INDEX2(j, i, numDim)]-minX[j])*scale[j];
+            c = std::max(0., std::min(c, maxCoord));
+            x[j] = static_cast<uint32_t>(c);
+        }
+        keys[i] = hilbertIndex(x, numDim, bits);
+    }
+}
+
+void getHilbertOrder(int numDim, dim_t numPoints, const double* coords,
+                     DataTypes::IndexVector& order)
+{
+    if (numDim < 1 || numDim > 3)
+        throw ValueError("getHilbertOrder: only 1, 2 and 3 dimensions are supported.");
+
+    double minX[3], maxX[3];
+    getBoundingBox(numDim, numPoints, coords, minX, maxX);
+
+    std::vector<uint64_t> keys;
+    getHilbertKeys(numDim, numPoints, coords, minX, maxX, keys);
+
+    // the index breaks ties so the order is deterministic
+    std::vector<std::pair<uint64_t, index_t> > items(numPoints);
+#pragma omp parallel for
+    for (index_t i = 0; i < numPoints; i++)
+        items[i] = std::make_pair(keys[i], i);
+    std::sort(items.begin(), items.end());
+
+    order.resize(numPoints);
+#pragma omp parallel for
+    for (index_t i = 0; i < numPoints; i++)
+        order[i] = items[i].second;
+}
+
+void getHilbertPartition(JMPI mpiInfo, int numDim, dim_t numPoints,
+                         const double* coords, const double* weights,
+                         index_t* partition)
+{
+    if (numDim < 1 || numDim > 3)
+        throw ValueError("getHilbertPartition: only 1, 2 and 3 dimensions are supported.");
+
+    const int mpiSize = mpiInfo->size;
+    if (mpiSize == 1) {
+#pragma omp parallel for
+        for (index_t i = 0; i < numPoints; i++)
+            partition[i] = 0;
+        return;
+    }
+
+    // global bounding box, the maxima are negated to use a single reduction
+    double box[6];
+    getBoundingBox(numDim, numPoints, coords, box, box+numDim);
+    for (int j = 0; j < numDim; j++)
+        box[numDim+j] = -box[numDim+j];
+#ifdef ESYS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, box, 2*numDim, MPI_DOUBLE, MPI_MIN,
+                  mpiInfo->comm);
+#endif
+    double minX[3], maxX[3];
+    for (int j = 0; j < numDim; j++) {
+        minX[j] = box[j];
+        maxX[j] = -box[numDim+j];
+    }
+
+    std::vector<uint64_t> keys;
+    getHilbertKeys(numDim, numPoints, coords, minX, maxX, keys);
+
+    // sort the local keys and accumulate their weights so the local weight
+    // below any key is found by a binary search
+    std::vector<std::pair<uint64_t, double> > items(numPoints);
+#pragma omp parallel for
+    for (index_t i = 0; i < numPoints; i++)
+        items[i] = std::make_pair(keys[i], weights[i]);
+    std::sort(items.begin(), items.end());
+    std::vector<uint64_t> sortedKeys(numPoints);
+    std::vector<double> weightBelow(numPoints+1, 0.);
+    for (index_t i = 0; i < numPoints; i++) {
+        sortedKeys[i] = items[i].first;
+        weightBelow[i+1] = weightBelow[i]+items[i].second;
+    }
+    items.clear();
+
+    double totalWeight = weightBelow[numPoints];
+#ifdef ESYS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &totalWeight, 1, MPI_DOUBLE, MPI_SUM,
+                  mpiInfo->comm);
+#endif
+
+    // bisect the key range for the smallest splitter key of every rank
+    // boundary such that the global weight below it reaches the target.
+    // All ranks see the same reduced weights so they take the same steps.
+    const int numSplitters = mpiSize-1;
+    std::vector<uint64_t> lo(numSplitters, 0);
+    std::vector<uint64_t> hi(numSplitters, std::numeric_limits<uint64_t>::max());
+    std::vector<uint64_t> mid(numSplitters);
+    std::vector<double> weight(numSplitters);
+    bool done = false;
+    while (!done) {
+        for (int p = 0; p < numSplitters; p++) {
+            mid[p] = lo[p]+(hi[p]-lo[p])/2;
+            const index_t k = std::lower_bound(sortedKeys.begin(),
+                    sortedKeys.end(), mid[p]) - sortedKeys.begin();
+            weight[p] = weightBelow[k];
+        }
+#ifdef ESYS_MPI
+        MPI_Allreduce(MPI_IN_PLACE, &weight[0], numSplitters, MPI_DOUBLE,
+                      MPI_SUM, mpiInfo->comm);
+#endif
+        done = true;
+        for (int p = 0; p < numSplitters; p++) {
+            if (lo[p] == hi[p])
+                continue;
+            const double target = totalWeight*(p+1)/mpiSize;
+            if (weight[p] >= target) {
+                hi[p] = mid[p];
+            } else {
+                lo[p] = mid[p]+1;
+            }
+            done = done && (lo[p] == hi[p]);
+        }
+    }
+
+    // rank p receives the points with keys in [lo[p-1], lo[p])
+#pragma omp parallel for
+    for (index_t i = 0; i < numPoints; i++) {
+        partition[i] = std::upper_bound(lo.begin(), lo.end(), keys[i])
+                            - lo.begin();
+    }
+}
+
+} // namespace escript
+
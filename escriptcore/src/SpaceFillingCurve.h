@@ -0,0 +1,71 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __ESCRIPT_SPACEFILLINGCURVE_H__
+#define __ESCRIPT_SPACEFILLINGCURVE_H__
+
+#include "system_dep.h"
+#include "DataTypes.h"
+#include "EsysMPI.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace escript {
+
+/**
+    \brief
+    returns the position of `numPoints` points on a Hilbert curve through
+    the box [minX[0],maxX[0]] x ... x [minX[numDim-1],maxX[numDim-1]].
+
+    The coordinates of point i are coords[INDEX2(j,i,numDim)], j<numDim.
+    Points outside the box are clamped to it. Points close to each other on
+    the curve are close in space. Only 1, 2 and 3 dimensions are supported.
+*/
+ESCRIPT_DLL_API
+void getHilbertKeys(int numDim, DataTypes::dim_t numPoints,
+                    const double* coords, const double* minX,
+                    const double* maxX, std::vector<uint64_t>& keys);
+
+/**
+    \brief
+    returns the permutation `order` of the points such that points
+    order[0], order[1], ... follow a Hilbert curve through their bounding
+    box. Points with the same key keep their relative order.
+*/
+ESCRIPT_DLL_API
+void getHilbertOrder(int numDim, DataTypes::dim_t numPoints,
+                     const double* coords, DataTypes::IndexVector& order);
+
+/**
+    \brief
+    partitions points distributed over the ranks of `mpiInfo` into
+    mpiInfo->size parts of roughly equal total weight by splitting a Hilbert
+    curve through the global bounding box of the points. On return
+    partition[i] is the rank that point i is assigned to. The ranks receive
+    consecutive sections of the curve so the parts are spatially compact.
+    Must be called on all ranks.
+*/
+ESCRIPT_DLL_API
+void getHilbertPartition(JMPI mpiInfo, int numDim, DataTypes::dim_t numPoints,
+                         const double* coords, const double* weights,
+                         DataTypes::index_t* partition);
+
+} // namespace escript
+
+#endif // __ESCRIPT_SPACEFILLINGCURVE_H__
+
@@ -109,3 +109,46 @@ def GetMeshFromFile(filename, **kwargs):
     else:
 #        return LoadMesh(filename)
         raise ValueError("Unsupported extension .%s"%ext)
+
+def ConvertMesh(inputFile, outputFile, numDim=None, optimize=True,
+                integrationOrder=-1, reducedIntegrationOrder=-1,
+                useMacroElements=False):
+    """
+    Converts a fly or gmsh mesh file into the finley binary mesh format.
+    The binary file can be read by `ReadMesh` and `LoadMesh` on any number
+    of processes and is much faster to read than fly or gmsh files, so large
+    meshes should be converted once and the binary file used afterwards.
+    The integration orders are stored in the binary file.
+
+    :param inputFile: name of the fly or gmsh (.msh) file to convert
+    :type inputFile: ``str``
+    :param outputFile: name of the binary mesh file to write
+    :type outputFile: ``str``
+    :param numDim: spatial dimensionality, required for gmsh files
+    :type numDim: ``int``
+    :param optimize: if set the labeling of the mesh nodes is optimized
+    :type optimize: ``bool``
+    :param integrationOrder: order of the quadrature scheme. If
+                             ``integrationOrder<0`` the integration order is
+                             selected independently.
+    :type integrationOrder: ``int``
+    :param reducedIntegrationOrder: order of the reduced quadrature scheme.
+                                    If ``reducedIntegrationOrder<0`` the
+                                    integration order is selected
+                                    independently.
+    :type reducedIntegrationOrder: ``int``
+    :param useMacroElements: if set, macro elements are used for gmsh files
+    :type useMacroElements: ``bool``
+    :return: the domain read from the input file
+    :rtype: `Domain`
+    """
+    if inputFile.endswith(".msh"):
+        if numDim is None:
+            raise ValueError("The numDim argument is required in order to read .msh files.")
+        dom=ReadGmsh(inputFile, numDim, integrationOrder,
+                     reducedIntegrationOrder, optimize, useMacroElements)
+    else:
+        dom=ReadMesh(inputFile, integrationOrder, reducedIntegrationOrder,
+                     optimize)
+    dom.writeBinary(outputFile)
+    return dom
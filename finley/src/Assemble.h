@@ -106,6 +106,14 @@ void Assemble_PDE_Single_3D(const AssembleParameters& p,
                             const escript::Data& C, const escript::Data& D,
                             const escript::Data& X, const escript::Data& Y);
 
+/// Assembles a single PDE in 2D or 3D for blocks of elements of the same
+/// color at once. Requires elements without sub-elements (numSub == 1).
+template<int DIM, typename Scalar>
+void Assemble_PDE_Single_batched(const AssembleParameters& p,
+                                 const escript::Data& A, const escript::Data& B,
+                                 const escript::Data& C, const escript::Data& D,
+                                 const escript::Data& X, const escript::Data& Y);
+
 template<typename Scalar>
 void Assemble_PDE_Single_C(const AssembleParameters& p, const escript::Data& D,
                            const escript::Data& Y);
@@ -249,6 +257,13 @@ void Assemble_jacobians_3D_M2D_E3D_C(const double* coordinates, int numQuad,
                            const double* DSDv, int numTest, const double* DTDv,
                            double* dTdX, double* volume, const index_t* elementId);
 
+/// computes the inverse dvdX[INDEX4(j,i,q,e,DIM,DIM,numQuad)] of the
+/// Jacobians of elements whose geometry is parametrized by the tensor
+/// product shape functions `shape` using sum factorization
+void Assemble_inverseJacobians(const double* coordinates, int numDim,
+                           const ShapeFunction& shape, dim_t numElements,
+                           int numNodes, const index_t* nodes, double* dvdX);
+
 } // namespace finley
 
 #endif // __FINLEY_ASSEMBLE_H__
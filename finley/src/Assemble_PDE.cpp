@@ -243,7 +243,23 @@ void Assemble_PDE(const NodeFile* nodes, const ElementFile* elements,
                 throw escript::ValueError("Assemble_PDE supports spatial dimensions 1,2,3 only.");
             }
         } else { // single PDE
-            if (p.numDim == 3) {
+            // the batched assembler handles elements without sub-elements
+            const bool batched = (p.numSub == 1
+                    && p.row_numShapes == p.row_numShapesTotal
+                    && p.col_numShapes == p.col_numShapesTotal);
+            if (batched && p.numDim == 3) {
+                if (isComplex) {
+                    Assemble_PDE_Single_batched<3, cplx_t>(p, A, B, C, D, X, Y);
+                } else {
+                    Assemble_PDE_Single_batched<3, real_t>(p, A, B, C, D, X, Y);
+                }
+            } else if (batched && p.numDim == 2) {
+                if (isComplex) {
+                    Assemble_PDE_Single_batched<2, cplx_t>(p, A, B, C, D, X, Y);
+                } else {
+                    Assemble_PDE_Single_batched<2, real_t>(p, A, B, C, D, X, Y);
+                }
+            } else if (p.numDim == 3) {
                 if (isComplex) {
                     Assemble_PDE_Single_3D<cplx_t>(p, A, B, C, D, X, Y);
                 } else {
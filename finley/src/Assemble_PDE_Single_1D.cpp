@@ -64,195 +64,197 @@ void Assemble_PDE_Single_1D(const AssembleParameters& p,
     const int len_EM_S = p.row_numShapesTotal*p.col_numShapesTotal;
     const int len_EM_F = p.row_numShapesTotal;
 
+    const index_t* colorOffsets = p.elements->borrowColorOffsets();
+    const index_t* elementsByColor = p.elements->borrowElementsByColor();
+
 #pragma omp parallel
     {
-        for (index_t color = p.elements->minColor; color <= p.elements->maxColor; color++) {
-            // loop over all elements:
+        for (index_t color = 0; color < p.elements->getNumColors(); color++) {
+            // loop over the elements of this color
 #pragma omp for
-            for (index_t e = 0; e < p.elements->numElements; e++) {
-                if (p.elements->Color[e] == color) {
-                    for (int isub = 0; isub < p.numSub; isub++) {
-                        const double* Vol = &p.row_jac->volume[INDEX3(0,isub,e,p.numQuadSub,p.numSub)];
-                        const double* DSDX = &p.row_jac->DSDX[INDEX5(0,0,0,isub,e, p.row_numShapesTotal,DIM,p.numQuadSub,p.numSub)];
-                        std::vector<double> EM_S(len_EM_S);
-                        std::vector<double> EM_F(len_EM_F);
-                        bool add_EM_F = false;
-                        bool add_EM_S = false;
-                        ///////////////
-                        // process A //
-                        ///////////////
-                        if (!A.isEmpty()) {
-                            const double *A_p = A.getSampleDataRO(e);
-                            add_EM_S = true;
-                            if (expandedA) {
-                                const double* A_q = &(A_p[INDEX4(0,0,0,isub,DIM,DIM,p.numQuadSub)]);
-                                for (int s = 0; s < p.row_numShapes; s++) {
-                                    for (int r = 0; r < p.col_numShapes; r++) {
-                                        double f = 0.;
-                                        for (int q = 0; q < p.numQuadSub; q++) {
-                                            f += Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*A_q[INDEX3(0,0,q,DIM,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
-                                        }
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
-                                    }
-                                }
-                            } else { // constant A
-                                for (int s = 0; s < p.row_numShapes; s++) {
-                                    for (int r = 0; r < p.col_numShapes; r++) {
-                                        double f = 0.;
-                                        for (int q = 0; q < p.numQuadSub; q++)
-                                            f += Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*A_p[INDEX2(0,0,DIM)];
+            for (index_t i = colorOffsets[color]; i < colorOffsets[color+1]; i++) {
+                const index_t e = elementsByColor[i];
+                for (int isub = 0; isub < p.numSub; isub++) {
+                    const double* Vol = &p.row_jac->volume[INDEX3(0,isub,e,p.numQuadSub,p.numSub)];
+                    const double* DSDX = &p.row_jac->DSDX[INDEX5(0,0,0,isub,e, p.row_numShapesTotal,DIM,p.numQuadSub,p.numSub)];
+                    std::vector<double> EM_S(len_EM_S);
+                    std::vector<double> EM_F(len_EM_F);
+                    bool add_EM_F = false;
+                    bool add_EM_S = false;
+                    ///////////////
+                    // process A //
+                    ///////////////
+                    if (!A.isEmpty()) {
+                        const double *A_p = A.getSampleDataRO(e);
+                        add_EM_S = true;
+                        if (expandedA) {
+                            const double* A_q = &(A_p[INDEX4(0,0,0,isub,DIM,DIM,p.numQuadSub)]);
+                            for (int s = 0; s < p.row_numShapes; s++) {
+                                for (int r = 0; r < p.col_numShapes; r++) {
+                                    double f = 0.;
+                                    for (int q = 0; q < p.numQuadSub; q++) {
+                                        f += Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*A_q[INDEX3(0,0,q,DIM,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
                                     }
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
                                 }
                             }
-                        }
-                        ///////////////
-                        // process B //
-                        ///////////////
-                        if (!B.isEmpty()) {
-                            const double *B_p=B.getSampleDataRO(e);
-                            add_EM_S=true;
-                            if (expandedB) {
-                                const double *B_q=&(B_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++) {
-                                            f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*B_q[INDEX2(0,q,DIM)]*S[INDEX2(r,q,p.row_numShapes)];
-                                        }
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
-                                    }
-                                }
-                            } else { // constant B
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++)
-                                            f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*S[INDEX2(r,q,p.row_numShapes)];
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*B_p[0];
-                                    }
+                        } else { // constant A
+                            for (int s = 0; s < p.row_numShapes; s++) {
+                                for (int r = 0; r < p.col_numShapes; r++) {
+                                    double f = 0.;
+                                    for (int q = 0; q < p.numQuadSub; q++)
+                                        f += Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*A_p[INDEX2(0,0,DIM)];
                                 }
                             }
                         }
-                        ///////////////
-                        // process C //
-                        ///////////////
-                        if (!C.isEmpty()) {
-                            const double *C_p=C.getSampleDataRO(e);
-                            add_EM_S=true;
-                            if (expandedC) {
-                                const double *C_q=&(C_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++) {
-                                            f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*C_q[INDEX2(0,q,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
-                                        }
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
+                    }
+                    ///////////////
+                    // process B //
+                    ///////////////
+                    if (!B.isEmpty()) {
+                        const double *B_p=B.getSampleDataRO(e);
+                        add_EM_S=true;
+                        if (expandedB) {
+                            const double *B_q=&(B_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
+                                    double f=0.;
+                                    for (int q=0; q<p.numQuadSub; q++) {
+                                        f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*B_q[INDEX2(0,q,DIM)]*S[INDEX2(r,q,p.row_numShapes)];
                                     }
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
                                 }
-                            } else { // constant C
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++)
-                                            f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*C_p[0];
-                                    }
+                            }
+                        } else { // constant B
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
+                                    double f=0.;
+                                    for (int q=0; q<p.numQuadSub; q++)
+                                        f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*S[INDEX2(r,q,p.row_numShapes)];
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*B_p[0];
                                 }
                             }
                         }
-                        ///////////////
-                        // process D //
-                        ///////////////
-                        if (!D.isEmpty()) {
-                            const double *D_p=D.getSampleDataRO(e);
-                            add_EM_S=true;
-                            if (expandedD) {
-                                const double *D_q=&(D_p[INDEX2(0,isub,p.numQuadSub)]);
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++) {
-                                            f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*D_q[q]*S[INDEX2(r,q,p.row_numShapes)];
-                                        }
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
+                    }
+                    ///////////////
+                    // process C //
+                    ///////////////
+                    if (!C.isEmpty()) {
+                        const double *C_p=C.getSampleDataRO(e);
+                        add_EM_S=true;
+                        if (expandedC) {
+                            const double *C_q=&(C_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
+                                    double f=0.;
+                                    for (int q=0; q<p.numQuadSub; q++) {
+                                        f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*C_q[INDEX2(0,q,DIM)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
                                     }
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
                                 }
-                            } else { // constant D
-                                for (int s=0; s<p.row_numShapes; s++) {
-                                    for (int r=0; r<p.col_numShapes; r++) {
-                                        double f=0.;
-                                        for (int q=0; q<p.numQuadSub; q++)
-                                            f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*S[INDEX2(r,q,p.row_numShapes)];
-                                        EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*D_p[0];
-                                    }
+                            }
+                        } else { // constant C
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
+                                    double f=0.;
+                                    for (int q=0; q<p.numQuadSub; q++)
+                                        f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*DSDX[INDEX3(r,0,q,p.row_numShapesTotal,DIM)];
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*C_p[0];
                                 }
                             }
                         }
-                        ///////////////
-                        // process X //
-                        ///////////////
-                        if (!X.isEmpty()) {
-                            const double *X_p=X.getSampleDataRO(e);
-                            add_EM_F=true;
-                            if (expandedX) {
-                                const double *X_q=&(X_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
-                                for (int s=0; s<p.row_numShapes; s++) {
+                    }
+                    ///////////////
+                    // process D //
+                    ///////////////
+                    if (!D.isEmpty()) {
+                        const double *D_p=D.getSampleDataRO(e);
+                        add_EM_S=true;
+                        if (expandedD) {
+                            const double *D_q=&(D_p[INDEX2(0,isub,p.numQuadSub)]);
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
                                     double f=0.;
-                                    for (int q=0; q<p.numQuadSub; q++)
-                                        f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*X_q[INDEX2(0,q,DIM)];
-                                    EM_F[INDEX2(0,s,p.numEqu)]+=f;
+                                    for (int q=0; q<p.numQuadSub; q++) {
+                                        f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*D_q[q]*S[INDEX2(r,q,p.row_numShapes)];
+                                    }
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f;
                                 }
-                            } else { // constant X
-                                for (int s=0; s<p.row_numShapes; s++) {
+                            }
+                        } else { // constant D
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                for (int r=0; r<p.col_numShapes; r++) {
                                     double f=0.;
                                     for (int q=0; q<p.numQuadSub; q++)
-                                        f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)];
-                                    EM_F[INDEX2(0,s,p.numEqu)]+=f*X_p[0];
+                                        f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*S[INDEX2(r,q,p.row_numShapes)];
+                                    EM_S[INDEX4(0,0,s,r,p.numEqu,p.numComp,p.row_numShapesTotal)]+=f*D_p[0];
                                 }
                             }
                         }
-                        ///////////////
-                        // process Y //
-                        ///////////////
-                        if (!Y.isEmpty()) {
-                            const double *Y_p=Y.getSampleDataRO(e);
-                            add_EM_F=true;
-                            if (expandedY) {
-                                const double *Y_q=&(Y_p[INDEX2(0,isub, p.numQuadSub)]);
-                                for (int s = 0; s < p.row_numShapes; s++) {
-                                    double f = 0.;
-                                    for (int q = 0; q < p.numQuadSub; q++)
-                                        f += Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*Y_q[q];
-                                    EM_F[INDEX2(0,s,p.numEqu)]+=f;
-                                }
-                            } else { // constant Y
-                                for (int s = 0; s < p.row_numShapes; s++) {
-                                    double f = 0.;
-                                    for (int q = 0; q < p.numQuadSub; q++)
-                                        f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)];
-                                    EM_F[INDEX2(0,s,p.numEqu)]+=f*Y_p[0];
-                                }
+                    }
+                    ///////////////
+                    // process X //
+                    ///////////////
+                    if (!X.isEmpty()) {
+                        const double *X_p=X.getSampleDataRO(e);
+                        add_EM_F=true;
+                        if (expandedX) {
+                            const double *X_q=&(X_p[INDEX3(0,0,isub,DIM,p.numQuadSub)]);
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                double f=0.;
+                                for (int q=0; q<p.numQuadSub; q++)
+                                    f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)]*X_q[INDEX2(0,q,DIM)];
+                                EM_F[INDEX2(0,s,p.numEqu)]+=f;
+                            }
+                        } else { // constant X
+                            for (int s=0; s<p.row_numShapes; s++) {
+                                double f=0.;
+                                for (int q=0; q<p.numQuadSub; q++)
+                                    f+=Vol[q]*DSDX[INDEX3(s,0,q,p.row_numShapesTotal,DIM)];
+                                EM_F[INDEX2(0,s,p.numEqu)]+=f*X_p[0];
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process Y //
+                    ///////////////
+                    if (!Y.isEmpty()) {
+                        const double *Y_p=Y.getSampleDataRO(e);
+                        add_EM_F=true;
+                        if (expandedY) {
+                            const double *Y_q=&(Y_p[INDEX2(0,isub, p.numQuadSub)]);
+                            for (int s = 0; s < p.row_numShapes; s++) {
+                                double f = 0.;
+                                for (int q = 0; q < p.numQuadSub; q++)
+                                    f += Vol[q]*S[INDEX2(s,q,p.row_numShapes)]*Y_q[q];
+                                EM_F[INDEX2(0,s,p.numEqu)]+=f;
+                            }
+                        } else { // constant Y
+                            for (int s = 0; s < p.row_numShapes; s++) {
+                                double f = 0.;
+                                for (int q = 0; q < p.numQuadSub; q++)
+                                    f+=Vol[q]*S[INDEX2(s,q,p.row_numShapes)];
+                                EM_F[INDEX2(0,s,p.numEqu)]+=f*Y_p[0];
                             }
                         }
-                        // add the element matrices onto the matrix and
-                        // right hand side
-                        IndexVector row_index(p.row_numShapesTotal);
-                        for (int q = 0; q < p.row_numShapesTotal; q++)
-                            row_index[q] = p.row_DOF[p.elements->Nodes[INDEX2(p.row_node[INDEX2(q, isub, p.row_numShapesTotal)], e, p.NN)]];
+                    }
+                    // add the element matrices onto the matrix and
+                    // right hand side
+                    IndexVector row_index(p.row_numShapesTotal);
+                    for (int q = 0; q < p.row_numShapesTotal; q++)
+                        row_index[q] = p.row_DOF[p.elements->Nodes[INDEX2(p.row_node[INDEX2(q, isub, p.row_numShapesTotal)], e, p.NN)]];
 
-                        if (add_EM_F)
-                            util::addScatter(p.row_numShapesTotal,
-                                    &row_index[0], p.numEqu, &EM_F[0], F_p,
-                                    p.row_DOF_UpperBound);
-                        if (add_EM_S)
-                            Assemble_addToSystemMatrix(p.S,
-                                    p.row_numShapesTotal, &row_index[0],
-                                    p.numEqu, p.col_numShapesTotal,
-                                    &row_index[0], p.numComp, &EM_S[0]);
-                    } // end of isub
-                } // end color check
+                    if (add_EM_F)
+                        util::addScatter(p.row_numShapesTotal,
+                                &row_index[0], p.numEqu, &EM_F[0], F_p,
+                                p.row_DOF_UpperBound);
+                    if (add_EM_S)
+                        Assemble_addToSystemMatrix(p.S,
+                                p.row_numShapesTotal, &row_index[0],
+                                p.numEqu, p.col_numShapesTotal,
+                                &row_index[0], p.numComp, &EM_S[0]);
+                } // end of isub
             } // end element loop
         } // end color loop
     } // end parallel region
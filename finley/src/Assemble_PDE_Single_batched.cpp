@@ -0,0 +1,361 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+
+/****************************************************************************
+
+  Assembles a single PDE into the stiffness matrix S and right hand side F
+
+      -(A_{i,j} u_,j)_i-(B_{i} u)_i+C_{j} u_,j-D u_m  and -(X_,i)_i + Y
+
+  in a 2D or 3D domain processing blocks of elements of the same color at
+  once. The shape functions for test and solution must be identical,
+  row_NS == row_NN and there must be no sub-elements (numSub == 1).
+
+  For each block the Jacobians and coefficients are gathered into buffers
+  with the element index running fastest (structure of arrays) so the
+  element matrices of the whole block are computed by loops that vectorize
+  across elements. The element matrices are then added to the system one
+  element at a time as in the per-element assemblers.
+
+  Shape of the coefficients:
+
+      A = DIM x DIM
+      B = DIM
+      C = DIM
+      D = scalar
+      X = DIM
+      Y = scalar
+
+*****************************************************************************/
+
+#include "Assemble.h"
+#include "Util.h"
+
+#include <escript/index.h>
+
+namespace finley {
+
+/// number of elements processed together. Lanes of a partially filled
+/// block are zero and are not added to the system.
+static const int BATCH = 16;
+
+template<int DIM, typename Scalar>
+void Assemble_PDE_Single_batched(const AssembleParameters& p,
+                                 const escript::Data& A, const escript::Data& B,
+                                 const escript::Data& C, const escript::Data& D,
+                                 const escript::Data& X, const escript::Data& Y)
+{
+    const bool expandedA = A.actsExpanded();
+    const bool expandedB = B.actsExpanded();
+    const bool expandedC = C.actsExpanded();
+    const bool expandedD = D.actsExpanded();
+    const bool expandedX = X.actsExpanded();
+    const bool expandedY = Y.actsExpanded();
+    const Scalar zero = static_cast<Scalar>(0);
+    Scalar* F_p = NULL;
+    if (!p.F.isEmpty()) {
+        p.F.requireWrite();
+        F_p = p.F.getSampleDataRW(0, zero);
+    }
+    const std::vector<double>& S(p.row_jac->BasisFunctions->S);
+    const int NS = p.row_numShapes;
+    const int NQ = p.numQuadSub;
+    // number of quadrature points stored per coefficient (1 if constant)
+    const int NQA = (expandedA ? NQ : 1);
+    const int NQB = (expandedB ? NQ : 1);
+    const int NQC = (expandedC ? NQ : 1);
+    const int NQD = (expandedD ? NQ : 1);
+    const int NQX = (expandedX ? NQ : 1);
+    const int NQY = (expandedY ? NQ : 1);
+    const bool add_EM_S = !A.isEmpty() || !B.isEmpty() || !C.isEmpty()
+                          || !D.isEmpty();
+    const bool add_EM_F = !X.isEmpty() || !Y.isEmpty();
+
+    const index_t* colorOffsets = p.elements->borrowColorOffsets();
+    const index_t* elementsByColor = p.elements->borrowElementsByColor();
+
+#pragma omp parallel
+    {
+        // block buffers, the lane (element within block) runs fastest
+        std::vector<double> vol(NQ*BATCH);
+        std::vector<double> dsdx(NS*DIM*NQ*BATCH);
+        std::vector<Scalar> A_b(A.isEmpty() ? 0 : DIM*DIM*NQA*BATCH);
+        std::vector<Scalar> B_b(B.isEmpty() ? 0 : DIM*NQB*BATCH);
+        std::vector<Scalar> C_b(C.isEmpty() ? 0 : DIM*NQC*BATCH);
+        std::vector<Scalar> D_b(D.isEmpty() ? 0 : NQD*BATCH);
+        std::vector<Scalar> X_b(X.isEmpty() ? 0 : DIM*NQX*BATCH);
+        std::vector<Scalar> Y_b(Y.isEmpty() ? 0 : NQY*BATCH);
+        std::vector<Scalar> work(NS*DIM*BATCH);
+        std::vector<Scalar> EM_S_b(NS*NS*BATCH);
+        std::vector<Scalar> EM_F_b(NS*BATCH);
+        // element matrices of a single element for the scatter
+        std::vector<Scalar> EM_S(NS*NS);
+        std::vector<Scalar> EM_F(NS);
+        IndexVector row_index(NS);
+
+        for (index_t color = 0; color < p.elements->getNumColors(); color++) {
+            // loop over the blocks of elements of this color
+#pragma omp for
+            for (index_t i0 = colorOffsets[color]; i0 < colorOffsets[color+1]; i0 += BATCH) {
+                const int nb = std::min(static_cast<index_t>(BATCH), colorOffsets[color+1]-i0);
+                const index_t* elements = &elementsByColor[i0];
+                if (nb < BATCH) {
+                    std::fill(vol.begin(), vol.end(), 0.);
+                    std::fill(dsdx.begin(), dsdx.end(), 0.);
+                    std::fill(A_b.begin(), A_b.end(), zero);
+                    std::fill(B_b.begin(), B_b.end(), zero);
+                    std::fill(C_b.begin(), C_b.end(), zero);
+                    std::fill(D_b.begin(), D_b.end(), zero);
+                    std::fill(X_b.begin(), X_b.end(), zero);
+                    std::fill(Y_b.begin(), Y_b.end(), zero);
+                }
+                ////////////////////////////////////////////
+                // gather Jacobians and coefficients      //
+                ////////////////////////////////////////////
+                for (int b = 0; b < nb; b++) {
+                    const index_t e = elements[b];
+                    const double* Vol = &(p.row_jac->volume[INDEX2(0,e,NQ)]);
+                    const double* DSDX = &(p.row_jac->DSDX[INDEX4(0,0,0,e,NS,DIM,NQ)]);
+                    for (int q = 0; q < NQ; q++) {
+                        vol[INDEX2(b,q,BATCH)] = Vol[q];
+                        for (int i = 0; i < DIM; i++)
+                            for (int s = 0; s < NS; s++)
+                                dsdx[INDEX4(b,i,s,q,BATCH,DIM,NS)] = DSDX[INDEX3(s,i,q,NS,DIM)];
+                    }
+                    if (!A.isEmpty()) {
+                        const Scalar* A_p = A.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQA; q++)
+                            for (int j = 0; j < DIM; j++)
+                                for (int i = 0; i < DIM; i++)
+                                    A_b[INDEX4(b,i,j,q,BATCH,DIM,DIM)] = A_p[INDEX3(i,j,q,DIM,DIM)];
+                    }
+                    if (!B.isEmpty()) {
+                        const Scalar* B_p = B.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQB; q++)
+                            for (int i = 0; i < DIM; i++)
+                                B_b[INDEX3(b,i,q,BATCH,DIM)] = B_p[INDEX2(i,q,DIM)];
+                    }
+                    if (!C.isEmpty()) {
+                        const Scalar* C_p = C.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQC; q++)
+                            for (int i = 0; i < DIM; i++)
+                                C_b[INDEX3(b,i,q,BATCH,DIM)] = C_p[INDEX2(i,q,DIM)];
+                    }
+                    if (!D.isEmpty()) {
+                        const Scalar* D_p = D.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQD; q++)
+                            D_b[INDEX2(b,q,BATCH)] = D_p[q];
+                    }
+                    if (!X.isEmpty()) {
+                        const Scalar* X_p = X.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQX; q++)
+                            for (int i = 0; i < DIM; i++)
+                                X_b[INDEX3(b,i,q,BATCH,DIM)] = X_p[INDEX2(i,q,DIM)];
+                    }
+                    if (!Y.isEmpty()) {
+                        const Scalar* Y_p = Y.getSampleDataRO(e, zero);
+                        for (int q = 0; q < NQY; q++)
+                            Y_b[INDEX2(b,q,BATCH)] = Y_p[q];
+                    }
+                }
+
+                std::fill(EM_S_b.begin(), EM_S_b.end(), zero);
+                std::fill(EM_F_b.begin(), EM_F_b.end(), zero);
+                for (int q = 0; q < NQ; q++) {
+                    const double* vol_q = &vol[INDEX2(0,q,BATCH)];
+                    const double* dsdx_q = &dsdx[INDEX4(0,0,0,q,BATCH,DIM,NS)];
+                    ///////////////
+                    // process A //
+                    ///////////////
+                    if (!A.isEmpty()) {
+                        const Scalar* A_q = &A_b[INDEX4(0,0,0,expandedA ? q : 0,BATCH,DIM,DIM)];
+                        // work(s,j) = Vol * sum_i DSDX(s,i) * A(i,j)
+                        for (int s = 0; s < NS; s++) {
+                            for (int j = 0; j < DIM; j++) {
+                                Scalar* w = &work[INDEX3(0,j,s,BATCH,DIM)];
+#pragma omp simd
+                                for (int b = 0; b < BATCH; b++) {
+                                    Scalar f = zero;
+                                    for (int i = 0; i < DIM; i++)
+                                        f += dsdx_q[INDEX3(b,i,s,BATCH,DIM)]*A_q[INDEX3(b,i,j,BATCH,DIM)];
+                                    w[b] = vol_q[b]*f;
+                                }
+                            }
+                        }
+                        for (int r = 0; r < NS; r++) {
+                            for (int s = 0; s < NS; s++) {
+                                Scalar* EM = &EM_S_b[INDEX3(0,s,r,BATCH,NS)];
+#pragma omp simd
+                                for (int b = 0; b < BATCH; b++) {
+                                    Scalar f = zero;
+                                    for (int j = 0; j < DIM; j++)
+                                        f += work[INDEX3(b,j,s,BATCH,DIM)]*dsdx_q[INDEX3(b,j,r,BATCH,DIM)];
+                                    EM[b] += f;
+                                }
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process B //
+                    ///////////////
+                    if (!B.isEmpty()) {
+                        const Scalar* B_q = &B_b[INDEX3(0,0,expandedB ? q : 0,BATCH,DIM)];
+                        for (int s = 0; s < NS; s++) {
+                            Scalar* w = &work[INDEX2(0,s,BATCH)];
+#pragma omp simd
+                            for (int b = 0; b < BATCH; b++) {
+                                Scalar f = zero;
+                                for (int i = 0; i < DIM; i++)
+                                    f += dsdx_q[INDEX3(b,i,s,BATCH,DIM)]*B_q[INDEX2(b,i,BATCH)];
+                                w[b] = vol_q[b]*f;
+                            }
+                        }
+                        for (int r = 0; r < NS; r++) {
+                            const double S_r = S[INDEX2(r,q,NS)];
+                            for (int s = 0; s < NS; s++) {
+                                Scalar* EM = &EM_S_b[INDEX3(0,s,r,BATCH,NS)];
+                                const Scalar* w = &work[INDEX2(0,s,BATCH)];
+#pragma omp simd
+                                for (int b = 0; b < BATCH; b++)
+                                    EM[b] += w[b]*S_r;
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process C //
+                    ///////////////
+                    if (!C.isEmpty()) {
+                        const Scalar* C_q = &C_b[INDEX3(0,0,expandedC ? q : 0,BATCH,DIM)];
+                        for (int r = 0; r < NS; r++) {
+                            Scalar* w = &work[INDEX2(0,r,BATCH)];
+#pragma omp simd
+                            for (int b = 0; b < BATCH; b++) {
+                                Scalar f = zero;
+                                for (int i = 0; i < DIM; i++)
+                                    f += C_q[INDEX2(b,i,BATCH)]*dsdx_q[INDEX3(b,i,r,BATCH,DIM)];
+                                w[b] = vol_q[b]*f;
+                            }
+                        }
+                        for (int r = 0; r < NS; r++) {
+                            const Scalar* w = &work[INDEX2(0,r,BATCH)];
+                            for (int s = 0; s < NS; s++) {
+                                const double S_s = S[INDEX2(s,q,NS)];
+                                Scalar* EM = &EM_S_b[INDEX3(0,s,r,BATCH,NS)];
+#pragma omp simd
+                                for (int b = 0; b < BATCH; b++)
+                                    EM[b] += S_s*w[b];
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process D //
+                    ///////////////
+                    if (!D.isEmpty()) {
+                        const Scalar* D_q = &D_b[INDEX2(0,expandedD ? q : 0,BATCH)];
+                        for (int r = 0; r < NS; r++) {
+                            for (int s = 0; s < NS; s++) {
+                                const double SS = S[INDEX2(s,q,NS)]*S[INDEX2(r,q,NS)];
+                                Scalar* EM = &EM_S_b[INDEX3(0,s,r,BATCH,NS)];
+#pragma omp simd
+                                for (int b = 0; b < BATCH; b++)
+                                    EM[b] += vol_q[b]*SS*D_q[b];
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process X //
+                    ///////////////
+                    if (!X.isEmpty()) {
+                        const Scalar* X_q = &X_b[INDEX3(0,0,expandedX ? q : 0,BATCH,DIM)];
+                        for (int s = 0; s < NS; s++) {
+                            Scalar* EM = &EM_F_b[INDEX2(0,s,BATCH)];
+#pragma omp simd
+                            for (int b = 0; b < BATCH; b++) {
+                                Scalar f = zero;
+                                for (int i = 0; i < DIM; i++)
+                                    f += dsdx_q[INDEX3(b,i,s,BATCH,DIM)]*X_q[INDEX2(b,i,BATCH)];
+                                EM[b] += vol_q[b]*f;
+                            }
+                        }
+                    }
+                    ///////////////
+                    // process Y //
+                    ///////////////
+                    if (!Y.isEmpty()) {
+                        const Scalar* Y_q = &Y_b[INDEX2(0,expandedY ? q : 0,BATCH)];
+                        for (int s = 0; s < NS; s++) {
+                            const double S_s = S[INDEX2(s,q,NS)];
+                            Scalar* EM = &EM_F_b[INDEX2(0,s,BATCH)];
+#pragma omp simd
+                            for (int b = 0; b < BATCH; b++)
+                                EM[b] += vol_q[b]*S_s*Y_q[b];
+                        }
+                    }
+                } // end of quadrature loop
+
+                // add the element matrices onto the matrix and right hand
+                // side. Elements of one color do not share nodes.
+                for (int b = 0; b < nb; b++) {
+                    const index_t e = elements[b];
+                    for (int q = 0; q < NS; q++) {
+                        row_index[q] = p.row_DOF[p.elements->Nodes[INDEX2(p.row_node[q],e,p.NN)]];
+                    }
+                    if (add_EM_F) {
+                        for (int s = 0; s < NS; s++)
+                            EM_F[s] = EM_F_b[INDEX2(b,s,BATCH)];
+                        util::addScatter(NS, &row_index[0], p.numEqu,
+                                &EM_F[0], F_p, p.row_DOF_UpperBound);
+                    }
+                    if (add_EM_S) {
+                        for (int r = 0; r < NS; r++)
+                            for (int s = 0; s < NS; s++)
+                                EM_S[INDEX2(s,r,NS)] = EM_S_b[INDEX3(b,s,r,BATCH,NS)];
+                        Assemble_addToSystemMatrix(p.S, NS, &row_index[0],
+                                p.numEqu, NS, &row_index[0], p.numComp,
+                                &EM_S[0]);
+                    }
+                }
+            } // end block loop
+        } // end color loop
+    } // end parallel region
+}
+
+// instantiate our supported versions
+template void Assemble_PDE_Single_batched<2, escript::DataTypes::real_t>(
+                            const AssembleParameters& p,
+                            const escript::Data& A, const escript::Data& B,
+                            const escript::Data& C, const escript::Data& D,
+                            const escript::Data& X, const escript::Data& Y);
+template void Assemble_PDE_Single_batched<2, escript::DataTypes::cplx_t>(
+                            const AssembleParameters& p,
+                            const escript::Data& A, const escript::Data& B,
+                            const escript::Data& C, const escript::Data& D,
+                            const escript::Data& X, const escript::Data& Y);
+template void Assemble_PDE_Single_batched<3, escript::DataTypes::real_t>(
+                            const AssembleParameters& p,
+                            const escript::Data& A, const escript::Data& B,
+                            const escript::Data& C, const escript::Data& D,
+                            const escript::Data& X, const escript::Data& Y);
+template void Assemble_PDE_Single_batched<3, escript::DataTypes::cplx_t>(
+                            const AssembleParameters& p,
+                            const escript::Data& A, const escript::Data& B,
+                            const escript::Data& C, const escript::Data& D,
+                            const escript::Data& X, const escript::Data& Y);
+
+} // namespace finley
+
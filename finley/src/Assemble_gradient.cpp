@@ -107,6 +107,50 @@ void Assemble_gradient(const NodeFile* nodes, const ElementFile* elements,
     const Scalar zero = static_cast<Scalar>(0);
     const size_t localGradSize = numDim*numQuad*numSub*numComps;
     out.requireWrite();
+
+    // tensor product elements: the gradient in the reference element is
+    // calculated by sum factorization and then mapped by the inverse Jacobian
+    const TensorProductShape& tensor = jac->BasisFunctions->tensorProduct;
+    if (jac->DVDX && tensor.isEnabled()) {
+        const index_t* target = NULL;
+        if (dataType == FINLEY_REDUCED_NODES) {
+            target = nodes->borrowTargetReducedNodes();
+        } else if (dataType == FINLEY_DEGREES_OF_FREEDOM) {
+            target = nodes->borrowTargetDegreesOfFreedom();
+        } else if (dataType == FINLEY_REDUCED_DEGREES_OF_FREEDOM) {
+            target = nodes->borrowTargetReducedDegreesOfFreedom();
+        }
+        const size_t numComps_size = numComps * sizeof(Scalar);
+#pragma omp parallel
+        {
+            std::vector<Scalar> local_data(numShapes*numComps);
+            std::vector<Scalar> localGrad(localGradSize);
+            std::vector<Scalar> work(tensor.getWorkSize(numComps));
+#pragma omp for
+            for (index_t e = 0; e < elements->numElements; e++) {
+                for (int s = 0; s < numShapes; s++) {
+                    const index_t n = elements->Nodes[INDEX2(nodes_selector[s],e,NN)];
+                    const Scalar* data_array = data.getSampleDataRO(
+                                        target ? target[n] : n, zero);
+                    memcpy(&local_data[INDEX2(0,s,numComps)], data_array, numComps_size);
+                }
+                tensor.gradient(numComps, &local_data[0], &localGrad[0], &work[0]);
+                const double* dvdX = &jac->DVDX[INDEX4(0,0,0,e,numDim,numDim,numQuad)];
+                Scalar* gradData_e = out.getSampleDataRW(e, zero);
+                for (int q = 0; q < numQuad; q++) {
+                    for (int i = 0; i < numDim; i++) {
+                        for (int l = 0; l < numComps; l++) {
+                            Scalar g = zero;
+                            for (int j = 0; j < numDim; j++)
+                                g += localGrad[INDEX3(l,j,q,numComps,numDim)]*dvdX[INDEX3(j,i,q,numDim,numDim)];
+                            gradData_e[INDEX3(l,i,q,numComps,numDim)] = g;
+                        }
+                    }
+                }
+            }
+        } // end parallel region
+        return;
+    }
 #pragma omp parallel
     {
         if (dataType == FINLEY_NODES) {
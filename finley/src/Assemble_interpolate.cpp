@@ -121,11 +121,15 @@ void Assemble_interpolate(const NodeFile* nodes, const ElementFile* elements,
         throw escript::ValueError("Assemble_interpolate: expanded Data object is expected for output data.");
     }
 
+    // tensor product elements are interpolated by sum factorization
+    const TensorProductShape& tensor = basis->tensorProduct;
+    const bool useTensor = tensor.isEnabled();
     const Scalar zero = static_cast<Scalar>(0);
     interpolated_data.requireWrite();
 #pragma omp parallel
     {
         std::vector<Scalar> local_data(NS_DOF * numComps * numSub);
+        std::vector<Scalar> work(useTensor ? tensor.getWorkSize(numComps) : 0);
         const size_t numComps_size = numComps * sizeof(Scalar);
         // open the element loop
 #pragma omp for
@@ -137,10 +141,18 @@ void Assemble_interpolate(const NodeFile* nodes, const ElementFile* elements,
                     memcpy(&local_data[INDEX3(0, q, isub, numComps,NS_DOF)], data_array, numComps_size);
                 }
             }
-            // calculate interpolated_data=local_data*S
-            util::smallMatSetMult1<Scalar>(numSub, numComps, numQuad,
-                  interpolated_data.getSampleDataRW(e, zero), NS_DOF,
-                  local_data, basis->S);
+            Scalar* out = interpolated_data.getSampleDataRW(e, zero);
+            if (useTensor) {
+                for (int isub = 0; isub < numSub; isub++) {
+                    tensor.interpolate(numComps,
+                            &local_data[INDEX3(0,0,isub,numComps,NS_DOF)],
+                            &out[INDEX3(0,0,isub,numComps,numQuad)], &work[0]);
+                }
+            } else {
+                // calculate interpolated_data=local_data*S
+                util::smallMatSetMult1<Scalar>(numSub, numComps, numQuad,
+                      out, NS_DOF, local_data, basis->S);
+            }
         } // end of element loop
     } // end of parallel region
 }
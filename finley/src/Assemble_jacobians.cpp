@@ -21,6 +21,7 @@
 #include <escript/index.h>
 
 #include <sstream>
+#include <vector>
 
 /*
   input: 
@@ -828,5 +829,38 @@ void Assemble_jacobians_3D_M2D_E2D_C(const double* coordinates, int numQuad,
     }
 }
 
+/****************************************************************************/
+//
+//  inverse Jacobians of tensor product elements by sum factorization
+//
+void Assemble_inverseJacobians(const double* coordinates, int numDim,
+                               const ShapeFunction& shape, dim_t numElements,
+                               int numNodes, const index_t* nodes, double* dvdX)
+{
+    const TensorProductShape& tensor = shape.tensorProduct;
+    const int numShape = shape.Type->numShapes;
+    const int numQuad = shape.numQuadNodes;
+#pragma omp parallel
+    {
+        std::vector<double> X(numDim*numShape);
+        std::vector<double> dXdv(numDim*numDim*numQuad);
+        std::vector<double> work(tensor.getWorkSize(numDim));
+        std::vector<double> det(numQuad);
+#pragma omp for
+        for (index_t e = 0; e < numElements; e++) {
+            for (int s = 0; s < numShape; s++) {
+                const index_t n = nodes[INDEX2(s,e,numNodes)];
+                for (int i = 0; i < numDim; i++)
+                    X[INDEX2(i,s,numDim)] = coordinates[INDEX2(i,n,numDim)];
+            }
+            // dXdv[INDEX3(i,j,q,numDim,numDim)] = dX_i/dv_j
+            tensor.gradient(numDim, &X[0], &dXdv[0], &work[0]);
+            // elements with volume zero are rejected by the Jacobians above
+            util::invertSmallMat(numQuad, numDim, &dXdv[0],
+                    &dvdX[INDEX4(0,0,0,e,numDim,numDim,numQuad)], &det[0]);
+        }
+    }
+}
+
 } // namespace finley
 
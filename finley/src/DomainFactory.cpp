@@ -99,6 +99,14 @@ inline void cleanupAndThrow(FinleyDomain* dom, string msg)
 
 Domain_ptr FinleyDomain::load(const string& fileName)
 {
+    // binary mesh files can be loaded on any number of ranks and are
+    // repartitioned if the number of ranks changed
+    {
+        JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
+        int numPieces = 0;
+        if (isBinaryMesh(mpiInfo, fileName, &numPieces))
+            return readBinary(mpiInfo, fileName, numPieces != mpiInfo->size);
+    }
 #ifdef ESYS_HAVE_NETCDF
     JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
     const string fName(mpiInfo->appendRankToFileName(fileName));
@@ -490,6 +498,14 @@ Domain_ptr FinleyDomain::load(const string& fileName)
 
 Domain_ptr FinleyDomain::load(const string& fileName)
 {
+    // binary mesh files can be loaded on any number of ranks and are
+    // repartitioned if the number of ranks changed
+    {
+        JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
+        int numPieces = 0;
+        if (isBinaryMesh(mpiInfo, fileName, &numPieces))
+            return readBinary(mpiInfo, fileName, numPieces != mpiInfo->size);
+    }
 #ifdef ESYS_HAVE_NETCDF
     JMPI mpiInfo = makeInfo(MPI_COMM_WORLD);
     const string fName(mpiInfo->appendRankToFileName(fileName));
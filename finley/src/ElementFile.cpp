@@ -24,6 +24,29 @@
 
 namespace finley {
 
+namespace {
+
+/// returns true if the reduced shape functions of the reference element are
+/// identical to its full shape functions
+inline bool isLinear(const_ReferenceElement_ptr ref)
+{
+    return (ref->Type->TypeId == ref->Type->LinearTypeId &&
+            ref->Type->numSubElements == 1);
+}
+
+/// returns true if both reference elements use the same quadrature scheme
+inline bool haveSameQuadrature(const_ReferenceElement_ptr a,
+                               const_ReferenceElement_ptr b)
+{
+    const_ShapeFunction_ptr pa(a->Parametrization);
+    const_ShapeFunction_ptr pb(b->Parametrization);
+    return (pa->numQuadNodes == pb->numQuadNodes &&
+            pa->QuadNodes == pb->QuadNodes &&
+            pa->QuadWeights == pb->QuadWeights);
+}
+
+} // anonymous namespace
+
 /// constructor
 /// use ElementFile::allocTable to allocate the element table
 ElementFile::ElementFile(const_ReferenceElementSet_ptr refSet,
@@ -37,16 +60,28 @@ ElementFile::ElementFile(const_ReferenceElementSet_ptr refSet,
     Nodes(NULL),
     Color(NULL),
     minColor(0),
-    maxColor(-1)
+    maxColor(-1),
+    colorListsValid(false)
 {
-    jacobians = new ElementFile_Jacobians(
-            referenceElementSet->referenceElement->BasisFunctions);
-    jacobians_reducedQ = new ElementFile_Jacobians(
-            referenceElementSet->referenceElementReducedQuadrature->BasisFunctions);
-    jacobians_reducedS = new ElementFile_Jacobians(
-            referenceElementSet->referenceElement->LinearBasisFunctions);
-    jacobians_reducedS_reducedQ = new ElementFile_Jacobians(
-            referenceElementSet->referenceElementReducedQuadrature->LinearBasisFunctions);
+    const_ReferenceElement_ptr ref(referenceElementSet->referenceElement);
+    const_ReferenceElement_ptr refReduced(
+            referenceElementSet->referenceElementReducedQuadrature);
+    const bool linear = isLinear(ref);
+    const bool sameQuadrature = haveSameQuadrature(ref, refReduced);
+
+    jacobians = new ElementFile_Jacobians(ref->BasisFunctions);
+    jacobians_reducedQ = (sameQuadrature ? jacobians :
+            new ElementFile_Jacobians(refReduced->BasisFunctions));
+    jacobians_reducedS = (linear ? jacobians :
+            new ElementFile_Jacobians(ref->LinearBasisFunctions));
+    if (linear) {
+        jacobians_reducedS_reducedQ = jacobians_reducedQ;
+    } else if (sameQuadrature) {
+        jacobians_reducedS_reducedQ = jacobians_reducedS;
+    } else {
+        jacobians_reducedS_reducedQ = new ElementFile_Jacobians(
+                refReduced->LinearBasisFunctions);
+    }
 
     numNodes = referenceElementSet->getNumNodes();
 }
@@ -55,10 +90,15 @@ ElementFile::ElementFile(const_ReferenceElementSet_ptr refSet,
 ElementFile::~ElementFile()
 {
     freeTable();   
+    // shared Jacobians are deleted once
+    if (jacobians_reducedS_reducedQ != jacobians_reducedS &&
+            jacobians_reducedS_reducedQ != jacobians_reducedQ)
+        delete jacobians_reducedS_reducedQ;
+    if (jacobians_reducedQ != jacobians)
+        delete jacobians_reducedQ;
+    if (jacobians_reducedS != jacobians)
+        delete jacobians_reducedS;
     delete jacobians;
-    delete jacobians_reducedS;
-    delete jacobians_reducedQ;
-    delete jacobians_reducedS_reducedQ;
 }
 
 /// allocates the element table within this element file to hold NE elements.
@@ -67,12 +107,16 @@ void ElementFile::allocTable(dim_t NE)
     if (numElements > 0)
         freeTable();
 
+    // Jacobians of a previous table are no longer valid
+    freeJacobians();
+
     numElements = NE;
     Owner = new int[numElements];
     Id = new index_t[numElements];
     Nodes = new index_t[numElements * numNodes];
     Tag = new int[numElements];
     Color = new index_t[numElements];
+    colorListsValid = false;
 
     // this initialization makes sure that data are located on the right
     // processor
@@ -99,6 +143,7 @@ void ElementFile::freeTable()
     numElements = 0;
     maxColor = -1;
     minColor = 0;
+    colorListsValid = false;
 }
 
 /// copies element file 'in' into this element file starting from 'offset'.
@@ -137,6 +182,7 @@ void ElementFile::gather(const index_t* index, const ElementFile* in)
     }
     minColor = std::min(minColor, in->minColor+maxColor+1);
     maxColor = std::max(maxColor, in->maxColor+maxColor+1);
+    colorListsValid = false;
 }
 
 /// scatters the ElementFile in into this ElementFile.
@@ -156,6 +202,7 @@ void ElementFile::scatter(index_t* index, const ElementFile* in)
     }
     minColor = std::min(minColor, in->minColor+maxColor+1);
     maxColor = std::max(maxColor, in->maxColor+maxColor+1);
+    colorListsValid = false;
 }
 
 void ElementFile::swapTable(ElementFile* other)
@@ -169,6 +216,48 @@ void ElementFile::swapTable(ElementFile* other)
     std::swap(minColor, other->minColor);
     std::swap(maxColor, other->maxColor);
     std::swap(tagsInUse, other->tagsInUse);
+    colorListsValid = false;
+    other->colorListsValid = false;
+}
+
+const index_t* ElementFile::borrowColorOffsets() const
+{
+    updateColorLists();
+    return &colorOffsets[0];
+}
+
+const index_t* ElementFile::borrowElementsByColor() const
+{
+    updateColorLists();
+    return (elementsByColor.empty() ? NULL : &elementsByColor[0]);
+}
+
+/// sorts the element indices by color so that element loops only visit the
+/// elements of one color at a time. This method may be called by several
+/// threads at once.
+void ElementFile::updateColorLists() const
+{
+#pragma omp critical(finley_ElementFile_updateColorLists)
+    if (!colorListsValid) {
+        const index_t numColors = getNumColors();
+        colorOffsets.assign(numColors+1, 0);
+        for (index_t e = 0; e < numElements; e++) {
+            const index_t c = Color[e] - minColor;
+            if (c >= 0 && c < numColors)
+                colorOffsets[c+1]++;
+        }
+        for (index_t c = 0; c < numColors; c++)
+            colorOffsets[c+1] += colorOffsets[c];
+
+        elementsByColor.resize(colorOffsets[numColors]);
+        IndexVector pos(colorOffsets.begin(), colorOffsets.end()-1);
+        for (index_t e = 0; e < numElements; e++) {
+            const index_t c = Color[e] - minColor;
+            if (c >= 0 && c < numColors)
+                elementsByColor[pos[c]++] = e;
+        }
+        colorListsValid = true;
+    }
 }
 
 void ElementFile::optimizeOrdering()
@@ -260,6 +349,7 @@ void ElementFile::createColoring(const IndexVector& dofMap)
 #pragma omp parallel for
     for (index_t e = 0; e < numElements; e++)
         Color[e] = -1;
+    colorListsValid = false;
 
     index_t numUncoloredElements = numElements;
     minColor = 0;
@@ -57,6 +57,11 @@ struct ElementFile_Jacobians
     /// derivatives of shape functions in global coordinates at quadrature
     /// points
     double* DSDX;
+    /// inverse of the Jacobian at quadrature points,
+    /// DVDX[INDEX4(j,i,q,e,numDim,numDim,numQuadTotal)] = dv_j/dX_i.
+    /// Only set for tensor product elements (see TensorProductShape) which
+    /// use it to compute gradients by sum factorization, NULL otherwise.
+    double* DVDX;
 };
 
 class ElementFile
@@ -102,16 +107,38 @@ public:
 
     ElementFile_Jacobians* borrowJacobians(const NodeFile*, bool, bool) const;
 
+    /// releases the memory of all Jacobians. They are recomputed by the
+    /// next call to borrowJacobians().
+    void freeJacobians() const;
+
     /// returns the minimum and maximum reference number of nodes describing
     /// the elements
     inline std::pair<index_t,index_t> getNodeRange() const;
 
+    /// returns the number of colors, i.e. maxColor-minColor+1
+    inline index_t getNumColors() const;
+
+    /// returns an array of length getNumColors()+1 with offsets into the
+    /// array returned by borrowElementsByColor(). The elements with color
+    /// minColor+c are found at positions offsets[c] to offsets[c+1]-1.
+    const index_t* borrowColorOffsets() const;
+
+    /// returns the indices of all elements with a color between minColor and
+    /// maxColor sorted by color and in increasing order within each color
+    const index_t* borrowElementsByColor() const;
+
+    /// marks the lists of elements by color as outdated. Code that modifies
+    /// Color, minColor or maxColor directly must call this method unless the
+    /// table was just allocated.
+    void invalidateColorLists() { colorListsValid = false; }
+
     /// updates the list of tags in use. This method must be called by all
     /// ranks.
     inline void updateTagList();
 
 private:
     void swapTable(ElementFile* other);
+    void updateColorLists() const;
 
 public:
     escript::JMPI MPIInfo;
@@ -155,6 +182,11 @@ public:
     /// maximum color value
     index_t maxColor;
 
+    // Combinations of shape function and integration order which lead to
+    // identical Jacobians (e.g. reduced and full shape functions of linear
+    // elements) share the same object so the geometry is only computed and
+    // stored once.
+
     /// jacobians of the shape function used for solution approximation
     ElementFile_Jacobians* jacobians;
 
@@ -169,6 +201,12 @@ public:
     /// jacobians of the shape function used for solution approximation for
     /// reduced integration order and reduced order of shape function
     ElementFile_Jacobians* jacobians_reducedS_reducedQ;
+
+private:
+    /// element indices grouped by color, built on first use
+    mutable IndexVector colorOffsets;
+    mutable IndexVector elementsByColor;
+    mutable bool colorListsValid;
 };
 
 inline std::pair<index_t,index_t> ElementFile::getNodeRange() const
@@ -176,6 +214,11 @@ inline std::pair<index_t,index_t> ElementFile::getNodeRange() const
     return util::getMinMaxInt(numNodes, numElements, Nodes);
 }
 
+inline index_t ElementFile::getNumColors() const
+{
+    return std::max(maxColor-minColor+1, static_cast<index_t>(0));
+}
+
 inline void ElementFile::updateTagList()
 {
     util::setValuesInUse(Tag, numElements, tagsInUse, MPIInfo);
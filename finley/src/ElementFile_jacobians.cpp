@@ -27,7 +27,8 @@ ElementFile_Jacobians::ElementFile_Jacobians(const_ShapeFunction_ptr basis) :
     numQuadTotal(0),
     numElements(0),
     volume(NULL),
-    DSDX(NULL)
+    DSDX(NULL),
+    DVDX(NULL)
 {
 }
 
@@ -35,6 +36,22 @@ ElementFile_Jacobians::~ElementFile_Jacobians()
 {
     delete[] volume;
     delete[] DSDX;
+    delete[] DVDX;
+}
+
+void ElementFile::freeJacobians() const
+{
+    ElementFile_Jacobians* jac[4] = { jacobians, jacobians_reducedS,
+                          jacobians_reducedQ, jacobians_reducedS_reducedQ };
+    for (int i = 0; i < 4; i++) {
+        delete[] jac[i]->volume;
+        delete[] jac[i]->DSDX;
+        delete[] jac[i]->DVDX;
+        jac[i]->volume = NULL;
+        jac[i]->DSDX = NULL;
+        jac[i]->DVDX = NULL;
+        jac[i]->status = FINLEY_INITIAL_STATUS-1;
+    }
 }
 
 
@@ -233,6 +250,20 @@ ElementFile_Jacobians* ElementFile::borrowJacobians(const NodeFile* nodefile,
             throw escript::ValueError("ElementFile::borrowJacobians: number of spatial dimensions has to be 1, 2 or 3.");
         }
 
+        // tensor product elements keep the inverse Jacobians for gradients
+        // by sum factorization
+        if (out->numSub == 1 && out->numSides == 1
+                && refElement->numLocalDim == out->numDim
+                && shape->tensorProduct.isValid()
+                && basis->tensorProduct.isValid()) {
+            if (out->DVDX==NULL)
+                out->DVDX=new double[out->numElements
+                                      *out->numDim*out->numDim
+                                      *out->numQuadTotal];
+            Assemble_inverseJacobians(nodefile->Coordinates, out->numDim,
+                    *shape, numElements, numNodes, Nodes, out->DVDX);
+        }
+
         out->status = nodefile->status;
     }
     return out;
@@ -25,6 +25,7 @@
 #include <escript/DataFactory.h>
 #include <escript/Random.h>
 #include <escript/SolverOptions.h>
+#include <escript/SpaceFillingCurve.h>
 
 #ifdef ESYS_HAVE_PASO
 #include <paso/SystemMatrix.h>
@@ -80,7 +81,9 @@ FinleyDomain::FinleyDomain(const string& name, int numDim, escript::JMPI jmpi) :
     m_elements(NULL),
     m_faceElements(NULL),
     m_contactElements(NULL),
-    m_points(NULL)
+    m_points(NULL),
+    m_cacheGeometry(true),
+    m_pointLocatorStatus(-1)
 {
     // allocate node table
     m_nodes = new NodeFile(numDim, m_mpiInfo);
@@ -98,7 +101,9 @@ FinleyDomain::FinleyDomain(const FinleyDomain& in) :
     m_elements(in.m_elements),
     m_faceElements(in.m_faceElements),
     m_contactElements(in.m_contactElements),
-    m_points(in.m_points)
+    m_points(in.m_points),
+    m_cacheGeometry(in.m_cacheGeometry),
+    m_pointLocatorStatus(-1)
 {
     setFunctionSpaceTypeNames();
 }
@@ -112,6 +117,40 @@ FinleyDomain::~FinleyDomain()
     delete m_points;
 }
 
+void FinleyDomain::setGeometryCaching(bool cache)
+{
+    m_cacheGeometry = cache;
+    releaseGeometry();
+}
+
+void FinleyDomain::releaseGeometry() const
+{
+    if (m_cacheGeometry)
+        return;
+    if (m_elements)
+        m_elements->freeJacobians();
+    if (m_faceElements)
+        m_faceElements->freeJacobians();
+    if (m_contactElements)
+        m_contactElements->freeJacobians();
+    if (m_points)
+        m_points->freeJacobians();
+}
+
+const escript::PointLocator& FinleyDomain::getPointLocator() const
+{
+    if (!m_pointLocator || m_pointLocatorStatus != m_nodes->status) {
+        const dim_t numElements = (m_elements ? m_elements->numElements : 0);
+        const int numElementNodes = (m_elements ? m_elements->numNodes : 0);
+        const index_t* elementNodes = (m_elements ? m_elements->Nodes : NULL);
+        m_pointLocator.reset(new escript::PointLocator(getDim(),
+                    m_nodes->getNumNodes(), m_nodes->Coordinates,
+                    numElements, numElementNodes, elementNodes));
+        m_pointLocatorStatus = m_nodes->status;
+    }
+    return *m_pointLocator;
+}
+
 void FinleyDomain::MPIBarrier() const
 {
 #ifdef ESYS_MPI
@@ -123,6 +162,7 @@ void FinleyDomain::setElements(ElementFile* elements)
 {
     delete m_elements;
     m_elements = elements;
+    m_pointLocator.reset();
 }
 
 void FinleyDomain::setFaceElements(ElementFile* elements)
@@ -1167,6 +1207,7 @@ void FinleyDomain::addPDEToSystem(
         tm->fillComplete(true);
     }
 #endif
+    releaseGeometry();
 }
 
 void FinleyDomain::addPDEToLumpedSystem(escript::Data& mat,
@@ -1178,6 +1219,7 @@ void FinleyDomain::addPDEToLumpedSystem(escript::Data& mat,
     Assemble_LumpedSystem(m_nodes, m_elements, mat, D, useHRZ);
     Assemble_LumpedSystem(m_nodes, m_faceElements, mat, d, useHRZ);
     Assemble_LumpedSystem(m_nodes, m_points, mat, d_dirac, useHRZ);
+    releaseGeometry();
 }
 
 //
@@ -1202,6 +1244,7 @@ void FinleyDomain::addPDEToRHS(escript::Data& rhs, const escript::Data& X,
     Assemble_PDE(m_nodes, m_points, escript::ASM_ptr(), rhs,
                  escript::Data(), escript::Data(), escript::Data(),
                  escript::Data(), escript::Data(), y_dirac);
+    releaseGeometry();
 }
 
 //
@@ -1239,6 +1282,7 @@ void FinleyDomain::addPDEToTransportProblem(
     Assemble_PDE(m_nodes, m_points, tm, source, escript::Data(),
                  escript::Data(), escript::Data(), d_dirac, escript::Data(),
                  y_dirac);
+    releaseGeometry();
 #else
     throw FinleyException("Transport problems require the Paso library which "
                           "is not available.");
@@ -1746,6 +1790,7 @@ void FinleyDomain::setToIntegralsWorker(vector<Scalar>& integrals,
                 "function space type " << arg.getFunctionSpace().getTypeCode();
             throw ValueError(ss.str());
     }
+    releaseGeometry();
 }
 
 //
@@ -1812,6 +1857,7 @@ void FinleyDomain::setToGradient(escript::Data& grad, const escript::Data& arg)
                   "space type " << arg.getFunctionSpace().getTypeCode();
             throw ValueError(ss.str());
     }
+    releaseGeometry();
 }
 
 //
@@ -1850,6 +1896,7 @@ void FinleyDomain::setToSize(escript::Data& size) const
                   "space type " << size.getFunctionSpace().getTypeCode();
             throw ValueError(ss.str());
     }
+    releaseGeometry();
 }
 
 //
@@ -2796,6 +2843,8 @@ escript::Data FinleyDomain::randomFill(
 void FinleyDomain::prepare(bool optimize)
 {
     setOrders();
+    // nodes and elements are redistributed and relabelled
+    m_pointLocator.reset();
 
     // first step is to distribute the elements according to a global
     // distribution of DOF
@@ -2821,13 +2870,16 @@ void FinleyDomain::prepare(bool optimize)
         optimizeDOFDistribution(distribution);
         distributeByRankOfDOF(distribution);
     }
-    // the local labelling of the degrees of freedom is optimized
+    // the local labelling of the degrees of freedom is optimized and the
+    // nodes are put in space-filling curve order
     if (optimize) {
         optimizeDOFLabeling(distribution);
+        optimizeNodeOrdering();
     }
 
     // rearrange elements with the aim of bringing elements closer to memory
-    // locations of the nodes (distributed shared memory!):
+    // locations of the nodes (distributed shared memory!). If the nodes
+    // follow a space-filling curve so do the elements.
     optimizeElementOrdering();
 
     // create the global indices
@@ -2981,6 +3033,30 @@ void FinleyDomain::optimizeDOFLabeling(const IndexVector& distribution)
 #endif // ESYS_HAVE_PASO
 }
 
+/// renumbers the local nodes along a Hilbert curve so nodes close in space
+/// are close in memory
+void FinleyDomain::optimizeNodeOrdering()
+{
+    const dim_t numNodes = m_nodes->getNumNodes();
+    if (numNodes < 2)
+        return;
+
+    IndexVector order;
+    escript::getHilbertOrder(getDim(), numNodes, m_nodes->Coordinates, order);
+
+    NodeFile* newNodeFile = new NodeFile(getDim(), m_mpiInfo);
+    newNodeFile->allocTable(numNodes);
+    newNodeFile->gather(&order[0], m_nodes);
+    delete m_nodes;
+    m_nodes = newNodeFile;
+
+    IndexVector newNode(numNodes);
+#pragma omp parallel for
+    for (index_t n = 0; n < numNodes; n++)
+        newNode[order[n]] = n;
+    relabelElementNodes(newNode, 0);
+}
+
 void FinleyDomain::resolveNodeIds()
 {
     // find the minimum and maximum id used by elements
@@ -65,6 +65,7 @@
 #include <escript/AbstractContinuousDomain.h>
 #include <escript/FunctionSpace.h>
 #include <escript/FunctionSpaceFactory.h>
+#include <escript/PointLocator.h>
 
 #ifdef ESYS_HAVE_PASO
 #include <paso/SystemMatrixPattern.h>
@@ -106,7 +107,8 @@ public:
     /**
      \brief
      reads a mesh from a fly file. For MPI parallel runs fans out the mesh
-     to multiple processes.
+     to multiple processes. Files in the finley binary mesh format are
+     passed on to readBinary().
      \param mpiInfo the MPI information structure
      \param fileName the name of the file
      \param integrationOrder order of the quadrature scheme.
@@ -121,6 +123,36 @@ public:
                                     int reducedIntegrationOrder = -1,
                                     bool optimize = false);
 
+    /**
+     \brief
+     reads a mesh from a file in the finley binary mesh format written by
+     writeBinary(). All ranks read their part of the file concurrently.
+     If the number of ranks differs from the number of ranks that wrote
+     the file the mesh is redistributed.
+     \param mpiInfo the MPI information structure
+     \param fileName the name of the file
+     \param optimize whether to optimize the node labels
+     \param integrationOrder order of the quadrature scheme.
+                             If <0 the order stored in the file is used.
+     \param reducedIntegrationOrder order of the reduced quadrature scheme.
+                             If <0 the order stored in the file is used.
+    */
+    static escript::Domain_ptr readBinary(escript::JMPI mpiInfo,
+                                          const std::string& fileName,
+                                          bool optimize = false,
+                                          int integrationOrder = -1,
+                                          int reducedIntegrationOrder = -1);
+
+    /**
+     \brief
+     returns true if `fileName` is a file in the finley binary mesh format
+     and sets numPieces to the number of ranks that wrote it. Must be called
+     on all ranks.
+    */
+    static bool isBinaryMesh(escript::JMPI mpiInfo,
+                             const std::string& fileName,
+                             int* numPieces = NULL);
+
     /**
      \brief
      reads a gmsh mesh file.
@@ -334,6 +366,38 @@ public:
     */
     ElementFile* getPoints() const { return m_points; }
 
+    /**
+     \brief
+     switches caching of the element Jacobians on (the default) or off.
+     Without caching the Jacobians are released after each assembly,
+     integration, gradient or element size calculation which saves memory
+     at the cost of recomputing them on the next call.
+    */
+    void setGeometryCaching(bool cache);
+
+    /**
+     \brief
+     interpolates `data` at the points with coordinates
+     points[INDEX2(j,i,numDim)]. On return values[INDEX2(c,i,size)] holds
+     component c of the value at point i where size is the data point size
+     of `data`, and found[i] is false if point i is not in the domain.
+     Nodal data is interpolated with the element basis functions and element
+     data is averaged over the element containing the point.
+     Must be called on all ranks.
+    */
+    void interpolateAtPoints(const escript::Data& data,
+                             const std::vector<double>& points,
+                             std::vector<double>& values,
+                             std::vector<bool>& found) const;
+
+    /**
+     \brief
+     returns a list with the values of `data` at the points given as a
+     sequence of coordinate tuples. Points outside the domain give None.
+    */
+    boost::python::list evaluateAtPoints(const escript::Data& data,
+                                    const boost::python::object& points) const;
+
     /**
      \brief
      returns a reference to the MPI information wrapper for this domain
@@ -387,6 +451,15 @@ public:
     */
     void dump(const std::string& fileName) const;
 
+    /**
+     \brief
+     writes the mesh to a single file in the finley binary mesh format.
+     All ranks write their part of the mesh concurrently and the file can
+     be read on any number of ranks using readBinary().
+     \param fileName Input - The name of the file
+    */
+    void writeBinary(const std::string& fileName) const;
+
     /**
      \brief
      Return the tag key for the given sample number.
@@ -857,6 +930,13 @@ private:
     /// If k is the old node, the new node is newNode[k-offset].
     void relabelElementNodes(const IndexVector& newNode, index_t offset);
 
+    /// frees the element Jacobians unless geometry caching is switched on
+    void releaseGeometry() const;
+
+    /// returns the spatial index of the nodes and elements, rebuilding it if
+    /// the node coordinates have changed
+    const escript::PointLocator& getPointLocator() const;
+
     template<typename Scalar>
     void setToIntegralsWorker(std::vector<Scalar>& integrals,
                               const escript::Data& arg) const;
@@ -873,6 +953,7 @@ private:
     void markNodes(std::vector<short>& mask, index_t offset, bool useLinear) const;
     void optimizeDOFDistribution(IndexVector& distribution);
     void optimizeDOFLabeling(const IndexVector& distribution);
+    void optimizeNodeOrdering();
     void optimizeElementOrdering();
     void findMatchingFaces(double safetyFactor, double tolerance, int* numPairs,
                            int* elem0, int* elem1, int* matchingNodes) const;
@@ -901,6 +982,11 @@ private:
     ElementFile* m_contactElements;
     /// the table of points (treated as elements of dimension 0)
     ElementFile* m_points;
+    /// whether element Jacobians are kept between calls
+    bool m_cacheGeometry;
+    /// spatial index for point location and the node status it was built for
+    mutable escript::PointLocator_ptr m_pointLocator;
+    mutable int m_pointLocatorStatus;
     /// the tag map mapping names to tag keys
     TagMap m_tagMap;
 #ifdef ESYS_HAVE_PASO
@@ -42,6 +42,9 @@ void IndexList_insertElements(IndexList* index_list, ElementFile* elements,
     if (!elements)
         return;
 
+    const index_t* colorOffsets = elements->borrowColorOffsets();
+    const index_t* elementsByColor = elements->borrowElementsByColor();
+
     const int NN = elements->numNodes;
     const_ReferenceElement_ptr refElement(elements->referenceElementSet->
                                             borrowReferenceElement(false));
@@ -68,17 +71,17 @@ void IndexList_insertElements(IndexList* index_list, ElementFile* elements,
         NN_row=refElement->BasisFunctions->Type->numShapes * refElement->Type->numSides;
     }
 
-    for (int color=elements->minColor; color<=elements->maxColor; color++) {
+    for (index_t color = 0; color < elements->getNumColors(); color++) {
+        // loop over the elements of this color
 #pragma omp for
-        for (index_t e=0; e<elements->numElements; e++) {
-            if (elements->Color[e]==color) {
-                for (int isub=0; isub<numSub; isub++) {
-                    for (int kr=0; kr<NN_row; kr++) {
-                        const index_t irow=row_map[elements->Nodes[INDEX2(row_node[INDEX2(kr,isub,NN_row)],e,NN)]];
-                        for (int kc=0; kc<NN_col; kc++) {
-                            const index_t icol=col_map[elements->Nodes[INDEX2(col_node[INDEX2(kc,isub,NN_col)],e,NN)]];
-                            index_list[irow].insertIndex(icol);
-                        }
+        for (index_t i = colorOffsets[color]; i < colorOffsets[color+1]; i++) {
+            const index_t e = elementsByColor[i];
+            for (int isub=0; isub<numSub; isub++) {
+                for (int kr=0; kr<NN_row; kr++) {
+                    const index_t irow=row_map[elements->Nodes[INDEX2(row_node[INDEX2(kr,isub,NN_row)],e,NN)]];
+                    for (int kc=0; kc<NN_col; kc++) {
+                        const index_t icol=col_map[elements->Nodes[INDEX2(col_node[INDEX2(kc,isub,NN_col)],e,NN)]];
+                        index_list[irow].insertIndex(icol);
                     }
                 }
             }
@@ -94,21 +97,24 @@ void IndexList_insertElementsWithRowRangeNoMainDiagonal(
     if (!elements)
         return;
 
+    const index_t* colorOffsets = elements->borrowColorOffsets();
+    const index_t* elementsByColor = elements->borrowElementsByColor();
+
     // this does not resolve macro elements
     const int NN = elements->numNodes;
-    for (index_t color = elements->minColor; color <= elements->maxColor; color++) {
+    for (index_t color = 0; color < elements->getNumColors(); color++) {
+        // loop over the elements of this color
 #pragma omp for
-        for (index_t e = 0; e < elements->numElements; e++) {
-            if (elements->Color[e] == color) {
-                for (int kr = 0; kr < NN; kr++) {
-                    const index_t irow = row_map[elements->Nodes[INDEX2(kr, e, NN)]];
-                    if (firstRow <= irow && irow < lastRow) {
-                        const index_t irow_loc = irow - firstRow;
-                        for (int kc = 0; kc < NN; kc++) {
-                            const index_t icol = col_map[elements->Nodes[INDEX2(kc, e, NN)]];
-                            if (icol != irow)
-                                index_list[irow_loc].insertIndex(icol);
-                        }
+        for (index_t i = colorOffsets[color]; i < colorOffsets[color+1]; i++) {
+            const index_t e = elementsByColor[i];
+            for (int kr = 0; kr < NN; kr++) {
+                const index_t irow = row_map[elements->Nodes[INDEX2(kr, e, NN)]];
+                if (firstRow <= irow && irow < lastRow) {
+                    const index_t irow_loc = irow - firstRow;
+                    for (int kc = 0; kc < NN; kc++) {
+                        const index_t icol = col_map[elements->Nodes[INDEX2(kc, e, NN)]];
+                        if (icol != irow)
+                            index_list[irow_loc].insertIndex(icol);
                     }
                 }
             }
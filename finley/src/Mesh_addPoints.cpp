@@ -25,6 +25,9 @@
 #include "FinleyDomain.h"
 
 #include <escript/index.h>
+#include <escript/PointLocator.h>
+
+#include <set>
 
 using escript::ValueError;
 
@@ -69,8 +72,6 @@ void FinleyDomain::addDiracPoints(const std::vector<double>& points,
     if (numPoints == 0)
         return;
 
-    const escript::DataTypes::real_t LARGE_POSITIVE_FLOAT =
-                                         escript::DataTypes::real_t_max();
     ElementFile* oldPoints = m_points;
     const_ReferenceElementSet_ptr refPoints;
     int numOldPoints;
@@ -88,97 +89,14 @@ void FinleyDomain::addDiracPoints(const std::vector<double>& points,
     double *dist_p = new double[numPoints];
     int *node_id_p = new int[numPoints];
     int *point_index_p = new int[numPoints];
-    // the code below does actually initialise this before using it
 
+    const escript::PointLocator& locator = getPointLocator();
+#pragma omp parallel for
     for (int i = 0; i < numPoints; ++i) {
-        dist_p[i] = LARGE_POSITIVE_FLOAT;
-        node_id_p[i] = -1;
+        node_id_p[i] = locator.getClosestNode(&points[INDEX2(0,i,numDim)],
+                                              &dist_p[i]);
     }
 
-    const double* coords = m_nodes->Coordinates;
-    if (numDim == 3) {
-#pragma omp parallel
-        {
-            for (int i = 0; i < numPoints; ++i) {
-                const double X0 = points[INDEX2(0,i,numDim)];
-                const double X1 = points[INDEX2(1,i,numDim)];
-                const double X2 = points[INDEX2(2,i,numDim)];
-                double dist_local = LARGE_POSITIVE_FLOAT;
-                int node_id_local = -1;
-#pragma omp for
-                for (index_t n = 0; n < m_nodes->getNumNodes(); n++) {
-                    const double D0 = coords[INDEX2(0,n,numDim)] - X0;
-                    const double D1 = coords[INDEX2(1,n,numDim)] - X1;
-                    const double D2 = coords[INDEX2(2,n,numDim)] - X2;
-                    const double d = D0*D0 + D1*D1 + D2*D2;
-                    if (d < dist_local) {
-                        dist_local = d;
-                        node_id_local = n;
-                    }
-                }
-#pragma omp critical
-                {
-                    if (dist_local < dist_p[i] || (dist_local == dist_p[i] && node_id_p[i]>node_id_local)) {
-                        dist_p[i] = dist_local;
-                        node_id_p[i] = node_id_local;
-                    }
-                }
-            }
-        } // end parallel section
-    } else if (numDim == 2) {
-#pragma omp parallel
-        {
-            for (int i = 0; i < numPoints; ++i) {
-                const double X0 = points[INDEX2(0,i,numDim)];
-                const double X1 = points[INDEX2(1,i,numDim)];
-                double dist_local = LARGE_POSITIVE_FLOAT;
-                int node_id_local = -1;
-#pragma omp for
-                for (index_t n = 0; n < m_nodes->getNumNodes(); n++) {
-                    const double D0 = coords[INDEX2(0,n,numDim)] - X0;
-                    const double D1 = coords[INDEX2(1,n,numDim)] - X1;
-                    const double d = D0*D0 + D1*D1;
-                    if (d < dist_local) {
-                        dist_local = d;
-                        node_id_local = n;
-                    }
-                }
-#pragma omp critical
-                {
-                  if (dist_local < dist_p[i] || (dist_local == dist_p[i] && node_id_p[i]>node_id_local)) {
-                      dist_p[i] = dist_local;
-                      node_id_p[i] = node_id_local;
-                  }
-                }
-            }
-        } // end parallel section
-    } else { // numDim==1
-#pragma omp parallel
-        {
-            for (int i = 0; i < numPoints; ++i) {
-                const double X0 = points[INDEX2(0,i,numDim)];
-                double dist_local = LARGE_POSITIVE_FLOAT;
-                int node_id_local = -1;
-#pragma omp for
-                for (index_t n = 0; n < m_nodes->getNumNodes(); n++) {
-                    const double D0 = coords[INDEX2(0,n,numDim)] - X0;
-                    const double d = D0*D0;
-                    if (d < dist_local) {
-                        dist_local = d;
-                        node_id_local = n;
-                    }
-                }
-#pragma omp critical
-                {
-                    if (dist_local < dist_p[i] || (dist_local == dist_p[i] && node_id_p[i]>node_id_local)) {
-                        dist_p[i] = dist_local;
-                        node_id_p[i] = node_id_local;
-                    }
-                }
-            }
-        } // end parallel section
-    } //numDim
-
 #ifdef ESYS_MPI
     // now we need to reduce this across all processors
     const int count = 2*numPoints;
@@ -210,6 +128,10 @@ void FinleyDomain::addDiracPoints(const std::vector<double>& points,
     int numNewPoints = 0;
     const index_t firstDOF = m_nodes->degreesOfFreedomDistribution->getFirstComponent();
     const index_t lastDOF = m_nodes->degreesOfFreedomDistribution->getLastComponent();
+    // DOFs which already carry a point
+    std::set<index_t> usedDOFs;
+    for (int k = 0; k < numOldPoints; ++k)
+        usedDOFs.insert(m_nodes->globalDegreesOfFreedom[oldPoints->Nodes[k]]);
 
     for (int i = 0; i < numPoints; ++i) {
         if (node_id_p[i] > -1) {
@@ -217,32 +139,12 @@ void FinleyDomain::addDiracPoints(const std::vector<double>& points,
             if (m_nodes->globalReducedDOFIndex[node_id_p[i]] > -1) {
                 // the point is also used in the reduced mesh
                 const index_t global_id = m_nodes->globalDegreesOfFreedom[node_id_p[i]];
-                if (firstDOF <= global_id && global_id < lastDOF) {
-                    // is this point actually relevant
-                    bool notAnOldPoint = true;
-                    if (numOldPoints > 0) {
-                        // is this point already in the Point table?
-                        for (int k = 0; k < numOldPoints; ++k) {
-                            if (global_id == oldPoints->Nodes[k]) {
-                                notAnOldPoint=false;
-                                break;
-                            }
-                        }
-                    }
-                    if (notAnOldPoint) {
-                        // is this point unique in the new list of points?
-                        bool notANewPoint = true;
-                        for (int k = 0; k < numNewPoints; ++k) {
-                            if (global_id == m_nodes->globalDegreesOfFreedom[node_id_p[point_index_p[k]]]) {
-                                notANewPoint = false;
-                                break;
-                            }
-                        }
-                        if (notANewPoint) {
-                            point_index_p[numNewPoints] = i;
-                            numNewPoints++;
-                        }
-                    }
+                // is this point relevant and not already in the old or new
+                // list of points?
+                if (firstDOF <= global_id && global_id < lastDOF &&
+                        usedDOFs.insert(global_id).second) {
+                    point_index_p[numNewPoints] = i;
+                    numNewPoints++;
                 }
             }
         }
@@ -22,6 +22,11 @@
 
   searches for faces in the mesh which are matching.
 
+  The face centres are binned into a grid of cells at least as large as the
+  matching tolerance. Cells are sorted so that the candidates for a face
+  are found by binary searches in the neighbouring cells. Candidate search
+  and node matching of the pairs run in parallel.
+
 *****************************************************************************/
 
 #include "FinleyDomain.h"
@@ -29,33 +34,53 @@
 
 #include <escript/index.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 //#define Finley_TRACE
 
 namespace finley {
 
-static double lockingGridSize = 0.;
+namespace {
 
-// this structure is used for matching surface elements
-struct FaceCenter
+/// the cell a face centre falls into and the face
+struct FaceCell
 {
-   int refId;
-   std::vector<double> x;
+    int64_t cell[3];
+    index_t e;
 };
 
-/// comparison function for findMatchingFaces
-bool FaceCenterCompare(const FaceCenter& e1, const FaceCenter& e2)
+/// lexicographical comparison of cells
+inline bool lessCell(const int64_t* c0, const int64_t* c1)
 {
-    for (int i = 0; i < e1.x.size(); i++) {
-        bool l = (e1.x[i] < e2.x[i]+lockingGridSize);
-        bool g = (e2.x[i] < e1.x[i]+lockingGridSize);
-        if (! (l && g)) {
-            if (l) return true;
-            if (g) return false;
-        }
+    for (int i = 0; i < 3; i++) {
+        if (c0[i] != c1[i])
+            return c0[i] < c1[i];
     }
-    return e1.refId < e2.refId; // strict order to e1==e2 is false
+    return false;
 }
 
+struct FaceCellCompare
+{
+    bool operator()(const FaceCell& a, const FaceCell& b) const
+    {
+        if (lessCell(a.cell, b.cell))
+            return true;
+        if (lessCell(b.cell, a.cell))
+            return false;
+        return a.e < b.e;
+    }
+    bool operator()(const FaceCell& a, const int64_t* c) const
+    {
+        return lessCell(a.cell, c);
+    }
+    bool operator()(const int64_t* c, const FaceCell& a) const
+    {
+        return lessCell(c, a.cell);
+    }
+};
+
 inline double getDist(int e0, int i0, int e1, int i1, int numDim, int NN,
                       const double* X)
 {
@@ -67,6 +92,8 @@ inline double getDist(int e0, int i0, int e1, int i1, int numDim, int NN,
     return dist;
 }
 
+} // anonymous namespace
+
 void FinleyDomain::findMatchingFaces(double safety_factor, double tolerance,
                                      int* numPairs, int* elem0, int* elem1,
                                      int* matching_nodes_in_elem1) const
@@ -75,6 +102,7 @@ void FinleyDomain::findMatchingFaces(double safety_factor, double tolerance,
                                             borrowReferenceElement(false));
     const int numDim = m_nodes->numDim;
     const int NN = m_faceElements->numNodes;
+    const dim_t numElements = m_faceElements->numElements;
     const int numNodesOnFace = refElement->Type->numNodesOnFace;
     const int* faceNodes = refElement->Type->faceNodes;
     const int* shiftNodes = refElement->Type->shiftNodes;
@@ -86,142 +114,200 @@ void FinleyDomain::findMatchingFaces(double safety_factor, double tolerance,
             "face elements of type " << refElement->Type->Name;
         throw escript::ValueError(ss.str());
     }
-    double* X = new double[NN * numDim * m_faceElements->numElements];
-    std::vector<FaceCenter> center(m_faceElements->numElements);
-    int* a1 = new int[NN];
-    int* a2 = new int[NN];
+    *numPairs = 0;
+    if (numElements < 2)
+        return;
+
+    std::vector<double> X(NN * numDim * numElements);
+    std::vector<double> center(numDim * numElements, 0.);
     double h = std::numeric_limits<double>::max();
 
-    // TODO: OMP
-    for (index_t e = 0; e < m_faceElements->numElements; e++) {
-        // get the coordinates of the nodes
-        util::gather(NN, &(m_faceElements->Nodes[INDEX2(0,e,NN)]), numDim,
-                     m_nodes->Coordinates, &X[INDEX3(0,0,e,numDim,NN)]);
-        // get the element center
-        center[e].refId = e;
-        center[e].x.assign(numDim, 0);
-        for (int i0 = 0; i0 < numNodesOnFace; i0++) {
+#pragma omp parallel
+    {
+        double h_local = std::numeric_limits<double>::max();
+#pragma omp for
+        for (index_t e = 0; e < numElements; e++) {
+            // get the coordinates of the nodes
+            util::gather(NN, &(m_faceElements->Nodes[INDEX2(0,e,NN)]), numDim,
+                         m_nodes->Coordinates, &X[INDEX3(0,0,e,numDim,NN)]);
+            // get the element center
+            for (int i0 = 0; i0 < numNodesOnFace; i0++) {
+                for (int i = 0; i < numDim; i++)
+                    center[INDEX2(i,e,numDim)] += X[INDEX3(i,faceNodes[i0],e,numDim,NN)];
+            }
             for (int i = 0; i < numDim; i++)
-                center[e].x[i] += X[INDEX3(i,faceNodes[i0],e,numDim,NN)];
-        }
-        for (int i = 0; i < numDim; i++)
-            center[e].x[i] /= numNodesOnFace;
-        // get the minimum distance between nodes in the element
-        for (int i0 = 0; i0 < numNodesOnFace; i0++) {
-            for (int i1 = i0+1; i1 < numNodesOnFace; i1++) {
-                double h_local = getDist(e, faceNodes[i0], e, faceNodes[i1], numDim, NN, X);
-                h = std::min(h, h_local);
+                center[INDEX2(i,e,numDim)] /= numNodesOnFace;
+            // get the minimum distance between nodes in the element
+            for (int i0 = 0; i0 < numNodesOnFace; i0++) {
+                for (int i1 = i0+1; i1 < numNodesOnFace; i1++) {
+                    h_local = std::min(h_local, getDist(e, faceNodes[i0], e,
+                                        faceNodes[i1], numDim, NN, &X[0]));
+                }
             }
         }
+#pragma omp critical
+        h = std::min(h, h_local);
     }
-    lockingGridSize = h*std::max(safety_factor, 0.);
+    const double tol = h*tolerance;
+    // the cells must not be smaller than the tolerance so matching centres
+    // are in the same or in neighbouring cells
+    double cellSize = h*std::max(std::max(safety_factor, tolerance), 0.);
+    if (!(cellSize > 0.) || cellSize == std::numeric_limits<double>::max())
+        cellSize = 1.;
 #ifdef Finley_TRACE
-    std::cout << "locking grid size is " << lockingGridSize << std::endl;
-    std::cout << "absolute tolerance is " << h * tolerance << std::endl;
-    std::cout << "number of face elements is " << m_faceElements->numElements << std::endl;
+    std::cout << "cell size is " << cellSize << std::endl;
+    std::cout << "absolute tolerance is " << tol << std::endl;
+    std::cout << "number of face elements is " << numElements << std::endl;
 #endif
-    // sort the elements by center coordinates (lexicographical)
-    std::sort(center.begin(), center.end(), FaceCenterCompare);
-    // find elements with matching center
-    *numPairs = 0;
 
-    // TODO: OMP
-    for (index_t e = 0; e < m_faceElements->numElements-1; e++) {
-        double dist = 0.;
-        for (int i = 0; i < numDim; i++)
-            dist = std::max(dist, std::abs(center[e].x[i]-center[e+1].x[i]));
-        if (dist < h * tolerance) {
-            const int e_0 = center[e].refId;
-            const int e_1 = center[e+1].refId;
-            elem0[*numPairs] = e_0;
-            elem1[*numPairs] = e_1;
+    // bin the centres and sort the cells
+    std::vector<FaceCell> cells(numElements);
+    const double maxCell = 1e18;
+#pragma omp parallel for
+    for (index_t e = 0; e < numElements; e++) {
+        cells[e].e = e;
+        for (int i = 0; i < 3; i++) {
+            double c = 0.;
+            if (i < numDim)
+                c = std::floor(center[INDEX2(i,e,numDim)]/cellSize);
+            cells[e].cell[i] = static_cast<int64_t>(
+                                    std::max(-maxCell, std::min(c, maxCell)));
+        }
+    }
+    std::sort(cells.begin(), cells.end(), FaceCellCompare());
+
+    // find the partner of every face: the face with the smallest index
+    // larger than its own whose centre is within the tolerance
+    std::vector<index_t> partner(numElements, -1);
+    const int numNeighbours = (numDim == 1 ? 3 : (numDim == 2 ? 9 : 27));
+#pragma omp parallel for
+    for (index_t k = 0; k < numElements; k++) {
+        const index_t e = cells[k].e;
+        index_t best = -1;
+        for (int n = 0; n < numNeighbours; n++) {
+            int64_t c[3];
+            int m = n;
+            for (int i = 0; i < 3; i++) {
+                c[i] = cells[k].cell[i];
+                if (i < numDim) {
+                    c[i] += m%3 - 1;
+                    m /= 3;
+                }
+            }
+            std::pair<std::vector<FaceCell>::const_iterator,
+                      std::vector<FaceCell>::const_iterator> range(
+                    std::equal_range(cells.begin(), cells.end(),
+                                     static_cast<const int64_t*>(c),
+                                     FaceCellCompare()));
+            for (std::vector<FaceCell>::const_iterator it = range.first;
+                    it != range.second; ++it) {
+                const index_t e1 = it->e;
+                if (e1 <= e || (best >= 0 && e1 >= best))
+                    continue;
+                double dist = 0.;
+                for (int i = 0; i < numDim; i++)
+                    dist = std::max(dist, std::abs(center[INDEX2(i,e,numDim)]
+                                - center[INDEX2(i,e1,numDim)]));
+                if (dist < tol)
+                    best = e1;
+            }
+        }
+        partner[e] = best;
+    }
+    cells.clear();
+
+    for (index_t e = 0; e < numElements; e++) {
+        if (partner[e] >= 0) {
+            elem0[*numPairs] = e;
+            elem1[*numPairs] = partner[e];
+            (*numPairs)++;
+        }
+    }
+
+    // rotate the nodes of the second element of each pair such that the
+    // nodes of both elements have the same coordinates. Errors are reported
+    // for the first pair that fails.
+    int errorPair = *numPairs;
+    std::string errorMsg;
+#pragma omp parallel
+    {
+        std::vector<int> a1(NN), a2(NN);
+#pragma omp for
+        for (int p = 0; p < *numPairs; p++) {
+            const int e_0 = elem0[p];
+            const int e_1 = elem1[p];
+            std::stringstream ss;
             // now the element e_1 is rotated such that the first node in
             // element e_0 and e_1 have the same coordinates
-            int* perm = a1;
-            int* perm_tmp = a2;
+            int* perm = &a1[0];
+            int* perm_tmp = &a2[0];
             for (int i = 0; i < NN; i++)
                 perm[i] = i;
             while (1) {
                 // if node 0 and perm[0] are the same we are ready
-                dist = getDist(e_0, 0, e_1, perm[0], numDim, NN, X);
-                if (dist <= h*tolerance)
+                if (getDist(e_0, 0, e_1, perm[0], numDim, NN, &X[0]) <= tol)
                     break;
                 if (shiftNodes[0] >= 0) {
                     // rotate the nodes
-                    int* itmp_ptr = perm;
-                    perm = perm_tmp;
-                    perm_tmp = itmp_ptr;
-                    #pragma ivdep
+                    std::swap(perm, perm_tmp);
                     for (int i = 0; i < NN; i++)
                         perm[i] = perm_tmp[shiftNodes[i]];
                 }
                 // if the permutation is back at the identity, i.e. perm[0]=0,
                 // the faces don't match:
                 if (perm[0] == 0) {
-                    std::stringstream ss;
                     ss << "Mesh::findMatchingFaces: couldn't match first node "
                         "of element " << e_0 << " to touching element " << e_1;
-                    throw escript::ValueError(ss.str());
+                    break;
                 }
             }
             // now we check if the second nodes match
-            if (numNodesOnFace > 1) {
-                dist = getDist(e_0, 1, e_1, perm[faceNodes[1]], numDim, NN, X);
+            if (ss.str().empty() && numNodesOnFace > 1 &&
+                    getDist(e_0, 1, e_1, perm[faceNodes[1]], numDim, NN, &X[0]) > tol) {
                 // if the second node does not match we reverse the
                 // direction of the nodes
-                if (dist > h*tolerance) {
-                    // rotate the nodes
-                    if (reverseNodes[0] < 0) {
-                        std::stringstream ss;
-                        ss << "Mesh::findMatchingFaces: couldn't match the"
-                            " second node of element " << e_0
-                            << " to touching element " << e_1;
-                        throw escript::ValueError(ss.str());
-                    } else {
-                        int* itmp_ptr = perm;
-                        perm = perm_tmp;
-                        perm_tmp = itmp_ptr;
-                        #pragma ivdep
-                        for (int i = 0; i < NN; i++)
-                            perm[i] = perm_tmp[reverseNodes[i]];
-                        dist = getDist(e_0, 1, e_1, perm[faceNodes[1]], numDim, NN, X);
-                        if (dist > h*tolerance) {
-                            std::stringstream ss;
-                            ss << "Mesh::findMatchingFaces: couldn't match the"
-                                " second node of element " << e_0
-                                << " to touching element " << e_1;
-                            throw escript::ValueError(ss.str());
-                        }
-                    }
+                if (reverseNodes[0] >= 0) {
+                    std::swap(perm, perm_tmp);
+                    for (int i = 0; i < NN; i++)
+                        perm[i] = perm_tmp[reverseNodes[i]];
+                }
+                if (reverseNodes[0] < 0 || getDist(e_0, 1, e_1,
+                            perm[faceNodes[1]], numDim, NN, &X[0]) > tol) {
+                    ss << "Mesh::findMatchingFaces: couldn't match the"
+                        " second node of element " << e_0
+                        << " to touching element " << e_1;
                 }
             }
             // we check if the rest of the face nodes match
-            for (int i = 2; i < numNodesOnFace; i++) {
+            for (int i = 2; ss.str().empty() && i < numNodesOnFace; i++) {
                 const int n = faceNodes[i];
-                dist = getDist(e_0, n, e_1, perm[n], numDim, NN, X);
-                if (dist > h*tolerance) {
-                    std::stringstream ss;
+                if (getDist(e_0, n, e_1, perm[n], numDim, NN, &X[0]) > tol) {
                     ss << "Mesh::findMatchingFaces: couldn't match the "
                         << i << "-th node of element " << e_0
                         << " to touching element " << e_1;
-                    throw escript::ValueError(ss.str());
                 }
             }
+            if (!ss.str().empty()) {
+#pragma omp critical
+                {
+                    if (p < errorPair) {
+                        errorPair = p;
+                        errorMsg = ss.str();
+                    }
+                }
+                continue;
+            }
             // copy over the permuted nodes of e_1 into matching_nodes_in_elem1
             for (int i = 0; i < NN; i++)
-                matching_nodes_in_elem1[INDEX2(i,*numPairs,NN)] =
+                matching_nodes_in_elem1[INDEX2(i,p,NN)] =
                     m_faceElements->Nodes[INDEX2(perm[i],e_1,NN)];
-            (*numPairs)++;
         }
     }
+    if (errorPair < *numPairs)
+        throw escript::ValueError(errorMsg);
 #ifdef Finley_TRACE
     std::cout << "number of pairs of matching faces " << *numPairs << std::endl;
 #endif
-
-    delete[] X;
-    delete[] a1;
-    delete[] a2;
 }
 
 } // namespace finley
-
@@ -0,0 +1,373 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+
+/****************************************************************************
+
+  Locates points in the elements of the mesh and interpolates data there.
+
+*****************************************************************************/
+
+#include "FinleyDomain.h"
+
+#include <escript/index.h>
+
+#include <boost/python/extract.hpp>
+#include <boost/python/tuple.hpp>
+
+#include <cmath>
+#include <sstream>
+
+namespace bp = boost::python;
+
+using escript::ValueError;
+
+namespace finley {
+
+/// maximum number of Newton steps to find the local coordinates of a point
+static const int MAX_NEWTON_STEPS = 20;
+
+/// relative tolerance of the local coordinates
+static const double LOCAL_TOLERANCE = 1e-8;
+
+/// solves the dim x dim system A*x=b, returns false if A is singular
+static bool solveSmall(int dim, const double* A, const double* b, double* x)
+{
+    if (dim == 1) {
+        if (A[0] == 0.)
+            return false;
+        x[0] = b[0]/A[0];
+    } else if (dim == 2) {
+        const double D = A[INDEX2(0,0,2)]*A[INDEX2(1,1,2)]
+                       - A[INDEX2(0,1,2)]*A[INDEX2(1,0,2)];
+        if (D == 0.)
+            return false;
+        x[0] = (A[INDEX2(1,1,2)]*b[0]-A[INDEX2(0,1,2)]*b[1])/D;
+        x[1] = (A[INDEX2(0,0,2)]*b[1]-A[INDEX2(1,0,2)]*b[0])/D;
+    } else {
+        const double A11=A[INDEX2(0,0,3)], A12=A[INDEX2(0,1,3)], A13=A[INDEX2(0,2,3)];
+        const double A21=A[INDEX2(1,0,3)], A22=A[INDEX2(1,1,3)], A23=A[INDEX2(1,2,3)];
+        const double A31=A[INDEX2(2,0,3)], A32=A[INDEX2(2,1,3)], A33=A[INDEX2(2,2,3)];
+        const double D = A11*(A22*A33-A23*A32) + A12*(A23*A31-A21*A33)
+                       + A13*(A21*A32-A22*A31);
+        if (D == 0.)
+            return false;
+        x[0] = ((A22*A33-A23*A32)*b[0] + (A13*A32-A12*A33)*b[1]
+                + (A12*A23-A13*A22)*b[2])/D;
+        x[1] = ((A23*A31-A21*A33)*b[0] + (A11*A33-A13*A31)*b[1]
+                + (A13*A21-A11*A23)*b[2])/D;
+        x[2] = ((A21*A32-A22*A31)*b[0] + (A12*A31-A11*A32)*b[1]
+                + (A11*A22-A12*A21)*b[2])/D;
+    }
+    return true;
+}
+
+/// returns true if `shape` is defined on the unit simplex rather than the
+/// unit square/cube
+static bool isSimplex(const ShapeFunctionInfo* shape)
+{
+    return (shape->TypeId == Tri3Shape || shape->TypeId == Tet4Shape);
+}
+
+/// computes the local coordinates `xi` of `x` in the geometry of element e
+/// given by the shape functions `shape` over the element nodes
+/// nodeSelection[0:shape->numShapes]. Returns false if the Newton
+/// iteration failed. `x` may lie outside the element, see
+/// getDistanceOutside().
+static bool getLocalCoordinates(const NodeFile* nodes,
+                                const ElementFile* elements, index_t e,
+                                const ShapeFunctionInfo* shape,
+                                const int* nodeSelection, const double* x,
+                                double* xi)
+{
+    const int dim = nodes->numDim;
+    const int numShapes = shape->numShapes;
+    const int NN = elements->numNodes;
+    const bool simplex = isSimplex(shape);
+    std::vector<double> v(dim), s(numShapes), dsdv(numShapes*dim);
+    double J[9], r[3], dxi[3];
+
+    for (int j = 0; j < dim; j++)
+        v[j] = (simplex ? 1./(dim+1) : 0.5);
+    bool converged = false;
+    for (int step = 0; step < MAX_NEWTON_STEPS && !converged; step++) {
+        shape->getValues(1, v, s, dsdv);
+        for (int i = 0; i < dim; i++) {
+            r[i] = x[i];
+            for (int j = 0; j < dim; j++)
+                J[INDEX2(i,j,dim)] = 0.;
+        }
+        for (int k = 0; k < numShapes; k++) {
+            const index_t n = elements->Nodes[INDEX2(nodeSelection[k],e,NN)];
+            for (int i = 0; i < dim; i++) {
+                const double X = nodes->Coordinates[INDEX2(i,n,dim)];
+                r[i] -= X*s[S_INDEX(k,0,numShapes)];
+                for (int j = 0; j < dim; j++)
+                    J[INDEX2(i,j,dim)] += X*dsdv[DSDV_INDEX(k,j,0,numShapes,dim)];
+            }
+        }
+        if (!solveSmall(dim, J, r, dxi))
+            return false;
+        double norm = 0.;
+        for (int j = 0; j < dim; j++) {
+            v[j] += dxi[j];
+            norm = std::max(norm, std::abs(dxi[j]));
+        }
+        converged = (norm <= LOCAL_TOLERANCE);
+    }
+    for (int j = 0; j < dim; j++)
+        xi[j] = v[j];
+    return converged;
+}
+
+/// returns by how much the local coordinates `xi` lie outside the reference
+/// element of `shape`, 0 if the point is inside
+static double getDistanceOutside(const ShapeFunctionInfo* shape, int dim,
+                                 const double* xi)
+{
+    const bool simplex = isSimplex(shape);
+    double dist = 0., sum = 0.;
+    for (int j = 0; j < dim; j++) {
+        dist = std::max(dist, -xi[j]);
+        if (!simplex)
+            dist = std::max(dist, xi[j]-1.);
+        sum += xi[j];
+    }
+    if (simplex)
+        dist = std::max(dist, sum-1.);
+    return dist;
+}
+
+void FinleyDomain::interpolateAtPoints(const escript::Data& data,
+                                       const std::vector<double>& points,
+                                       std::vector<double>& values,
+                                       std::vector<bool>& found) const
+{
+    if (*data.getFunctionSpace().getDomain() != *this)
+        throw ValueError("interpolateAtPoints: Illegal domain of data.");
+    if (data.isComplex())
+        throw ValueError("interpolateAtPoints: complex data is not supported.");
+    const int numDim = getDim();
+    if (points.size() % numDim != 0)
+        throw ValueError("interpolateAtPoints: number of coordinates is not a multiple of the domain's dimensionality.");
+    if (!m_elements)
+        throw ValueError("interpolateAtPoints: domain has no elements.");
+
+    const_ReferenceElement_ptr refElement(m_elements->referenceElementSet->
+                                          borrowReferenceElement(false));
+    if (refElement->numLocalDim != numDim)
+        throw ValueError("interpolateAtPoints: elements of a manifold are not supported.");
+
+    // all ranks get the same points so they return together before the
+    // collective interpolation and reductions below
+    const dim_t numPoints = points.size()/numDim;
+    if (numPoints == 0) {
+        values.clear();
+        found.clear();
+        return;
+    }
+
+    escript::Data in;
+    switch (data.getFunctionSpace().getTypeCode()) {
+        case DegreesOfFreedom:
+            in = escript::Data(data, continuousFunction(*this));
+            break;
+        case ReducedDegreesOfFreedom:
+            in = escript::Data(data, reducedContinuousFunction(*this));
+            break;
+        case Nodes:
+        case ReducedNodes:
+        case Elements:
+        case ReducedElements:
+            in = data;
+            break;
+        default:
+            throw ValueError("interpolateAtPoints: data must be defined on "
+                             "nodes, degrees of freedom or elements.");
+    }
+    const int typeCode = in.getFunctionSpace().getTypeCode();
+    const bool nodal = (typeCode == Nodes || typeCode == ReducedNodes);
+    const bool reduced = (typeCode == ReducedNodes);
+
+    const int numComps = in.getDataPointSize();
+    const int numDataPoints = (in.actsExpanded() ?
+                                    in.getNumDataPointsPerSample() : 1);
+    const int NN = m_elements->numNodes;
+    const int numSub = refElement->Type->numSubElements;
+    const ShapeFunctionInfo* linearShape = refElement->LinearBasisFunctions->Type;
+    const ShapeFunctionInfo* basis = refElement->BasisFunctions->Type;
+    const int numShapes = basis->numShapes;
+    const int* linearNodes = refElement->Type->linearNodes;
+    const int* subElementNodes = refElement->Type->subElementNodes;
+    const index_t* map = (reduced ? m_nodes->borrowTargetReducedNodes()
+                                  : m_nodes->borrowTargetNodes());
+    const escript::PointLocator& locator = getPointLocator();
+
+    values.assign(numPoints*numComps, 0.);
+    // rank that located each point, MPI size if none
+    std::vector<int> owner(numPoints, m_mpiInfo->size);
+#pragma omp parallel
+    {
+        std::vector<index_t> candidates;
+        std::vector<double> v(numDim), s(std::max(numShapes,
+                        linearShape->numShapes)), dsdv(s.size()*numDim);
+        double xi[3];
+#pragma omp for
+        for (index_t p = 0; p < numPoints; p++) {
+            const double* x = &points[INDEX2(0,p,numDim)];
+            double* out = &values[INDEX2(0,p,numComps)];
+            locator.getCandidateElements(x, candidates);
+            for (size_t c = 0; c < candidates.size(); c++) {
+                const index_t e = candidates[c];
+                if (!getLocalCoordinates(m_nodes, m_elements, e, linearShape,
+                                         linearNodes, x, xi)
+                        || getDistanceOutside(linearShape, numDim, xi) > LOCAL_TOLERANCE)
+                    continue;
+                if (!nodal) {
+                    // element data is averaged over the element
+                    for (int q = 0; q < numDataPoints; q++) {
+                        const double* d = in.getSampleDataRO(e)+q*numComps;
+                        for (int i = 0; i < numComps; i++)
+                            out[i] += d[i]/numDataPoints;
+                    }
+                    owner[p] = m_mpiInfo->rank;
+                    break;
+                }
+                // pick the basis functions and nodes for the nodal data.
+                // Macro elements are searched for the sub-element
+                // containing the point.
+                const ShapeFunctionInfo* shape = basis;
+                const int* selection = subElementNodes;
+                int numS = numShapes;
+                if (reduced) {
+                    shape = linearShape;
+                    selection = linearNodes;
+                    numS = linearShape->numShapes;
+                } else if (numSub > 1) {
+                    // the sub-elements tile the element but rounding may
+                    // leave the point just outside all of them, in which
+                    // case the closest one is used
+                    double minDist = -1.;
+                    double subXi[3];
+                    for (int isub = 0; isub < numSub; isub++) {
+                        const int* sel = &subElementNodes[INDEX2(0,isub,numShapes)];
+                        if (!getLocalCoordinates(m_nodes, m_elements, e, basis,
+                                                 sel, x, subXi))
+                            continue;
+                        const double dist = getDistanceOutside(basis, numDim, subXi);
+                        if (minDist < 0. || dist < minDist) {
+                            minDist = dist;
+                            selection = sel;
+                            for (int j = 0; j < numDim; j++)
+                                xi[j] = subXi[j];
+                        }
+                        if (dist <= LOCAL_TOLERANCE)
+                            break;
+                    }
+                    // no local coordinates in any sub-element, leave the
+                    // point to the other candidates
+                    if (minDist < 0.)
+                        continue;
+                }
+                for (int j = 0; j < numDim; j++)
+                    v[j] = xi[j];
+                shape->getValues(1, v, s, dsdv);
+                for (int k = 0; k < numS; k++) {
+                    const index_t n = m_elements->Nodes[INDEX2(selection[k],e,NN)];
+                    const double* d = in.getSampleDataRO(map[n]);
+                    for (int i = 0; i < numComps; i++)
+                        out[i] += s[S_INDEX(k,0,numS)]*d[i];
+                }
+                owner[p] = m_mpiInfo->rank;
+                break;
+            }
+        }
+    } // end of parallel region
+
+#ifdef ESYS_MPI
+    // the lowest rank that located a point provides its value
+    if (m_mpiInfo->size > 1) {
+        std::vector<int> minOwner(numPoints);
+        MPI_Allreduce(&owner[0], &minOwner[0], numPoints, MPI_INT, MPI_MIN,
+                      m_mpiInfo->comm);
+        owner.swap(minOwner);
+#pragma omp parallel for
+        for (index_t p = 0; p < numPoints; p++) {
+            if (owner[p] != m_mpiInfo->rank) {
+                for (int i = 0; i < numComps; i++)
+                    values[INDEX2(i,p,numComps)] = 0.;
+            }
+        }
+        std::vector<double> sum(values.size());
+        MPI_Allreduce(&values[0], &sum[0], values.size(), MPI_DOUBLE,
+                      MPI_SUM, m_mpiInfo->comm);
+        values.swap(sum);
+    }
+#endif
+    found.resize(numPoints);
+    for (index_t p = 0; p < numPoints; p++)
+        found[p] = (owner[p] < m_mpiInfo->size);
+}
+
+bp::list FinleyDomain::evaluateAtPoints(const escript::Data& data,
+                                        const bp::object& points) const
+{
+    const int numDim = getDim();
+    const int numPoints = bp::extract<int>(points.attr("__len__")());
+    std::vector<double> coords(numPoints*numDim);
+    for (int i = 0; i < numPoints; i++) {
+        const bp::object p = points[i];
+        bp::extract<double> scalar(p);
+        if (numDim == 1 && scalar.check()) {
+            coords[i] = scalar();
+            continue;
+        }
+        const int len = bp::extract<int>(p.attr("__len__")());
+        if (len != numDim) {
+            std::stringstream ss;
+            ss << "evaluateAtPoints: point " << i << " has " << len
+               << " coordinates but the domain has dimension " << numDim;
+            throw ValueError(ss.str());
+        }
+        for (int j = 0; j < numDim; j++)
+            coords[INDEX2(j,i,numDim)] = bp::extract<double>(p[j]);
+    }
+
+    std::vector<double> values;
+    std::vector<bool> found;
+    interpolateAtPoints(data, coords, values, found);
+
+    const int numComps = data.getDataPointSize();
+    const bool scalar = (data.getDataPointRank() == 0);
+    bp::list out;
+    for (int i = 0; i < numPoints; i++) {
+        if (!found[i]) {
+            out.append(bp::object());
+        } else if (scalar) {
+            out.append(values[i]);
+        } else {
+            bp::list comps;
+            for (int c = 0; c < numComps; c++)
+                comps.append(values[INDEX2(c,i,numComps)]);
+            out.append(bp::tuple(comps));
+        }
+    }
+    return out;
+}
+
+} // namespace finley
+
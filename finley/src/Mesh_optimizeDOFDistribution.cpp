@@ -19,6 +19,7 @@
 #include "IndexList.h"
 
 #include <escript/index.h>
+#include <escript/SpaceFillingCurve.h>
 
 #ifdef ESYS_HAVE_PARMETIS
 #include <parmetis.h>
@@ -60,7 +61,45 @@ static bool allRanksHaveNodes(escript::JMPI mpiInfo,
 }
 #endif
 
-/// optimizes the distribution of DOFs across processors using ParMETIS.
+/// returns an estimate of the work per node of an element of `elements`:
+/// the element adds one entry per node to the matrix rows of its nodes and
+/// the element matrix is integrated over all quadrature points
+static double getElementWork(const ElementFile* elements)
+{
+    const_ReferenceElement_ptr refElement(
+                    elements->referenceElementSet->referenceElement);
+    const int numQuad = refElement->Parametrization->numQuadNodes *
+                        refElement->Type->numSubElements;
+    return static_cast<double>(elements->numNodes * (numQuad + 1));
+}
+
+/// adds the work of the elements in `elements` to the weights of the DOFs
+/// in [myFirstVertex, myLastVertex) they refer to
+static void addElementWeights(std::vector<double>& weights,
+                              const ElementFile* elements,
+                              const index_t* globalDOF,
+                              index_t myFirstVertex, index_t myLastVertex)
+{
+    if (!elements || elements->numElements == 0)
+        return;
+    const double work = getElementWork(elements);
+    const int NN = elements->numNodes;
+#pragma omp parallel for
+    for (index_t e = 0; e < elements->numElements; e++) {
+        for (int j = 0; j < NN; j++) {
+            const index_t k = globalDOF[elements->Nodes[INDEX2(j, e, NN)]];
+            if (k >= myFirstVertex && k < myLastVertex) {
+#pragma omp atomic
+                weights[k - myFirstVertex] += work;
+            }
+        }
+    }
+}
+
+/// optimizes the distribution of DOFs across processors using ParMETIS or,
+/// if ParMETIS is not available, by splitting a Hilbert curve through the
+/// DOFs. The DOFs are weighted by the work of the elements using them so
+/// that high-order, contact and point elements are taken into account.
 /// On return a new distribution is given and the globalDOF are relabeled
 /// accordingly but the mesh has not been redistributed yet
 void FinleyDomain::optimizeDOFDistribution(IndexVector& distribution)
@@ -78,11 +117,32 @@ void FinleyDomain::optimizeDOFDistribution(IndexVector& distribution)
         len = std::max(len, distribution[p + 1] - distribution[p]);
 
     index_t* partition = new index_t[len];
+    const int dim = m_nodes->numDim;
+
+    // the coordinates and work weights of the DOFs owned by this rank
+    std::vector<double> xyz(myNumVertices * dim);
+    std::vector<double> weights(myNumVertices, 0.);
+#pragma omp parallel for
+    for (index_t i = 0; i < numNodes; ++i) {
+        const index_t k = m_nodes->globalDegreesOfFreedom[i] - myFirstVertex;
+        if (k >= 0 && k < myNumVertices) {
+            for (int j = 0; j < dim; ++j)
+                xyz[INDEX2(j, k, dim)] = m_nodes->Coordinates[INDEX2(j, i, dim)];
+        }
+    }
+    addElementWeights(weights, m_elements, m_nodes->globalDegreesOfFreedom,
+                      myFirstVertex, myLastVertex);
+    addElementWeights(weights, m_faceElements, m_nodes->globalDegreesOfFreedom,
+                      myFirstVertex, myLastVertex);
+    addElementWeights(weights, m_contactElements,
+                      m_nodes->globalDegreesOfFreedom, myFirstVertex,
+                      myLastVertex);
+    addElementWeights(weights, m_points, m_nodes->globalDegreesOfFreedom,
+                      myFirstVertex, myLastVertex);
 
 #ifdef ESYS_HAVE_PARMETIS
     if (mpiSize > 1 && allRanksHaveNodes(m_mpiInfo, distribution)) {
         boost::scoped_array<IndexList> index_list(new IndexList[myNumVertices]);
-        int dim = m_nodes->numDim;
 
         // create the adjacency structure xadj and adjncy
 #pragma omp parallel
@@ -102,15 +162,15 @@ void FinleyDomain::optimizeDOFDistribution(IndexVector& distribution)
                     m_nodes->globalDegreesOfFreedom, m_nodes->globalDegreesOfFreedom);
         }
 
-        // set the coordinates
-        real_t* xyz = new real_t[myNumVertices * dim];
+        // set the coordinates and integer vertex weights
+        real_t* pxyz = new real_t[myNumVertices * dim];
+        index_t* vwgt = new index_t[myNumVertices];
 #pragma omp parallel for
-        for (index_t i = 0; i < numNodes; ++i) {
-            const index_t k = m_nodes->globalDegreesOfFreedom[i] - myFirstVertex;
-            if (k >= 0 && k < myNumVertices) {
-                for (int j = 0; j < dim; ++j)
-                    xyz[k * dim + j] = static_cast<real_t>(m_nodes->Coordinates[INDEX2(j, i, dim)]);
-            }
+        for (index_t i = 0; i < myNumVertices; ++i) {
+            for (int j = 0; j < dim; ++j)
+                pxyz[i * dim + j] = static_cast<real_t>(xyz[INDEX2(j, i, dim)]);
+            vwgt[i] = std::max(static_cast<index_t>(weights[i] + 0.5),
+                               static_cast<index_t>(1));
         }
 
         // create the local CSR matrix pattern
@@ -136,7 +196,8 @@ void FinleyDomain::optimizeDOFDistribution(IndexVector& distribution)
             index_list[i].toArray(&index[ptr[i]], 0, globalNumVertices, 0);
         }
 
-        index_t wgtflag = 0;
+        // weights on vertices only
+        index_t wgtflag = 2;
         index_t numflag = 0;
         index_t ncon = 1;
         index_t edgecut;
@@ -148,21 +209,23 @@ void FinleyDomain::optimizeDOFDistribution(IndexVector& distribution)
         index_t options[3] = { 1, 0, 0 };
         std::vector<real_t> tpwgts(ncon * mpiSize, 1.f / mpiSize);
         std::vector<real_t> ubvec(ncon, 1.05f);
-        ParMETIS_V3_PartGeomKway(&distribution[0], ptr, index, NULL, NULL,
-                                 &wgtflag, &numflag, &idim, xyz, &ncon,
+        ParMETIS_V3_PartGeomKway(&distribution[0], ptr, index, vwgt, NULL,
+                                 &wgtflag, &numflag, &idim, pxyz, &ncon,
                                  &impiSize, &tpwgts[0], &ubvec[0], options,
                                  &edgecut, partition, &m_mpiInfo->comm);
-        delete[] xyz;
+        delete[] pxyz;
+        delete[] vwgt;
         delete[] index;
         delete[] ptr;
     } else {
-        for (index_t i = 0; i < myNumVertices; ++i)
-            partition[i] = 0; // CPU 0 owns all
+        escript::getHilbertPartition(m_mpiInfo, dim, myNumVertices,
+                        xyz.empty() ? NULL : &xyz[0],
+                        weights.empty() ? NULL : &weights[0], partition);
     }
 #else
-#pragma omp parallel for
-    for (index_t i = 0; i < myNumVertices; ++i)
-        partition[i] = myRank; // CPU myRank owns all
+    escript::getHilbertPartition(m_mpiInfo, dim, myNumVertices,
+                    xyz.empty() ? NULL : &xyz[0],
+                    weights.empty() ? NULL : &weights[0], partition);
 #endif // ESYS_HAVE_PARMETIS
 
     // create a new distribution and labeling of the DOF
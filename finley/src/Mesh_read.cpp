@@ -155,6 +155,11 @@ escript::Domain_ptr FinleyDomain::read(escript::JMPI mpiInfo,
                                        int order, int reducedOrder,
                                        bool optimize)
 {
+    // meshes converted to the binary format are read directly by all ranks.
+    // Orders <0 select the orders the file was written with.
+    if (isBinaryMesh(mpiInfo, filename))
+        return readBinary(mpiInfo, filename, optimize, order, reducedOrder);
+
     dim_t numNodes = 0;
     int numDim = 0;
     std::string name, line, token;
@@ -26,6 +26,9 @@
 
 namespace finley {
 
+using escript::RankExchange;
+using escript::RankExchange_ptr;
+
 // helper function
 static std::pair<index_t,index_t> getGlobalRange(dim_t n, const index_t* id,
                                                  escript::JMPI mpiInfo)
@@ -328,111 +331,87 @@ void NodeFile::gather(const index_t* index, const NodeFile* in)
 
 void NodeFile::gather_global(const index_t* index, const NodeFile* in)
 {
+    escript::JMPI mpiInfo(in->MPIInfo);
     // get the global range of node ids
     const std::pair<index_t,index_t> id_range(in->getGlobalIdRange());
     const index_t undefined_node = id_range.first-1;
-    std::vector<index_t> distribution(in->MPIInfo->size+1);
+    IndexVector distribution(mpiInfo->size+1);
 
     // distribute the range of node ids
-    index_t buffer_len = in->MPIInfo->setDistribution(id_range.first, id_range.second, &distribution[0]);
-
-    // allocate buffers
-    index_t* Id_buffer = new index_t[buffer_len];
-    int* Tag_buffer = new int[buffer_len];
-    index_t* globalDegreesOfFreedom_buffer = new index_t[buffer_len];
-    double* Coordinates_buffer = new double[buffer_len*numDim];
-
-    // fill Id_buffer by the undefined_node marker to check if nodes
-    // are defined
+    mpiInfo->setDistribution(id_range.first, id_range.second, &distribution[0]);
+    const index_t myFirstId = distribution[mpiInfo->rank];
+    const index_t myLastId = distribution[mpiInfo->rank+1];
+    const dim_t buffer_len = myLastId-myFirstId;
+
+    // allocate buffers for the node ids owned by this rank and fill
+    // Id_buffer by the undefined_node marker to check if nodes are defined
+    IndexVector Id_buffer(buffer_len, undefined_node);
+    std::vector<int> Tag_buffer(buffer_len);
+    IndexVector globalDegreesOfFreedom_buffer(buffer_len);
+    std::vector<double> Coordinates_buffer(buffer_len*numDim);
+
+    // send the nodes of `in` to the ranks owning their ids and fill the
+    // buffers with the entries received
+    {
+        std::vector<int> destRank(in->numNodes);
 #pragma omp parallel for
-    for (index_t n = 0; n < buffer_len; n++)
-        Id_buffer[n] = undefined_node;
-
-    // fill the buffer by sending portions around in a circle
-#ifdef ESYS_MPI
-    MPI_Status status;
-    int dest = in->MPIInfo->mod_rank(in->MPIInfo->rank+1);
-    int source = in->MPIInfo->mod_rank(in->MPIInfo->rank-1);
-#endif
-    int buffer_rank = in->MPIInfo->rank;
-    for (int p=0; p<in->MPIInfo->size; ++p) {
-        if (p>0) { // the initial send can be skipped
-#ifdef ESYS_MPI
-            MPI_Sendrecv_replace(Id_buffer, buffer_len, MPI_DIM_T, dest,
-                    in->MPIInfo->counter(), source,
-                    in->MPIInfo->counter(), in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(Tag_buffer, buffer_len, MPI_INT, dest,
-                    in->MPIInfo->counter()+1, source,
-                    in->MPIInfo->counter()+1, in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(globalDegreesOfFreedom_buffer, buffer_len,
-                    MPI_DIM_T, dest, in->MPIInfo->counter()+2, source,
-                    in->MPIInfo->counter()+2, in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(Coordinates_buffer, buffer_len*numDim,
-                    MPI_DOUBLE, dest, in->MPIInfo->counter()+3, source,
-                    in->MPIInfo->counter()+3, in->MPIInfo->comm, &status);
-	        in->MPIInfo->incCounter(4);
-#endif
-        }
-        buffer_rank=in->MPIInfo->mod_rank(buffer_rank-1);
-        scatterEntries(in->numNodes, in->Id, distribution[buffer_rank],
-                distribution[buffer_rank+1], Id_buffer, in->Id,
-                Tag_buffer, in->Tag, globalDegreesOfFreedom_buffer,
-                in->globalDegreesOfFreedom, numDim, Coordinates_buffer,
-                in->Coordinates);
-    }
-    // now entries are collected from the buffer again by sending the
-    // entries around in a circle
-#ifdef ESYS_MPI
-    dest = in->MPIInfo->mod_rank(in->MPIInfo->rank+1);
-    source = in->MPIInfo->mod_rank(in->MPIInfo->rank-1);
-#endif
-    buffer_rank=in->MPIInfo->rank;
-    for (int p=0; p<in->MPIInfo->size; ++p) {
-        gatherEntries(numNodes, index, distribution[buffer_rank],
-                distribution[buffer_rank+1], Id, Id_buffer, Tag, Tag_buffer,
-                globalDegreesOfFreedom, globalDegreesOfFreedom_buffer, numDim,
-                Coordinates, Coordinates_buffer);
-        if (p < in->MPIInfo->size-1) { // the last send can be skipped
-#ifdef ESYS_MPI
-            MPI_Sendrecv_replace(Id_buffer, buffer_len, MPI_DIM_T, dest,
-                    in->MPIInfo->counter(), source,
-                    in->MPIInfo->counter(), in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(Tag_buffer, buffer_len, MPI_INT, dest,
-                    in->MPIInfo->counter()+1, source,
-                    in->MPIInfo->counter()+1, in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(globalDegreesOfFreedom_buffer, buffer_len,
-                    MPI_DIM_T, dest, in->MPIInfo->counter()+2, source,
-                    in->MPIInfo->counter()+2, in->MPIInfo->comm, &status);
-            MPI_Sendrecv_replace(Coordinates_buffer, buffer_len*numDim,
-                    MPI_DOUBLE, dest, in->MPIInfo->counter()+3, source,
-                    in->MPIInfo->counter()+3, in->MPIInfo->comm, &status);
-            in->MPIInfo->incCounter(4);
-#endif
-        }
-        buffer_rank=in->MPIInfo->mod_rank(buffer_rank-1);
-    }
+        for (index_t n = 0; n < in->numNodes; n++)
+            destRank[n] = RankExchange::getOwner(distribution, in->Id[n]);
+        RankExchange exchange(mpiInfo, destRank);
+        IndexVector recvId, recvDOF;
+        std::vector<int> recvTag;
+        std::vector<double> recvCoordinates;
+        exchange.forward(in->Id, 1, recvId);
+        exchange.forward(in->Tag, 1, recvTag);
+        exchange.forward(in->globalDegreesOfFreedom, 1, recvDOF);
+        exchange.forward(in->Coordinates, numDim, recvCoordinates);
+        scatterEntries(exchange.getNumReceived(), recvId.data(), myFirstId,
+                myLastId, Id_buffer.data(), recvId.data(),
+                Tag_buffer.data(), recvTag.data(),
+                globalDegreesOfFreedom_buffer.data(), recvDOF.data(),
+                numDim, Coordinates_buffer.data(), recvCoordinates.data());
+    }
+
+    // now the entries referenced by index are requested from the ranks
+    // owning them
+    std::vector<int> destRank(numNodes);
+#pragma omp parallel for
+    for (index_t n = 0; n < numNodes; n++)
+        destRank[n] = RankExchange::getOwner(distribution, index[n]);
+    RankExchange exchange(mpiInfo, destRank);
+    IndexVector requested;
+    exchange.forward(index, 1, requested);
+    const dim_t numRequested = exchange.getNumReceived();
+    IndexVector Id_reply(numRequested), DOF_reply(numRequested);
+    std::vector<int> Tag_reply(numRequested);
+    std::vector<double> Coordinates_reply(numRequested*numDim);
+    gatherEntries(numRequested, requested.data(), myFirstId, myLastId,
+            Id_reply.data(), Id_buffer.data(), Tag_reply.data(),
+            Tag_buffer.data(), DOF_reply.data(),
+            globalDegreesOfFreedom_buffer.data(), numDim,
+            Coordinates_reply.data(), Coordinates_buffer.data());
+    exchange.backward(Id_reply, 1, Id);
+    exchange.backward(Tag_reply, 1, Tag);
+    exchange.backward(DOF_reply, 1, globalDegreesOfFreedom);
+    exchange.backward(Coordinates_reply, numDim, Coordinates);
 #if DOASSERT
     // check if all nodes are set:
     index_t err=-1;
 #pragma omp parallel for
     for (index_t n=0; n<numNodes; ++n) {
-        if (Id[n] == undefined_node) {
+        if (destRank[n] < 0 || Id[n] == undefined_node) {
 #pragma omp critical
             err=n;
         }
     }
     if (err>=0) {
         std::stringstream ss;
-        ss << "NodeFile::gather_global: Node id " << Id[err]
+        ss << "NodeFile::gather_global: Node id " << index[err]
             << " at position " << err << " is referenced but not defined.";
         const std::string errorMsg(ss.str());
         throw escript::AssertException(errorMsg);
     }
 #endif // DOASSERT
-    delete[] Id_buffer;
-    delete[] Tag_buffer;
-    delete[] globalDegreesOfFreedom_buffer;
-    delete[] Coordinates_buffer;
 }
 
 void NodeFile::assignMPIRankToDOFs(std::vector<int>& mpiRankOfDOF,
@@ -464,7 +443,8 @@ void NodeFile::assignMPIRankToDOFs(std::vector<int>& mpiRankOfDOF,
 dim_t NodeFile::prepareLabeling(const std::vector<short>& mask,
                                 IndexVector& buffer,
                                 IndexVector& distribution,
-                                bool useNodes)
+                                bool useNodes, RankExchange_ptr& exchange,
+                                IndexVector& requested)
 {
     const index_t UNSET_ID=-1,SET_ID=1;
 
@@ -474,42 +454,27 @@ dim_t NodeFile::prepareLabeling(const std::vector<short>& mask,
     const index_t* indexArray = (useNodes ? globalNodesIndex : globalDegreesOfFreedom);
     // distribute the range of node ids
     distribution.assign(MPIInfo->size+1, 0);
-    int buffer_len = MPIInfo->setDistribution(idRange.first,
-            idRange.second, &distribution[0]);
-    const dim_t myCount = distribution[MPIInfo->rank+1]-distribution[MPIInfo->rank];
+    MPIInfo->setDistribution(idRange.first, idRange.second, &distribution[0]);
+    const index_t id0 = distribution[MPIInfo->rank];
+    const dim_t myCount = distribution[MPIInfo->rank+1]-id0;
 
     // fill buffer by the UNSET_ID marker to check if nodes are defined
-    buffer.assign(buffer_len, UNSET_ID);
+    buffer.assign(myCount, UNSET_ID);
 
-    // fill the buffer by sending portions around in a circle
-#ifdef ESYS_MPI
-    MPI_Status status;
-    int dest = MPIInfo->mod_rank(MPIInfo->rank + 1);
-    int source = MPIInfo->mod_rank(MPIInfo->rank - 1);
-#endif
-    int buffer_rank=MPIInfo->rank;
-    for (int p=0; p<MPIInfo->size; ++p) {
-        if (p>0) { // the initial send can be skipped
-#ifdef ESYS_MPI
-            MPI_Sendrecv_replace(&buffer[0], buffer.size(), MPI_DIM_T, dest,
-                    MPIInfo->counter(), source, MPIInfo->counter(),
-                    MPIInfo->comm, &status);
-            MPIInfo->incCounter();
-#endif
-        }
-        buffer_rank = MPIInfo->mod_rank(buffer_rank-1);
-        const index_t id0 = distribution[buffer_rank];
-        const index_t id1 = distribution[buffer_rank+1];
+    // send the ids in use to the ranks owning them
+    std::vector<int> destRank(numNodes, -1);
 #pragma omp parallel for
-        for (index_t n = 0; n < numNodes; n++) {
-            if (mask.size() < numNodes || mask[n] > -1) {
-                const index_t k = indexArray[n];
-                if (id0 <= k && k < id1) {
-                    buffer[k - id0] = SET_ID;
-                }
-            }
-        }
+    for (index_t n = 0; n < numNodes; n++) {
+        if (mask.size() < numNodes || mask[n] > -1)
+            destRank[n] = RankExchange::getOwner(distribution, indexArray[n]);
     }
+    exchange.reset(new RankExchange(MPIInfo, destRank));
+    exchange->forward(indexArray, 1, requested);
+    const dim_t numRequested = exchange->getNumReceived();
+#pragma omp parallel for
+    for (index_t i = 0; i < numRequested; i++)
+        buffer[requested[i] - id0] = SET_ID;
+
     // count the entries in the buffer
     // TODO: OMP parallel
     index_t myNewCount = 0;
@@ -529,10 +494,12 @@ dim_t NodeFile::createDenseDOFLabeling()
     std::vector<index_t> loc_offsets(MPIInfo->size);
     std::vector<index_t> offsets(MPIInfo->size);
     index_t new_numGlobalDOFs = 0;
+    RankExchange_ptr exchange;
+    IndexVector requested;
 
     // retrieve the number of own DOFs and fill buffer
     loc_offsets[MPIInfo->rank] = prepareLabeling(std::vector<short>(),
-            DOF_buffer, distribution, false);
+            DOF_buffer, distribution, false, exchange, requested);
 #ifdef ESYS_MPI
     MPI_Allreduce(&loc_offsets[0], &offsets[0], MPIInfo->size, MPI_DIM_T,
                   MPI_SUM, MPIInfo->comm);
@@ -545,42 +512,14 @@ dim_t NodeFile::createDenseDOFLabeling()
     loc_offsets[0] = 0;
 #endif
 
-    const dim_t myDOFs = distribution[MPIInfo->rank+1]-distribution[MPIInfo->rank];
+    // now the new labels are returned to the ranks that requested them
+    const index_t dof0 = distribution[MPIInfo->rank];
+    const dim_t numRequested = exchange->getNumReceived();
+    IndexVector reply(numRequested);
 #pragma omp parallel for
-    for (index_t n = 0; n < myDOFs; ++n)
-        DOF_buffer[n] += loc_offsets[MPIInfo->rank];
-
-    std::vector<unsigned char> set_new_DOF(numNodes, true);
-
-    // now entries are collected from the buffer again by sending them around
-    // in a circle
-#ifdef ESYS_MPI
-    int dest = MPIInfo->mod_rank(MPIInfo->rank + 1);
-    int source = MPIInfo->mod_rank(MPIInfo->rank - 1);
-#endif
-    int buffer_rank = MPIInfo->rank;
-    for (int p = 0; p < MPIInfo->size; ++p) {
-        const index_t dof0 = distribution[buffer_rank];
-        const index_t dof1 = distribution[buffer_rank+1];
-#pragma omp parallel for
-        for (index_t n = 0; n < numNodes; n++) {
-            const index_t k = globalDegreesOfFreedom[n];
-            if (set_new_DOF[n] && dof0<=k && k<dof1) {
-                globalDegreesOfFreedom[n]=DOF_buffer[k-dof0];
-                set_new_DOF[n]=false;
-            }
-        }
-        if (p<MPIInfo->size-1) { // the last send can be skipped
-#ifdef ESYS_MPI
-            MPI_Status status;
-            MPI_Sendrecv_replace(&DOF_buffer[0], DOF_buffer.size(), MPI_DIM_T,
-                    dest, MPIInfo->counter(), source,
-                    MPIInfo->counter(), MPIInfo->comm, &status);
-	        MPIInfo->incCounter();
-#endif
-        }
-        buffer_rank = MPIInfo->mod_rank(buffer_rank-1);
-    }
+    for (index_t i = 0; i < numRequested; i++)
+        reply[i] = DOF_buffer[requested[i]-dof0] + loc_offsets[MPIInfo->rank];
+    exchange->backward(reply, 1, globalDegreesOfFreedom);
 
     return new_numGlobalDOFs;
 }
@@ -613,21 +552,8 @@ dim_t NodeFile::createDenseNodeLabeling(IndexVector& nodeDistribution,
             min_id = std::min(loc_min_id, min_id);
         }
     }
-    index_t my_buffer_len = (max_id>=min_id ? max_id-min_id+1 : 0);
-    index_t buffer_len;
-
-#ifdef ESYS_MPI
-    MPI_Allreduce(&my_buffer_len, &buffer_len, 1, MPI_DIM_T, MPI_MAX,
-                  MPIInfo->comm);
-#else
-    buffer_len=my_buffer_len;
-#endif
-
-    const int header_len=2;
-    std::vector<index_t> Node_buffer(buffer_len+header_len, UNSET_ID);
-    // extra storage for these IDs
-    Node_buffer[0]=min_id;
-    Node_buffer[1]=max_id;
+    const index_t my_buffer_len = (max_id>=min_id ? max_id-min_id+1 : 0);
+    std::vector<index_t> Node_buffer(my_buffer_len, UNSET_ID);
 
     // mark and count the nodes in use
 #pragma omp parallel for
@@ -635,12 +561,12 @@ dim_t NodeFile::createDenseNodeLabeling(IndexVector& nodeDistribution,
         globalNodesIndex[n] = -1;
         const index_t dof = globalDegreesOfFreedom[n];
         if (myFirstDOF <= dof && dof < myLastDOF)
-            Node_buffer[Id[n]-min_id+header_len] = SET_ID;
+            Node_buffer[Id[n]-min_id] = SET_ID;
     }
     index_t myNewNumNodes = 0;
     for (index_t n = 0; n < my_buffer_len; n++) {
-        if (Node_buffer[header_len+n] == SET_ID) {
-            Node_buffer[header_len+n] = myNewNumNodes;
+        if (Node_buffer[n] == SET_ID) {
+            Node_buffer[n] = myNewNumNodes;
             myNewNumNodes++;
         }
     }
@@ -663,39 +589,26 @@ dim_t NodeFile::createDenseNodeLabeling(IndexVector& nodeDistribution,
     // offset node buffer
 #pragma omp parallel for
     for (index_t n = 0; n < my_buffer_len; n++)
-        Node_buffer[n+header_len] += nodeDistribution[MPIInfo->rank];
+        Node_buffer[n] += nodeDistribution[MPIInfo->rank];
 
-    // now we send this buffer around to assign global node index
-#ifdef ESYS_MPI
-    int dest = MPIInfo->mod_rank(MPIInfo->rank + 1);
-    int source = MPIInfo->mod_rank(MPIInfo->rank - 1);
-#endif
-    int buffer_rank=MPIInfo->rank;
-    for (int p=0; p<MPIInfo->size; ++p) {
-        const index_t nodeID_0 = Node_buffer[0];
-        const index_t nodeID_1 = Node_buffer[1];
-        const index_t dof0 = dofDistribution[buffer_rank];
-        const index_t dof1 = dofDistribution[buffer_rank+1];
-        if (nodeID_0 <= nodeID_1) {
+    // now the global node index of each node is requested from the rank
+    // owning its DOF
+    std::vector<int> destRank(numNodes);
 #pragma omp parallel for
-            for (index_t n = 0; n < numNodes; n++) {
-                const index_t dof = globalDegreesOfFreedom[n];
-                const index_t id = Id[n]-nodeID_0;
-                if (dof0 <= dof && dof < dof1 && id>=0 && id<=nodeID_1-nodeID_0)
-                    globalNodesIndex[n] = Node_buffer[id+header_len];
-            }
-        }
-        if (p<MPIInfo->size-1) { // the last send can be skipped
-#ifdef ESYS_MPI
-            MPI_Status status;
-            MPI_Sendrecv_replace(&Node_buffer[0], Node_buffer.size(), MPI_DIM_T,
-                    dest, MPIInfo->counter(), source,
-                    MPIInfo->counter(), MPIInfo->comm, &status);
-	        MPIInfo->incCounter();
-#endif
-        }
-        buffer_rank = MPIInfo->mod_rank(buffer_rank-1);
+    for (index_t n = 0; n < numNodes; n++)
+        destRank[n] = RankExchange::getOwner(dofDistribution,
+                                             globalDegreesOfFreedom[n]);
+    RankExchange exchange(MPIInfo, destRank);
+    IndexVector requested;
+    exchange.forward(Id, 1, requested);
+    const dim_t numRequested = exchange.getNumReceived();
+    IndexVector reply(numRequested);
+#pragma omp parallel for
+    for (index_t i = 0; i < numRequested; i++) {
+        const index_t id = requested[i]-min_id;
+        reply[i] = (id>=0 && id<my_buffer_len ? Node_buffer[id] : -1);
     }
+    exchange.backward(reply, 1, globalNodesIndex);
     return globalNumNodes;
 }
 
@@ -707,10 +620,13 @@ dim_t NodeFile::createDenseReducedLabeling(const std::vector<short>& reducedMask
     std::vector<index_t> loc_offsets(MPIInfo->size);
     std::vector<index_t> offsets(MPIInfo->size);
     dim_t new_numGlobalReduced=0;
+    RankExchange_ptr exchange;
+    IndexVector requested;
 
     // retrieve the number of own DOFs/nodes and fill buffer
     loc_offsets[MPIInfo->rank]=prepareLabeling(reducedMask, buffer,
-                                               distribution, useNodes);
+                                       distribution, useNodes, exchange,
+                                       requested);
 #ifdef ESYS_MPI
     MPI_Allreduce(&loc_offsets[0], &offsets[0], MPIInfo->size, MPI_DIM_T,
                   MPI_SUM, MPIInfo->comm);
@@ -723,13 +639,6 @@ dim_t NodeFile::createDenseReducedLabeling(const std::vector<short>& reducedMask
     loc_offsets[0]=0;
 #endif
 
-    const dim_t myCount=distribution[MPIInfo->rank+1]-distribution[MPIInfo->rank];
-#pragma omp parallel for
-    for (index_t n=0; n<myCount; ++n)
-        buffer[n]+=loc_offsets[MPIInfo->rank];
-
-    const index_t* denseArray =
-        (useNodes ? globalNodesIndex : globalDegreesOfFreedom);
     index_t* reducedArray =
         (useNodes ? globalReducedNodesIndex : globalReducedDOFIndex);
 
@@ -737,35 +646,15 @@ dim_t NodeFile::createDenseReducedLabeling(const std::vector<short>& reducedMask
     for (index_t n=0; n<numNodes; ++n)
         reducedArray[n]=loc_offsets[0]-1;
 
-    // now entries are collected from the buffer by sending them around
-    // in a circle
-#ifdef ESYS_MPI
-    int dest = MPIInfo->mod_rank(MPIInfo->rank + 1);
-    int source = MPIInfo->mod_rank(MPIInfo->rank - 1);
-#endif
-    int buffer_rank=MPIInfo->rank;
-    for (int p=0; p<MPIInfo->size; ++p) {
-        const index_t id0=distribution[buffer_rank];
-        const index_t id1=distribution[buffer_rank+1];
+    // now the new labels are returned to the ranks that requested them
+    const index_t id0 = distribution[MPIInfo->rank];
+    const dim_t numRequested = exchange->getNumReceived();
+    IndexVector reply(numRequested);
 #pragma omp parallel for
-        for (index_t n=0; n<numNodes; n++) {
-            if (reducedMask[n] > -1) {
-                const index_t k=denseArray[n];
-                if (id0<=k && k<id1)
-                    reducedArray[n]=buffer[k-id0];
-            }
-        }
-        if (p<MPIInfo->size-1) { // the last send can be skipped
-#ifdef ESYS_MPI
-            MPI_Status status;
-            MPI_Sendrecv_replace(&buffer[0], buffer.size(), MPI_DIM_T, dest,
-                    MPIInfo->counter(), source,
-                    MPIInfo->counter(), MPIInfo->comm, &status);
-	        MPIInfo->incCounter();
-#endif
-        }
-        buffer_rank = MPIInfo->mod_rank(buffer_rank-1);
-    }
+    for (index_t i = 0; i < numRequested; i++)
+        reply[i] = buffer[requested[i]-id0] + loc_offsets[MPIInfo->rank];
+    exchange->backward(reply, 1, reducedArray);
+
     return new_numGlobalReduced;
 }
 
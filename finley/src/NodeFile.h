@@ -24,6 +24,7 @@
 #include "NodeMapping.h"
 
 #include <escript/Distribution.h>
+#include <escript/RankExchange.h>
 
 #ifdef ESYS_HAVE_PASO
 #include <paso/Coupler.h>
@@ -140,7 +141,9 @@ private:
     std::pair<index_t,index_t> getGlobalDOFRange() const;
     std::pair<index_t,index_t> getGlobalNodeIDIndexRange() const;
     dim_t prepareLabeling(const std::vector<short>& mask, IndexVector& buffer,
-                          IndexVector& distribution, bool useNodes);
+                          IndexVector& distribution, bool useNodes,
+                          escript::RankExchange_ptr& exchange,
+                          IndexVector& requested);
     void createDOFMappingAndCoupling(bool reduced);
 
     NodeMapping nodesMapping;
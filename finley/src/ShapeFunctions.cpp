@@ -26,10 +26,15 @@
 
 #include <escript/index.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
 namespace finley {
 
+using escript::DataTypes::real_t;
+using escript::DataTypes::cplx_t;
+
 const ShapeFunctionInfo ShapeFunction_InfoList[] = {
     { Point1Shape, "Point1", 0,  1, 1, 1, Shape_Point1 },
     { Line2Shape,  "Line2",  1,  2, 1, 2, Shape_Line2  },
@@ -55,6 +60,203 @@ const ShapeFunctionInfo ShapeFunction_InfoList[] = {
 };
 
 
+namespace {
+
+/// tolerance for identifying the tensor product structure of shape functions
+const double TENSOR_TOLERANCE = 1e-10;
+
+/// evaluates the 1D Lagrange polynomials on numShapes equidistant nodes in
+/// [0,1] and their derivatives at x
+void getLagrange1D(int numShapes, double x, double* s, double* dsdv)
+{
+    const double h = 1./(numShapes-1);
+    for (int a = 0; a < numShapes; a++) {
+        s[a] = 1.;
+        dsdv[a] = 0.;
+        for (int b = 0; b < numShapes; b++) {
+            if (b == a)
+                continue;
+            double f = 1./((a-b)*h);
+            for (int c = 0; c < numShapes; c++) {
+                if (c != a && c != b)
+                    f *= (x-c*h)/((a-c)*h);
+            }
+            s[a] *= (x-b*h)/((a-b)*h);
+            dsdv[a] += f;
+        }
+    }
+}
+
+/// identifies the tensor product structure of `sf`. On return t.numDim is 0
+/// if the shape functions are not products of 1D Lagrange polynomials or the
+/// quadrature nodes do not form a tensor product grid.
+void factorize(const ShapeFunction& sf, TensorProductShape& t)
+{
+    const int numDim = sf.Type->numDim;
+    const int numShapes = sf.Type->numShapes;
+    const int numQuad = sf.numQuadNodes;
+    if (numDim < 1 || numDim > 3 || numQuad < 1)
+        return;
+
+    int n = 2, numTensorShapes = 2;
+    for (; (numTensorShapes = n*(numDim > 1 ? n : 1)*(numDim > 2 ? n : 1))
+            < numShapes; n++);
+    if (numTensorShapes != numShapes)
+        return;
+
+    // the 1D quadrature nodes must be the same in all directions
+    std::vector<double> quad1D;
+    for (int q = 0; q < numQuad; q++) {
+        const double x = sf.QuadNodes[INDEX2(0,q,numDim)];
+        bool found = false;
+        for (size_t i = 0; i < quad1D.size() && !found; i++)
+            found = (std::abs(quad1D[i]-x) < TENSOR_TOLERANCE);
+        if (!found)
+            quad1D.push_back(x);
+    }
+    std::sort(quad1D.begin(), quad1D.end());
+    const int m = quad1D.size();
+    const int m1 = (numDim > 1 ? m : 1), m2 = (numDim > 2 ? m : 1);
+    if (m*m1*m2 != numQuad)
+        return;
+    std::vector<int> quadIndex(numQuad, -1);
+    for (int q = 0; q < numQuad; q++) {
+        int idx[3] = { 0, 0, 0 };
+        for (int j = 0; j < numDim; j++) {
+            const double x = sf.QuadNodes[INDEX2(j,q,numDim)];
+            idx[j] = -1;
+            for (int i = 0; i < m && idx[j] < 0; i++) {
+                if (std::abs(quad1D[i]-x) < TENSOR_TOLERANCE)
+                    idx[j] = i;
+            }
+            if (idx[j] < 0)
+                return;
+        }
+        const int k = INDEX3(idx[0], idx[1], idx[2], m, m1);
+        if (quadIndex[k] >= 0)
+            return;
+        quadIndex[k] = q;
+    }
+
+    // shape function a0,a1,a2 is the one which is one at the node
+    // (a0,a1,a2)/(n-1) and zero at all other nodes
+    std::vector<double> v(numDim*numShapes), s(numShapes*numShapes),
+                        dsdv(numShapes*numDim*numShapes);
+    const int n1 = (numDim > 1 ? n : 1);
+    for (int k = 0; k < numShapes; k++) {
+        const int a[3] = { k%n, (k/n)%n1, k/(n*n1) };
+        for (int j = 0; j < numDim; j++)
+            v[INDEX2(j,k,numDim)] = static_cast<double>(a[j])/(n-1);
+    }
+    sf.Type->getValues(numShapes, v, s, dsdv);
+    std::vector<int> shapeIndex(numShapes, -1);
+    std::vector<bool> used(numShapes, false);
+    for (int k = 0; k < numShapes; k++) {
+        for (int l = 0; l < numShapes; l++) {
+            const double value = s[S_INDEX(l,k,numShapes)];
+            if (std::abs(value-1.) < TENSOR_TOLERANCE) {
+                if (shapeIndex[k] >= 0 || used[l])
+                    return;
+                shapeIndex[k] = l;
+                used[l] = true;
+            } else if (std::abs(value) > TENSOR_TOLERANCE) {
+                return;
+            }
+        }
+        if (shapeIndex[k] < 0)
+            return;
+    }
+
+    std::vector<double> S1D(n*m), dS1DdV(n*m);
+    for (int i = 0; i < m; i++)
+        getLagrange1D(n, quad1D[i], &S1D[INDEX2(0,i,n)], &dS1DdV[INDEX2(0,i,n)]);
+
+    // finally the products must reproduce the tables
+    for (int kq = 0; kq < numQuad; kq++) {
+        const int i[3] = { kq%m, (kq/m)%m1, kq/(m*m1) };
+        const int q = quadIndex[kq];
+        for (int ks = 0; ks < numShapes; ks++) {
+            const int a[3] = { ks%n, (ks/n)%n1, ks/(n*n1) };
+            const int l = shapeIndex[ks];
+            double prod = 1.;
+            for (int j = 0; j < numDim; j++)
+                prod *= S1D[INDEX2(a[j],i[j],n)];
+            if (std::abs(prod-sf.S[S_INDEX(l,q,numShapes)]) > TENSOR_TOLERANCE)
+                return;
+            for (int d = 0; d < numDim; d++) {
+                double dprod = 1.;
+                for (int j = 0; j < numDim; j++) {
+                    dprod *= (j == d ? dS1DdV[INDEX2(a[j],i[j],n)]
+                                     : S1D[INDEX2(a[j],i[j],n)]);
+                }
+                if (std::abs(dprod-sf.dSdv[DSDV_INDEX(l,d,q,numShapes,numDim)])
+                        > TENSOR_TOLERANCE*numShapes)
+                    return;
+            }
+        }
+    }
+
+    t.numDim = numDim;
+    t.numShapes1D = n;
+    t.numQuad1D = m;
+    t.S1D.swap(S1D);
+    t.dS1DdV.swap(dS1DdV);
+    t.shapeIndex.swap(shapeIndex);
+    t.quadIndex.swap(quadIndex);
+}
+
+/// out(p,i,r) = sum_a B(a,i)*in(p,a,r) for p<pre, i<m, r<post and a<n.
+/// If `transpose` is set out(p,a,r) = sum_i B(a,i)*in(p,i,r) instead.
+template<typename Scalar>
+void contract(const double* B, int n, int m, int pre, int post,
+              const Scalar* in, Scalar* out, bool transpose)
+{
+    const int numIn = (transpose ? m : n);
+    const int numOut = (transpose ? n : m);
+    for (int r = 0; r < post; r++) {
+        for (int o = 0; o < numOut; o++) {
+            Scalar* out_p = &out[pre*(o+numOut*r)];
+            for (int p = 0; p < pre; p++)
+                out_p[p] = static_cast<Scalar>(0);
+            for (int k = 0; k < numIn; k++) {
+                const double b = (transpose ? B[o+n*k] : B[k+n*o]);
+                const Scalar* in_p = &in[pre*(k+numIn*r)];
+#pragma ivdep
+                for (int p = 0; p < pre; p++)
+                    out_p[p] += b*in_p[p];
+            }
+        }
+    }
+}
+
+/// applies the 1D tables of `t` in all directions to the array in `a` using
+/// the derivative in direction `derivative` (-1 for none). `b` is a buffer
+/// of the same size. Returns the buffer holding the result.
+template<typename Scalar>
+Scalar* applyTensor(const TensorProductShape& t, int numComps,
+                    int derivative, bool transpose, Scalar* a, Scalar* b)
+{
+    const int n = t.numShapes1D;
+    const int m = t.numQuad1D;
+    const int in = (transpose ? m : n);
+    const int out = (transpose ? n : m);
+    int pre = numComps;
+    int post = 1;
+    for (int j = 1; j < t.numDim; j++)
+        post *= in;
+    for (int d = 0; d < t.numDim; d++) {
+        const double* B = (d == derivative ? &t.dS1DdV[0] : &t.S1D[0]);
+        contract(B, n, m, pre, post, a, b, transpose);
+        std::swap(a, b);
+        pre *= out;
+        if (d+1 < t.numDim)
+            post /= in;
+    }
+    return a;
+}
+
+} // anonymous namespace
+
 /// Creates an evaluation of the ShapeFunction on the given quadrature scheme.
 /// If QuadNodes==Null or QuadWeights==Null the shape functions method is used
 /// to generate a quadrature scheme with numQuadNodes nodes. Otherwise it is
@@ -88,6 +290,9 @@ ShapeFunction::ShapeFunction(ShapeFunctionTypeId id, int numQDim,
 
     // evaluate shape functions on quadrature nodes
     Type->getValues(numQuadNodes, QuadNodes, S, dSdv);
+
+    // factorize S and dSdv for tensor product elements
+    factorize(*this, tensorProduct);
 }
 
 ShapeFunctionTypeId ShapeFunction::getTypeId(const char* element_type)
@@ -118,6 +323,116 @@ const ShapeFunctionInfo* ShapeFunction::getInfo(ShapeFunctionTypeId id)
 }
 
 
+int TensorProductShape::getWorkSize(int numComps) const
+{
+    const int k = std::max(numShapes1D, numQuad1D);
+    int size = numComps;
+    for (int j = 0; j < numDim; j++)
+        size *= k;
+    return 2*size;
+}
+
+template<typename Scalar>
+void TensorProductShape::interpolate(int numComps, const Scalar* in,
+                                     Scalar* out, Scalar* work) const
+{
+    const int numShapes = shapeIndex.size();
+    const int numQuad = quadIndex.size();
+    Scalar* a = work;
+    Scalar* b = work+getWorkSize(numComps)/2;
+    for (int k = 0; k < numShapes; k++) {
+        for (int c = 0; c < numComps; c++)
+            a[INDEX2(c,k,numComps)] = in[INDEX2(c,shapeIndex[k],numComps)];
+    }
+    const Scalar* res = applyTensor(*this, numComps, -1, false, a, b);
+    for (int k = 0; k < numQuad; k++) {
+        for (int c = 0; c < numComps; c++)
+            out[INDEX2(c,quadIndex[k],numComps)] = res[INDEX2(c,k,numComps)];
+    }
+}
+
+template<typename Scalar>
+void TensorProductShape::gradient(int numComps, const Scalar* in,
+                                  Scalar* out, Scalar* work) const
+{
+    const int numShapes = shapeIndex.size();
+    const int numQuad = quadIndex.size();
+    Scalar* a = work;
+    Scalar* b = work+getWorkSize(numComps)/2;
+    for (int j = 0; j < numDim; j++) {
+        for (int k = 0; k < numShapes; k++) {
+            for (int c = 0; c < numComps; c++)
+                a[INDEX2(c,k,numComps)] = in[INDEX2(c,shapeIndex[k],numComps)];
+        }
+        const Scalar* res = applyTensor(*this, numComps, j, false, a, b);
+        for (int k = 0; k < numQuad; k++) {
+            for (int c = 0; c < numComps; c++)
+                out[INDEX3(c,j,quadIndex[k],numComps,numDim)] =
+                                                res[INDEX2(c,k,numComps)];
+        }
+    }
+}
+
+template<typename Scalar>
+void TensorProductShape::integrate(int numComps, const Scalar* in,
+                                   Scalar* out, Scalar* work) const
+{
+    const int numShapes = shapeIndex.size();
+    const int numQuad = quadIndex.size();
+    Scalar* a = work;
+    Scalar* b = work+getWorkSize(numComps)/2;
+    for (int k = 0; k < numQuad; k++) {
+        for (int c = 0; c < numComps; c++)
+            a[INDEX2(c,k,numComps)] = in[INDEX2(c,quadIndex[k],numComps)];
+    }
+    const Scalar* res = applyTensor(*this, numComps, -1, true, a, b);
+    for (int k = 0; k < numShapes; k++) {
+        for (int c = 0; c < numComps; c++)
+            out[INDEX2(c,shapeIndex[k],numComps)] += res[INDEX2(c,k,numComps)];
+    }
+}
+
+template<typename Scalar>
+void TensorProductShape::integrateGradient(int numComps, const Scalar* in,
+                                           Scalar* out, Scalar* work) const
+{
+    const int numShapes = shapeIndex.size();
+    const int numQuad = quadIndex.size();
+    Scalar* a = work;
+    Scalar* b = work+getWorkSize(numComps)/2;
+    for (int j = 0; j < numDim; j++) {
+        for (int k = 0; k < numQuad; k++) {
+            for (int c = 0; c < numComps; c++)
+                a[INDEX2(c,k,numComps)] =
+                            in[INDEX3(c,j,quadIndex[k],numComps,numDim)];
+        }
+        const Scalar* res = applyTensor(*this, numComps, j, true, a, b);
+        for (int k = 0; k < numShapes; k++) {
+            for (int c = 0; c < numComps; c++)
+                out[INDEX2(c,shapeIndex[k],numComps)] +=
+                                                res[INDEX2(c,k,numComps)];
+        }
+    }
+}
+
+// instantiate our two supported versions
+template void TensorProductShape::interpolate<real_t>(int numComps,
+                    const real_t* in, real_t* out, real_t* work) const;
+template void TensorProductShape::interpolate<cplx_t>(int numComps,
+                    const cplx_t* in, cplx_t* out, cplx_t* work) const;
+template void TensorProductShape::gradient<real_t>(int numComps,
+                    const real_t* in, real_t* out, real_t* work) const;
+template void TensorProductShape::gradient<cplx_t>(int numComps,
+                    const cplx_t* in, cplx_t* out, cplx_t* work) const;
+template void TensorProductShape::integrate<real_t>(int numComps,
+                    const real_t* in, real_t* out, real_t* work) const;
+template void TensorProductShape::integrate<cplx_t>(int numComps,
+                    const cplx_t* in, cplx_t* out, cplx_t* work) const;
+template void TensorProductShape::integrateGradient<real_t>(int numComps,
+                    const real_t* in, real_t* out, real_t* work) const;
+template void TensorProductShape::integrateGradient<cplx_t>(int numComps,
+                    const cplx_t* in, cplx_t* out, cplx_t* work) const;
+
 #define V(_K_,_I_) v[INDEX2((_K_)-1,(_I_),DIM)]
 #define S(_J_,_I_) s[S_INDEX((_J_)-1,(_I_),NUMSHAPES)]
 #define DSDV(_J_,_K_,_I_) dsdv[DSDV_INDEX((_J_)-1,(_K_)-1,(_I_),NUMSHAPES,DIM)]
@@ -22,6 +22,8 @@
 
 #include "Finley.h"
 
+#include <escript/EscriptParams.h>
+
 #include <boost/shared_ptr.hpp>
 
 #define S_INDEX(_J_,_I_,_NUMNODES_) INDEX2(_J_,_I_,_NUMNODES_)
@@ -75,6 +77,70 @@ struct ShapeFunctionInfo {
 };
 
 
+/// Factorization of shape functions which are products of 1D Lagrange
+/// polynomials on equidistant nodes (Line2/3, Rec4/9, Hex8/27) evaluated on
+/// a tensor product quadrature scheme. Contractions with S and dSdv then
+/// reduce to a sequence of 1D contractions (sum factorization) which for
+/// a Hex27 needs a fraction of the operations of the full tables.
+/// All arrays run over the components fastest, i.e. in[INDEX2(c,s,numComps)]
+/// is component c at shape function s and out[INDEX2(c,q,numComps)] or
+/// out[INDEX3(c,j,q,numComps,numDim)] component c at quadrature node q.
+struct FINLEY_DLL_API TensorProductShape {
+    TensorProductShape() : numDim(0), numShapes1D(0), numQuad1D(0) {}
+
+    /// returns true if the shape functions factorize
+    bool isValid() const { return numDim > 0; }
+
+    /// returns true if the shape functions factorize and sum factorization
+    /// has not been switched off by the escript parameter SUM_FACTORIZATION
+    bool isEnabled() const
+    {
+        return isValid() && escript::escriptParams.getSumFactorization();
+    }
+
+    /// returns the number of values of type Scalar needed as workspace for
+    /// numComps components
+    int getWorkSize(int numComps) const;
+
+    /// out(c,q) = sum_s S(s,q)*in(c,s)
+    template<typename Scalar>
+    void interpolate(int numComps, const Scalar* in, Scalar* out,
+                     Scalar* work) const;
+
+    /// out(c,j,q) = sum_s dSdv(s,j,q)*in(c,s)
+    template<typename Scalar>
+    void gradient(int numComps, const Scalar* in, Scalar* out,
+                  Scalar* work) const;
+
+    /// out(c,s) += sum_q S(s,q)*in(c,q)
+    template<typename Scalar>
+    void integrate(int numComps, const Scalar* in, Scalar* out,
+                   Scalar* work) const;
+
+    /// out(c,s) += sum_q sum_j dSdv(s,j,q)*in(c,j,q)
+    template<typename Scalar>
+    void integrateGradient(int numComps, const Scalar* in, Scalar* out,
+                           Scalar* work) const;
+
+    /// number of dimensions, 0 if the shape functions do not factorize
+    int numDim;
+    /// number of 1D shape functions
+    int numShapes1D;
+    /// number of 1D quadrature nodes
+    int numQuad1D;
+    /// S1D[INDEX2(a,i,numShapes1D)] is 1D shape function a at 1D quadrature
+    /// node i
+    std::vector<double> S1D;
+    /// derivatives of the 1D shape functions at the 1D quadrature nodes
+    std::vector<double> dS1DdV;
+    /// shapeIndex[INDEX3(a0,a1,a2,numShapes1D,numShapes1D)] is the shape
+    /// function which is the product of the 1D shape functions a0,a1,a2
+    std::vector<int> shapeIndex;
+    /// quadIndex[INDEX3(i0,i1,i2,numQuad1D,numQuad1D)] is the quadrature
+    /// node with 1D nodes i0,i1,i2
+    std::vector<int> quadIndex;
+};
+
 /// this struct holds the evaluation of a shape function on a quadrature scheme
 struct FINLEY_DLL_API ShapeFunction {
     ShapeFunction(ShapeFunctionTypeId id, int numQuadDim, int numQuadNodes,
@@ -97,6 +163,8 @@ struct FINLEY_DLL_API ShapeFunction {
     std::vector<double> S;
     /// derivative of the shape functions at quadrature nodes
     std::vector<double> dSdv;
+    /// factorization of S and dSdv for tensor product elements
+    TensorProductShape tensorProduct;
 };
 
 typedef boost::shared_ptr<const ShapeFunction> const_ShapeFunction_ptr;
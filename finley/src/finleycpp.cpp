@@ -49,11 +49,11 @@ BOOST_PYTHON_MODULE(finleycpp)
 
   def("__ReadMesh_driver", finley::readMesh_driver,
       (arg("params"))
-	,"Read a mesh from a file. For MPI parallel runs fan out the mesh to multiple processes.\n\n"
+	,"Read a mesh from a fly file or a binary mesh file written by ``writeBinary``. For MPI parallel runs fan out the mesh to multiple processes.\n\n"
 ":rtype: `Domain`\n:param fileName:\n:type fileName: ``string``\n"
-":param integrationOrder: order of the quadrature scheme. If *integrationOrder<0* the integration order is selected independently.\n"
+":param integrationOrder: order of the quadrature scheme. If *integrationOrder<0* the integration order is selected independently or, for binary mesh files, taken from the file.\n"
 ":type integrationOrder: ``int``\n"
-":param reducedIntegrationOrder: order of the quadrature scheme. If *reducedIntegrationOrder<0* the integration order is selected independently.\n"
+":param reducedIntegrationOrder: order of the quadrature scheme. If *reducedIntegrationOrder<0* the integration order is selected independently or, for binary mesh files, taken from the file.\n"
 ":param optimize: Enable optimisation of node labels\n:type optimize: ``bool``");
 
   def("__ReadGmsh_driver", finley::readGmsh_driver,
@@ -134,6 +134,10 @@ BOOST_PYTHON_MODULE(finleycpp)
 ":param full:\n:type full: ``bool``")
       .def("dump", &finley::FinleyDomain::dump, args("fileName")
 ,"dumps the mesh to a file with the given name.")
+      .def("writeBinary", &finley::FinleyDomain::writeBinary, args("fileName"),
+"Writes the mesh to a single file in the finley binary mesh format. All "
+"processes write concurrently and the file can be loaded with `LoadMesh` "
+"or `ReadMesh` on any number of processes.")
       .def("getDescription", &finley::FinleyDomain::getDescription,
 ":return: a description for this domain\n:rtype: ``string``")
       .def("getDim", &finley::FinleyDomain::getDim,":rtype: ``int``")
@@ -225,6 +229,22 @@ args("solver", "preconditioner", "package", "symmetry"),
 args("arg"), "assigns new location to the domain\n\n:param arg:\n:type arg: `Data`")
       .def("getX", &finley::FinleyDomain::getX, ":return: locations in the FEM nodes\n\n"
 ":rtype: `Data`")
+      .def("setGeometryCaching", &finley::FinleyDomain::setGeometryCaching,
+args("cache"), "switches caching of the element Jacobians on or off. "
+"Without caching less memory is used but the Jacobians are recomputed "
+"for every assembly, integration and gradient.\n\n"
+":param cache: whether to keep the Jacobians between calls\n"
+":type cache: ``bool``")
+      .def("evaluateAtPoints", &finley::FinleyDomain::evaluateAtPoints,
+args("data", "points"), "returns the values of ``data`` at arbitrary points. "
+"Nodal data is interpolated with the element basis functions, element data "
+"is averaged over the element containing the point.\n\n"
+":param data: data on nodes, degrees of freedom or elements\n"
+":type data: `Data`\n"
+":param points: coordinates of the points\n"
+":type points: sequence of ``tuple``\n"
+":return: the value at each point, None for points outside the domain\n"
+":rtype: ``list``")
 #ifdef ESYS_HAVE_BOOST_NUMPY
       .def("getConnectivityInfo", &finley::FinleyDomain::getConnectivityInfo, ":return: returns point and connectivity information\n\n"
 ":rtype: `Data`")
@@ -38,7 +38,7 @@ Test suite for input and output of meshes and data objects
 import esys.escriptcore.utestselect as unittest, sys
 from esys.escriptcore.testing import *
 from esys.escript import *
-from esys.finley import Rectangle, Brick, LoadMesh, ReadMesh, GetMeshFromFile, ReadGmsh
+from esys.finley import Rectangle, Brick, LoadMesh, ReadMesh, GetMeshFromFile, ReadGmsh, ConvertMesh
 import os as os
 import numpy as np
 
@@ -183,6 +183,22 @@ class Test_InputOutputOnFinley(unittest.TestCase):
      #    mydomain2=LoadMesh(dumpfile)
      #    self.domainsEqual(mydomain1, mydomain2)
 
+     def test_mesh_writeBinary_rectangle(self):
+        mydomain1 = Rectangle(n0=NE0, n1=NE1, order=1, l0=1., l1=1., optimize=False)
+        meshfile=os.path.join(FINLEY_WORKDIR, "tempfile.mesh.bin")
+        mydomain1.writeBinary(meshfile)
+        mydomain2=LoadMesh(meshfile)
+        self.domainsEqual(mydomain1, mydomain2)
+
+     def test_mesh_writeBinary_brick_tags(self):
+        mydomain1 = Brick(n0=NE0, n1=NE1, n2=NE2, order=2, l0=1., l1=1., l2=1., optimize=False)
+        mydomain1.setTagMap("mytag", 42)
+        meshfile=os.path.join(FINLEY_WORKDIR, "tempfile.mesh.bin")
+        mydomain1.writeBinary(meshfile)
+        mydomain2=LoadMesh(meshfile)
+        self.domainsEqual(mydomain1, mydomain2)
+        self.assertEqual(mydomain2.getTag("mytag"), 42)
+
      @unittest.skipIf(mpisize>15, "more than 15 MPI ranks")
      def test_mesh_read_rectangle_from_finley_file(self):
          mydomain1 = Rectangle(n0=8, n1=10, order=1, l0=1., l1=1., optimize=False)
@@ -195,6 +211,40 @@ class Test_InputOutputOnFinley(unittest.TestCase):
           mydomain2 = ReadMesh(os.path.join(FINLEY_TEST_MESH_PATH,"brick_8x10x12.fly"))
           self.domainsEqual(mydomain1, mydomain2)
 
+     @unittest.skipIf(mpisize>15, "more than 15 MPI ranks")
+     def test_mesh_read_brick_from_converted_finley_file(self):
+          flyfile=os.path.join(FINLEY_TEST_MESH_PATH,"brick_8x10x12.fly")
+          meshfile=os.path.join(FINLEY_WORKDIR, "tempfile.brick.bin")
+          mydomain1 = ConvertMesh(flyfile, meshfile)
+          mydomain2 = ReadMesh(meshfile)
+          self.domainsEqual(mydomain1, mydomain2)
+
+     @unittest.skipIf(mpisize>15, "more than 15 MPI ranks")
+     def test_mesh_read_converted_file_integration_order(self):
+          flyfile=os.path.join(FINLEY_TEST_MESH_PATH,"rectangle_8x10.fly")
+          meshfile=os.path.join(FINLEY_WORKDIR, "tempfile.rectangle.bin")
+          ConvertMesh(flyfile, meshfile, integrationOrder=6)
+          def numQuadraturePoints(dom):
+              return Function(dom).getX().getNumberOfDataPoints()
+          # the orders stored in the file are used by default
+          self.assertEqual(numQuadraturePoints(ReadMesh(meshfile)),
+                  numQuadraturePoints(ReadMesh(flyfile, integrationOrder=6)))
+          # and overridden by explicit orders
+          self.assertEqual(
+                  numQuadraturePoints(ReadMesh(meshfile, integrationOrder=2)),
+                  numQuadraturePoints(ReadMesh(flyfile, integrationOrder=2)))
+          self.assertNotEqual(numQuadraturePoints(ReadMesh(flyfile, integrationOrder=2)),
+                  numQuadraturePoints(ReadMesh(flyfile, integrationOrder=6)))
+
+     @unittest.skipIf(mpisize>1, "more than 1 MPI rank")
+     def test_mesh_read_from_converted_gmsh_file(self):
+          mshfile=os.path.join(FINLEY_TEST_MESH_PATH,'tet10_gmsh.msh')
+          meshfile=os.path.join(FINLEY_WORKDIR, "tempfile.tet10.bin")
+          self.assertRaises(ValueError, ConvertMesh, mshfile, meshfile)
+          mydomain1 = ConvertMesh(mshfile, meshfile, numDim=3, optimize=False)
+          mydomain2 = ReadMesh(meshfile)
+          self.domainsEqual(mydomain1, mydomain2)
+
      @unittest.skipIf(mpisize>1, "more than 1 MPI rank")
      def test_GetMeshFromFile(self):
            m=GetMeshFromFile(os.path.join(FINLEY_TEST_MESH_PATH,'tet10_gmsh.msh'), numDim=3)
@@ -233,5 +283,10 @@ class Test_InputOutputOnFinley(unittest.TestCase):
         mydomain2 = ReadGmsh(os.path.join(FINLEY_TEST_MESH_PATH,"testcube.4.1.msh"), numDim=3)
         self.domainsEqual(mydomain1, mydomain2)
 
+     def test_readgmsh_format_4_1_binary(self):
+        mydomain1 = ReadGmsh(os.path.join(FINLEY_TEST_MESH_PATH,"testcube.4.1.msh"), numDim=3)
+        mydomain2 = ReadGmsh(os.path.join(FINLEY_TEST_MESH_PATH,"testcube.4.1.binary.msh"), numDim=3)
+        self.domainsEqual(mydomain1, mydomain2)
+
 if __name__ == '__main__':
     run_tests(__name__, exit_on_failure=True)
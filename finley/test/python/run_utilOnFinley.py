@@ -33,6 +33,10 @@ from test_util_NaN_funcs import Test_util_NaN_funcs
 # from test_copyWithData import Test_copyWithMask
 
 from esys.escript import FunctionOnBoundary, getMPISizeWorld, HAVE_SYMBOLS
+from esys.escript import Function, ReducedContinuousFunction, Scalar, Solution
+from esys.escript import ReducedSolution, Lsup, cos, grad, interpolate, \
+        kronecker, setEscriptParamInt, sin
+from esys.escript.linearPDEs import LinearPDE
 from esys.finley import Rectangle, Brick, JoinFaces, ReadMesh
 import os
 
@@ -186,6 +190,15 @@ class Test_Util_SpatialFunctionsOnFinleyHex3DMacro(Test_Util_SpatialFunctions_no
         del self.order
         del self.domain
 
+class Test_Util_SpatialFunctionsOnFinleyHex3DOrder2noGeometryCache(Test_Util_SpatialFunctions_noGradOnBoundary_noContact):
+    def setUp(self):
+        self.order=2
+        self.domain = Brick(n0=NE,n1=NE,n2=NE,order=2,useElementsOnFace=0)
+        self.domain.setGeometryCaching(False)
+    def tearDown(self):
+        del self.order
+        del self.domain
+
 class Test_Util_SpatialFunctionsOnFinleyHex2DOrder1withContact(Test_Util_SpatialFunctions_noGradOnBoundary):
     def setUp(self):
         self.order=1
@@ -354,6 +367,165 @@ class Test_3D_Point_Data_Integration(Test_Util_Point_Data_Interpolation):
     def tearDown(self):
         del self.domain
 
+class Test_EvaluateAtPointsOnFinley(unittest.TestCase):
+    POINTS_2D = [ (0.,0.), (0.3,0.7), (0.55,0.125), (1.,1.), (0.999,0.01) ]
+    POINTS_3D = [ (0.,0.,0.), (0.3,0.7,0.2), (0.55,0.125,0.9), (1.,1.,1.) ]
+
+    def check(self, domain, u, f, points):
+        values = domain.evaluateAtPoints(u, points)
+        self.assertEqual(len(values), len(points))
+        for v, p in zip(values, points):
+            self.assertAlmostEqual(v, f(p), places=8)
+
+    def test_Rectangle_order2(self):
+        dom = Rectangle(n0=3, n1=5, order=2)
+        x = dom.getX()
+        f = lambda p: p[0]**2-2*p[0]*p[1]+3*p[1]+1.
+        self.check(dom, x[0]**2-2*x[0]*x[1]+3*x[1]+1., f, self.POINTS_2D)
+
+    def test_Rectangle_macro(self):
+        dom = Rectangle(n0=3, n1=5, order=-1)
+        x = dom.getX()
+        f = lambda p: 2*p[0]-p[1]
+        self.check(dom, 2*x[0]-x[1], f, self.POINTS_2D)
+
+    def test_Rectangle_macro_subelement_boundaries(self):
+        # points on (or within rounding of) the edges between the
+        # sub-elements of the macro elements
+        dom = Rectangle(n0=3, n1=5, order=-1)
+        x = dom.getX()
+        f = lambda p: 2*p[0]-p[1]
+        points = [ (1./6,0.1), (0.5,0.3+1e-14), (5./6-1e-14,0.5),
+                   (1./3+1e-15,0.9-1e-15) ]
+        self.check(dom, 2*x[0]-x[1], f, points)
+
+    def test_Brick_macro(self):
+        dom = Brick(n0=3, n1=2, n2=2, order=-1)
+        x = dom.getX()
+        f = lambda p: p[0]-2*p[1]+3*p[2]
+        points = self.POINTS_3D + [ (1./6,0.25,0.25), (0.5,0.75-1e-14,0.5) ]
+        self.check(dom, x[0]-2*x[1]+3*x[2], f, points)
+
+    def test_Rectangle_reduced(self):
+        dom = Rectangle(n0=3, n1=5, order=2)
+        x = ReducedContinuousFunction(dom).getX()
+        f = lambda p: 2*p[0]-p[1]+p[0]*p[1]
+        self.check(dom, 2*x[0]-x[1]+x[0]*x[1], f, self.POINTS_2D)
+
+    def test_Brick_order1(self):
+        dom = Brick(n0=3, n1=4, n2=5)
+        x = dom.getX()
+        f = lambda p: p[0]-2*p[1]+3*p[2]+p[0]*p[1]*p[2]
+        self.check(dom, x[0]-2*x[1]+3*x[2]+x[0]*x[1]*x[2], f, self.POINTS_3D)
+
+    def test_Solution_and_Vector(self):
+        dom = Rectangle(n0=4, n1=4)
+        u = Solution(dom).getX()
+        values = dom.evaluateAtPoints(u, self.POINTS_2D)
+        for v, p in zip(values, self.POINTS_2D):
+            self.assertEqual(len(v), 2)
+            self.assertAlmostEqual(v[0], p[0], places=8)
+            self.assertAlmostEqual(v[1], p[1], places=8)
+
+    def test_Function(self):
+        dom = Rectangle(n0=4, n1=4)
+        values = dom.evaluateAtPoints(Scalar(3., Function(dom)),
+                                      self.POINTS_2D)
+        for v in values:
+            self.assertAlmostEqual(v, 3., places=8)
+        # averaging x over an element gives its centre
+        values = dom.evaluateAtPoints(Function(dom).getX()[0], [(0.3,0.7)])
+        self.assertAlmostEqual(values[0], 0.375, places=8)
+
+    def test_outside(self):
+        dom = Rectangle(n0=4, n1=4)
+        values = dom.evaluateAtPoints(dom.getX()[0], [(1.5,0.5), (0.5,0.5)])
+        self.assertTrue(values[0] is None)
+        self.assertAlmostEqual(values[1], 0.5, places=8)
+
+class Test_SumFactorizationOnFinley(unittest.TestCase):
+    """
+    compares the sum factorization kernels of tensor product elements with
+    the generic kernels which are used if SUM_FACTORIZATION is switched off.
+    Line3 elements are covered by the faces of Rec9.
+    """
+    RES_TOL = 1.e-10
+
+    def tearDown(self):
+        setEscriptParamInt('SUM_FACTORIZATION', 1)
+
+    def distort(self, dom):
+        x = dom.getX()
+        dim = dom.getDim()
+        e = kronecker(dim)
+        X = x
+        for i in range(dim):
+            X = X + 0.04*sin(3.*x[(i+1)%dim])*(1.+x[i])*e[i]
+        dom.setX(X)
+        return dom
+
+    def getData(self, dom):
+        x = dom.getX()
+        dim = dom.getDim()
+        e = kronecker(dim)
+        u = sin(2.*x[0])*cos(3.*x[dim-1]) + x[0]**2*x[1]
+        v = u*e[0] + (cos(x[1])*x[0] - x[dim-1]**3)*e[1]
+        if dim == 3:
+            v = v + x[0]*x[1]*x[2]*e[2]
+        return u, v
+
+    def compare(self, f, msg):
+        fast = f()
+        fast.resolve()
+        setEscriptParamInt('SUM_FACTORIZATION', 0)
+        try:
+            generic = f()
+            generic.resolve()
+        finally:
+            setEscriptParamInt('SUM_FACTORIZATION', 1)
+        self.assertLessEqual(Lsup(fast-generic), self.RES_TOL*Lsup(generic),
+                             msg)
+
+    def getRHS(self, dom, numEquations, X, Y, y):
+        pde = LinearPDE(dom, numEquations=numEquations)
+        pde.setValue(X=X, Y=Y, y=y)
+        return pde.getRightHandSide()
+
+    def checkKernels(self, dom):
+        dom = self.distort(dom)
+        dim = dom.getDim()
+        u, v = self.getData(dom)
+        for fs in (Function(dom), FunctionOnBoundary(dom)):
+            self.compare(lambda: interpolate(u, fs), "interpolate on %s"%fs)
+            self.compare(lambda: interpolate(v, fs), "interpolate vector on %s"%fs)
+        self.compare(lambda: grad(u), "gradient on nodes")
+        self.compare(lambda: grad(v), "vector gradient on nodes")
+        self.compare(lambda: grad(interpolate(u, Solution(dom))),
+                     "gradient on degrees of freedom")
+        self.compare(lambda: grad(interpolate(v, ReducedSolution(dom))),
+                     "gradient on reduced degrees of freedom")
+        # right hand side terms X and Y of a single PDE and a system
+        Y = interpolate(u, Function(dom))
+        X = grad(u)
+        y = interpolate(u, FunctionOnBoundary(dom))
+        self.compare(lambda: self.getRHS(dom, 1, X, Y, y), "single PDE")
+        Y = interpolate(v, Function(dom))
+        X = grad(v)
+        y = interpolate(v, FunctionOnBoundary(dom))
+        self.compare(lambda: self.getRHS(dom, dim, X, Y, y), "PDE system")
+
+    def test_Rec9(self):
+        self.checkKernels(Rectangle(n0=3, n1=4, order=2))
+
+    def test_Rec9Macro(self):
+        self.checkKernels(Rectangle(n0=3, n1=4, order=-1))
+
+    def test_Hex27(self):
+        self.checkKernels(Brick(n0=2, n1=3, n2=2, order=2))
+
+    def test_Hex27Macro(self):
+        self.checkKernels(Brick(n0=2, n1=3, n2=2, order=-1))
+
 # TODO
 # class Test_copyWithMask_rectangle(Test_copyWithMask):
 #     def setUp(self):
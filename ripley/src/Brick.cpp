@@ -20,6 +20,7 @@
 #include <ripley/LameAssembler3D.h>
 #include <ripley/WaveAssembler3D.h>
 #include <ripley/blocktools.h>
+#include <ripley/chunkedgrid.h>
 #include <ripley/domainhelpers.h>
 
 #include <escript/FileWriter.h>
@@ -73,6 +74,12 @@ using std::fill;
 
 namespace ripley {
 
+// element tile sizes used by the gradient and interpolation loops. A tile of
+// 32x8x8 elements keeps the node planes it touches in cache.
+const dim_t TILE_NE0 = 32;
+const dim_t TILE_NE1 = 8;
+const dim_t TILE_NE2 = 8;
+
 inline int indexOfMax(dim_t a, dim_t b, dim_t c)
 {
     if (a > b) {
@@ -665,9 +672,28 @@ void Brick::readBinaryGrid(escript::Data& out, string filename,
     }
 }
 
+void Brick::readBinaryGridFromChunked(escript::Data& out, string filename,
+                               const ReaderParameters& params) const
+{
+    switch (params.dataType) {
+        case DATATYPE_INT32:
+            readBinaryGridImpl<int>(out, filename, params, true);
+            break;
+        case DATATYPE_FLOAT32:
+            readBinaryGridImpl<float>(out, filename, params, true);
+            break;
+        case DATATYPE_FLOAT64:
+            readBinaryGridImpl<double>(out, filename, params, true);
+            break;
+        default:
+            throw ValueError("readBinaryGridFromChunked(): invalid or unsupported datatype");
+    }
+}
+
 template<typename ValueType>
 void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
-                               const ReaderParameters& params) const
+                               const ReaderParameters& params,
+                               bool chunked) const
 {
     // check destination function space
     dim_t myN0, myN1, myN2;
@@ -697,30 +723,17 @@ void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
     if (params.reverse[0] != 0 || params.reverse[1] != 0)
         throw RipleyException("readBinaryGrid(): reversing only supported in Z-direction currently");
 
-    // check file existence and size
-    std::ifstream f(filename.c_str(), std::ifstream::binary);
-    if (f.fail()) {
-        throw RipleyException("readBinaryGrid(): cannot open file " + filename);
-    }
-    f.seekg(0, std::ios::end);
     const int numComp = out.getDataPointSize();
-    const dim_t filesize = f.tellg();
     const dim_t reqsize = params.numValues[0]*params.numValues[1]*params.numValues[2]*numComp*sizeof(ValueType);
-    if (filesize < reqsize) {
-        f.close();
-        throw RipleyException("readBinaryGrid(): not enough data in file");
-    }
 
-    // check if this rank contributes anything
-    if (params.first[0] >= m_offset[0]+myN0 ||
+    // check if this rank contributes anything. Ranks that don't still take
+    // part in the (collective) read below with an empty block.
+    const bool contributes = !(params.first[0] >= m_offset[0]+myN0 ||
             params.first[0]+params.numValues[0]*params.multiplier[0] <= m_offset[0] ||
             params.first[1] >= m_offset[1]+myN1 ||
             params.first[1]+params.numValues[1]*params.multiplier[1] <= m_offset[1] ||
             params.first[2] >= m_offset[2]+myN2 ||
-            params.first[2]+params.numValues[2]*params.multiplier[2] <= m_offset[2]) {
-        f.close();
-        return;
-    }
+            params.first[2]+params.numValues[2]*params.multiplier[2] <= m_offset[2]);
 
     // now determine how much this rank has to write
 
@@ -740,19 +753,45 @@ void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
     const dim_t rest2 = m_offset[2]%params.multiplier[2];
 
     // number of values to read
-    const dim_t num0 = min(params.numValues[0]-idx0, myN0-first0);
-    const dim_t num1 = min(params.numValues[1]-idx1, myN1-first1);
-    const dim_t num2 = min(params.numValues[2]-idx2, myN2-first2);
+    const dim_t num0 = (contributes ? min(params.numValues[0]-idx0, myN0-first0) : 0);
+    const dim_t num1 = (contributes ? min(params.numValues[1]-idx1, myN1-first1) : 0);
+    const dim_t num2 = (contributes ? min(params.numValues[2]-idx2, myN2-first2) : 0);
 
-    // make sure we read the right block if going backwards through file
+    // make sure we read the right block if going backwards through file.
+    // The block is read in file order so plane z of this rank is at
+    // index (num2-1-z) of the buffer in that case.
     if (params.reverse[2])
-        idx2 = params.numValues[2]-idx2-1;
+        idx2 = params.numValues[2]-idx2-num2;
+
+    // read this rank's block in one go
+    vector<ValueType> values(num0*num1*num2*numComp);
+    char* buffer = (values.empty() ? NULL : (char*)&values[0]);
+    const dim_t dims[3] = { params.numValues[0], params.numValues[1], params.numValues[2] };
+    const dim_t start[3] = { idx0, idx1, idx2 };
+    const dim_t count[3] = { num0, num1, num2 };
+    if (chunked) {
+        const int status = readChunkedGrid(m_mpiInfo, filename, 3, dims,
+                start, count, numComp, params.dataType, params.byteOrder,
+                sizeof(ValueType), buffer);
+        if (status < 0) {
+            throw RipleyException("readBinaryGridFromChunked(): cannot open file " + filename);
+        } else if (status > 0) {
+            throw RipleyException("readBinaryGridFromChunked(): not enough data in file");
+        }
+    } else {
+        const dim_t filesize = readBinaryBlock(m_mpiInfo, filename, 3, dims,
+                start, count, numComp*sizeof(ValueType), reqsize, buffer);
+        if (filesize < 0) {
+            throw RipleyException("readBinaryGrid(): cannot open file " + filename);
+        } else if (filesize < reqsize) {
+            throw RipleyException("readBinaryGrid(): not enough data in file");
+        }
+    }
 
-    // helpers for reversing
-    const int z_mult = (params.reverse[2] ? -1 : 1);
+    if (!contributes)
+        return;
 
     out.requireWrite();
-    vector<ValueType> values(num0*numComp);
     const int dpp = out.getNumDataPointsPerSample();
 
     for (dim_t z=0; z<num2; z++) {
@@ -760,13 +799,10 @@ void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
         dim_t dataZbase = first2 + z*params.multiplier[2];
         if (z>0)
             dataZbase -= rest2;
+        const dim_t plane = (params.reverse[2] ? num2-1-z : z);
 
         for (dim_t y=0; y<num1; y++) {
-            const dim_t fileofs = numComp*(idx0 +
-                                (idx1+y)*params.numValues[0] +
-                                (idx2+z_mult*z)*params.numValues[0]*params.numValues[1]);
-            f.seekg(fileofs*sizeof(ValueType));
-            f.read((char*)&values[0], num0*numComp*sizeof(ValueType));
+            const ValueType* row = &values[(plane*num1+y)*num0*numComp];
             const dim_t m1limit = (y==0 ? params.multiplier[1]-rest1 : params.multiplier[1]);
             dim_t dataYbase = first1 + y*params.multiplier[1];
             if (y>0)
@@ -794,7 +830,7 @@ void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
                             const dim_t dataIndex = dataX + dataY*myN0 + dataZ*myN0*myN1;
                             double* dest = out.getSampleDataRW(dataIndex);
                             for (int c=0; c<numComp; c++) {
-                                ValueType val = values[x*numComp+c];
+                                ValueType val = row[x*numComp+c];
 
                                 if (params.byteOrder != BYTEORDER_NATIVE) {
                                     char* cval = reinterpret_cast<char*>(&val);
@@ -817,8 +853,6 @@ void Brick::readBinaryGridImpl(escript::Data& out, const string& filename,
             }
         }
     }
-
-    f.close();
 }
 
 #ifdef ESYS_HAVE_BOOST_IO
@@ -852,34 +886,15 @@ void Brick::readBinaryGridZippedImpl(escript::Data& out, const string& filename,
         if (params.multiplier[i]<1)
             throw ValueError("readBinaryGridFromZipped(): all multipliers must be positive");
 
-    // check file existence and size
-    std::ifstream f(filename.c_str(), std::ifstream::binary);
-    if (f.fail()) {
-        throw RipleyException("readBinaryGridFromZipped(): cannot open file " + filename);
-    }
-    f.seekg(0, std::ios::end);
     const int numComp = out.getDataPointSize();
-    dim_t filesize = f.tellg();
-    f.seekg(0, ios::beg);
-    vector<char> compressed(filesize);
-    f.read((char*)&compressed[0], filesize);
-    f.close();
-    vector<char> decompressed = unzip(compressed);
-    filesize = decompressed.size();
-    const dim_t reqsize = params.numValues[0]*params.numValues[1]*params.numValues[2]*numComp*sizeof(ValueType);
-    if (filesize < reqsize) {
-        throw RipleyException("readBinaryGridFromZipped(): not enough data in file");
-    }
 
     // check if this rank contributes anything
-    if (params.first[0] >= m_offset[0]+myN0 ||
+    const bool contributes = !(params.first[0] >= m_offset[0]+myN0 ||
             params.first[0]+params.numValues[0]*params.multiplier[0] <= m_offset[0] ||
             params.first[1] >= m_offset[1]+myN1 ||
             params.first[1]+params.numValues[1]*params.multiplier[1] <= m_offset[1] ||
             params.first[2] >= m_offset[2]+myN2 ||
-            params.first[2]+params.numValues[2]*params.multiplier[2] <= m_offset[2]) {
-        return;
-    }
+            params.first[2]+params.numValues[2]*params.multiplier[2] <= m_offset[2]);
 
     // now determine how much this rank has to write
 
@@ -892,19 +907,33 @@ void Brick::readBinaryGridZippedImpl(escript::Data& out, const string& filename,
     const dim_t idx1 = max(dim_t(0), m_offset[1]-params.first[1]);
     const dim_t idx2 = max(dim_t(0), m_offset[2]-params.first[2]);
     // number of values to read
-    const dim_t num0 = min(params.numValues[0]-idx0, myN0-first0);
-    const dim_t num1 = min(params.numValues[1]-idx1, myN1-first1);
-    const dim_t num2 = min(params.numValues[2]-idx2, myN2-first2);
+    const dim_t num0 = (contributes ? min(params.numValues[0]-idx0, myN0-first0) : 0);
+    const dim_t num1 = (contributes ? min(params.numValues[1]-idx1, myN1-first1) : 0);
+    const dim_t num2 = (contributes ? min(params.numValues[2]-idx2, myN2-first2) : 0);
+
+    // decompress only what is needed for this rank's block
+    vector<ValueType> values(num0*num1*num2*numComp);
+    const dim_t dims[3] = { params.numValues[0], params.numValues[1], params.numValues[2] };
+    const dim_t start[3] = { idx0, idx1, idx2 };
+    const dim_t count[3] = { num0, num1, num2 };
+    const int status = readZippedBlock(m_mpiInfo, filename, 3, dims, start,
+            count, numComp*sizeof(ValueType),
+            values.empty() ? NULL : (char*)&values[0]);
+    if (status < 0) {
+        throw RipleyException("readBinaryGridFromZipped(): cannot open file " + filename);
+    } else if (status > 0) {
+        throw RipleyException("readBinaryGridFromZipped(): not enough data in file");
+    }
+
+    if (!contributes)
+        return;
 
     out.requireWrite();
-    vector<ValueType> values(num0*numComp);
     const int dpp = out.getNumDataPointsPerSample();
 
     for (dim_t z=0; z<num2; z++) {
         for (dim_t y=0; y<num1; y++) {
-            const dim_t fileofs = numComp*(idx0+(idx1+y)*params.numValues[0]
-                             +(idx2+z)*params.numValues[0]*params.numValues[1]);
-            memcpy((char*)&values[0], (char*)&decompressed[fileofs*sizeof(ValueType)], num0*numComp*sizeof(ValueType));
+            const ValueType* row = &values[(z*num1+y)*num0*numComp];
 
             for (dim_t x=0; x<num0; x++) {
                 const dim_t baseIndex = first0+x*params.multiplier[0]
@@ -918,12 +947,16 @@ void Brick::readBinaryGridZippedImpl(escript::Data& out, const string& filename,
                                            +m2*myN0*myN1;
                             double* dest = out.getSampleDataRW(dataIndex);
                             for (int c=0; c<numComp; c++) {
-                                ValueType val = values[x*numComp+c];
+                                ValueType val = row[x*numComp+c];
 
                                 if (params.byteOrder != BYTEORDER_NATIVE) {
                                     char* cval = reinterpret_cast<char*>(&val);
                                     // this will alter val!!
-                                    byte_swap32(cval);
+                                    if (sizeof(ValueType)>4) {
+                                        byte_swap64(cval);
+                                    } else {
+                                        byte_swap32(cval);
+                                    }
                                 }
                                 if (!bm::isnan(val)) {
                                     for (int q=0; q<dpp; q++) {
@@ -1042,6 +1075,119 @@ void Brick::writeBinaryGridImpl(const escript::Data& in,
     fw.close();
 }
 
+void Brick::writeBinaryGridChunked(const escript::Data& in, string filename,
+                                   int byteOrder, int dataType,
+                                   int compressionLevel) const
+{
+    switch (dataType) {
+        case DATATYPE_INT32:
+            writeBinaryGridChunkedImpl<int>(in, filename, byteOrder,
+                                            dataType, compressionLevel);
+            break;
+        case DATATYPE_FLOAT32:
+            writeBinaryGridChunkedImpl<float>(in, filename, byteOrder,
+                                              dataType, compressionLevel);
+            break;
+        case DATATYPE_FLOAT64:
+            writeBinaryGridChunkedImpl<double>(in, filename, byteOrder,
+                                               dataType, compressionLevel);
+            break;
+        default:
+            throw ValueError("writeBinaryGridChunked(): invalid or unsupported datatype");
+    }
+}
+
+template<typename ValueType>
+void Brick::writeBinaryGridChunkedImpl(const escript::Data& in,
+                                       const string& filename, int byteOrder,
+                                       int dataType, int compressionLevel) const
+{
+    // check function space and determine the points owned by this rank.
+    // Unlike writeBinaryGrid() the overlap with neighbouring ranks is
+    // skipped so the chunks of the file are disjoint.
+    dim_t myN0, myN1, myN2;
+    dim_t totalN0, totalN1, totalN2;
+    dim_t offset0, offset1, offset2;
+    // samples per row and layer and first owned sample in each dimension
+    dim_t sampleN0, sampleN1;
+    dim_t start0 = 0, start1 = 0, start2 = 0;
+    if (in.getFunctionSpace().getTypeCode() == Nodes) {
+        myN0 = getNumDOFInAxis(0);
+        myN1 = getNumDOFInAxis(1);
+        myN2 = getNumDOFInAxis(2);
+        totalN0 = m_gNE[0]+1;
+        totalN1 = m_gNE[1]+1;
+        totalN2 = m_gNE[2]+1;
+        start0 = getFirstInDim(0);
+        start1 = getFirstInDim(1);
+        start2 = getFirstInDim(2);
+        sampleN0 = m_NN[0];
+        sampleN1 = m_NN[1];
+    } else if (in.getFunctionSpace().getTypeCode() == DegreesOfFreedom ||
+            in.getFunctionSpace().getTypeCode() == ReducedDegreesOfFreedom) {
+        myN0 = sampleN0 = getNumDOFInAxis(0);
+        myN1 = sampleN1 = getNumDOFInAxis(1);
+        myN2 = getNumDOFInAxis(2);
+        totalN0 = m_gNE[0]+1;
+        totalN1 = m_gNE[1]+1;
+        totalN2 = m_gNE[2]+1;
+    } else if (in.getFunctionSpace().getTypeCode() == Elements ||
+                in.getFunctionSpace().getTypeCode() == ReducedElements) {
+        myN0 = m_ownNE[0];
+        myN1 = m_ownNE[1];
+        myN2 = m_ownNE[2];
+        totalN0 = m_gNE[0];
+        totalN1 = m_gNE[1];
+        totalN2 = m_gNE[2];
+        start0 = getFirstInDim(0);
+        start1 = getFirstInDim(1);
+        start2 = getFirstInDim(2);
+        sampleN0 = m_NE[0];
+        sampleN1 = m_NE[1];
+    } else
+        throw RipleyException("writeBinaryGridChunked(): unsupported function space");
+    offset0 = m_offset[0] + getFirstInDim(0);
+    offset1 = m_offset[1] + getFirstInDim(1);
+    offset2 = m_offset[2] + getFirstInDim(2);
+
+    const int numComp = in.getDataPointSize();
+    const int dpp = in.getNumDataPointsPerSample();
+
+    if (dpp > 1)
+        throw RipleyException("writeBinaryGridChunked(): only single-value data supported");
+
+    // convert the owned part of this rank's block to the file representation
+    const dim_t numSamples = myN0*myN1*myN2;
+    vector<ValueType> values(numSamples*numComp);
+#pragma omp parallel for
+    for (index_t i=0; i<numSamples; i++) {
+        const index_t x = start0 + i%myN0;
+        const index_t y = start1 + (i/myN0)%myN1;
+        const index_t z = start2 + i/(myN0*myN1);
+        const double* sample = in.getSampleDataRO(
+                                    INDEX3(x,y,z,sampleN0,sampleN1));
+        for (int c=0; c<numComp; c++) {
+            ValueType fvalue = static_cast<ValueType>(sample[c]);
+            if (byteOrder != BYTEORDER_NATIVE) {
+                char* value = reinterpret_cast<char*>(&fvalue);
+                if (sizeof(fvalue)>4) {
+                    byte_swap64(value);
+                } else {
+                    byte_swap32(value);
+                }
+            }
+            values[i*numComp+c] = fvalue;
+        }
+    }
+
+    const dim_t dims[3] = { totalN0, totalN1, totalN2 };
+    const dim_t first[3] = { offset0, offset1, offset2 };
+    const dim_t count[3] = { myN0, myN1, myN2 };
+    writeChunkedGrid(m_mpiInfo, filename, 3, dims, first, count, numComp,
+                     dataType, byteOrder, sizeof(ValueType), compressionLevel,
+                     values.empty() ? NULL : (const char*)&values[0]);
+}
+
 void Brick::write(const std::string& filename) const
 {
     throw RipleyException("write: not supported");
@@ -1720,8 +1866,12 @@ void Brick::assembleGradient(escript::Data& out,
 //protected
 template<typename Scalar>
 void Brick::assembleGradientImpl(escript::Data& out,
-                                 const escript::Data& in) const
+                                 const escript::Data& arg) const
 {
+    // the element loops address nodal values directly so make sure they
+    // are stored contiguously
+    escript::Data in(arg);
+    in.expand();
     const dim_t numComp = in.getDataPointSize();
     const double C0 = .044658198738520451079;
     const double C1 = .16666666666666666667;
@@ -1736,31 +1886,36 @@ void Brick::assembleGradientImpl(escript::Data& out,
     const Scalar zero = static_cast<Scalar>(0);
 
     if (out.getFunctionSpace().getTypeCode() == Elements) {
+        out.expand();
         out.requireWrite();
-#pragma omp parallel
-        {
-            vector<Scalar> f_000(numComp, zero);
-            vector<Scalar> f_001(numComp, zero);
-            vector<Scalar> f_010(numComp, zero);
-            vector<Scalar> f_011(numComp, zero);
-            vector<Scalar> f_100(numComp, zero);
-            vector<Scalar> f_101(numComp, zero);
-            vector<Scalar> f_110(numComp, zero);
-            vector<Scalar> f_111(numComp, zero);
-#pragma omp for
-            for (index_t k2=0; k2 < NE2; ++k2) {
-                for (index_t k1=0; k1 < NE1; ++k1) {
-                    for (index_t k0=0; k0 < NE0; ++k0) {
-                        memcpy(&f_000[0], in.getSampleDataRO(INDEX3(k0,k1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_001[0], in.getSampleDataRO(INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_010[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_011[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_100[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_101[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_110[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_111[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        Scalar* o = out.getSampleDataRW(INDEX3(k0,k1,k2,NE0,NE1), zero);
-                        for (index_t i=0; i < numComp; ++i) {
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        Scalar* out_p = out.getSampleDataRW(0, zero);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+        const dim_t numTiles2 = (m_NE[2]+TILE_NE2-1)/TILE_NE2;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1*numTiles2; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0%numTiles1)*TILE_NE1;
+            const index_t k2_0 = (t/(numTiles0*numTiles1))*TILE_NE2;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            const index_t k2_1 = min(k2_0+TILE_NE2, m_NE[2]);
+            for (index_t k2 = k2_0; k2 < k2_1; ++k2) {
+                for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                    for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                        for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                            const Scalar* f_000 = &in_p[INDEX3(k0,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_001 = &in_p[INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_010 = &in_p[INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_011 = &in_p[INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_100 = &in_p[INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_101 = &in_p[INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_110 = &in_p[INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_111 = &in_p[INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            Scalar* o = &out_p[INDEX3(k0,k1,k2,NE0,NE1)*outSize];
                             const Scalar V0=((f_100[i]-f_000[i])*C5 + (f_111[i]-f_011[i])*C0 + (f_101[i]+f_110[i]-f_001[i]-f_010[i])*C1) / m_dx[0];
                             const Scalar V1=((f_110[i]-f_010[i])*C5 + (f_101[i]-f_001[i])*C0 + (f_100[i]+f_111[i]-f_000[i]-f_011[i])*C1) / m_dx[0];
                             const Scalar V2=((f_101[i]-f_001[i])*C5 + (f_110[i]-f_010[i])*C0 + (f_100[i]+f_111[i]-f_000[i]-f_011[i])*C1) / m_dx[0];
@@ -1797,45 +1952,50 @@ void Brick::assembleGradientImpl(escript::Data& out,
                             o[INDEX3(i,0,7,numComp,3)] = V3;
                             o[INDEX3(i,1,7,numComp,3)] = V7;
                             o[INDEX3(i,2,7,numComp,3)] = V11;
-                        } // end of component loop i
-                    } // end of k0 loop
+                        } // end of k0 loop
+                    } // end of component loop i
                 } // end of k1 loop
             } // end of k2 loop
-        } // end of parallel section
+        } // end of tile loop
     } else if (out.getFunctionSpace().getTypeCode() == ReducedElements) {
+        out.expand();
         out.requireWrite();
-#pragma omp parallel
-        {
-            vector<Scalar> f_000(numComp, zero);
-            vector<Scalar> f_001(numComp, zero);
-            vector<Scalar> f_010(numComp, zero);
-            vector<Scalar> f_011(numComp, zero);
-            vector<Scalar> f_100(numComp, zero);
-            vector<Scalar> f_101(numComp, zero);
-            vector<Scalar> f_110(numComp, zero);
-            vector<Scalar> f_111(numComp, zero);
-#pragma omp for
-            for (index_t k2=0; k2 < NE2; ++k2) {
-                for (index_t k1=0; k1 < NE1; ++k1) {
-                    for (index_t k0=0; k0 < NE0; ++k0) {
-                        memcpy(&f_000[0], in.getSampleDataRO(INDEX3(k0,k1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_001[0], in.getSampleDataRO(INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_010[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_011[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_100[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_101[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_110[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        memcpy(&f_111[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1]), zero), numComp*sizeof(Scalar));
-                        Scalar* o = out.getSampleDataRW(INDEX3(k0,k1,k2,NE0,NE1), zero);
-                        for (index_t i=0; i < numComp; ++i) {
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        Scalar* out_p = out.getSampleDataRW(0, zero);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+        const dim_t numTiles2 = (m_NE[2]+TILE_NE2-1)/TILE_NE2;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1*numTiles2; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0%numTiles1)*TILE_NE1;
+            const index_t k2_0 = (t/(numTiles0*numTiles1))*TILE_NE2;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            const index_t k2_1 = min(k2_0+TILE_NE2, m_NE[2]);
+            for (index_t k2 = k2_0; k2 < k2_1; ++k2) {
+                for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                    for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                        for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                            const Scalar* f_000 = &in_p[INDEX3(k0,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_001 = &in_p[INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_010 = &in_p[INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_011 = &in_p[INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_100 = &in_p[INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_101 = &in_p[INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_110 = &in_p[INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const Scalar* f_111 = &in_p[INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            Scalar* o = &out_p[INDEX3(k0,k1,k2,NE0,NE1)*outSize];
                             o[INDEX3(i,0,0,numComp,3)] = (f_100[i]+f_101[i]+f_110[i]+f_111[i]-f_000[i]-f_001[i]-f_010[i]-f_011[i])*C3 / m_dx[0];
                             o[INDEX3(i,1,0,numComp,3)] = (f_010[i]+f_011[i]+f_110[i]+f_111[i]-f_000[i]-f_001[i]-f_100[i]-f_101[i])*C3 / m_dx[1];
                             o[INDEX3(i,2,0,numComp,3)] = (f_001[i]+f_011[i]+f_101[i]+f_111[i]-f_000[i]-f_010[i]-f_100[i]-f_110[i])*C3 / m_dx[2];
-                        } // end of component loop i
-                    } // end of k0 loop
+                        } // end of k0 loop
+                    } // end of component loop i
                 } // end of k1 loop
             } // end of k2 loop
-        } // end of parallel section
+        } // end of tile loop
     } else if (out.getFunctionSpace().getTypeCode() == FaceElements) {
         out.requireWrite();
 #pragma omp parallel
@@ -2235,6 +2395,10 @@ void Brick::assembleIntegrateImpl(vector<Scalar>& integrals, const escript::Data
 #endif
         integrals[0] += arg.getNumberOfTaggedValues();
     } else if (fs == Elements && arg.actsExpanded()) {
+        // sum strips of elements along x directly from the sample array
+        escript::Data in(arg);
+        in.resolve();
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
         const real_t w_0 = m_dx[0]*m_dx[1]*m_dx[2]/8.;
 #pragma omp parallel
         {
@@ -2242,9 +2406,12 @@ void Brick::assembleIntegrateImpl(vector<Scalar>& integrals, const escript::Data
 #pragma omp for nowait
             for (index_t k2 = front; k2 < front+m_ownNE[2]; ++k2) {
                 for (index_t k1 = bottom; k1 < bottom+m_ownNE[1]; ++k1) {
-                    for (index_t k0 = left; k0 < left+m_ownNE[0]; ++k0) {
-                        const Scalar* f = arg.getSampleDataRO(INDEX3(k0, k1, k2, m_NE[0], m_NE[1]), zero);
-                        for (index_t i = 0; i < numComp; ++i) {
+                    const Scalar* row = &in_p[INDEX3(left, k1, k2, m_NE[0], m_NE[1])*8*numComp];
+                    for (index_t i = 0; i < numComp; ++i) {
+                        Scalar sum = zero;
+#pragma ivdep
+                        for (index_t k0 = 0; k0 < m_ownNE[0]; ++k0) {
+                            const Scalar* f = &row[k0*8*numComp];
                             const Scalar f_0 = f[INDEX2(i,0,numComp)];
                             const Scalar f_1 = f[INDEX2(i,1,numComp)];
                             const Scalar f_2 = f[INDEX2(i,2,numComp)];
@@ -2253,9 +2420,38 @@ void Brick::assembleIntegrateImpl(vector<Scalar>& integrals, const escript::Data
                             const Scalar f_5 = f[INDEX2(i,5,numComp)];
                             const Scalar f_6 = f[INDEX2(i,6,numComp)];
                             const Scalar f_7 = f[INDEX2(i,7,numComp)];
-                            int_local[i]+=(f_0+f_1+f_2+f_3+f_4+f_5+f_6+f_7)*w_0;
-                        }  // end of component loop i
-                    } // end of k0 loop
+                            sum += f_0+f_1+f_2+f_3+f_4+f_5+f_6+f_7;
+                        } // end of k0 loop
+                        int_local[i] += sum*w_0;
+                    }  // end of component loop i
+                } // end of k1 loop
+            } // end of k2 loop
+
+#pragma omp critical
+            for (index_t i = 0; i < numComp; i++)
+                integrals[i] += int_local[i];
+        } // end of parallel section
+
+    } else if (fs == ReducedElements && arg.actsExpanded()) {
+        escript::Data in(arg);
+        in.resolve();
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        const real_t w_0 = m_dx[0]*m_dx[1]*m_dx[2];
+#pragma omp parallel
+        {
+            vector<Scalar> int_local(numComp, zero);
+#pragma omp for nowait
+            for (index_t k2 = front; k2 < front+m_ownNE[2]; ++k2) {
+                for (index_t k1 = bottom; k1 < bottom+m_ownNE[1]; ++k1) {
+                    const Scalar* row = &in_p[INDEX3(left, k1, k2, m_NE[0], m_NE[1])*numComp];
+                    for (index_t i = 0; i < numComp; ++i) {
+                        Scalar sum = zero;
+#pragma ivdep
+                        for (index_t k0 = 0; k0 < m_ownNE[0]; ++k0) {
+                            sum += row[k0*numComp+i];
+                        }
+                        int_local[i] += sum*w_0;
+                    }  // end of component loop i
                 } // end of k1 loop
             } // end of k2 loop
 
@@ -2265,6 +2461,7 @@ void Brick::assembleIntegrateImpl(vector<Scalar>& integrals, const escript::Data
         } // end of parallel section
 
     } else if (fs==ReducedElements || (fs==Elements && !arg.actsExpanded())) {
+        // constant or tagged data
         const real_t w_0 = m_dx[0]*m_dx[1]*m_dx[2];
 #pragma omp parallel
         {
@@ -3314,72 +3511,86 @@ void Brick::interpolateNodesOnFaces(escript::Data& out, const escript::Data& in,
 //private
 template <typename S>
 void Brick::interpolateNodesOnElementsWorker(escript::Data& out,
-                                       const escript::Data& in,
+                                       const escript::Data& arg,
                                        bool reduced, S sentinel) const
 {
+    // the element loops address nodal values directly so make sure they
+    // are stored contiguously
+    escript::Data in(arg);
+    in.expand();
     const dim_t numComp = in.getDataPointSize();
     if (reduced) {
+        out.expand();
         out.requireWrite();
-#pragma omp parallel
-        {
-            vector<S> f_000(numComp);
-            vector<S> f_001(numComp);
-            vector<S> f_010(numComp);
-            vector<S> f_011(numComp);
-            vector<S> f_100(numComp);
-            vector<S> f_101(numComp);
-            vector<S> f_110(numComp);
-            vector<S> f_111(numComp);
-#pragma omp for
-            for (index_t k2=0; k2 < m_NE[2]; ++k2) {
-                for (index_t k1=0; k1 < m_NE[1]; ++k1) {
-                    for (index_t k0=0; k0 < m_NE[0]; ++k0) {
-                        memcpy(&f_000[0], in.getSampleDataRO(INDEX3(k0,k1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_001[0], in.getSampleDataRO(INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_010[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_011[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_100[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_101[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_110[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_111[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        S* o = out.getSampleDataRW(INDEX3(k0,k1,k2,m_NE[0],m_NE[1]), sentinel);
-                        for (index_t i=0; i < numComp; ++i) {
+        const S* in_p = in.getSampleDataRO(0, sentinel);
+        S* out_p = out.getSampleDataRW(0, sentinel);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+        const dim_t numTiles2 = (m_NE[2]+TILE_NE2-1)/TILE_NE2;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1*numTiles2; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0%numTiles1)*TILE_NE1;
+            const index_t k2_0 = (t/(numTiles0*numTiles1))*TILE_NE2;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            const index_t k2_1 = min(k2_0+TILE_NE2, m_NE[2]);
+            for (index_t k2 = k2_0; k2 < k2_1; ++k2) {
+                for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                    for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                        for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                            const S* f_000 = &in_p[INDEX3(k0,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_001 = &in_p[INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_010 = &in_p[INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_011 = &in_p[INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_100 = &in_p[INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_101 = &in_p[INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_110 = &in_p[INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_111 = &in_p[INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            S* o = &out_p[INDEX3(k0,k1,k2,m_NE[0],m_NE[1])*outSize];
                             o[INDEX2(i,numComp,0)] = (f_000[i] + f_001[i] + f_010[i] + f_011[i] + f_100[i] + f_101[i] + f_110[i] + f_111[i])/static_cast<S>(8);
-                        } // end of component loop i
-                    } // end of k0 loop
+                        } // end of k0 loop
+                    } // end of component loop i
                 } // end of k1 loop
             } // end of k2 loop
-        } // end of parallel section
+        } // end of tile loop
     } else {
+        out.expand();
         out.requireWrite();
         const S c0 = .0094373878376559314545;
         const S c1 = .035220810900864519624;
         const S c2 = .13144585576580214704;
         const S c3 = .49056261216234406855;
-#pragma omp parallel
-        {
-            vector<S> f_000(numComp);
-            vector<S> f_001(numComp);
-            vector<S> f_010(numComp);
-            vector<S> f_011(numComp);
-            vector<S> f_100(numComp);
-            vector<S> f_101(numComp);
-            vector<S> f_110(numComp);
-            vector<S> f_111(numComp);
-#pragma omp for
-            for (index_t k2=0; k2 < m_NE[2]; ++k2) {
-                for (index_t k1=0; k1 < m_NE[1]; ++k1) {
-                    for (index_t k0=0; k0 < m_NE[0]; ++k0) {
-                        memcpy(&f_000[0], in.getSampleDataRO(INDEX3(k0,k1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_001[0], in.getSampleDataRO(INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_010[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_011[0], in.getSampleDataRO(INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_100[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_101[0], in.getSampleDataRO(INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_110[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        memcpy(&f_111[0], in.getSampleDataRO(INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1]), sentinel), numComp*sizeof(S));
-                        S* o = out.getSampleDataRW(INDEX3(k0,k1,k2,m_NE[0],m_NE[1]), sentinel);
-                        for (index_t i=0; i < numComp; ++i) {
+        const S* in_p = in.getSampleDataRO(0, sentinel);
+        S* out_p = out.getSampleDataRW(0, sentinel);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+        const dim_t numTiles2 = (m_NE[2]+TILE_NE2-1)/TILE_NE2;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1*numTiles2; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0%numTiles1)*TILE_NE1;
+            const index_t k2_0 = (t/(numTiles0*numTiles1))*TILE_NE2;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            const index_t k2_1 = min(k2_0+TILE_NE2, m_NE[2]);
+            for (index_t k2 = k2_0; k2 < k2_1; ++k2) {
+                for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                    for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                        for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                            const S* f_000 = &in_p[INDEX3(k0,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_001 = &in_p[INDEX3(k0,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_010 = &in_p[INDEX3(k0,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_011 = &in_p[INDEX3(k0,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_100 = &in_p[INDEX3(k0+1,k1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_101 = &in_p[INDEX3(k0+1,k1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            const S* f_110 = &in_p[INDEX3(k0+1,k1+1,k2, m_NN[0],m_NN[1])*numComp];
+                            const S* f_111 = &in_p[INDEX3(k0+1,k1+1,k2+1, m_NN[0],m_NN[1])*numComp];
+                            S* o = &out_p[INDEX3(k0,k1,k2,m_NE[0],m_NE[1])*outSize];
                             o[INDEX2(i,numComp,0)] = f_000[i]*c3 + f_111[i]*c0 + c2*(f_001[i] + f_010[i] + f_100[i]) + c1*(f_011[i] + f_101[i] + f_110[i]);
                             o[INDEX2(i,numComp,1)] = f_011[i]*c0 + f_100[i]*c3 + c2*(f_000[i] + f_101[i] + f_110[i]) + c1*(f_001[i] + f_010[i] + f_111[i]);
                             o[INDEX2(i,numComp,2)] = f_010[i]*c3 + f_101[i]*c0 + c2*(f_000[i] + f_011[i] + f_110[i]) + c1*(f_001[i] + f_100[i] + f_111[i]);
@@ -3388,11 +3599,11 @@ void Brick::interpolateNodesOnElementsWorker(escript::Data& out,
                             o[INDEX2(i,numComp,5)] = f_010[i]*c0 + f_101[i]*c3 + c2*(f_001[i] + f_100[i] + f_111[i]) + c1*(f_000[i] + f_011[i] + f_110[i]);
                             o[INDEX2(i,numComp,6)] = f_011[i]*c3 + f_100[i]*c0 + c2*(f_001[i] + f_010[i] + f_111[i]) + c1*(f_000[i] + f_101[i] + f_110[i]);
                             o[INDEX2(i,numComp,7)] = f_000[i]*c0 + f_111[i]*c3 + c2*(f_011[i] + f_101[i] + f_110[i]) + c1*(f_001[i] + f_010[i] + f_100[i]);
-                        } // end of component loop i
-                    } // end of k0 loop
+                        } // end of k0 loop
+                    } // end of component loop i
                 } // end of k1 loop
             } // end of k2 loop
-        } // end of parallel section
+        } // end of tile loop
     }
 }
 
@@ -723,6 +723,24 @@ void MultiBrick::writeBinaryGrid(const escript::Data& in, string filename,
     Brick::writeBinaryGrid(in, filename, byteOrder, dataType);
 }
 
+void MultiBrick::readBinaryGridFromChunked(escript::Data& out, string filename,
+                               const ReaderParameters& params) const
+{
+    if (m_subdivisions != 1)
+        throw RipleyException("Non-parent MultiBricks cannot read datafiles");
+    Brick::readBinaryGridFromChunked(out, filename, params);
+}
+
+void MultiBrick::writeBinaryGridChunked(const escript::Data& in, string filename,
+                                int byteOrder, int dataType,
+                                int compressionLevel) const
+{
+    if (m_subdivisions != 1)
+        throw RipleyException("Non-parent MultiBricks cannot write datafiles");
+    Brick::writeBinaryGridChunked(in, filename, byteOrder, dataType,
+                                compressionLevel);
+}
+
 void MultiBrick::dump(const string& fileName) const
 {
     if (m_subdivisions != 1)
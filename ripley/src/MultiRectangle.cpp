@@ -579,6 +579,24 @@ void MultiRectangle::writeBinaryGrid(const escript::Data& in, string filename,
     Rectangle::writeBinaryGrid(in, filename, byteOrder, dataType);
 }
 
+void MultiRectangle::readBinaryGridFromChunked(escript::Data& out, string filename,
+                               const ReaderParameters& params) const
+{
+    if (m_subdivisions != 1)
+        throw RipleyException("Non-parent MultiRectangles cannot read datafiles");
+    Rectangle::readBinaryGridFromChunked(out, filename, params);
+}
+
+void MultiRectangle::writeBinaryGridChunked(const escript::Data& in, string filename,
+                                int byteOrder, int dataType,
+                                int compressionLevel) const
+{
+    if (m_subdivisions != 1)
+        throw RipleyException("Non-parent MultiRectangles cannot write datafiles");
+    Rectangle::writeBinaryGridChunked(in, filename, byteOrder, dataType,
+                                compressionLevel);
+}
+
 void MultiRectangle::dump(const string& fileName) const
 {
     if (m_subdivisions != 1)
@@ -102,12 +102,21 @@ public:
     virtual void readBinaryGridFromZipped(escript::Data& out, std::string filename,
                                 const ReaderParameters& params) const;
 
+    virtual void readBinaryGridFromChunked(escript::Data& out, std::string filename,
+                                const ReaderParameters& params) const;
+
     /**
     */
     virtual void writeBinaryGrid(const escript::Data& in,
                                  std::string filename,
                                  int byteOrder, int dataType) const;
 
+    /**
+    */
+    virtual void writeBinaryGridChunked(const escript::Data& in,
+                                 std::string filename, int byteOrder,
+                                 int dataType, int compressionLevel) const;
+
     /**
        \brief
        returns the number of times each root element has been subdivided
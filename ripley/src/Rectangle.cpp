@@ -20,6 +20,7 @@
 #include <ripley/LameAssembler2D.h>
 #include <ripley/WaveAssembler2D.h>
 #include <ripley/blocktools.h>
+#include <ripley/chunkedgrid.h>
 #include <ripley/domainhelpers.h>
 
 #include <escript/FileWriter.h>
@@ -79,6 +80,11 @@ using namespace netCDF;
 
 namespace ripley {
 
+// element tile sizes used by the gradient and interpolation loops. A tile of
+// 64x8 elements keeps the two node rows it touches in cache.
+const dim_t TILE_NE0 = 64;
+const dim_t TILE_NE1 = 8;
+
 Rectangle::Rectangle(dim_t n0, dim_t n1, double x0, double y0, double x1,
                      double y1, int d0, int d1,
                      const vector<double>& points,
@@ -568,9 +574,28 @@ void Rectangle::readBinaryGridFromZipped(escript::Data& out, string filename,
 #endif
 }
 
+void Rectangle::readBinaryGridFromChunked(escript::Data& out, string filename,
+                               const ReaderParameters& params) const
+{
+    switch (params.dataType) {
+        case DATATYPE_INT32:
+            readBinaryGridImpl<int>(out, filename, params, true);
+            break;
+        case DATATYPE_FLOAT32:
+            readBinaryGridImpl<float>(out, filename, params, true);
+            break;
+        case DATATYPE_FLOAT64:
+            readBinaryGridImpl<double>(out, filename, params, true);
+            break;
+        default:
+            throw ValueError("readBinaryGridFromChunked(): invalid or unsupported datatype");
+    }
+}
+
 template<typename ValueType>
 void Rectangle::readBinaryGridImpl(escript::Data& out, const string& filename,
-                                   const ReaderParameters& params) const
+                                   const ReaderParameters& params,
+                                   bool chunked) const
 {
     // check destination function space
     dim_t myN0, myN1;
@@ -598,28 +623,15 @@ void Rectangle::readBinaryGridImpl(escript::Data& out, const string& filename,
     if (params.reverse[0] != 0 || params.reverse[1] != 0)
         throw NotImplementedError("readBinaryGrid(): reversing not supported yet");
 
-    // check file existence and size
-    std::ifstream f(filename.c_str(), std::ifstream::binary);
-    if (f.fail()) {
-        throw IOError("readBinaryGrid(): cannot open file " + filename);
-    }
-    f.seekg(0, ios::end);
     const int numComp = out.getDataPointSize();
-    const dim_t filesize = f.tellg();
     const dim_t reqsize = params.numValues[0]*params.numValues[1]*numComp*sizeof(ValueType);
-    if (filesize < reqsize) {
-        f.close();
-        throw IOError("readBinaryGrid(): not enough data in file");
-    }
 
-    // check if this rank contributes anything
-    if (params.first[0] >= m_offset[0]+myN0 ||
+    // check if this rank contributes anything. Ranks that don't still take
+    // part in the (collective) read below with an empty block.
+    const bool contributes = !(params.first[0] >= m_offset[0]+myN0 ||
             params.first[0]+(params.numValues[0]*params.multiplier[0]) <= m_offset[0] ||
             params.first[1] >= m_offset[1]+myN1 ||
-            params.first[1]+(params.numValues[1]*params.multiplier[1]) <= m_offset[1]) {
-        f.close();
-        return;
-    }
+            params.first[1]+(params.numValues[1]*params.multiplier[1]) <= m_offset[1]);
 
     // now determine how much this rank has to write
 
@@ -635,17 +647,42 @@ void Rectangle::readBinaryGridImpl(escript::Data& out, const string& filename,
     const dim_t rest0 = m_offset[0]%params.multiplier[0];
     const dim_t rest1 = m_offset[1]%params.multiplier[1];
     // number of values to read
-    const dim_t num0 = min(params.numValues[0]-idx0, myN0-first0);
-    const dim_t num1 = min(params.numValues[1]-idx1, myN1-first1);
+    const dim_t num0 = (contributes ? min(params.numValues[0]-idx0, myN0-first0) : 0);
+    const dim_t num1 = (contributes ? min(params.numValues[1]-idx1, myN1-first1) : 0);
+
+    // read this rank's block in one go
+    vector<ValueType> values(num0*num1*numComp);
+    char* buffer = (values.empty() ? NULL : (char*)&values[0]);
+    const dim_t dims[2] = { params.numValues[0], params.numValues[1] };
+    const dim_t start[2] = { idx0, idx1 };
+    const dim_t count[2] = { num0, num1 };
+    if (chunked) {
+        const int status = readChunkedGrid(m_mpiInfo, filename, 2, dims,
+                start, count, numComp, params.dataType, params.byteOrder,
+                sizeof(ValueType), buffer);
+        if (status < 0) {
+            throw IOError("readBinaryGridFromChunked(): cannot open file " + filename);
+        } else if (status > 0) {
+            throw IOError("readBinaryGridFromChunked(): not enough data in file");
+        }
+    } else {
+        const dim_t filesize = readBinaryBlock(m_mpiInfo, filename, 2, dims,
+                start, count, numComp*sizeof(ValueType), reqsize, buffer);
+        if (filesize < 0) {
+            throw IOError("readBinaryGrid(): cannot open file " + filename);
+        } else if (filesize < reqsize) {
+            throw IOError("readBinaryGrid(): not enough data in file");
+        }
+    }
+
+    if (!contributes)
+        return;
 
     out.requireWrite();
-    vector<ValueType> values(num0*numComp);
     const int dpp = out.getNumDataPointsPerSample();
 
     for (dim_t y=0; y<num1; y++) {
-        const dim_t fileofs = numComp*(idx0+(idx1+y)*params.numValues[0]);
-        f.seekg(fileofs*sizeof(ValueType));
-        f.read((char*)&values[0], num0*numComp*sizeof(ValueType));
+        const ValueType* row = &values[y*num0*numComp];
         const dim_t m1limit = (y==0 ? params.multiplier[1]-rest1 : params.multiplier[1]);
         dim_t dataYbase = first1+y*params.multiplier[1];
         if (y>0)
@@ -667,7 +704,7 @@ void Rectangle::readBinaryGridImpl(escript::Data& out, const string& filename,
                     const dim_t dataIndex = dataX+dataY*myN0;
                     double* dest = out.getSampleDataRW(dataIndex);
                     for (int c=0; c<numComp; c++) {
-                        ValueType val = values[x*numComp+c];
+                        ValueType val = row[x*numComp+c];
 
                         if (params.byteOrder != BYTEORDER_NATIVE) {
                             char* cval = reinterpret_cast<char*>(&val);
@@ -688,8 +725,6 @@ void Rectangle::readBinaryGridImpl(escript::Data& out, const string& filename,
             }
         }
     }
-
-    f.close();
 }
 
 #ifdef ESYS_HAVE_BOOST_IO
@@ -709,33 +744,13 @@ void Rectangle::readBinaryGridZippedImpl(escript::Data& out, const string& filen
     } else
         throw ValueError("readBinaryGrid(): invalid function space for output data object");
 
-    // check file existence and size
-    std::ifstream f(filename.c_str(), std::ifstream::binary);
-    if (f.fail()) {
-        throw IOError("readBinaryGridFromZipped(): cannot open file" + filename);
-    }
-    f.seekg(0, ios::end);
     const int numComp = out.getDataPointSize();
-    dim_t filesize = f.tellg();
-    f.seekg(0, ios::beg);
-    vector<char> compressed(filesize);
-    f.read((char*)&compressed[0], filesize);
-    f.close();
-    vector<char> decompressed = unzip(compressed);
-    filesize = decompressed.size();
-    const dim_t reqsize = params.numValues[0]*params.numValues[1]*numComp*sizeof(ValueType);
-    if (filesize < reqsize) {
-        throw IOError("readBinaryGridFromZipped(): not enough data in file");
-    }
 
     // check if this rank contributes anything
-    if (params.first[0] >= m_offset[0]+myN0 ||
+    const bool contributes = !(params.first[0] >= m_offset[0]+myN0 ||
             params.first[0]+params.numValues[0] <= m_offset[0] ||
             params.first[1] >= m_offset[1]+myN1 ||
-            params.first[1]+params.numValues[1] <= m_offset[1]) {
-        f.close();
-        return;
-    }
+            params.first[1]+params.numValues[1] <= m_offset[1]);
 
     // now determine how much this rank has to write
 
@@ -746,16 +761,31 @@ void Rectangle::readBinaryGridZippedImpl(escript::Data& out, const string& filen
     const dim_t idx0 = max(dim_t(0), m_offset[0]-params.first[0]);
     const dim_t idx1 = max(dim_t(0), m_offset[1]-params.first[1]);
     // number of values to read
-    const dim_t num0 = min(params.numValues[0]-idx0, myN0-first0);
-    const dim_t num1 = min(params.numValues[1]-idx1, myN1-first1);
+    const dim_t num0 = (contributes ? min(params.numValues[0]-idx0, myN0-first0) : 0);
+    const dim_t num1 = (contributes ? min(params.numValues[1]-idx1, myN1-first1) : 0);
+
+    // decompress only what is needed for this rank's block
+    vector<ValueType> values(num0*num1*numComp);
+    const dim_t dims[2] = { params.numValues[0], params.numValues[1] };
+    const dim_t start[2] = { idx0, idx1 };
+    const dim_t count[2] = { num0, num1 };
+    const int status = readZippedBlock(m_mpiInfo, filename, 2, dims, start,
+            count, numComp*sizeof(ValueType),
+            values.empty() ? NULL : (char*)&values[0]);
+    if (status < 0) {
+        throw IOError("readBinaryGridFromZipped(): cannot open file" + filename);
+    } else if (status > 0) {
+        throw IOError("readBinaryGridFromZipped(): not enough data in file");
+    }
+
+    if (!contributes)
+        return;
 
     out.requireWrite();
-    vector<ValueType> values(num0*numComp);
     const int dpp = out.getNumDataPointsPerSample();
 
     for (dim_t y=0; y<num1; y++) {
-        const dim_t fileofs = numComp*(idx0+(idx1+y)*params.numValues[0]);
-            memcpy((char*)&values[0], (char*)&decompressed[fileofs*sizeof(ValueType)], num0*numComp*sizeof(ValueType));
+        const ValueType* row = &values[y*num0*numComp];
         for (dim_t x=0; x<num0; x++) {
             const dim_t baseIndex = first0+x*params.multiplier[0]
                                     +(first1+y*params.multiplier[1])*myN0;
@@ -764,12 +794,16 @@ void Rectangle::readBinaryGridZippedImpl(escript::Data& out, const string& filen
                     const dim_t dataIndex = baseIndex+m0+m1*myN0;
                     double* dest = out.getSampleDataRW(dataIndex);
                     for (int c=0; c<numComp; c++) {
-                        ValueType val = values[x*numComp+c];
+                        ValueType val = row[x*numComp+c];
 
                         if (params.byteOrder != BYTEORDER_NATIVE) {
                             char* cval = reinterpret_cast<char*>(&val);
                             // this will alter val!!
-                            byte_swap32(cval);
+                            if (sizeof(ValueType) > 4) {
+                                byte_swap64(cval);
+                            } else {
+                                byte_swap32(cval);
+                            }
                         }
                         if (!bm::isnan(val)) {
                             for (int q=0; q<dpp; q++) {
@@ -781,8 +815,6 @@ void Rectangle::readBinaryGridZippedImpl(escript::Data& out, const string& filen
             }
         }
     }
-
-    f.close();
 }
 #endif
 
@@ -877,6 +909,105 @@ void Rectangle::writeBinaryGridImpl(const escript::Data& in,
     fw.close();
 }
 
+void Rectangle::writeBinaryGridChunked(const escript::Data& in,
+                                       string filename, int byteOrder,
+                                       int dataType, int compressionLevel) const
+{
+    switch (dataType) {
+        case DATATYPE_INT32:
+            writeBinaryGridChunkedImpl<int>(in, filename, byteOrder,
+                                            dataType, compressionLevel);
+            break;
+        case DATATYPE_FLOAT32:
+            writeBinaryGridChunkedImpl<float>(in, filename, byteOrder,
+                                              dataType, compressionLevel);
+            break;
+        case DATATYPE_FLOAT64:
+            writeBinaryGridChunkedImpl<double>(in, filename, byteOrder,
+                                               dataType, compressionLevel);
+            break;
+        default:
+            throw ValueError("writeBinaryGridChunked(): invalid or unsupported datatype");
+    }
+}
+
+template<typename ValueType>
+void Rectangle::writeBinaryGridChunkedImpl(const escript::Data& in,
+                                    const string& filename, int byteOrder,
+                                    int dataType, int compressionLevel) const
+{
+    // check function space and determine the points owned by this rank.
+    // Unlike writeBinaryGrid() the overlap with neighbouring ranks is
+    // skipped so the chunks of the file are disjoint.
+    dim_t myN0, myN1;
+    dim_t totalN0, totalN1;
+    dim_t offset0, offset1;
+    // samples per row and first owned sample in each dimension
+    dim_t sampleN0;
+    dim_t start0 = 0, start1 = 0;
+    if (in.getFunctionSpace().getTypeCode() == Nodes) {
+        myN0 = getNumDOFInAxis(0);
+        myN1 = getNumDOFInAxis(1);
+        totalN0 = m_gNE[0]+1;
+        totalN1 = m_gNE[1]+1;
+        start0 = getFirstInDim(0);
+        start1 = getFirstInDim(1);
+        sampleN0 = m_NN[0];
+    } else if (in.getFunctionSpace().getTypeCode() == DegreesOfFreedom ||
+            in.getFunctionSpace().getTypeCode() == ReducedDegreesOfFreedom) {
+        myN0 = sampleN0 = getNumDOFInAxis(0);
+        myN1 = getNumDOFInAxis(1);
+        totalN0 = m_gNE[0]+1;
+        totalN1 = m_gNE[1]+1;
+    } else if (in.getFunctionSpace().getTypeCode() == Elements ||
+                in.getFunctionSpace().getTypeCode() == ReducedElements) {
+        myN0 = m_ownNE[0];
+        myN1 = m_ownNE[1];
+        totalN0 = m_gNE[0];
+        totalN1 = m_gNE[1];
+        start0 = getFirstInDim(0);
+        start1 = getFirstInDim(1);
+        sampleN0 = m_NE[0];
+    } else
+        throw ValueError("writeBinaryGridChunked(): unsupported function space");
+    offset0 = m_offset[0] + getFirstInDim(0);
+    offset1 = m_offset[1] + getFirstInDim(1);
+
+    const int numComp = in.getDataPointSize();
+    const int dpp = in.getNumDataPointsPerSample();
+
+    if (dpp > 1)
+        throw NotImplementedError("writeBinaryGridChunked(): only single-value data supported");
+
+    // convert the owned part of this rank's block to the file representation
+    vector<ValueType> values(myN0*myN1*numComp);
+#pragma omp parallel for
+    for (index_t i=0; i<myN0*myN1; i++) {
+        const index_t x = start0 + i%myN0;
+        const index_t y = start1 + i/myN0;
+        const double* sample = in.getSampleDataRO(INDEX2(x,y,sampleN0));
+        for (int c=0; c<numComp; c++) {
+            ValueType fvalue = static_cast<ValueType>(sample[c]);
+            if (byteOrder != BYTEORDER_NATIVE) {
+                char* value = reinterpret_cast<char*>(&fvalue);
+                if (sizeof(fvalue)>4) {
+                    byte_swap64(value);
+                } else {
+                    byte_swap32(value);
+                }
+            }
+            values[i*numComp+c] = fvalue;
+        }
+    }
+
+    const dim_t dims[2] = { totalN0, totalN1 };
+    const dim_t first[2] = { offset0, offset1 };
+    const dim_t count[2] = { myN0, myN1 };
+    writeChunkedGrid(m_mpiInfo, filename, 2, dims, first, count, numComp,
+                     dataType, byteOrder, sizeof(ValueType), compressionLevel,
+                     values.empty() ? NULL : (const char*)&values[0]);
+}
+
 void Rectangle::write(const std::string& filename) const
 {
     throw NotImplementedError("write: not supported");
@@ -1362,8 +1493,12 @@ void Rectangle::assembleGradient(escript::Data& out,
 //protected
 template<typename Scalar>
 void Rectangle::assembleGradientImpl(escript::Data& out,
-                                     const escript::Data& in) const
+                                     const escript::Data& arg) const
 {
+    // the element loops address nodal values directly so make sure they
+    // are stored contiguously
+    escript::Data in(arg);
+    in.expand();
     const dim_t numComp = in.getDataPointSize();
     const dim_t NE0 = m_NE[0];
     const dim_t NE1 = m_NE[1];
@@ -1376,22 +1511,28 @@ void Rectangle::assembleGradientImpl(escript::Data& out,
     const Scalar zero = static_cast<Scalar>(0);
 
     if (out.getFunctionSpace().getTypeCode() == Elements) {
+        out.expand();
         out.requireWrite();
-#pragma omp parallel
-        {
-            vector<Scalar> f_00(numComp, zero);
-            vector<Scalar> f_01(numComp, zero);
-            vector<Scalar> f_10(numComp, zero);
-            vector<Scalar> f_11(numComp, zero);
-#pragma omp for
-            for (index_t k1 = 0; k1 < NE1; ++k1) {
-                for (index_t k0 = 0; k0 < NE0; ++k0) {
-                    memcpy(&f_00[0], in.getSampleDataRO(INDEX2(k0,k1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_01[0], in.getSampleDataRO(INDEX2(k0,k1+1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_10[0], in.getSampleDataRO(INDEX2(k0+1,k1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_11[0], in.getSampleDataRO(INDEX2(k0+1,k1+1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    Scalar* o = out.getSampleDataRW(INDEX2(k0,k1,m_NE[0]), zero);
-                    for (index_t i = 0; i < numComp; ++i) {
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        Scalar* out_p = out.getSampleDataRW(0, zero);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0)*TILE_NE1;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                    for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                        const Scalar* f_00 = &in_p[INDEX2(k0,k1, m_NN[0])*numComp];
+                        const Scalar* f_01 = &in_p[INDEX2(k0,k1+1, m_NN[0])*numComp];
+                        const Scalar* f_10 = &in_p[INDEX2(k0+1,k1, m_NN[0])*numComp];
+                        const Scalar* f_11 = &in_p[INDEX2(k0+1,k1+1, m_NN[0])*numComp];
+                        Scalar* o = &out_p[INDEX2(k0,k1,m_NE[0])*outSize];
                         o[INDEX3(i,0,0,numComp,2)] = (f_10[i]-f_00[i])*cx1 + (f_11[i]-f_01[i])*cx0;
                         o[INDEX3(i,1,0,numComp,2)] = (f_01[i]-f_00[i])*cy1 + (f_11[i]-f_10[i])*cy0;
                         o[INDEX3(i,0,1,numComp,2)] = (f_10[i]-f_00[i])*cx1 + (f_11[i]-f_01[i])*cx0;
@@ -1400,33 +1541,39 @@ void Rectangle::assembleGradientImpl(escript::Data& out,
                         o[INDEX3(i,1,2,numComp,2)] = (f_01[i]-f_00[i])*cy1 + (f_11[i]-f_10[i])*cy0;
                         o[INDEX3(i,0,3,numComp,2)] = (f_10[i]-f_00[i])*cx0 + (f_11[i]-f_01[i])*cx1;
                         o[INDEX3(i,1,3,numComp,2)] = (f_01[i]-f_00[i])*cy0 + (f_11[i]-f_10[i])*cy1;
-                    } // end of component loop i
-                } // end of k0 loop
+                    } // end of k0 loop
+                } // end of component loop i
             } // end of k1 loop
-        } // end of parallel section
+        } // end of tile loop
     } else if (out.getFunctionSpace().getTypeCode() == ReducedElements) {
+        out.expand();
         out.requireWrite();
-#pragma omp parallel
-        {
-            vector<Scalar> f_00(numComp, zero);
-            vector<Scalar> f_01(numComp, zero);
-            vector<Scalar> f_10(numComp, zero);
-            vector<Scalar> f_11(numComp, zero);
-#pragma omp for
-            for (index_t k1 = 0; k1 < NE1; ++k1) {
-                for (index_t k0 = 0; k0 < NE0; ++k0) {
-                    memcpy(&f_00[0], in.getSampleDataRO(INDEX2(k0,k1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_01[0], in.getSampleDataRO(INDEX2(k0,k1+1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_10[0], in.getSampleDataRO(INDEX2(k0+1,k1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    memcpy(&f_11[0], in.getSampleDataRO(INDEX2(k0+1,k1+1, m_NN[0]), zero), numComp*sizeof(Scalar));
-                    Scalar* o = out.getSampleDataRW(INDEX2(k0,k1,m_NE[0]), zero);
-                    for (index_t i = 0; i < numComp; ++i) {
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        Scalar* out_p = out.getSampleDataRW(0, zero);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0)*TILE_NE1;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                    for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                        const Scalar* f_00 = &in_p[INDEX2(k0,k1, m_NN[0])*numComp];
+                        const Scalar* f_01 = &in_p[INDEX2(k0,k1+1, m_NN[0])*numComp];
+                        const Scalar* f_10 = &in_p[INDEX2(k0+1,k1, m_NN[0])*numComp];
+                        const Scalar* f_11 = &in_p[INDEX2(k0+1,k1+1, m_NN[0])*numComp];
+                        Scalar* o = &out_p[INDEX2(k0,k1,m_NE[0])*outSize];
                         o[INDEX3(i,0,0,numComp,2)] = (f_10[i] + f_11[i] - f_00[i] - f_01[i])*cx2 * 0.5;
                         o[INDEX3(i,1,0,numComp,2)] = (f_01[i] + f_11[i] - f_00[i] - f_10[i])*cy2 * 0.5;
-                    } // end of component loop i
-                } // end of k0 loop
+                    } // end of k0 loop
+                } // end of component loop i
             } // end of k1 loop
-        } // end of parallel section
+        } // end of tile loop
     } else if (out.getFunctionSpace().getTypeCode() == FaceElements) {
         out.requireWrite();
 #pragma omp parallel
@@ -1612,29 +1759,63 @@ void Rectangle::assembleIntegrateImpl(vector<Scalar>& integrals,
 #endif
         integrals[0] += arg.getNumberOfTaggedValues();
     } else if (fs == Elements && arg.actsExpanded()) {
+        // sum strips of elements along x directly from the sample array
+        escript::Data in(arg);
+        in.resolve();
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        const real_t w = m_dx[0]*m_dx[1]/4.;
 #pragma omp parallel
         {
             vector<Scalar> int_local(numComp, zero);
-            const real_t w = m_dx[0]*m_dx[1]/4.;
 #pragma omp for nowait
             for (index_t k1 = bottom; k1 < bottom+m_ownNE[1]; ++k1) {
-                for (index_t k0 = left; k0 < left+m_ownNE[0]; ++k0) {
-                    const Scalar* f = arg.getSampleDataRO(INDEX2(k0, k1, m_NE[0]), zero);
-                    for (index_t i = 0; i < numComp; ++i) {
+                const Scalar* row = &in_p[INDEX2(left, k1, m_NE[0])*4*numComp];
+                for (index_t i = 0; i < numComp; ++i) {
+                    Scalar sum = zero;
+#pragma ivdep
+                    for (index_t k0 = 0; k0 < m_ownNE[0]; ++k0) {
+                        const Scalar* f = &row[k0*4*numComp];
                         const Scalar f0 = f[INDEX2(i,0,numComp)];
                         const Scalar f1 = f[INDEX2(i,1,numComp)];
                         const Scalar f2 = f[INDEX2(i,2,numComp)];
                         const Scalar f3 = f[INDEX2(i,3,numComp)];
-                        int_local[i] += (f0+f1+f2+f3)*w;
-                    }  // end of component loop i
-                } // end of k0 loop
+                        sum += f0+f1+f2+f3;
+                    } // end of k0 loop
+                    int_local[i] += sum*w;
+                }  // end of component loop i
             } // end of k1 loop
 #pragma omp critical
             for (index_t i=0; i<numComp; i++)
                 integrals[i] += int_local[i];
         } // end of parallel section
 
+    } else if (fs == ReducedElements && arg.actsExpanded()) {
+        escript::Data in(arg);
+        in.resolve();
+        const Scalar* in_p = in.getSampleDataRO(0, zero);
+        const real_t w = m_dx[0]*m_dx[1];
+#pragma omp parallel
+        {
+            vector<Scalar> int_local(numComp, zero);
+#pragma omp for nowait
+            for (index_t k1 = bottom; k1 < bottom+m_ownNE[1]; ++k1) {
+                const Scalar* row = &in_p[INDEX2(left, k1, m_NE[0])*numComp];
+                for (index_t i = 0; i < numComp; ++i) {
+                    Scalar sum = zero;
+#pragma ivdep
+                    for (index_t k0 = 0; k0 < m_ownNE[0]; ++k0) {
+                        sum += row[k0*numComp+i];
+                    }
+                    int_local[i] += sum*w;
+                }
+            }
+#pragma omp critical
+            for (index_t i = 0; i < numComp; i++)
+                integrals[i] += int_local[i];
+        } // end of parallel section
+
     } else if (fs==ReducedElements || (fs==Elements && !arg.actsExpanded())) {
+        // constant or tagged data
         const real_t w = m_dx[0]*m_dx[1];
 #pragma omp parallel
         {
@@ -2300,63 +2481,77 @@ void Rectangle::interpolateNodesOnFaces(escript::Data& out,
 // private
 template <typename S>
 void Rectangle::interpolateNodesOnElementsWorker(escript::Data& out,
-                                           const escript::Data& in,
+                                           const escript::Data& arg,
                                            bool reduced, S sentinel) const
 {
+    // the element loops address nodal values directly so make sure they
+    // are stored contiguously
+    escript::Data in(arg);
+    in.expand();
     const dim_t numComp = in.getDataPointSize();
-    const dim_t NE0 = m_NE[0];
-    const dim_t NE1 = m_NE[1];
     if (reduced) {
+        out.expand();
         out.requireWrite();
         const S c0 = 0.25;
-#pragma omp parallel
-        {
-            vector<S> f_00(numComp);
-            vector<S> f_01(numComp);
-            vector<S> f_10(numComp);
-            vector<S> f_11(numComp);
-#pragma omp for
-            for (index_t k1=0; k1 < NE1; ++k1) {
-                for (index_t k0=0; k0 < NE0; ++k0) {
-                    memcpy(&f_00[0], in.getSampleDataRO(INDEX2(k0,k1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_01[0], in.getSampleDataRO(INDEX2(k0,k1+1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_10[0], in.getSampleDataRO(INDEX2(k0+1,k1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_11[0], in.getSampleDataRO(INDEX2(k0+1,k1+1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    S* o = out.getSampleDataRW(INDEX2(k0,k1,m_NE[0]), sentinel);
-                    for (index_t i=0; i < numComp; ++i) {
+        const S* in_p = in.getSampleDataRO(0, sentinel);
+        S* out_p = out.getSampleDataRW(0, sentinel);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0)*TILE_NE1;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                    for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                        const S* f_00 = &in_p[INDEX2(k0,k1, m_NN[0])*numComp];
+                        const S* f_01 = &in_p[INDEX2(k0,k1+1, m_NN[0])*numComp];
+                        const S* f_10 = &in_p[INDEX2(k0+1,k1, m_NN[0])*numComp];
+                        const S* f_11 = &in_p[INDEX2(k0+1,k1+1, m_NN[0])*numComp];
+                        S* o = &out_p[INDEX2(k0,k1,m_NE[0])*outSize];
                         o[INDEX2(i,numComp,0)] = c0*(f_00[i] + f_01[i] + f_10[i] + f_11[i]);
-                    } /* end of component loop i */
-                } /* end of k0 loop */
+                    } /* end of k0 loop */
+                } /* end of component loop i */
             } /* end of k1 loop */
-        } /* end of parallel section */
+        } /* end of tile loop */
     } else {
+        out.expand();
         out.requireWrite();
         const S c0 = 0.16666666666666666667;
         const S c1 = 0.044658198738520451079;
         const S c2 = 0.62200846792814621559;
-#pragma omp parallel
-        {
-            vector<S> f_00(numComp);
-            vector<S> f_01(numComp);
-            vector<S> f_10(numComp);
-            vector<S> f_11(numComp);
-#pragma omp for
-            for (index_t k1=0; k1 < NE1; ++k1) {
-                for (index_t k0=0; k0 < NE0; ++k0) {
-                    memcpy(&f_00[0], in.getSampleDataRO(INDEX2(k0,k1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_01[0], in.getSampleDataRO(INDEX2(k0,k1+1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_10[0], in.getSampleDataRO(INDEX2(k0+1,k1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    memcpy(&f_11[0], in.getSampleDataRO(INDEX2(k0+1,k1+1, m_NN[0]), sentinel), numComp*sizeof(S));
-                    S* o = out.getSampleDataRW(INDEX2(k0,k1,m_NE[0]), sentinel);
-                    for (index_t i=0; i < numComp; ++i) {
+        const S* in_p = in.getSampleDataRO(0, sentinel);
+        S* out_p = out.getSampleDataRW(0, sentinel);
+        const dim_t outSize = out.getNumDataPointsPerSample()*out.getDataPointSize();
+        const dim_t numTiles0 = (m_NE[0]+TILE_NE0-1)/TILE_NE0;
+        const dim_t numTiles1 = (m_NE[1]+TILE_NE1-1)/TILE_NE1;
+#pragma omp parallel for
+        for (index_t t = 0; t < numTiles0*numTiles1; ++t) {
+            const index_t k0_0 = (t%numTiles0)*TILE_NE0;
+            const index_t k1_0 = (t/numTiles0)*TILE_NE1;
+            const index_t k0_1 = min(k0_0+TILE_NE0, m_NE[0]);
+            const index_t k1_1 = min(k1_0+TILE_NE1, m_NE[1]);
+            for (index_t k1 = k1_0; k1 < k1_1; ++k1) {
+                for (index_t i = 0; i < numComp; ++i) {
+#pragma ivdep
+                    for (index_t k0 = k0_0; k0 < k0_1; ++k0) {
+                        const S* f_00 = &in_p[INDEX2(k0,k1, m_NN[0])*numComp];
+                        const S* f_01 = &in_p[INDEX2(k0,k1+1, m_NN[0])*numComp];
+                        const S* f_10 = &in_p[INDEX2(k0+1,k1, m_NN[0])*numComp];
+                        const S* f_11 = &in_p[INDEX2(k0+1,k1+1, m_NN[0])*numComp];
+                        S* o = &out_p[INDEX2(k0,k1,m_NE[0])*outSize];
                         o[INDEX2(i,numComp,0)] = c0*(f_01[i] + f_10[i]) + c1*f_11[i] + c2*f_00[i];
                         o[INDEX2(i,numComp,1)] = c0*(f_00[i] + f_11[i]) + c1*f_01[i] + c2*f_10[i];
                         o[INDEX2(i,numComp,2)] = c0*(f_00[i] + f_11[i]) + c1*f_10[i] + c2*f_01[i];
                         o[INDEX2(i,numComp,3)] = c0*(f_01[i] + f_10[i]) + c1*f_00[i] + c2*f_11[i];
-                    } /* end of component loop i */
-                } /* end of k0 loop */
+                    } /* end of k0 loop */
+                } /* end of component loop i */
             } /* end of k1 loop */
-        } /* end of parallel section */
+        } /* end of tile loop */
     }
 }
 
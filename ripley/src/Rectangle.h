@@ -99,12 +99,23 @@ public:
     virtual void readBinaryGridFromZipped(escript::Data& out, std::string filename,
                                 const ReaderParameters& params) const;
 
+    /**
+    */
+    virtual void readBinaryGridFromChunked(escript::Data& out, std::string filename,
+                                const ReaderParameters& params) const;
+
     /**
     */
     virtual void writeBinaryGrid(const escript::Data& in,
                                  std::string filename,
                                  int byteOrder, int dataType) const;
 
+    /**
+    */
+    virtual void writeBinaryGridChunked(const escript::Data& in,
+                                 std::string filename, int byteOrder,
+                                 int dataType, int compressionLevel) const;
+
     /**
        \brief
        returns the array of reference numbers for a function space type
@@ -272,7 +283,8 @@ protected:
 
     template<typename ValueType>
     void readBinaryGridImpl(escript::Data& out, const std::string& filename,
-                            const ReaderParameters& params) const;
+                            const ReaderParameters& params,
+                            bool chunked = false) const;
 
 #ifdef ESYS_HAVE_BOOST_IO
     template<typename ValueType>
@@ -284,6 +296,11 @@ protected:
     void writeBinaryGridImpl(const escript::Data& in,
                              const std::string& filename, int byteOrder) const;
 
+    template<typename ValueType>
+    void writeBinaryGridChunkedImpl(const escript::Data& in,
+                             const std::string& filename, int byteOrder,
+                             int dataType, int compressionLevel) const;
+
     virtual dim_t findNode(const double *coords) const;
 
     
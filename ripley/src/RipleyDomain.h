@@ -93,6 +93,10 @@ struct DiracPoint
     int tag;
 };
 
+/// converts a python list of (name, Data) tuples into a DataMap
+RIPLEY_DLL_API
+void tupleListToMap(DataMap& mapping, const boost::python::list& list);
+
 /**
    \brief
    RipleyDomain extends the AbstractContinuousDomain interface
@@ -101,6 +105,8 @@ struct DiracPoint
 
 class RIPLEY_DLL_API RipleyDomain : public escript::AbstractContinuousDomain
 {
+    friend class WaveStepper;
+
 public:
     /**
        \brief
@@ -664,6 +670,14 @@ public:
     virtual void readBinaryGridFromZipped(escript::Data& out,
                std::string filename, const ReaderParameters& params) const = 0;
 
+    /**
+       \brief
+       reads grid data from a chunked (block compressed) grid file as
+       written by writeBinaryGridChunked into a Data object
+    */
+    virtual void readBinaryGridFromChunked(escript::Data& out,
+               std::string filename, const ReaderParameters& params) const = 0;
+
     /**
        \brief
        writes a Data object to a file in raw binary format
@@ -671,6 +685,15 @@ public:
     virtual void writeBinaryGrid(const escript::Data& in, std::string filename,
                                  int byteOrder, int dataType) const = 0;
 
+    /**
+       \brief
+       writes a Data object to a chunked grid file where each chunk is
+       compressed with the given zlib level (0 = uncompressed)
+    */
+    virtual void writeBinaryGridChunked(const escript::Data& in,
+                                 std::string filename, int byteOrder,
+                                 int dataType, int compressionLevel) const = 0;
+
     /**
        \brief
        returns true if this rank owns the sample id on given function space
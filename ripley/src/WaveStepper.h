@@ -0,0 +1,180 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __RIPLEY_WAVESTEPPER_H__
+#define __RIPLEY_WAVESTEPPER_H__
+
+#include <ripley/RipleyDomain.h>
+
+#ifdef ESYS_HAVE_PASO
+#include <paso/Coupler.h>
+#endif
+
+namespace ripley {
+
+class WaveStepper;
+
+typedef POINTER_WRAPPER_CLASS(WaveStepper) WaveStepper_ptr;
+
+/**
+   \brief
+   Explicit time integration of the elastic wave equation
+
+        rho u_tt = div(sigma(grad(u))) + f(t) * r
+
+   on a ripley domain using the WaveAssembler for the stiffness action and a
+   row-sum lumped mass matrix. The scheme is the same as the one used by the
+   downunder wave classes:
+
+        a_n = M^-1 (F(u_{n-1}) + f(t_{n-1}) * R)
+        v_n = v_{n-1} + dt * a_n
+        u_n = u_{n-1} + dt * v_n
+
+   The inverse lumped mass, the source vector R and all work arrays are
+   assembled/allocated once, so every step only consists of the halo
+   exchange, the gradient and the WaveAssembler's du-assembly.
+*/
+class RIPLEY_DLL_API WaveStepper
+{
+public:
+    /**
+       \brief
+       Creates a new stepper.
+       \param domain the ripley domain
+       \param c the stiffness constants as accepted by the WaveAssembler
+       \param rho density
+       \param source the source orientation on DiracDeltaFunctions (may be
+                     empty)
+       \param dt the time step size
+    */
+    WaveStepper(escript::const_Domain_ptr domain, const DataMap& c,
+                const escript::Data& rho, const escript::Data& source,
+                double dt);
+
+    ~WaveStepper() {}
+
+    /**
+       \brief
+       sets displacement and velocity. Both are reset to zero by default.
+    */
+    void setInitialValues(const escript::Data& u0, const escript::Data& v0);
+
+    /**
+       \brief
+       sets the constraint mask. Components where q is positive are not
+       accelerated, i.e. they keep their initial velocity.
+    */
+    void setConstraint(const escript::Data& q);
+
+    /**
+       \brief
+       sets the receiver locations. 'coords' holds numDim coordinates per
+       receiver. Receivers are snapped to the closest node.
+    */
+    void setReceivers(const std::vector<double>& coords);
+
+    /**
+       \brief
+       performs wavelet.size() time steps, the source amplitude for step i
+       being wavelet[i]. Every 'receiverInterval' steps the displacement at
+       all receivers is appended to 'traces' (numDim values per receiver),
+       every 'snapshotInterval' steps a copy of the displacement is appended
+       to 'snapshots'. Intervals smaller than 1 disable recording.
+       Must be called on all ranks.
+    */
+    void run(const std::vector<double>& wavelet, int receiverInterval,
+             int snapshotInterval, std::vector<double>& traces,
+             std::vector<escript::Data>& snapshots);
+
+    /// returns the current displacement
+    escript::Data getDisplacement() const;
+
+    /// returns the current velocity
+    escript::Data getVelocity() const;
+
+    /// returns the current time
+    double getTime() const { return m_time; }
+
+    /// returns the number of steps performed so far
+    dim_t getNumSteps() const { return m_numSteps; }
+
+    /// returns the time step size
+    double getTimeStepSize() const { return m_dt; }
+
+    /// returns the number of spatial dimensions
+    int getNumDim() const { return m_numDim; }
+
+    /// returns the number of receivers
+    dim_t getNumReceivers() const { return m_numReceivers; }
+
+private:
+    /// copies the displacement to the nodes including the halo
+    void updateNodes();
+
+    /// computes the acceleration for source amplitude 'f' into m_accel
+    void computeAcceleration(double f);
+
+    /// copies displacement values at owned receivers into 'out'
+    void sampleReceivers(double* out) const;
+
+    /// creates a DOF Data object holding a copy of 'values'
+    escript::Data toData(const std::vector<double>& values) const;
+
+    /// copies the values of DOF Data object 'in' into 'values'
+    void fromData(std::vector<double>& values, const escript::Data& in) const;
+
+    POINTER_WRAPPER_CLASS(const RipleyDomain) m_domain;
+    escript::JMPI m_mpiInfo;
+    Assembler_ptr m_assembler;
+    int m_numDim;
+    dim_t m_numDOF;
+    dim_t m_numNodes;
+    double m_dt;
+    double m_time;
+    dim_t m_numSteps;
+
+    /// node to DOF mapping, split into owned and halo nodes
+    std::vector<index_t> m_ownNodes;
+    std::vector<index_t> m_haloNodes;
+    std::vector<index_t> m_nodeDOF;
+
+    std::vector<double> m_u;
+    std::vector<double> m_v;
+    std::vector<double> m_accel;
+    std::vector<double> m_invMass;
+    std::vector<double> m_source;
+    std::vector<char> m_fixed;
+
+    escript::Data m_uNodes;
+    escript::Data m_rhs;
+    escript::Data m_uDOF;
+    /// holds "du" only, the gradient is written in place every step
+    DataMap m_coefs;
+
+    dim_t m_numReceivers;
+    /// receiver index and local DOF of receivers owned by this rank
+    std::vector<std::pair<dim_t, index_t> > m_receivers;
+
+#ifdef ESYS_HAVE_PASO
+    paso::Coupler_ptr<double> m_coupler;
+#endif
+};
+
+} // namespace ripley
+
+#endif // __RIPLEY_WAVESTEPPER_H__
+
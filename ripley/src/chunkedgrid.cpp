@@ -0,0 +1,463 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include <ripley/chunkedgrid.h>
+#include <ripley/RipleyException.h>
+
+#include <escript/Data.h>
+#include <escript/EsysException.h>
+#include <escript/Utils.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef ESYS_HAVE_BOOST_IO
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#endif
+
+namespace ripley {
+
+namespace {
+
+const char MAGIC[8] = { 'R','I','P','L','E','Y','C','G' };
+const int64_t FORMAT_VERSION = 1;
+const int NUM_HEADER_ENTRIES = 11;
+const int NUM_INDEX_ENTRIES = 8;
+const int64_t HEADER_SIZE = sizeof(MAGIC) + 8*NUM_HEADER_ENTRIES;
+const int64_t INDEX_ENTRY_SIZE = 8*NUM_INDEX_ENTRIES;
+// preferred maximum uncompressed size of a chunk
+const int64_t MAX_CHUNK_BYTES = 1<<22;
+// maximum number of bytes handed to a single MPI-IO call
+const int64_t MAX_IO_BYTES = 1<<30;
+
+void putInt64(std::vector<char>& buf, int64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        buf.push_back(static_cast<char>((value >> (8*i)) & 0xff));
+}
+
+int64_t getInt64(const char* bytes)
+{
+    int64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | static_cast<unsigned char>(bytes[i]);
+    return value;
+}
+
+std::vector<char> compressChunk(const char* data, int64_t size, int level)
+{
+    std::vector<char> compressed;
+    if (level <= 0) {
+        compressed.assign(data, data+size);
+        return compressed;
+    }
+#ifdef ESYS_HAVE_BOOST_IO
+    boost::iostreams::filtering_ostream os;
+    os.push(boost::iostreams::zlib_compressor(
+                boost::iostreams::zlib_params(level)));
+    os.push(boost::iostreams::back_inserter(compressed));
+    boost::iostreams::write(os, data, size);
+    // flush the compressor before handing out the result
+    os.reset();
+#endif
+    return compressed;
+}
+
+bool decompressChunk(const std::vector<char>& compressed, int codec,
+                     char* dest, int64_t size)
+{
+    if (codec == CHUNKCODEC_NONE) {
+        if ((int64_t)compressed.size() != size)
+            return false;
+        memcpy(dest, &compressed[0], size);
+        return true;
+    }
+#ifdef ESYS_HAVE_BOOST_IO
+    try {
+        boost::iostreams::filtering_istream is;
+        is.push(boost::iostreams::zlib_decompressor());
+        is.push(boost::iostreams::array_source(&compressed[0],
+                                               compressed.size()));
+        is.read(dest, size);
+        return is.gcount() == size;
+    } catch (boost::iostreams::zlib_error&) {
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+#ifdef ESYS_MPI
+/// throws on all ranks if any rank reports an error
+void checkGlobalError(escript::JMPI mpiInfo, bool error, const std::string& msg)
+{
+    int local = error, global;
+    MPI_Allreduce(&local, &global, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+    if (global)
+        throw RipleyException(msg);
+}
+#endif
+
+} // anonymous namespace
+
+void writeChunkedGrid(escript::JMPI mpiInfo, const std::string& filename,
+                      int numDim, const dim_t* dims, const dim_t* first,
+                      const dim_t* count, int numComp, int dataType,
+                      int byteOrder, int valueSize, int compressionLevel,
+                      const char* values)
+{
+#ifndef ESYS_HAVE_BOOST_IO
+    if (compressionLevel > 0)
+        throw RipleyException("writeBinaryGridChunked(): not compiled with zip support, use compression level 0");
+#endif
+    if (compressionLevel > 9)
+        throw escript::ValueError("writeBinaryGridChunked(): compression level must be between 0 and 9");
+
+    dim_t d[3] = {1, 1, 1};
+    dim_t f[3] = {0, 0, 0};
+    dim_t n[3] = {1, 1, 1};
+    for (int i = 0; i < numDim; i++) {
+        d[i] = dims[i];
+        f[i] = first[i];
+        n[i] = count[i];
+    }
+
+    // split the block into slabs along the slowest varying dimension, at
+    // least one per thread and no larger than MAX_CHUNK_BYTES if possible
+    const int slowDim = numDim-1;
+    const int64_t pointBytes = numComp*valueSize;
+    const int64_t blockBytes = n[0]*n[1]*n[2]*pointBytes;
+    const dim_t numSlices = (blockBytes > 0 ? n[slowDim] : 0);
+    const int64_t sliceBytes = (numSlices > 0 ? blockBytes/numSlices : 0);
+    dim_t numChunks = 0;
+    if (numSlices > 0) {
+        numChunks = std::max<int64_t>(escript::getNumberOfThreads(),
+                            (blockBytes+MAX_CHUNK_BYTES-1)/MAX_CHUNK_BYTES);
+        numChunks = std::min(numChunks, numSlices);
+    }
+
+    std::vector<std::vector<char> > chunks(numChunks);
+#pragma omp parallel for schedule(dynamic)
+    for (dim_t c = 0; c < numChunks; c++) {
+        const dim_t s0 = c*numSlices/numChunks;
+        const dim_t s1 = (c+1)*numSlices/numChunks;
+        chunks[c] = compressChunk(values+s0*sliceBytes, (s1-s0)*sliceBytes,
+                                  compressionLevel);
+    }
+
+    // determine where this rank's data goes
+    int64_t localBytes = 0;
+    for (dim_t c = 0; c < numChunks; c++)
+        localBytes += chunks[c].size();
+    int64_t dataOffset = 0;
+    int64_t totalChunks = numChunks;
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        int64_t localChunks = numChunks;
+        MPI_Exscan(&localBytes, &dataOffset, 1, MPI_INT64_T, MPI_SUM,
+                   mpiInfo->comm);
+        if (mpiInfo->rank == 0)
+            dataOffset = 0;
+        MPI_Allreduce(&localChunks, &totalChunks, 1, MPI_INT64_T, MPI_SUM,
+                      mpiInfo->comm);
+    }
+#endif
+    const int64_t dataStart = HEADER_SIZE + totalChunks*INDEX_ENTRY_SIZE;
+
+    // index entries of this rank
+    std::vector<char> index;
+    int64_t ofs = dataStart + dataOffset;
+    for (dim_t c = 0; c < numChunks; c++) {
+        const dim_t s0 = c*numSlices/numChunks;
+        const dim_t s1 = (c+1)*numSlices/numChunks;
+        for (int i = 0; i < 3; i++)
+            putInt64(index, i == slowDim ? f[i]+s0 : f[i]);
+        for (int i = 0; i < 3; i++)
+            putInt64(index, i == slowDim ? s1-s0 : n[i]);
+        putInt64(index, ofs);
+        putInt64(index, chunks[c].size());
+        ofs += chunks[c].size();
+    }
+
+    // rank 0 assembles header and full index
+    std::vector<char> header;
+    if (mpiInfo->rank == 0) {
+        header.insert(header.end(), MAGIC, MAGIC+sizeof(MAGIC));
+        putInt64(header, FORMAT_VERSION);
+        putInt64(header, numDim);
+        for (int i = 0; i < 3; i++)
+            putInt64(header, d[i]);
+        putInt64(header, numComp);
+        putInt64(header, dataType);
+        putInt64(header, byteOrder);
+        putInt64(header, valueSize);
+        putInt64(header, compressionLevel > 0 ? CHUNKCODEC_ZLIB : CHUNKCODEC_NONE);
+        putInt64(header, totalChunks);
+    }
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        int localSize = index.size();
+        std::vector<int> sizes(mpiInfo->size), displs(mpiInfo->size);
+        MPI_Gather(&localSize, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0,
+                   mpiInfo->comm);
+        std::vector<char> allEntries;
+        if (mpiInfo->rank == 0) {
+            for (int r = 1; r < mpiInfo->size; r++)
+                displs[r] = displs[r-1] + sizes[r-1];
+            allEntries.resize(displs.back() + sizes.back() + 1);
+        }
+        MPI_Gatherv(index.empty() ? NULL : &index[0], localSize, MPI_CHAR,
+                    allEntries.empty() ? NULL : &allEntries[0], &sizes[0],
+                    &displs[0], MPI_CHAR, 0, mpiInfo->comm);
+        if (mpiInfo->rank == 0)
+            header.insert(header.end(), allEntries.begin(), allEntries.end()-1);
+    } else
+#endif
+    {
+        header.insert(header.end(), index.begin(), index.end());
+    }
+
+    // concatenate compressed chunks so each rank writes one contiguous region
+    std::vector<char> data;
+    data.reserve(localBytes);
+    for (dim_t c = 0; c < numChunks; c++) {
+        data.insert(data.end(), chunks[c].begin(), chunks[c].end());
+        std::vector<char>().swap(chunks[c]);
+    }
+
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        int error = 0;
+        if (mpiInfo->rank == 0) {
+            std::ifstream f(filename.c_str());
+            if (f.is_open()) {
+                f.close();
+                error = (std::remove(filename.c_str()) != 0);
+            }
+        }
+        checkGlobalError(mpiInfo, error,
+                "writeBinaryGridChunked(): cannot remove existing file " + filename);
+
+        MPI_File fh;
+        int mpiErr = MPI_File_open(mpiInfo->comm,
+                const_cast<char*>(filename.c_str()),
+                MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+        checkGlobalError(mpiInfo, mpiErr != MPI_SUCCESS,
+                "writeBinaryGridChunked(): cannot open file " + filename);
+
+        MPI_Status status;
+        if (mpiInfo->rank == 0) {
+            error = (MPI_File_write_at(fh, 0, &header[0], header.size(),
+                                 MPI_CHAR, &status) != MPI_SUCCESS);
+        }
+        // collective writes of at most MAX_IO_BYTES per call and rank
+        int64_t numPieces = (localBytes+MAX_IO_BYTES-1)/MAX_IO_BYTES;
+        int64_t maxPieces;
+        MPI_Allreduce(&numPieces, &maxPieces, 1, MPI_INT64_T, MPI_MAX,
+                      mpiInfo->comm);
+        for (int64_t p = 0; p < maxPieces; p++) {
+            const int64_t pieceStart = std::min(p*MAX_IO_BYTES, localBytes);
+            const int len = std::min(MAX_IO_BYTES, localBytes-pieceStart);
+            mpiErr = MPI_File_write_at_all(fh,
+                    dataStart+dataOffset+pieceStart,
+                    len > 0 ? &data[pieceStart] : NULL, len, MPI_CHAR,
+                    &status);
+            error |= (mpiErr != MPI_SUCCESS);
+        }
+        MPI_File_close(&fh);
+        checkGlobalError(mpiInfo, error,
+                "writeBinaryGridChunked(): error writing file " + filename);
+        return;
+    }
+#endif
+
+    std::ofstream fs(filename.c_str(), std::ofstream::binary);
+    if (fs.fail())
+        throw RipleyException("writeBinaryGridChunked(): cannot open file " + filename);
+    fs.write(&header[0], header.size());
+    if (!data.empty())
+        fs.write(&data[0], data.size());
+    if (fs.fail())
+        throw RipleyException("writeBinaryGridChunked(): error writing file " + filename);
+}
+
+int readChunkedGrid(escript::JMPI mpiInfo, const std::string& filename,
+                    int numDim, const dim_t* dims, const dim_t* first,
+                    const dim_t* count, int numComp, int dataType,
+                    int byteOrder, int valueSize, char* buffer)
+{
+    dim_t d[3] = {1, 1, 1};
+    dim_t f[3] = {0, 0, 0};
+    dim_t n[3] = {1, 1, 1};
+    for (int i = 0; i < numDim; i++) {
+        d[i] = dims[i];
+        f[i] = first[i];
+        n[i] = count[i];
+    }
+
+    // rank 0 reads header and index and shares them with everyone else
+    std::vector<char> meta;
+    int64_t metaSize = 0;
+    if (mpiInfo->rank == 0) {
+        std::ifstream fs(filename.c_str(), std::ifstream::binary);
+        if (fs.fail()) {
+            metaSize = -1;
+        } else {
+            meta.resize(HEADER_SIZE);
+            fs.read(&meta[0], HEADER_SIZE);
+            if (fs.gcount() == HEADER_SIZE &&
+                    !memcmp(&meta[0], MAGIC, sizeof(MAGIC))) {
+                const int64_t numChunks = getInt64(&meta[HEADER_SIZE-8]);
+                meta.resize(HEADER_SIZE + numChunks*INDEX_ENTRY_SIZE);
+                fs.read(&meta[HEADER_SIZE], numChunks*INDEX_ENTRY_SIZE);
+                if (fs.gcount() != numChunks*INDEX_ENTRY_SIZE)
+                    meta.clear();
+            } else {
+                meta.clear();
+            }
+            metaSize = meta.size();
+        }
+    }
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        MPI_Bcast(&metaSize, 1, MPI_INT64_T, 0, mpiInfo->comm);
+        if (metaSize > 0) {
+            meta.resize(metaSize);
+            MPI_Bcast(&meta[0], metaSize, MPI_CHAR, 0, mpiInfo->comm);
+        }
+    }
+#endif
+    if (metaSize < 0)
+        return -1;
+    if (metaSize == 0)
+        throw RipleyException("readBinaryGridFromChunked(): " + filename
+                              + " is not a chunked grid file");
+
+    const char* hdr = &meta[sizeof(MAGIC)];
+    const int fileDim = getInt64(&hdr[8]);
+    dim_t fileDims[3];
+    for (int i = 0; i < 3; i++)
+        fileDims[i] = getInt64(&hdr[16+8*i]);
+    const int codec = getInt64(&hdr[72]);
+    const int64_t numChunks = getInt64(&hdr[80]);
+    if (getInt64(&hdr[0]) != FORMAT_VERSION || fileDim != numDim)
+        throw RipleyException("readBinaryGridFromChunked(): unsupported file version or dimension");
+    if (getInt64(&hdr[40]) != numComp || getInt64(&hdr[48]) != dataType
+            || getInt64(&hdr[56]) != byteOrder
+            || getInt64(&hdr[64]) != valueSize)
+        throw RipleyException("readBinaryGridFromChunked(): number of components, data type or byte order of file do not match");
+#ifndef ESYS_HAVE_BOOST_IO
+    if (codec != CHUNKCODEC_NONE)
+        throw RipleyException("readBinaryGridFromChunked(): not compiled with zip support");
+#endif
+    for (int i = 0; i < 3; i++)
+        if (fileDims[i] < d[i])
+            return 1;
+
+    const int64_t pointBytes = numComp*valueSize;
+
+    // collect the chunks overlapping this rank's block. The chunks of a file
+    // are disjoint so the block is covered iff the overlaps add up to it.
+    std::vector<const char*> overlapping;
+    dim_t covered = 0;
+    for (int64_t c = 0; c < numChunks; c++) {
+        const char* entry = &meta[HEADER_SIZE + c*INDEX_ENTRY_SIZE];
+        dim_t overlap = 1;
+        for (int i = 0; i < 3; i++) {
+            const dim_t cf = getInt64(&entry[8*i]);
+            const dim_t cn = getInt64(&entry[24+8*i]);
+            overlap *= std::max(dim_t(0),
+                    std::min(f[i]+n[i], cf+cn) - std::max(f[i], cf));
+        }
+        if (overlap > 0) {
+            overlapping.push_back(entry);
+            covered += overlap;
+        }
+    }
+
+    // errors are collected first and thrown on all ranks together, ranks
+    // with nothing to read still take part in the reduction
+    enum { READ_OK, NOT_COVERED, READ_ERROR, CORRUPT_CHUNK };
+    int error = (covered != n[0]*n[1]*n[2] ? NOT_COVERED : READ_OK);
+    const dim_t numOverlapping = (error == READ_OK ? overlapping.size() : 0);
+    std::vector<std::vector<char> > compressed(numOverlapping);
+    if (numOverlapping > 0) {
+        std::ifstream fs(filename.c_str(), std::ifstream::binary);
+        for (dim_t c = 0; c < numOverlapping; c++) {
+            compressed[c].resize(getInt64(&overlapping[c][56]));
+            fs.seekg(getInt64(&overlapping[c][48]));
+            fs.read(&compressed[c][0], compressed[c].size());
+        }
+        if (fs.fail())
+            error = READ_ERROR;
+    }
+
+    // decompress and copy the overlapping part of each chunk
+    const dim_t numDecompress = (error == READ_OK ? numOverlapping : 0);
+    bool corrupt = false;
+#pragma omp parallel for schedule(dynamic)
+    for (dim_t c = 0; c < numDecompress; c++) {
+        dim_t cf[3], cn[3], lo[3], hi[3];
+        for (int i = 0; i < 3; i++) {
+            cf[i] = getInt64(&overlapping[c][8*i]);
+            cn[i] = getInt64(&overlapping[c][24+8*i]);
+            lo[i] = std::max(f[i], cf[i]);
+            hi[i] = std::min(f[i]+n[i], cf[i]+cn[i]);
+        }
+        std::vector<char> chunk(cn[0]*cn[1]*cn[2]*pointBytes);
+        if (!decompressChunk(compressed[c], codec, &chunk[0], chunk.size())) {
+#pragma omp critical
+            corrupt = true;
+            continue;
+        }
+        const int64_t len = (hi[0]-lo[0])*pointBytes;
+        for (dim_t z = lo[2]; z < hi[2]; z++) {
+            for (dim_t y = lo[1]; y < hi[1]; y++) {
+                const int64_t src = ((z-cf[2])*cn[1] + y-cf[1])*cn[0] + lo[0]-cf[0];
+                const int64_t dst = ((z-f[2])*n[1] + y-f[1])*n[0] + lo[0]-f[0];
+                memcpy(buffer+dst*pointBytes, &chunk[src*pointBytes], len);
+            }
+        }
+    }
+    if (corrupt)
+        error = CORRUPT_CHUNK;
+
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        int gError;
+        MPI_Allreduce(&error, &gError, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+        error = gError;
+    }
+#endif
+    if (error == NOT_COVERED)
+        throw RipleyException("readBinaryGridFromChunked(): chunks in file "
+                              + filename + " do not cover the requested block");
+    if (error == READ_ERROR)
+        throw RipleyException("readBinaryGridFromChunked(): error reading file " + filename);
+    if (error == CORRUPT_CHUNK)
+        throw RipleyException("readBinaryGridFromChunked(): corrupt chunk in file " + filename);
+    return 0;
+}
+
+} // namespace ripley
+
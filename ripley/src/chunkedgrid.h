@@ -0,0 +1,90 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __RIPLEY_CHUNKEDGRID_H__
+#define __RIPLEY_CHUNKEDGRID_H__
+
+/*****************************************************************************
+ *  Block compressed ("chunked") grid files.
+ *
+ *  A chunked grid file stores a 2D or 3D grid of values (each consisting of
+ *  numComp components) as a set of independently compressed chunks, each
+ *  covering a box of the grid. The layout is
+ *
+ *    header  : magic "RIPLEYCG" followed by 11 little-endian 64-bit integers
+ *              version, numDim, dims[3], numComp, dataType, byteOrder,
+ *              valueSize, codec, numChunks
+ *    index   : numChunks entries of 8 little-endian 64-bit integers
+ *              first[3], count[3], file offset, compressed size
+ *    chunks  : the compressed chunk data. Within a chunk values are stored
+ *              x fastest, then y, then z, in the byte order from the header.
+ *
+ *  Chunks follow the domain decomposition of the writer (each rank's block
+ *  is split into slabs along the slowest dimension) so every rank writes a
+ *  single contiguous region and readers only decompress the chunks that
+ *  overlap their own block, independent of the number of ranks used to
+ *  write the file.
+ ****************************************************************************/
+
+#include <ripley/Ripley.h>
+
+namespace ripley {
+
+enum {
+    CHUNKCODEC_NONE = 0,
+    CHUNKCODEC_ZLIB = 1
+};
+
+/**
+    writes the block of count[0] x count[1] (x count[2]) values starting at
+    index 'first' of a dims[0] x dims[1] (x dims[2]) grid to the chunked grid
+    file 'filename'. 'values' holds the block x fastest, each value consists
+    of numComp components of valueSize bytes stored in 'byteOrder'.
+
+    compressionLevel is the zlib level (1-9), 0 stores chunks uncompressed.
+    Chunks are compressed in parallel by OpenMP threads and with MPI all
+    ranks write their data with a collective call so this must be called on
+    all ranks of 'mpiInfo'.
+*/
+void writeChunkedGrid(escript::JMPI mpiInfo, const std::string& filename,
+                      int numDim, const dim_t* dims, const dim_t* first,
+                      const dim_t* count, int numComp, int dataType,
+                      int byteOrder, int valueSize, int compressionLevel,
+                      const char* values);
+
+/**
+    reads the block of count[0] x count[1] (x count[2]) values starting at
+    index 'first' from the chunked grid file 'filename' into 'buffer' (see
+    readBinaryBlock for the layout). Only chunks overlapping the block are
+    read and decompressed.
+
+    The file's grid must be at least dims[0] x dims[1] (x dims[2]) and hold
+    values of the given number of components, data type and byte order.
+
+    Returns 0 on success, -1 if the file could not be opened and 1 if the
+    file's grid is smaller than 'dims'. Must be called on all ranks of
+    'mpiInfo'.
+*/
+int readChunkedGrid(escript::JMPI mpiInfo, const std::string& filename,
+                    int numDim, const dim_t* dims, const dim_t* first,
+                    const dim_t* count, int numComp, int dataType,
+                    int byteOrder, int valueSize, char* buffer);
+
+} // namespace ripley
+
+#endif // __RIPLEY_CHUNKEDGRID_H__
+
@@ -17,7 +17,11 @@
 
 #include <ripley/domainhelpers.h>
 #include <ripley/RipleyException.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
 
 #ifdef ESYS_HAVE_BOOST_IO
 #include <boost/iostreams/filter/gzip.hpp>
@@ -67,7 +71,354 @@ std::vector<char> unzip(const std::vector<char>& compressed)
     }
     return decompressed;
 }
+
+namespace {
+
+/// offsets of the gzip members of a block compressed (BGZF) file.
+/// compOfs and dataOfs have one entry more than there are members, the
+/// last one marking the end of the compressed and uncompressed data.
+struct MemberIndex
+{
+    std::vector<dim_t> compOfs;
+    std::vector<dim_t> dataOfs;
+};
+
+inline dim_t readLittleEndian(const unsigned char* bytes, int numBytes)
+{
+    dim_t value = 0;
+    for (int i = numBytes-1; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+/// returns the total size in bytes of the gzip member starting at 'ofs' if
+/// its header carries a BGZF block size field, 0 otherwise
+dim_t bgzfMemberSize(std::ifstream& f, dim_t ofs)
+{
+    unsigned char hdr[12];
+    f.seekg(ofs);
+    f.read((char*)hdr, 12);
+    // magic, deflate and FEXTRA flag
+    if (f.gcount() != 12 || hdr[0] != 31 || hdr[1] != 139 || hdr[2] != 8
+            || !(hdr[3] & 4))
+        return 0;
+    const int xlen = readLittleEndian(&hdr[10], 2);
+    std::vector<unsigned char> extra(xlen+1);
+    f.read((char*)&extra[0], xlen);
+    if (f.gcount() != xlen)
+        return 0;
+    for (int i = 0; i+4 <= xlen; ) {
+        const int slen = readLittleEndian(&extra[i+2], 2);
+        if (extra[i] == 'B' && extra[i+1] == 'C' && slen == 2 && i+6 <= xlen)
+            return readLittleEndian(&extra[i+4], 2) + 1;
+        i += 4+slen;
+    }
+    return 0;
+}
+
+/// fills 'index' from the .gzi file written by 'bgzip -i' if there is one,
+/// otherwise by walking the member headers until 'dataEnd' uncompressed
+/// bytes are covered. Returns false if the file is not block compressed.
+bool buildMemberIndex(std::ifstream& f, const std::string& filename,
+                      dim_t fileSize, dim_t dataEnd, MemberIndex& index)
+{
+    index.compOfs.assign(1, 0);
+    index.dataOfs.assign(1, 0);
+
+    std::ifstream gzi((filename+".gzi").c_str(), std::ifstream::binary);
+    if (gzi.is_open()) {
+        unsigned char buf[16];
+        gzi.read((char*)buf, 8);
+        const dim_t numEntries = readLittleEndian(buf, 8);
+        for (dim_t i = 0; i < numEntries; i++) {
+            gzi.read((char*)buf, 16);
+            if (gzi.gcount() != 16)
+                return false;
+            index.compOfs.push_back(readLittleEndian(buf, 8));
+            index.dataOfs.push_back(readLittleEndian(&buf[8], 8));
+        }
+        // size of the last member is only known once it is decompressed
+        index.compOfs.push_back(fileSize);
+        index.dataOfs.push_back(std::numeric_limits<dim_t>::max());
+        return bgzfMemberSize(f, 0) > 0;
+    }
+
+    dim_t ofs = 0, data = 0;
+    while (ofs < fileSize && data < dataEnd) {
+        const dim_t size = bgzfMemberSize(f, ofs);
+        if (size < 4 || ofs+size > fileSize)
+            return false;
+        // ISIZE, the uncompressed size of the member, is in the last 4 bytes
+        unsigned char isize[4];
+        f.seekg(ofs+size-4);
+        f.read((char*)isize, 4);
+        ofs += size;
+        data += readLittleEndian(isize, 4);
+        index.compOfs.push_back(ofs);
+        index.dataOfs.push_back(data);
+    }
+    return true;
+}
+
+/// calls 'op(offset, length, dest)' for all rows of the block in file order
+/// with offsets and lengths in bytes
+template<typename RowOp>
+bool forEachBlockRow(const dim_t* d, const dim_t* f, const dim_t* n,
+                     int valueSize, char* buffer, RowOp& op)
+{
+    for (dim_t z = 0; z < n[2]; z++) {
+        for (dim_t y = 0; y < n[1]; y++) {
+            const dim_t fileofs = f[0] + (f[1]+y)*d[0] + (f[2]+z)*d[0]*d[1];
+            if (!op(fileofs*valueSize, n[0]*valueSize,
+                    buffer + (z*n[1]+y)*n[0]*valueSize))
+                return false;
+        }
+    }
+    return true;
+}
+
+/// copies byte ranges out of individually decompressed BGZF members
+struct MemberReader
+{
+    MemberReader(std::ifstream& file, const MemberIndex& idx) :
+        f(file), index(idx), current(-1), currentStart(0) {}
+
+    bool operator()(dim_t ofs, dim_t len, char* dest)
+    {
+        const dim_t numMembers = index.compOfs.size()-1;
+        while (len > 0) {
+            if (current < 0 || ofs < currentStart ||
+                    ofs >= currentStart+(dim_t)member.size()) {
+                const dim_t i = std::upper_bound(index.dataOfs.begin(),
+                        index.dataOfs.begin()+numMembers, ofs)
+                        - index.dataOfs.begin() - 1;
+                if (i < 0 || i >= numMembers || i == current)
+                    return false;
+                std::vector<char> compressed(index.compOfs[i+1]-index.compOfs[i]);
+                f.seekg(index.compOfs[i]);
+                f.read(&compressed[0], compressed.size());
+                member = unzip(compressed);
+                current = i;
+                currentStart = index.dataOfs[i];
+                if (ofs >= currentStart+(dim_t)member.size())
+                    return false;
+            }
+            const dim_t num = std::min(len, currentStart+(dim_t)member.size()-ofs);
+            memcpy(dest, &member[ofs-currentStart], num);
+            ofs += num;
+            dest += num;
+            len -= num;
+        }
+        return true;
+    }
+
+    std::ifstream& f;
+    const MemberIndex& index;
+    std::vector<char> member;
+    dim_t current;
+    dim_t currentStart;
+};
+
+/// reads byte ranges in increasing order from a gzip stream, discarding
+/// everything in between
+struct StreamReader
+{
+    StreamReader(std::istream& in) : stream(in), pos(0) {}
+
+    bool operator()(dim_t ofs, dim_t len, char* dest)
+    {
+        if (ofs > pos) {
+            stream.ignore(ofs-pos);
+            if (stream.gcount() != ofs-pos)
+                return false;
+        }
+        stream.read(dest, len);
+        pos = ofs+len;
+        return stream.gcount() == len;
+    }
+
+    std::istream& stream;
+    dim_t pos;
+};
+
+} // anonymous namespace
+
+int readZippedBlock(escript::JMPI mpiInfo, const std::string& filename,
+                    int numDim, const dim_t* dims, const dim_t* first,
+                    const dim_t* count, int valueSize, char* buffer)
+{
+    dim_t d[3] = {1, 1, 1};
+    dim_t f[3] = {0, 0, 0};
+    dim_t n[3] = {1, 1, 1};
+    for (int i = 0; i < numDim; i++) {
+        d[i] = dims[i];
+        f[i] = first[i];
+        n[i] = count[i];
+    }
+
+    int status = 0;
+    // decompression errors are only thrown once all ranks know about them,
+    // otherwise the others would wait in the reduction below forever
+    std::string zipError;
+    std::ifstream fs(filename.c_str(), std::ifstream::binary);
+    if (fs.fail()) {
+        status = -1;
+    } else if (n[0]*n[1]*n[2] > 0) {
+        try {
+            fs.seekg(0, std::ios::end);
+            const dim_t fileSize = fs.tellg();
+            // one past the last byte of the block
+            const dim_t dataEnd = (f[0]+n[0] + (f[1]+n[1]-1)*d[0]
+                    + (f[2]+n[2]-1)*d[0]*d[1])*valueSize;
+            MemberIndex index;
+            if (buildMemberIndex(fs, filename, fileSize, dataEnd, index)) {
+                MemberReader reader(fs, index);
+                if (!forEachBlockRow(d, f, n, valueSize, buffer, reader))
+                    status = 1;
+            } else {
+                fs.clear();
+                fs.seekg(0, std::ios::beg);
+                boost::iostreams::filtering_istream in;
+                in.push(boost::iostreams::gzip_decompressor());
+                in.push(fs);
+                StreamReader reader(in);
+                if (!forEachBlockRow(d, f, n, valueSize, buffer, reader))
+                    status = 1;
+            }
+        } catch (boost::iostreams::gzip_error& e) {
+            zipError = "Decompressing failed with: gzip error";
+        } catch (RipleyException& e) {
+            zipError = e.what();
+        }
+    }
+
+    // failing to decompress takes precedence over failing to open the file
+    // which takes precedence over missing data
+    int error = (!zipError.empty() ? 3 : (status < 0 ? 2 : status));
+    int gError = error;
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        MPI_Allreduce(&error, &gError, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+    }
+#endif
+    if (gError == 3) {
+        if (zipError.empty())
+            zipError = "Decompressing failed on another rank";
+        throw RipleyException(zipError);
+    }
+    status = (gError == 2 ? -1 : gError);
+    return status;
+}
+#endif
+
+dim_t readBinaryBlock(escript::JMPI mpiInfo, const std::string& filename,
+                      int numDim, const dim_t* dims, const dim_t* first,
+                      const dim_t* count, int valueSize, dim_t reqsize,
+                      char* buffer)
+{
+    // pad to three dimensions so the loops below need no special cases
+    dim_t d[3] = {1, 1, 1};
+    dim_t f[3] = {0, 0, 0};
+    dim_t n[3] = {1, 1, 1};
+    for (int i = 0; i < numDim; i++) {
+        d[i] = dims[i];
+        f[i] = first[i];
+        n[i] = count[i];
+    }
+    const dim_t numValues = n[0]*n[1]*n[2];
+
+#ifdef ESYS_MPI
+    if (mpiInfo->size > 1) {
+        MPI_Info info;
+        MPI_Info_create(&info);
+        // ask ROMIO for collective buffering so the per-rank blocks are
+        // serviced by a few aggregators with large contiguous requests
+        MPI_Info_set(info, const_cast<char*>("romio_cb_read"),
+                     const_cast<char*>("enable"));
+        MPI_File fh;
+        int mpiErr = MPI_File_open(mpiInfo->comm,
+                const_cast<char*>(filename.c_str()), MPI_MODE_RDONLY, info,
+                &fh);
+        MPI_Info_free(&info);
+        if (mpiErr != MPI_SUCCESS)
+            return -1;
+
+        MPI_Offset filesize;
+        MPI_File_get_size(fh, &filesize);
+        if (filesize < reqsize) {
+            MPI_File_close(&fh);
+            return filesize;
+        }
+
+        MPI_Datatype valueType, blockType, rowType;
+        MPI_Type_contiguous(valueSize, MPI_BYTE, &valueType);
+        MPI_Type_commit(&valueType);
+        int rowCount = 0;
+        if (numValues > 0) {
+            // MPI expects the slowest varying dimension first
+            int sizes[3], subsizes[3], starts[3];
+            for (int i = 0; i < numDim; i++) {
+                sizes[numDim-1-i] = static_cast<int>(d[i]);
+                subsizes[numDim-1-i] = static_cast<int>(n[i]);
+                starts[numDim-1-i] = static_cast<int>(f[i]);
+            }
+            MPI_Type_create_subarray(numDim, sizes, subsizes, starts,
+                                     MPI_ORDER_C, valueType, &blockType);
+            MPI_Type_commit(&blockType);
+            mpiErr = MPI_File_set_view(fh, 0, valueType, blockType,
+                                const_cast<char*>("native"), MPI_INFO_NULL);
+            // read in units of rows to keep the count within int range
+            MPI_Type_contiguous(static_cast<int>(n[0]), valueType, &rowType);
+            rowCount = static_cast<int>(n[1]*n[2]);
+        } else {
+            mpiErr = MPI_File_set_view(fh, 0, valueType, valueType,
+                                const_cast<char*>("native"), MPI_INFO_NULL);
+            MPI_Type_contiguous(1, valueType, &rowType);
+        }
+        MPI_Type_commit(&rowType);
+
+        MPI_Status status;
+        int readErr = MPI_File_read_all(fh, buffer, rowCount, rowType,
+                                        &status);
+        if (mpiErr == MPI_SUCCESS)
+            mpiErr = readErr;
+        MPI_File_close(&fh);
+        MPI_Type_free(&rowType);
+        if (numValues > 0)
+            MPI_Type_free(&blockType);
+        MPI_Type_free(&valueType);
+
+        int error = (mpiErr != MPI_SUCCESS);
+        int gError;
+        MPI_Allreduce(&error, &gError, 1, MPI_INT, MPI_MAX, mpiInfo->comm);
+        if (gError)
+            throw RipleyException("readBinaryGrid(): error reading file "
+                                  + filename);
+        return filesize;
+    }
 #endif
 
+    std::ifstream fs(filename.c_str(), std::ifstream::binary);
+    if (fs.fail())
+        return -1;
+    fs.seekg(0, std::ios::end);
+    const dim_t filesize = fs.tellg();
+    if (filesize < reqsize || numValues == 0)
+        return filesize;
+
+    // if the block spans complete rows each plane is a single contiguous
+    // read, otherwise read row by row
+    const dim_t rowsPerRead = (n[0] == d[0] ? n[1] : 1);
+    for (dim_t z = 0; z < n[2]; z++) {
+        for (dim_t y = 0; y < n[1]; y += rowsPerRead) {
+            const dim_t fileofs = f[0] + (f[1]+y)*d[0] + (f[2]+z)*d[0]*d[1];
+            fs.seekg(fileofs*valueSize);
+            fs.read(buffer + (z*n[1]+y)*n[0]*valueSize,
+                    rowsPerRead*n[0]*valueSize);
+        }
+    }
+    return filesize;
+}
+
 } // namespace ripley
 
@@ -65,8 +65,48 @@ void factorise(std::vector<int>& factors, int product);
     converts the given gzip compressed char vector into an uncompressed form 
 */
 std::vector<char> unzip(const std::vector<char>& compressed);
+
+/**
+    reads the block of count[0] x count[1] (x count[2]) values starting at
+    index 'first' from a gzip compressed raw binary grid file of size
+    dims[0] x dims[1] (x dims[2]) into 'buffer' (see readBinaryBlock).
+
+    The file is never decompressed as a whole. If it consists of
+    independently compressed gzip members that record their size (BGZF as
+    written by bgzip, optionally with a .gzi index next to the file) only
+    the members overlapping the block are decompressed. Otherwise the file
+    is decompressed as a stream up to the end of the block, discarding all
+    data before it.
+
+    Returns 0 on success, -1 if the file could not be opened and 1 if the
+    decompressed data ended before the end of the block. The status is
+    agreed upon by all ranks of 'mpiInfo'.
+*/
+int readZippedBlock(escript::JMPI mpiInfo, const std::string& filename,
+                    int numDim, const dim_t* dims, const dim_t* first,
+                    const dim_t* count, int valueSize, char* buffer);
 #endif // ESYS_HAVE_BOOST_IO
 
+/**
+    reads the block of count[0] x count[1] (x count[2]) values starting at
+    index 'first' from a raw binary grid file of size dims[0] x dims[1]
+    (x dims[2]) where the first dimension varies fastest and each value
+    occupies 'valueSize' bytes. The block is stored contiguously in 'buffer'.
+
+    With MPI this is a collective operation on the communicator of 'mpiInfo':
+    every rank describes its block by a subarray file view and all ranks
+    read with a single MPI_File_read_all so the MPI-IO layer can aggregate
+    requests. Ranks that do not contribute must still call this function
+    with a zero count.
+
+    Returns the file size in bytes or -1 if the file could not be opened.
+    'buffer' is only filled if the file holds at least 'reqsize' bytes.
+*/
+dim_t readBinaryBlock(escript::JMPI mpiInfo, const std::string& filename,
+                      int numDim, const dim_t* dims, const dim_t* first,
+                      const dim_t* count, int valueSize, dim_t reqsize,
+                      char* buffer);
+
 } // namespace ripley
 
 #endif // _RIPLEY_DOMAINHELPERS_H_
@@ -20,6 +20,7 @@
 #include <ripley/MultiBrick.h>
 #include <ripley/MultiRectangle.h>
 #include <ripley/Rectangle.h>
+#include <ripley/WaveStepper.h>
 
 #include <escript/ExceptionTranslators.h>
 #include <escript/SubWorld.h>
@@ -114,6 +115,32 @@ escript::Data readBinaryGridFromZipped(std::string filename, escript::FunctionSp
 #endif
 }
 
+escript::Data readBinaryGridFromChunked(std::string filename,
+        escript::FunctionSpace fs, const object& pyShape, double fill,
+        int byteOrder, int dataType, const object& pyFirst,
+        const object& pyNum, const object& pyMultiplier,
+        const object& pyReverse)
+{
+    int dim=fs.getDim();
+    ReaderParameters params;
+
+    params.first = extractPyArray<dim_t>(pyFirst, "first", dim);
+    params.numValues = extractPyArray<dim_t>(pyNum, "numValues", dim);
+    params.multiplier = extractPyArray<int>(pyMultiplier, "multiplier", dim);
+    params.reverse = extractPyArray<int>(pyReverse, "reverse", dim);
+    params.byteOrder = byteOrder;
+    params.dataType = dataType;
+    std::vector<int> shape(extractPyArray<int>(pyShape, "shape"));
+
+    const RipleyDomain* dom=dynamic_cast<const RipleyDomain*>(fs.getDomain().get());
+    if (!dom)
+        throw RipleyException("Function space must be on a ripley domain");
+
+    escript::Data res(fill, shape, fs, true);
+    dom->readBinaryGridFromChunked(res, filename, params);
+    return res;
+}
+
 escript::Data readNcGrid(std::string filename, std::string varname,
         escript::FunctionSpace fs, const object& pyShape, double fill,
         const object& pyFirst, const object& pyNum, const object& pyMultiplier,
@@ -486,6 +513,60 @@ escript::Domain_ptr _rectangle(double _n0, double _n1, const object& l0,
                                              points, tags, tagstonames, world));
 }
 
+WaveStepper_ptr createWaveStepper(escript::Domain_ptr domain,
+        const boost::python::list& c, const escript::Data& rho,
+        const escript::Data& source, double dt)
+{
+    DataMap mapping;
+    tupleListToMap(mapping, c);
+    return WaveStepper_ptr(new WaveStepper(domain, mapping, rho, source, dt));
+}
+
+void setWaveStepperReceivers(WaveStepper& stepper, const object& receivers)
+{
+    const int dim = stepper.getNumDim();
+    std::vector<double> coords;
+    for (int i = 0; i < len(receivers); i++) {
+        const object r(receivers[i]);
+        if (len(r) != dim)
+            throw RipleyException("Receiver coordinates don't match domain dimensionality");
+        for (int j = 0; j < dim; j++)
+            coords.push_back(extract<double>(r[j]));
+    }
+    stepper.setReceivers(coords);
+}
+
+tuple runWaveStepper(WaveStepper& stepper, const object& wavelet,
+                     int receiverInterval, int snapshotInterval)
+{
+    std::vector<double> values;
+    for (int i = 0; i < len(wavelet); i++)
+        values.push_back(extract<double>(wavelet[i]));
+
+    std::vector<double> traces;
+    std::vector<escript::Data> snapshots;
+    stepper.run(values, receiverInterval, snapshotInterval, traces,
+                snapshots);
+
+    const int dim = stepper.getNumDim();
+    const dim_t numReceivers = stepper.getNumReceivers();
+    boost::python::list pyTraces;
+    for (size_t i = 0; i < traces.size(); i += numReceivers*dim) {
+        boost::python::list record;
+        for (dim_t r = 0; r < numReceivers; r++) {
+            boost::python::list value;
+            for (int j = 0; j < dim; j++)
+                value.append(traces[i+r*dim+j]);
+            record.append(tuple(value));
+        }
+        pyTraces.append(record);
+    }
+    boost::python::list pySnapshots;
+    for (size_t i = 0; i < snapshots.size(); i++)
+        pySnapshots.append(snapshots[i]);
+    return make_tuple(pyTraces, pySnapshots);
+}
+
 } // end of namespace ripley
 
 
@@ -585,6 +666,12 @@ BOOST_PYTHON_MODULE(ripleycpp)
                 arg("byteOrder"), arg("dataType"), arg("first"),
                 arg("numValues"), arg("multiplier"), arg("reverse")),
             "Reads a binary Grid");
+    def("readBinaryGridFromChunked", &ripley::readBinaryGridFromChunked,
+                (arg("filename"), arg("functionspace"), arg("shape"),
+                arg("fill")=0., arg("byteOrder"), arg("dataType"),
+                arg("first"), arg("numValues"), arg("multiplier"),
+                arg("reverse")),
+            "Reads a binary grid written by ``writeBinaryGridChunked``");
     def("_readNcGrid", &ripley::readNcGrid, (arg("filename"), arg("varname"),
                 arg("functionspace"), arg("shape"), arg("fill"), arg("first"),
                 arg("numValues"), arg("multiplier"), arg("reverse")),
@@ -596,6 +683,14 @@ BOOST_PYTHON_MODULE(ripleycpp)
                 "Prints out a summary about the mesh.\n"
                 ":param full: whether to output additional data\n:type full: ``bool``")
         .def("writeBinaryGrid", &ripley::RipleyDomain::writeBinaryGrid)
+        .def("writeBinaryGridChunked", &ripley::RipleyDomain::writeBinaryGridChunked,
+                (arg("data"), arg("filename"), arg("byteOrder"),
+                arg("dataType"), arg("compressionLevel")=6),
+                "Writes data to a chunked grid file. Each rank's block is split "
+                "into chunks which are compressed independently and written "
+                "with a single collective call.\n"
+                ":param compressionLevel: zlib compression level (1-9), 0 "
+                "stores chunks uncompressed\n:type compressionLevel: ``int``")
 
         .def("dump", &ripley::RipleyDomain::dump, args("filename"),
                 "Dumps the mesh to a file with the given name.")
@@ -698,5 +793,40 @@ BOOST_PYTHON_MODULE(ripleycpp)
     class_<ripley::MultiBrick, bases<ripley::RipleyDomain> >("RipleyMultiBrick", "", no_init);
     class_<ripley::AbstractAssembler, ripley::Assembler_ptr, boost::noncopyable >
         ("AbstractAssembler", "", no_init);
+
+    class_<ripley::WaveStepper, ripley::WaveStepper_ptr, boost::noncopyable >
+        ("WaveStepper",
+         "Explicit time stepper for the elastic wave equation using the "
+         "WaveAssembler and a lumped mass matrix.", no_init)
+        .def("__init__", make_constructor(&ripley::createWaveStepper,
+                default_call_policies(), (arg("domain"), arg("c"), arg("rho"),
+                arg("source"), arg("dt"))),
+                ":param domain: the ripley domain\n"
+                ":param c: list of (name, value) tuples of stiffness constants "
+                "as used by ``WavePDE``\n"
+                ":param rho: density\n:type rho: ``Data``\n"
+                ":param source: source orientation on ``DiracDeltaFunctions`` "
+                "or empty ``Data``\n"
+                ":param dt: time step size\n:type dt: ``float``")
+        .def("setInitialValues", &ripley::WaveStepper::setInitialValues,
+                (arg("u0"), arg("v0")),
+                "Sets initial displacement and velocity")
+        .def("setConstraint", &ripley::WaveStepper::setConstraint, args("q"),
+                "Components where ``q`` is positive are not accelerated")
+        .def("setReceivers", &ripley::setWaveStepperReceivers,
+                args("receivers"),
+                "Sets the receiver locations as a list of coordinate tuples")
+        .def("run", &ripley::runWaveStepper, (arg("wavelet"),
+                arg("receiverInterval")=1, arg("snapshotInterval")=0),
+                "Performs one time step per entry of ``wavelet`` which holds "
+                "the source amplitudes.\n"
+                ":return: tuple of receiver traces (one list of receiver "
+                "values every ``receiverInterval`` steps) and displacement "
+                "snapshots (every ``snapshotInterval`` steps)")
+        .def("getDisplacement", &ripley::WaveStepper::getDisplacement)
+        .def("getVelocity", &ripley::WaveStepper::getVelocity)
+        .def("getTime", &ripley::WaveStepper::getTime)
+        .def("getNumSteps", &ripley::WaveStepper::getNumSteps)
+        .def("getTimeStepSize", &ripley::WaveStepper::getTimeStepSize);
 }
 
@@ -407,6 +407,77 @@ class Test_readBinaryGridZippedRipley(unittest.TestCase):
             self.assertEqual(Lsup(zipped - unzipped), 0, "Data objects don't match for "+str(FS))
 
 
+class Test_chunkedBinaryGridRipley(unittest.TestCase):
+    byteorder = BYTEORDER_NATIVE
+    datatype = DATATYPE_FLOAT64
+
+    def getData(self, FS):
+        x = FS.getX()
+        data = x[0] + 10*x[1]
+        if FS.getDim() > 2:
+            data = data + 100*x[2]
+        return data
+
+    def writeThenRead(self, domain, NE, ftype, fcode, level, reader=None,
+                      readType=None):
+        # the file is read on `reader` into `readType` if given
+        reader = reader or domain
+        readType = readType or ftype
+        dim = domain.getDim()
+        filename = os.path.join(RIPLEY_WORKDIR,
+                "_cgrid%dd%s_%d.grid"%(dim, fcode, level))
+        domain.writeBinaryGridChunked(self.getData(ftype(domain)), filename,
+                self.byteorder, self.datatype, level)
+        MPIBarrierWorld()
+        NV = adjust(NE, ftype)
+        result = readBinaryGridFromChunked(filename, readType(reader), (),
+                50000, self.byteorder, self.datatype, [0]*dim, NV, [1]*dim,
+                [0]*dim)
+        data = self.getData(readType(reader))
+        self.assertAlmostEqual(Lsup(data-result), 0, delta=1e-9,
+                msg="Data doesn't match for "+str(readType(reader)))
+
+    def test_chunkedGrid2D(self):
+        NE = [10*mpiSize-1, 10]
+        domain = Rectangle(NE[0], NE[1], d1=0)
+        levels = [0, 6] if HAVE_UNZIP else [0]
+        for ftype,fcode in [(ReducedFunction,'RF'), (ContinuousFunction,'CF')]:
+            for level in levels:
+                self.writeThenRead(domain, NE, ftype, fcode, level)
+
+    def test_chunkedGrid3D(self):
+        NE = [10*mpiSize-1, 10*mpiSize-1, 10]
+        domain = Brick(NE[0], NE[1], NE[2], d2=0)
+        levels = [0, 6] if HAVE_UNZIP else [0]
+        for ftype,fcode in [(ReducedFunction,'RF'), (ContinuousFunction,'CF')]:
+            for level in levels:
+                self.writeThenRead(domain, NE, ftype, fcode, level)
+
+    # every rank writes the part of its block it owns, without the overlap
+    # with its neighbours, so the file is read with any subdivision
+    @unittest.skipIf(mpiSize < 2, "needs at least 2 MPI ranks")
+    def test_chunkedGridSubdivision2D(self):
+        NE = [10*mpiSize-1, 10*mpiSize-1]
+        writer = Rectangle(NE[0], NE[1], d0=mpiSize, d1=1)
+        reader = Rectangle(NE[0], NE[1], d0=1, d1=mpiSize)
+        for ftype,fcode in [(ReducedFunction,'RF'), (ContinuousFunction,'CF')]:
+            self.writeThenRead(writer, NE, ftype, fcode, 0)
+            self.writeThenRead(writer, NE, ftype, fcode, 0, reader)
+        self.writeThenRead(writer, NE, Solution, 'S', 0, reader,
+                           ContinuousFunction)
+
+    @unittest.skipIf(mpiSize < 2, "needs at least 2 MPI ranks")
+    def test_chunkedGridSubdivision3D(self):
+        NE = [10*mpiSize-1, 9, 10*mpiSize-1]
+        writer = Brick(NE[0], NE[1], NE[2], d0=mpiSize, d1=1, d2=1)
+        reader = Brick(NE[0], NE[1], NE[2], d0=1, d1=1, d2=mpiSize)
+        for ftype,fcode in [(ReducedFunction,'RF'), (ContinuousFunction,'CF')]:
+            self.writeThenRead(writer, NE, ftype, fcode, 0)
+            self.writeThenRead(writer, NE, ftype, fcode, 0, reader)
+        self.writeThenRead(writer, NE, Solution, 'S', 0, reader,
+                           ContinuousFunction)
+
+
 if __name__ == '__main__':
     run_tests(__name__, exit_on_failure=True)
 
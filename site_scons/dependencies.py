@@ -676,6 +676,18 @@ def checkOptionalLibraries(env):
         env['buildvars']['silo_lib_path']=silo_lib_path
     env['buildvars']['silo']=int(env['silo'])
 
+    ######## HDF5
+    hdf5_inc_path=''
+    hdf5_lib_path=''
+    if env['hdf5']:
+        hdf5_inc_path,hdf5_lib_path=findLibWithHeader(env, env['hdf5_libs'], 'hdf5.h', env['hdf5_prefix'], lang='c++')
+        env.AppendUnique(CPPPATH = [hdf5_inc_path])
+        env.AppendUnique(LIBPATH = [hdf5_lib_path])
+        env.Append(CPPDEFINES = ['ESYS_HAVE_HDF5'])
+        env['buildvars']['hdf5_inc_path']=hdf5_inc_path
+        env['buildvars']['hdf5_lib_path']=hdf5_lib_path
+    env['buildvars']['hdf5']=int(env['hdf5'])
+
     ######## VisIt
     visit_inc_path=''
     visit_lib_path=''
@@ -1368,49 +1368,49 @@ void Brick::assembleGradient(escript::Data& out, const escript::Data& in) const
 
     if (m_order == 2) {
         if (in.isComplex())
-            gradient_order2<cplx_t>(out,converted);
+            gradient_order<cplx_t,2>(out,converted);
         else
-            gradient_order2<real_t>(out,converted);
+            gradient_order<real_t,2>(out,converted);
     } else if (m_order == 3) {
         if (in.isComplex())
-            gradient_order3<cplx_t>(out,converted);
+            gradient_order<cplx_t,3>(out,converted);
         else
-            gradient_order3<real_t>(out,converted);
+            gradient_order<real_t,3>(out,converted);
     } else if (m_order == 4) {
         if (in.isComplex())
-            gradient_order4<cplx_t>(out,converted);
+            gradient_order<cplx_t,4>(out,converted);
         else
-            gradient_order4<real_t>(out,converted);
+            gradient_order<real_t,4>(out,converted);
     } else if (m_order == 5) {
         if (in.isComplex())
-            gradient_order5<cplx_t>(out,converted);
+            gradient_order<cplx_t,5>(out,converted);
         else
-            gradient_order5<real_t>(out,converted);
+            gradient_order<real_t,5>(out,converted);
     } else if (m_order == 6) {
         if (in.isComplex())
-            gradient_order6<cplx_t>(out,converted);
+            gradient_order<cplx_t,6>(out,converted);
         else
-            gradient_order6<real_t>(out,converted);
+            gradient_order<real_t,6>(out,converted);
     } else if (m_order == 7) {
         if (in.isComplex())
-            gradient_order7<cplx_t>(out,converted);
+            gradient_order<cplx_t,7>(out,converted);
         else
-            gradient_order7<real_t>(out,converted);
+            gradient_order<real_t,7>(out,converted);
     } else if (m_order == 8) {
         if (in.isComplex())
-            gradient_order8<cplx_t>(out,converted);
+            gradient_order<cplx_t,8>(out,converted);
         else
-            gradient_order8<real_t>(out,converted);
+            gradient_order<real_t,8>(out,converted);
     } else if (m_order == 9) {
         if (in.isComplex())
-            gradient_order9<cplx_t>(out,converted);
+            gradient_order<cplx_t,9>(out,converted);
         else
-            gradient_order9<real_t>(out,converted);
+            gradient_order<real_t,9>(out,converted);
     } else if (m_order == 10) {
         if (in.isComplex())
-            gradient_order10<cplx_t>(out,converted);
+            gradient_order<cplx_t,10>(out,converted);
         else
-            gradient_order10<real_t>(out,converted);
+            gradient_order<real_t,10>(out,converted);
     }
 }
 
@@ -1445,23 +1445,23 @@ void Brick::assembleIntegrateWorker(vector<Scalar>& integrals, const escript::Da
 #endif
         integrals[0] += arg.getNumberOfTaggedValues();
     } else if (m_order == 2) {
-        integral_order2(integrals, arg);
+        integral_order<Scalar,2>(integrals, arg);
     } else if (m_order == 3) {
-        integral_order3(integrals, arg);
+        integral_order<Scalar,3>(integrals, arg);
     } else if (m_order == 4) {
-        integral_order4(integrals, arg);
+        integral_order<Scalar,4>(integrals, arg);
     } else if (m_order == 5) {
-        integral_order5(integrals, arg);
+        integral_order<Scalar,5>(integrals, arg);
     } else if (m_order == 6) {
-        integral_order6(integrals, arg);
+        integral_order<Scalar,6>(integrals, arg);
     } else if (m_order == 7) {
-        integral_order7(integrals, arg);
+        integral_order<Scalar,7>(integrals, arg);
     } else if (m_order == 8) {
-        integral_order8(integrals, arg);
+        integral_order<Scalar,8>(integrals, arg);
     } else if (m_order == 9) {
-        integral_order9(integrals, arg);
+        integral_order<Scalar,9>(integrals, arg);
     } else if (m_order == 10) {
-        integral_order10(integrals, arg);
+        integral_order<Scalar,10>(integrals, arg);
     }
 }
 
@@ -1747,49 +1747,49 @@ void Brick::reduceElements(escript::Data& out, const escript::Data& in) const
 {
     if (m_order == 2) {
         if (in.isComplex())
-            reduction_order2<cplx_t>(in, out);
+            reduction_order<cplx_t,2>(in, out);
         else
-            reduction_order2<real_t>(in, out);
+            reduction_order<real_t,2>(in, out);
     } else if (m_order == 3) {
         if (in.isComplex())
-            reduction_order3<cplx_t>(in, out);
+            reduction_order<cplx_t,3>(in, out);
         else
-            reduction_order3<real_t>(in, out);
+            reduction_order<real_t,3>(in, out);
     } else if (m_order == 4) {
         if (in.isComplex())
-            reduction_order4<cplx_t>(in, out);
+            reduction_order<cplx_t,4>(in, out);
         else
-            reduction_order4<real_t>(in, out);
+            reduction_order<real_t,4>(in, out);
     } else if (m_order == 5) {
         if (in.isComplex())
-            reduction_order5<cplx_t>(in, out);
+            reduction_order<cplx_t,5>(in, out);
         else
-            reduction_order5<real_t>(in, out);
+            reduction_order<real_t,5>(in, out);
     } else if (m_order == 6) {
         if (in.isComplex())
-            reduction_order6<cplx_t>(in, out);
+            reduction_order<cplx_t,6>(in, out);
         else
-            reduction_order6<real_t>(in, out);
+            reduction_order<real_t,6>(in, out);
     } else if (m_order == 7) {
         if (in.isComplex())
-            reduction_order7<cplx_t>(in, out);
+            reduction_order<cplx_t,7>(in, out);
         else
-            reduction_order7<real_t>(in, out);
+            reduction_order<real_t,7>(in, out);
     } else if (m_order == 8) {
         if (in.isComplex())
-            reduction_order8<cplx_t>(in, out);
+            reduction_order<cplx_t,8>(in, out);
         else
-            reduction_order8<real_t>(in, out);
+            reduction_order<real_t,8>(in, out);
     } else if (m_order == 9) {
         if (in.isComplex())
-            reduction_order9<cplx_t>(in, out);
+            reduction_order<cplx_t,9>(in, out);
         else
-            reduction_order9<real_t>(in, out);
+            reduction_order<real_t,9>(in, out);
     } else if (m_order == 10) {
         if (in.isComplex())
-            reduction_order10<cplx_t>(in, out);
+            reduction_order<cplx_t,10>(in, out);
         else
-            reduction_order10<real_t>(in, out);
+            reduction_order<real_t,10>(in, out);
     }
 }
 
@@ -2909,4 +2909,17 @@ void Brick::interpolateAcross(escript::Data& target, const escript::Data& source
 #endif
 }
 
+void Brick::interpolateAcrossTransposed(escript::Data& target,
+        const escript::Data& source) const
+{
+#ifdef USE_RIPLEY
+    if (coupler == NULL) {
+        coupler = new RipleyCoupler(this, m_dx, m_mpiInfo->rank);
+    }
+    coupler->interpolateTransposed(target, source);
+#else
+    throw SpeckleyException("Speckley::Brick interpolation from unsupported domain");
+#endif
+}
+
 } // end of namespace speckley
@@ -201,6 +201,16 @@ public:
     virtual void interpolateAcross(escript::Data& target,
                                    const escript::Data& source) const;
 
+    /**
+       \brief
+       applies the transpose of the interpolation from this domain to the
+       domain of source, i.e. the adjoint of interpolateAcross. Source must
+       be given on Function of a ripley domain, target on Function of this
+       domain.
+    */
+    virtual void interpolateAcrossTransposed(escript::Data& target,
+                                   const escript::Data& source) const;
+
     /**
        \brief
        determines whether interpolation from source to target is possible
@@ -238,62 +248,14 @@ protected:
 #endif
 
 private:
-    template<typename Scalar>
-    void gradient_order2(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order3(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order4(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order5(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order6(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order7(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order8(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order9(escript::Data&, const escript::Data&) const;
-    template<typename Scalar>
-    void gradient_order10(escript::Data&, const escript::Data&) const;
+    template<typename Scalar, int Order>
+    void gradient_order(escript::Data&, const escript::Data&) const;
 
-    template<typename Scalar>
-    void reduction_order2(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order3(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order4(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order5(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order6(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order7(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order8(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order9(const escript::Data&, escript::Data&) const;
-    template<typename Scalar>
-    void reduction_order10(const escript::Data&, escript::Data&) const;
+    template<typename Scalar, int Order>
+    void reduction_order(const escript::Data&, escript::Data&) const;
 
-    template<typename Scalar>
-    void integral_order2(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order3(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order4(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order5(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order6(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order7(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order8(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order9(std::vector<Scalar>&, const escript::Data&) const;
-    template<typename Scalar>
-    void integral_order10(std::vector<Scalar>&, const escript::Data&) const; 
+    template<typename Scalar, int Order>
+    void integral_order(std::vector<Scalar>&, const escript::Data&) const;
 
     template<typename Scalar>
     void assembleIntegrateWorker(std::vector<Scalar>& integrals,
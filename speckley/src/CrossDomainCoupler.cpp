@@ -20,6 +20,8 @@
 
 #include <escript/index.h>
 
+#include <algorithm>
+
 #define MINE 1
 #define SHARED 0
 #define THEIRS -1
@@ -72,29 +74,12 @@ RipleyCoupler::RipleyCoupler(const speckley::SpeckleyDomain *speck,
 #endif
 }
 
-bool RipleyCoupler::validInterpolation(escript::Data& target,
-            const escript::Data& source,
-            const SpeckleyDomain *speck, const double *s_dx,
-            const ripley::RipleyDomain *other) const
+void RipleyCoupler::validDomains(const ripley::RipleyDomain *other) const
 {
-    if (source.getDomain().get() != speck)
-        throw SpeckleyException(
-            "ripleyCoupler: interpolation from unsupported domain");
-
     if (speck->getDim() != other->getDim())
         throw SpeckleyException(
             "ripleyCoupler: domains must have the same dimensions");
 
-    //validate functionspaces
-    const int tFS = target.getFunctionSpace().getTypeCode();
-    const int sFS = source.getFunctionSpace().getTypeCode();
-    if (sFS != Elements)
-        throw SpeckleyException(
-                "ripleyCoupler: source data must be in Function functionspace");
-    if (tFS != ripley::Elements)
-        throw SpeckleyException(
-                "ripleyCoupler: target data must be in Function functionspace");
-
     //ensure same division setup
     const int *r_NX = other->getNumSubdivisionsPerDim();
     for (int i = 0; i < speck->getDim(); i++) {
@@ -104,11 +89,6 @@ bool RipleyCoupler::validInterpolation(escript::Data& target,
         }
     }
 
-    //ensure same data shape
-    if (target.getDataPointSize() != source.getDataPointSize())
-        throw SpeckleyException(
-                "ripleyCoupler: data point size mismatch");
-
     const double *r_len = other->getLength();
     const double *s_len = speck->getLength();
     for (int i = 0; i < speck->getDim(); i++) {
@@ -127,6 +107,34 @@ bool RipleyCoupler::validInterpolation(escript::Data& target,
         throw SpeckleyException(
                 "ripleyCoupler: domain communicators are not identical");
 #endif
+}
+
+bool RipleyCoupler::validInterpolation(const escript::Data& ripleyData,
+            const escript::Data& speckleyData,
+            const ripley::RipleyDomain *other) const
+{
+    if (speckleyData.getDomain().get() != speck)
+        throw SpeckleyException(
+            "ripleyCoupler: interpolation from unsupported domain");
+
+    if (speck->getDim() != other->getDim())
+        throw SpeckleyException(
+            "ripleyCoupler: domains must have the same dimensions");
+
+    //validate functionspaces
+    const int rFS = ripleyData.getFunctionSpace().getTypeCode();
+    const int sFS = speckleyData.getFunctionSpace().getTypeCode();
+    if (sFS != Elements)
+        throw SpeckleyException(
+                "ripleyCoupler: speckley data must be in Function functionspace");
+    if (rFS != ripley::Elements)
+        throw SpeckleyException(
+                "ripleyCoupler: ripley data must be in Function functionspace");
+
+    //ensure same data shape
+    if (ripleyData.getDataPointSize() != speckleyData.getDataPointSize())
+        throw SpeckleyException(
+                "ripleyCoupler: data point size mismatch");
     return true;
 }
 
@@ -406,90 +414,40 @@ void RipleyCoupler::getEdgeSpacing(struct Ripley r, int *lower, int *upper) cons
 }
 
 
-inline void RipleyCoupler::calculate(struct Ripley& r,
-        dim_t ex, dim_t ey, dim_t ez, int oqx, int oqy, int oqz, double *out,
-        const double *factor_x, const double *factor_y, const double *factor_z,
-        const escript::Data& source) const
+void RipleyCoupler::buildOperator(const ripley::RipleyDomain *other) const
 {
-    const double x = r.domain->getLocalCoordinate(ex, 0) - speckley_origin[0]
-                + ripleyLocations[oqx]*r.dx[0];
-    const double y = r.domain->getLocalCoordinate(ey, 1) - speckley_origin[1]
-                + ripleyLocations[oqy]*r.dx[1];
-    const dim_t source_ex = x / s_dx[0];
-    const dim_t source_ey = y / s_dx[1];
-
-    if (speck->getDim() == 2) {
-        const double *sdata = source.getSampleDataRO(
-                                    INDEX2(source_ex, source_ey, s_NE[0]));
-        for (int sqy = 0; sqy < numQuads; sqy++) {
-            for (int sqx = 0; sqx < numQuads; sqx++) {
-                for (int comp = 0; comp < numComp; comp++) {
-                    out[INDEX3(comp,oqx,oqy,numComp,2)]
-                          += sdata[INDEX3(comp,sqx,sqy,numComp,numQuads)]
-                             * factor_x[sqx] * factor_y[sqy];
-                }
-            }
-        }
-    } else { //dim == 3
-        const double z = r.domain->getLocalCoordinate(ez, 2) - speckley_origin[2]
-                + ripleyLocations[oqz]*r.dx[2];
-        const dim_t source_ez = z / s_dx[2];
-        const double *sdata = source.getSampleDataRO(
-                    INDEX3(source_ex, source_ey, source_ez, s_NE[0], s_NE[1]));
-        for (int sqz = 0; sqz < numQuads; sqz++) {
-            for (int sqy = 0; sqy < numQuads; sqy++) {
-                for (int sqx = 0; sqx < numQuads; sqx++) {
-                    for (int comp = 0; comp < numComp; comp++) {
-                        out[INDEX4(comp,oqx,oqy,oqz,numComp,2,2)]
-                              += sdata[INDEX4(comp,sqx,sqy,sqz,numComp,numQuads,numQuads)]
-                                * factor_x[sqx] * factor_y[sqy] * factor_z[sqz];
-                    }
-                }
-            }
-        }
-    }
-}
-
-void RipleyCoupler::interpolate(escript::Data& target,
-        const escript::Data& source) const
-{
-    //can only interpolate to ripley right now, so check it
-    const ripley::RipleyDomain *other =
-                            dynamic_cast<const ripley::RipleyDomain *>
-                                                (target.getDomain().get());
-    if (other == NULL)
-        throw SpeckleyException("interpolation to unsupported domain");
-    validInterpolation(target, source, speck, s_dx, other); //throws if bad
+    if (!cached.expired() && cached.lock().get() == other)
+        return;
+    validDomains(other); //throws if bad
 
     //gather details from the ripley side
+    const int dim = speck->getDim();
     const dim_t *r_NE = other->getNumElementsPerDim();
     const double *r_dx = other->getElementLength();
     const dim_t *edges = other->getNumFacesPerBoundary();//left,right,bottom,top
     struct Ripley r = {other, {0,0,0},{0,0,0},{0,0,0}, {0,0,0}};
-    for (int i = 0; i < speck->getDim(); i++) {
+    for (int i = 0; i < dim; i++) {
         r.NE[i] = r_NE[i];
         r.dx[i] = r_dx[i];
         r.mins[i] =           (edges[2*i] == 0 ? 1 : 0);
         r.maxs[i] = r_NE[i] - (edges[2*i + 1] == 0 ? 1 : 0);
     }
 
-    std::vector<double> factors_x_vec(2*r.NE[0]*numQuads);
-    std::vector<double> factors_y_vec(2*r.NE[1]*numQuads);
-    std::vector<double> factors_z_vec(speck->getDim() == 3 ? 2*r.NE[2]*numQuads : numQuads, 1);
-    double *factors[3] = {&factors_x_vec[0], &factors_y_vec[0], &factors_z_vec[0]};
-    generateLocations(r, factors);
-    double *factors_x = factors[0];
-    double *factors_y = factors[1];
-    double *factors_z = factors[2];
-
-    numComp = source.getDataPointSize();
-    target.requireWrite();
+    factors[0].assign(2*r.NE[0]*numQuads, 0.);
+    factors[1].assign(2*r.NE[1]*numQuads, 0.);
+    factors[2].assign(dim == 3 ? 2*r.NE[2]*numQuads : numQuads, 1.);
+    double *positions[3] = {&factors[0][0], &factors[1][0], &factors[2][0]};
+    generateLocations(r, positions);
 
     //positional help, 0 = split, -1 = both on neighbour, 1 = both local
-    int upper[3] = {1,1,1};
-    int lower[3] = {1,1,1};
+    int *upper = edgeUpper;
+    int *lower = edgeLower;
+    for (int i = 0; i < 3; i++) {
+        upper[i] = MINE;
+        lower[i] = MINE;
+    }
     getEdgeSpacing(r, lower, upper);
-    for (int i = 0; i < speck->getDim(); i++) {
+    for (int i = 0; i < dim; i++) {
         if (hasUpper[i] && upper[i] == MINE) {
             r.maxs[i] += 1;
         }
@@ -497,35 +455,131 @@ void RipleyCoupler::interpolate(escript::Data& target,
             r.mins[i] = 0;
         }
     }
-    if (speck->getDim() == 2) {
+    if (dim == 2) {
         r.mins[2] = 0;
         r.maxs[2] = 1;
     }
-    //end of setup
 
     const dim_t xmin = (lower[0] == SHARED) ? 1 : (lower[0] == MINE) ? 0 : 2;
     const dim_t xmax = r.NE[0]*2 - ((upper[0] == SHARED) ? 1 : (upper[0] == MINE) ? 0 : 2);
     const dim_t ymin = (lower[1] == SHARED) ? 1 : (lower[1] == MINE) ? 0 : 2;
     const dim_t ymax = r.NE[1]*2 - ((upper[1] == SHARED) ? 1 : (upper[1] == MINE) ? 0 : 2);
-    const dim_t zmin = (speck->getDim() == 1) ? 1 : (lower[2] == SHARED) ? 1 : (lower[2] == MINE) ? 0 : 2;
-    const dim_t zmax = r.NE[2]*2 - ((speck->getDim() == 2) ? -1 : ((upper[2] == SHARED) ? 1 : (upper[2] == MINE) ? 0 : 2));
-
-    // inefficient cache use, but the alternative isn't simple
+    const dim_t zmin = (dim == 2) ? 0 : (lower[2] == SHARED) ? 1 : (lower[2] == MINE) ? 0 : 2;
+    const dim_t zmax = (dim == 2) ? 1 : r.NE[2]*2 - ((upper[2] == SHARED) ? 1 : (upper[2] == MINE) ? 0 : 2);
+
+    // one row per ripley quadrature point that lies in a local speckley
+    // element, the remaining points are filled in by the neighbours
+    rowTarget.clear();
+    rowQuad.clear();
+    rowSource.clear();
+    rowFactors.clear();
     for (dim_t z = zmin; z < zmax; z++) {
         const dim_t ez = z/2;
         const int oqz = z%2;
-        double *precalc_z = factors_z + z * numQuads;
-#pragma omp parallel for
+        dim_t source_ez = 0;
+        if (dim == 3) {
+            const double loc = r.domain->getLocalCoordinate(ez, 2)
+                    - speckley_origin[2] + ripleyLocations[oqz]*r.dx[2];
+            source_ez = loc / s_dx[2];
+        }
         for (dim_t y = ymin; y < ymax; y++) {
             const dim_t ey = y/2;
-            const dim_t oqy = y%2;
-            double *precalc_y = factors_y + y * numQuads;
+            const int oqy = y%2;
+            const double yloc = r.domain->getLocalCoordinate(ey, 1)
+                    - speckley_origin[1] + ripleyLocations[oqy]*r.dx[1];
+            const dim_t source_ey = yloc / s_dx[1];
             for (dim_t x = xmin; x < xmax; x++) {
                 const dim_t ex = x/2;
-                const dim_t oqx = x%2;
-                double *precalc_x = factors_x + x * numQuads;
-                double *out = target.getSampleDataRW(INDEX3(ex,ey,ez,r.NE[0],r.NE[1]));
-                calculate(r, ex, ey, ez, oqx, oqy, oqz, out, precalc_x, precalc_y, precalc_z, source);
+                const int oqx = x%2;
+                const double xloc = r.domain->getLocalCoordinate(ex, 0)
+                        - speckley_origin[0] + ripleyLocations[oqx]*r.dx[0];
+                const dim_t source_ex = xloc / s_dx[0];
+                rowTarget.push_back(INDEX3(ex, ey, ez, r.NE[0], r.NE[1]));
+                rowQuad.push_back(oqx + 2*oqy + 4*oqz);
+                rowSource.push_back(INDEX3(source_ex, source_ey, source_ez,
+                                           s_NE[0], s_NE[1]));
+                rowFactors.push_back(x*numQuads);
+                rowFactors.push_back(y*numQuads);
+                rowFactors.push_back(z*numQuads);
+            }
+        }
+    }
+
+    // group the rows by source element
+    const dim_t numRows = rowTarget.size();
+    const dim_t numElements = s_NE[0]*s_NE[1]*(dim == 3 ? s_NE[2] : 1);
+    sourceOffsets.assign(numElements+1, 0);
+    for (index_t i = 0; i < numRows; i++)
+        sourceOffsets[rowSource[i]+1]++;
+    for (index_t e = 0; e < numElements; e++)
+        sourceOffsets[e+1] += sourceOffsets[e];
+    std::vector<index_t> pos(sourceOffsets.begin(), sourceOffsets.end()-1);
+    sourceRows.resize(numRows);
+    for (index_t i = 0; i < numRows; i++)
+        sourceRows[pos[rowSource[i]]++] = i;
+
+    rInfo = r;
+    cached = other->getPtr();
+}
+
+void RipleyCoupler::interpolate(escript::Data& target,
+        const escript::Data& source) const
+{
+    //can only interpolate to ripley right now, so check it
+    const ripley::RipleyDomain *other =
+                            dynamic_cast<const ripley::RipleyDomain *>
+                                                (target.getDomain().get());
+    if (other == NULL)
+        throw SpeckleyException("interpolation to unsupported domain");
+    validInterpolation(target, source, other); //throws if bad
+    buildOperator(other);
+
+    escript::Data in(source);
+    in.expand();
+    numComp = in.getDataPointSize();
+    target.requireWrite();
+    const dim_t numRows = rowTarget.size();
+
+    if (speck->getDim() == 2) {
+#pragma omp parallel for
+        for (index_t i = 0; i < numRows; i++) {
+            const double *factor_x = &factors[0][rowFactors[3*i]];
+            const double *factor_y = &factors[1][rowFactors[3*i+1]];
+            const double *sdata = in.getSampleDataRO(rowSource[i]);
+            double *out = target.getSampleDataRW(rowTarget[i])
+                                + rowQuad[i]*numComp;
+            for (int comp = 0; comp < numComp; comp++)
+                out[comp] = 0.;
+            for (int sqy = 0; sqy < numQuads; sqy++) {
+                for (int sqx = 0; sqx < numQuads; sqx++) {
+                    const double w = factor_x[sqx] * factor_y[sqy];
+                    for (int comp = 0; comp < numComp; comp++) {
+                        out[comp] += sdata[INDEX3(comp,sqx,sqy,numComp,numQuads)] * w;
+                    }
+                }
+            }
+        }
+    } else { //dim == 3
+#pragma omp parallel for
+        for (index_t i = 0; i < numRows; i++) {
+            const double *factor_x = &factors[0][rowFactors[3*i]];
+            const double *factor_y = &factors[1][rowFactors[3*i+1]];
+            const double *factor_z = &factors[2][rowFactors[3*i+2]];
+            const double *sdata = in.getSampleDataRO(rowSource[i]);
+            double *out = target.getSampleDataRW(rowTarget[i])
+                                + rowQuad[i]*numComp;
+            for (int comp = 0; comp < numComp; comp++)
+                out[comp] = 0.;
+            for (int sqz = 0; sqz < numQuads; sqz++) {
+                for (int sqy = 0; sqy < numQuads; sqy++) {
+                    const double wyz = factor_y[sqy] * factor_z[sqz];
+                    for (int sqx = 0; sqx < numQuads; sqx++) {
+                        const double w = factor_x[sqx] * wyz;
+                        for (int comp = 0; comp < numComp; comp++) {
+                            out[comp] += sdata[INDEX4(comp,sqx,sqy,sqz,numComp,numQuads,numQuads)] * w;
+                        }
+                    }
+                }
             }
         }
     }
@@ -534,18 +588,71 @@ void RipleyCoupler::interpolate(escript::Data& target,
         return;
     }
 
+    struct Ripley& r = rInfo;
     if (speck->getDim() == 2) {
         if (hasLower[0] || hasUpper[0])
-            shareRectangleXEdges(r, hasLower[0], hasUpper[0], lower[0], upper[0], target);
+            shareRectangleXEdges(r, hasLower[0], hasUpper[0], edgeLower[0], edgeUpper[0], target);
         if (hasLower[1] || hasUpper[1])
-            shareRectangleYEdges(r, hasLower[1], hasUpper[1], lower[1], upper[1], target);
+            shareRectangleYEdges(r, hasLower[1], hasUpper[1], edgeLower[1], edgeUpper[1], target);
     } else {
         if (hasLower[0] || hasUpper[0])
-            shareBrickXFaces(r, hasLower[0], hasUpper[0], lower[0], upper[0], target);
+            shareBrickXFaces(r, hasLower[0], hasUpper[0], edgeLower[0], edgeUpper[0], target);
         if (hasLower[1] || hasUpper[1])
-            shareBrickYFaces(r, hasLower[1], hasUpper[1], lower[1], upper[1], target);
+            shareBrickYFaces(r, hasLower[1], hasUpper[1], edgeLower[1], edgeUpper[1], target);
         if (hasLower[2] || hasUpper[2])
-            shareBrickZFaces(r, hasLower[2], hasUpper[2], lower[2], upper[2], target);
+            shareBrickZFaces(r, hasLower[2], hasUpper[2], edgeLower[2], edgeUpper[2], target);
+    }
+}
+
+void RipleyCoupler::interpolateTransposed(escript::Data& target,
+        const escript::Data& source) const
+{
+    const ripley::RipleyDomain *other =
+                            dynamic_cast<const ripley::RipleyDomain *>
+                                                (source.getDomain().get());
+    if (other == NULL)
+        throw SpeckleyException("interpolation from unsupported domain");
+    validInterpolation(source, target, other); //throws if bad
+    buildOperator(other);
+
+    // every ripley quadrature point is computed by exactly one rank so
+    // no communication is required as long as the overlap is consistent
+    escript::Data in(source);
+    in.expand();
+    numComp = in.getDataPointSize();
+    target.expand();
+    target.requireWrite();
+    const int dim = speck->getDim();
+    const dim_t numElements = sourceOffsets.size() - 1;
+    const int pointsPerElement = (dim == 2 ? numQuads*numQuads
+                                           : numQuads*numQuads*numQuads);
+
+#pragma omp parallel for
+    for (index_t e = 0; e < numElements; e++) {
+        double *out = target.getSampleDataRW(e);
+        std::fill(out, out + pointsPerElement*numComp, 0.);
+        for (index_t j = sourceOffsets[e]; j < sourceOffsets[e+1]; j++) {
+            const index_t i = sourceRows[j];
+            const double *factor_x = &factors[0][rowFactors[3*i]];
+            const double *factor_y = &factors[1][rowFactors[3*i+1]];
+            const double *factor_z = &factors[2][rowFactors[3*i+2]];
+            const double *rdata = in.getSampleDataRO(rowTarget[i])
+                                        + rowQuad[i]*numComp;
+            const int numQuadsZ = (dim == 2 ? 1 : numQuads);
+            for (int sqz = 0; sqz < numQuadsZ; sqz++) {
+                for (int sqy = 0; sqy < numQuads; sqy++) {
+                    const double wyz = factor_y[sqy]
+                                        * (dim == 2 ? 1. : factor_z[sqz]);
+                    for (int sqx = 0; sqx < numQuads; sqx++) {
+                        const double w = factor_x[sqx] * wyz;
+                        double *dest = &out[INDEX4(0,sqx,sqy,sqz,numComp,numQuads,numQuads)];
+                        for (int comp = 0; comp < numComp; comp++) {
+                            dest[comp] += rdata[comp] * w;
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
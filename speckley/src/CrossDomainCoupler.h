@@ -24,6 +24,8 @@
 #include <ripley/Brick.h>
 #include <ripley/Rectangle.h>
 
+#include <boost/weak_ptr.hpp>
+
 namespace speckley {
 
 class RipleyCoupler {
@@ -31,7 +33,25 @@ public:
     RipleyCoupler(const SpeckleyDomain *speck, const double s_dx[2], int rank);
 
 
+    /**
+       \brief
+       interpolates 'source', given on Function of the speckley domain, onto
+       'target' on Function of a ripley domain. The interpolation operator is
+       built on first use for a ripley domain and reused for as long as
+       target data lives on the same domain.
+    */
     void interpolate(escript::Data& target, const escript::Data& source) const;
+
+    /**
+       \brief
+       applies the transpose of the interpolation operator to 'source', given
+       on Function of a ripley domain, and stores the result in 'target' on
+       Function of the speckley domain. Values on overlapping ripley elements
+       are expected to agree between ranks, as they do for data produced by
+       ripley itself.
+    */
+    void interpolateTransposed(escript::Data& target,
+                               const escript::Data& source) const;
 private:
     // a struct type to hold all the relevant info on the target domain
     struct Ripley {
@@ -53,13 +73,13 @@ private:
 
     void generateLocations(struct Ripley& r, double **positions) const;
 
-    bool validInterpolation(escript::Data& target, const escript::Data& source,
-            const SpeckleyDomain *speck, const double *s_dx,
+    bool validInterpolation(const escript::Data& ripleyData,
+            const escript::Data& speckleyData,
             const ripley::RipleyDomain *other) const;
-    void calculate(struct Ripley& r, dim_t ex, dim_t ey, dim_t ez,
-            int oqx, int oqy, int oqz, double *out, const double *factor_x,
-            const double *factor_y, const double *factor_z,
-            const escript::Data& source) const;
+
+    // (re)builds the cached operator if 'other' is not the cached domain
+    void buildOperator(const ripley::RipleyDomain *other) const;
+    void validDomains(const ripley::RipleyDomain *other) const;
 
     void shareWithNeighbours(bool lowerFirst, int hasLower, int hasUpper,
             double *bottom, double *top, double *brecv, double *trecv,
@@ -94,6 +114,23 @@ private:
     //per interpolation
     mutable int numComp;
 
+    //cached interpolation operator, valid for the ripley domain 'cached'
+    mutable REFCOUNTNS::weak_ptr<const escript::AbstractDomain> cached;
+    mutable struct Ripley rInfo;
+    mutable int edgeLower[3];
+    mutable int edgeUpper[3];
+    // 1D Lagrange weights per ripley quadrature point along each axis
+    mutable std::vector<double> factors[3];
+    // one row per locally computed ripley quadrature point: target sample,
+    // target quadrature point, source element and offsets into 'factors'
+    mutable std::vector<index_t> rowTarget;
+    mutable std::vector<int> rowQuad;
+    mutable std::vector<index_t> rowSource;
+    mutable std::vector<index_t> rowFactors;
+    // rows grouped by source element for the transposed application
+    mutable std::vector<index_t> sourceOffsets;
+    mutable std::vector<index_t> sourceRows;
+
 #ifdef ESYS_MPI
     int rank;
     MPI_Comm comm;
@@ -76,6 +76,10 @@ struct DiracPoint
     int tag;
 };
 
+/// converts a python list of (name, Data) tuples into a DataMap
+Speckley_DLL_API
+void tupleListToMap(DataMap& mapping, const boost::python::list& list);
+
 /**
    \brief
    SpeckleyDomain extends the AbstractContinuousDomain interface
@@ -84,6 +88,8 @@ struct DiracPoint
 
 class Speckley_DLL_API SpeckleyDomain : public escript::AbstractContinuousDomain
 {
+    friend class WaveStepper;
+
 public:
     /**
        \brief
@@ -272,6 +278,16 @@ public:
     virtual void interpolateAcross(escript::Data& target,
                                    const escript::Data& source) const = 0;
 
+    /**
+       \brief
+       applies the transpose of the interpolation from this domain to the
+       domain of source, i.e. the adjoint of interpolateAcross. Source must
+       be given on Function of a ripley domain, target on Function of this
+       domain.
+    */
+    virtual void interpolateAcrossTransposed(escript::Data& target,
+                                   const escript::Data& source) const = 0;
+
     /**
        \brief
        determines whether interpolation from source to target is possible
@@ -0,0 +1,286 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include <speckley/WaveStepper.h>
+
+#include <escript/FunctionSpace.h>
+
+#include <sstream>
+
+using escript::Data;
+using escript::FunctionSpace;
+using escript::ValueError;
+
+using std::string;
+using std::vector;
+
+namespace speckley {
+
+WaveStepper::WaveStepper(escript::const_Domain_ptr domain, const DataMap& c,
+                         const Data& rho, const Data& source, double dt) :
+    m_dt(dt),
+    m_time(0.),
+    m_numSteps(0),
+    m_numReceivers(0)
+{
+    m_domain = REFCOUNTNS::dynamic_pointer_cast<const SpeckleyDomain>(domain);
+    if (!m_domain)
+        throw ValueError("WaveStepper: domain must be a speckley domain");
+    if (dt <= 0.)
+        throw ValueError("WaveStepper: time step size must be positive");
+
+    // the assembler checks the constants
+    m_assembler = m_domain->createAssembler("WaveAssembler", c);
+    if (rho.isEmpty() || rho.getDataPointRank() != 0)
+        throw ValueError("WaveStepper: density must be a scalar");
+
+    m_mpiInfo = m_domain->getMPI();
+    m_numDim = m_domain->getDim();
+    m_numNodes = m_domain->getNumNodes();
+
+    const escript::DataTypes::ShapeType vectorShape(1, m_numDim);
+    const escript::DataTypes::ShapeType tensorShape(2, m_numDim);
+    const FunctionSpace nodes(domain, Nodes);
+    const FunctionSpace elements(domain, Elements);
+    const FunctionSpace solution(domain, m_domain->getSolutionCode());
+
+    m_uNodes = Data(0., vectorShape, nodes, true);
+    m_uElements = Data(0., vectorShape, elements, true);
+    m_rhs = Data(0., vectorShape, nodes, true);
+    m_coefs["du"] = Data(0., tensorShape, elements, true);
+
+    // the quadrature points coincide with the nodes so integrating rho times
+    // the basis functions yields the diagonal mass matrix directly
+    Data Y = Data(rho, elements) * Data(1., vectorShape, elements, true);
+    Y.expand();
+    DataMap massCoefs;
+    massCoefs["Y"] = Y;
+    Data mass(0., vectorShape, nodes, true);
+    m_assembler->assemblePDESystem(NULL, mass, massCoefs);
+    sumSharedNodes(mass);
+
+    const dim_t numValues = m_numNodes*m_numDim;
+    m_invMass.resize(numValues);
+    int badMass = 0;
+    const double* mass_p = mass.getSampleDataRO(0);
+    for (index_t i = 0; i < numValues; i++) {
+        if (mass_p[i] > 0.)
+            m_invMass[i] = 1./mass_p[i];
+        else
+            badMass = 1;
+    }
+#ifdef ESYS_MPI
+    if (m_mpiInfo->size > 1) {
+        int localBad = badMass;
+        MPI_Allreduce(&localBad, &badMass, 1, MPI_INT, MPI_MAX,
+                      m_mpiInfo->comm);
+    }
+#endif
+    if (badMass)
+        throw ValueError("WaveStepper: mass matrix is not positive");
+
+    m_source.assign(numValues, 0.);
+    if (!source.isEmpty()) {
+        if (source.getDataPointSize() != m_numDim)
+            throw ValueError("WaveStepper: source must be a vector");
+        Data sourceRHS(0., vectorShape, solution, true);
+        DataMap sourceCoefs;
+        sourceCoefs["y_dirac"] = source;
+        m_domain->addToRHS(sourceRHS, sourceCoefs, m_assembler);
+        fromData(m_source, sourceRHS);
+    }
+
+    m_u.assign(numValues, 0.);
+    m_v.assign(numValues, 0.);
+    m_accel.assign(numValues, 0.);
+    m_fixed.assign(numValues, 0);
+}
+
+void WaveStepper::setInitialValues(const Data& u0, const Data& v0)
+{
+    if (u0.isEmpty())
+        m_u.assign(m_u.size(), 0.);
+    else
+        fromData(m_u, u0);
+    if (v0.isEmpty())
+        m_v.assign(m_v.size(), 0.);
+    else
+        fromData(m_v, v0);
+}
+
+void WaveStepper::setConstraint(const Data& q)
+{
+    if (q.isEmpty()) {
+        m_fixed.assign(m_fixed.size(), 0);
+        return;
+    }
+    vector<double> mask(m_fixed.size());
+    fromData(mask, q);
+    for (size_t i = 0; i < mask.size(); i++)
+        m_fixed[i] = (mask[i] > 0. ? 1 : 0);
+}
+
+void WaveStepper::setReceivers(const vector<double>& coords)
+{
+    if (coords.size() % m_numDim != 0)
+        throw ValueError("WaveStepper: receiver coordinates don't match "
+                         "domain dimensionality");
+    m_numReceivers = coords.size() / m_numDim;
+    m_receivers.clear();
+    vector<int> found(m_numReceivers, 0);
+    for (dim_t r = 0; r < m_numReceivers; r++) {
+        const dim_t node = m_domain->findNode(&coords[r*m_numDim]);
+        // nodes on rank boundaries exist on all neighbours but only one of
+        // them records the receiver
+        if (node >= 0 && m_domain->ownSample(Nodes, node)) {
+            m_receivers.push_back(std::make_pair(r, node));
+            found[r] = 1;
+        }
+    }
+#ifdef ESYS_MPI
+    if (m_mpiInfo->size > 1 && m_numReceivers > 0) {
+        vector<int> local(found);
+        MPI_Allreduce(&local[0], &found[0], m_numReceivers, MPI_INT,
+                      MPI_SUM, m_mpiInfo->comm);
+    }
+#endif
+    for (dim_t r = 0; r < m_numReceivers; r++) {
+        if (found[r] == 0) {
+            m_receivers.clear();
+            m_numReceivers = 0;
+            std::stringstream msg;
+            msg << "WaveStepper: receiver " << r << " is outside the domain";
+            throw ValueError(msg.str());
+        }
+    }
+}
+
+void WaveStepper::run(const vector<double>& wavelet, int receiverInterval,
+                      int snapshotInterval, vector<double>& traces,
+                      vector<Data>& snapshots)
+{
+    const dim_t numSteps = wavelet.size();
+    const dim_t numValues = m_numNodes*m_numDim;
+    const dim_t recordSize = m_numReceivers*m_numDim;
+    const dim_t numRecords = (receiverInterval > 0 ?
+            (m_numSteps+numSteps)/receiverInterval - m_numSteps/receiverInterval
+            : 0);
+    // receiver values are combined across ranks once at the end
+    vector<double> records(numRecords*recordSize, 0.);
+    dim_t record = 0;
+
+    for (dim_t n = 0; n < numSteps; n++) {
+        computeAcceleration(wavelet[n]);
+#pragma omp parallel for
+        for (index_t i = 0; i < numValues; i++) {
+            m_v[i] += m_dt*m_accel[i];
+            m_u[i] += m_dt*m_v[i];
+        }
+        m_time += m_dt;
+        m_numSteps++;
+
+        if (receiverInterval > 0 && m_numSteps % receiverInterval == 0) {
+            if (recordSize > 0)
+                sampleReceivers(&records[record*recordSize]);
+            record++;
+        }
+        if (snapshotInterval > 0 && m_numSteps % snapshotInterval == 0)
+            snapshots.push_back(getDisplacement());
+    }
+
+#ifdef ESYS_MPI
+    if (m_mpiInfo->size > 1 && !records.empty()) {
+        MPI_Allreduce(MPI_IN_PLACE, &records[0], records.size(), MPI_DOUBLE,
+                      MPI_SUM, m_mpiInfo->comm);
+    }
+#endif
+    traces.insert(traces.end(), records.begin(), records.end());
+}
+
+Data WaveStepper::getDisplacement() const
+{
+    return toData(m_u);
+}
+
+Data WaveStepper::getVelocity() const
+{
+    return toData(m_v);
+}
+
+void WaveStepper::computeAcceleration(double f)
+{
+    // every rank holds all nodes of its elements so no halo exchange is
+    // required before the element loops
+    m_uNodes.requireWrite();
+    std::copy(m_u.begin(), m_u.end(), m_uNodes.getSampleDataRW(0));
+    m_domain->interpolateNodesOnElements(m_uElements, m_uNodes, false);
+    m_domain->assembleGradient(m_coefs["du"], m_uElements);
+    m_rhs.setToZero();
+    m_assembler->assemblePDESystem(NULL, m_rhs, m_coefs);
+    sumSharedNodes(m_rhs);
+
+    const dim_t numValues = m_numNodes*m_numDim;
+    const double* F = m_rhs.getSampleDataRO(0);
+#pragma omp parallel for
+    for (index_t i = 0; i < numValues; i++) {
+        m_accel[i] = (m_fixed[i] ? 0. :
+                m_invMass[i]*(F[i] + f*m_source[i]));
+    }
+}
+
+void WaveStepper::sumSharedNodes(Data& data) const
+{
+#ifdef ESYS_MPI
+    m_domain->balanceNeighbours(data, false);
+#endif
+}
+
+void WaveStepper::sampleReceivers(double* out) const
+{
+    for (size_t i = 0; i < m_receivers.size(); i++) {
+        const double* src = &m_u[m_receivers[i].second*m_numDim];
+        std::copy(src, src+m_numDim, &out[m_receivers[i].first*m_numDim]);
+    }
+}
+
+Data WaveStepper::toData(const vector<double>& values) const
+{
+    // Nodes and DegreesOfFreedom share the same layout in speckley
+    const FunctionSpace solution(m_domain, m_domain->getSolutionCode());
+    Data out(0., escript::DataTypes::ShapeType(1, m_numDim), solution, true);
+    out.requireWrite();
+    if (!values.empty())
+        std::copy(values.begin(), values.end(), out.getSampleDataRW(0));
+    return out;
+}
+
+void WaveStepper::fromData(vector<double>& values, const Data& in) const
+{
+    if (in.getDataPointSize() != m_numDim)
+        throw ValueError("WaveStepper: expected vector data");
+    const FunctionSpace nodes(m_domain, Nodes);
+    Data tmp(in, nodes);
+    tmp.expand();
+    values.resize(m_numNodes*m_numDim);
+    for (index_t i = 0; i < m_numNodes; i++) {
+        const double* src = tmp.getSampleDataRO(i);
+        std::copy(src, src+m_numDim, &values[i*m_numDim]);
+    }
+}
+
+} // namespace speckley
+
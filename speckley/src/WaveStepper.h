@@ -0,0 +1,167 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __SPECKLEY_WAVESTEPPER_H__
+#define __SPECKLEY_WAVESTEPPER_H__
+
+#include <speckley/SpeckleyDomain.h>
+
+namespace speckley {
+
+class WaveStepper;
+
+typedef POINTER_WRAPPER_CLASS(WaveStepper) WaveStepper_ptr;
+
+/**
+   \brief
+   Explicit time integration of the elastic wave equation
+
+        rho u_tt = div(sigma(grad(u))) + f(t) * r
+
+   on a speckley domain using the WaveAssembler for the stiffness action and
+   the diagonal mass matrix given by the Gauss-Lobatto-Legendre quadrature.
+   The scheme is the same as the one used by the downunder wave classes:
+
+        a_n = M^-1 (F(u_{n-1}) + f(t_{n-1}) * R)
+        v_n = v_{n-1} + dt * a_n
+        u_n = u_{n-1} + dt * v_n
+
+   The inverse mass, the source vector R and all work arrays are
+   assembled/allocated once, so every step only consists of the nodes to
+   elements interpolation, the gradient, the WaveAssembler's du-assembly and
+   the summation of contributions to nodes shared with neighbouring ranks.
+*/
+class Speckley_DLL_API WaveStepper
+{
+public:
+    /**
+       \brief
+       Creates a new stepper.
+       \param domain the speckley domain
+       \param c the stiffness constants as accepted by the WaveAssembler
+       \param rho density, must be interpolatable to Function
+       \param source the source orientation on DiracDeltaFunctions (may be
+                     empty)
+       \param dt the time step size
+    */
+    WaveStepper(escript::const_Domain_ptr domain, const DataMap& c,
+                const escript::Data& rho, const escript::Data& source,
+                double dt);
+
+    ~WaveStepper() {}
+
+    /**
+       \brief
+       sets displacement and velocity. Both are reset to zero by default.
+    */
+    void setInitialValues(const escript::Data& u0, const escript::Data& v0);
+
+    /**
+       \brief
+       sets the constraint mask. Components where q is positive are not
+       accelerated, i.e. they keep their initial velocity.
+    */
+    void setConstraint(const escript::Data& q);
+
+    /**
+       \brief
+       sets the receiver locations. 'coords' holds numDim coordinates per
+       receiver. Receivers are snapped to the closest element corner.
+    */
+    void setReceivers(const std::vector<double>& coords);
+
+    /**
+       \brief
+       performs wavelet.size() time steps, the source amplitude for step i
+       being wavelet[i]. Every 'receiverInterval' steps the displacement at
+       all receivers is appended to 'traces' (numDim values per receiver),
+       every 'snapshotInterval' steps a copy of the displacement is appended
+       to 'snapshots'. Intervals smaller than 1 disable recording.
+       Must be called on all ranks.
+    */
+    void run(const std::vector<double>& wavelet, int receiverInterval,
+             int snapshotInterval, std::vector<double>& traces,
+             std::vector<escript::Data>& snapshots);
+
+    /// returns the current displacement
+    escript::Data getDisplacement() const;
+
+    /// returns the current velocity
+    escript::Data getVelocity() const;
+
+    /// returns the current time
+    double getTime() const { return m_time; }
+
+    /// returns the number of steps performed so far
+    dim_t getNumSteps() const { return m_numSteps; }
+
+    /// returns the time step size
+    double getTimeStepSize() const { return m_dt; }
+
+    /// returns the number of spatial dimensions
+    int getNumDim() const { return m_numDim; }
+
+    /// returns the number of receivers
+    dim_t getNumReceivers() const { return m_numReceivers; }
+
+private:
+    /// computes the acceleration for source amplitude 'f' into m_accel
+    void computeAcceleration(double f);
+
+    /// sums contributions to nodes shared with neighbouring ranks
+    void sumSharedNodes(escript::Data& data) const;
+
+    /// copies displacement values at owned receivers into 'out'
+    void sampleReceivers(double* out) const;
+
+    /// creates a Solution Data object holding a copy of 'values'
+    escript::Data toData(const std::vector<double>& values) const;
+
+    /// copies the values of 'in' interpolated to Nodes into 'values'
+    void fromData(std::vector<double>& values, const escript::Data& in) const;
+
+    POINTER_WRAPPER_CLASS(const SpeckleyDomain) m_domain;
+    escript::JMPI m_mpiInfo;
+    Assembler_ptr m_assembler;
+    int m_numDim;
+    dim_t m_numNodes;
+    double m_dt;
+    double m_time;
+    dim_t m_numSteps;
+
+    std::vector<double> m_u;
+    std::vector<double> m_v;
+    std::vector<double> m_accel;
+    std::vector<double> m_invMass;
+    std::vector<double> m_source;
+    std::vector<char> m_fixed;
+
+    escript::Data m_uNodes;
+    escript::Data m_uElements;
+    escript::Data m_rhs;
+    /// holds "du" only, the gradient is written in place every step
+    DataMap m_coefs;
+
+    dim_t m_numReceivers;
+    /// receiver index and node of receivers owned by this rank
+    std::vector<std::pair<dim_t, index_t> > m_receivers;
+};
+
+} // namespace speckley
+
+#endif // __SPECKLEY_WAVESTEPPER_H__
+
@@ -18,6 +18,7 @@
 #include <speckley/AbstractAssembler.h>
 #include <speckley/Brick.h>
 #include <speckley/Rectangle.h>
+#include <speckley/WaveStepper.h>
 
 #include <escript/ExceptionTranslators.h>
 #include <escript/SubWorld.h>
@@ -313,6 +314,69 @@ escript::Domain_ptr _rectangle(int order, double _n0, double _n1,
                                              points, tags, tagstonames, world));
 }
 
+escript::Data interpolateAcrossTransposed(const SpeckleyDomain& domain,
+                                          const escript::Data& source)
+{
+    escript::Data target(0., source.getDataPointShape(),
+            escript::FunctionSpace(domain.getPtr(), Elements), true);
+    domain.interpolateAcrossTransposed(target, source);
+    return target;
+}
+
+WaveStepper_ptr createWaveStepper(escript::Domain_ptr domain,
+        const boost::python::list& c, const escript::Data& rho,
+        const escript::Data& source, double dt)
+{
+    DataMap mapping;
+    tupleListToMap(mapping, c);
+    return WaveStepper_ptr(new WaveStepper(domain, mapping, rho, source, dt));
+}
+
+void setWaveStepperReceivers(WaveStepper& stepper, const object& receivers)
+{
+    const int dim = stepper.getNumDim();
+    std::vector<double> coords;
+    for (int i = 0; i < len(receivers); i++) {
+        const object r(receivers[i]);
+        if (len(r) != dim)
+            throw SpeckleyException("Receiver coordinates don't match domain dimensionality");
+        for (int j = 0; j < dim; j++)
+            coords.push_back(extract<double>(r[j]));
+    }
+    stepper.setReceivers(coords);
+}
+
+tuple runWaveStepper(WaveStepper& stepper, const object& wavelet,
+                     int receiverInterval, int snapshotInterval)
+{
+    std::vector<double> values;
+    for (int i = 0; i < len(wavelet); i++)
+        values.push_back(extract<double>(wavelet[i]));
+
+    std::vector<double> traces;
+    std::vector<escript::Data> snapshots;
+    stepper.run(values, receiverInterval, snapshotInterval, traces,
+                snapshots);
+
+    const int dim = stepper.getNumDim();
+    const dim_t numReceivers = stepper.getNumReceivers();
+    boost::python::list pyTraces;
+    for (size_t i = 0; i < traces.size(); i += numReceivers*dim) {
+        boost::python::list record;
+        for (dim_t r = 0; r < numReceivers; r++) {
+            boost::python::list value;
+            for (int j = 0; j < dim; j++)
+                value.append(traces[i+r*dim+j]);
+            record.append(tuple(value));
+        }
+        pyTraces.append(record);
+    }
+    boost::python::list pySnapshots;
+    for (size_t i = 0; i < snapshots.size(); i++)
+        pySnapshots.append(snapshots[i]);
+    return make_tuple(pyTraces, pySnapshots);
+}
+
 } // end of namespace speckley
 
 
@@ -411,6 +475,12 @@ BOOST_PYTHON_MODULE(speckleycpp)
             "results depends on domain\n\n"
             ":param rhs:\n:type rhs: `Data`\n"
             ":param data:\n:type data: `list`")
+        .def("interpolateAcrossTransposed", &speckley::interpolateAcrossTransposed,
+            args("source"),
+            "applies the transpose of the interpolation from Function of this "
+            "domain to Function of a ripley domain, e.g. to compute adjoints\n\n"
+            ":param source: data on Function of a ripley domain\n:type source: `Data`\n"
+            ":return: data on Function of this domain\n:rtype: `Data`")
         .def("getOrder",&speckley::SpeckleyDomain::getOrder,
             ":return: the order of the domain\n"
             ":rtype: ``int``")
@@ -464,5 +534,41 @@ args("options"),
     class_<speckley::Rectangle, bases<speckley::SpeckleyDomain> >("SpeckleyRectangle", "", no_init);
     class_<speckley::AbstractAssembler, speckley::Assembler_ptr, boost::noncopyable >
         ("AbstractAssembler", "", no_init);
+
+    class_<speckley::WaveStepper, speckley::WaveStepper_ptr, boost::noncopyable >
+        ("WaveStepper",
+         "Explicit time stepper for the elastic wave equation using the "
+         "WaveAssembler and the diagonal spectral element mass matrix.",
+         no_init)
+        .def("__init__", make_constructor(&speckley::createWaveStepper,
+                default_call_policies(), (arg("domain"), arg("c"), arg("rho"),
+                arg("source"), arg("dt"))),
+                ":param domain: the speckley domain\n"
+                ":param c: list of (name, value) tuples of stiffness constants "
+                "on ``ReducedFunction`` as used by ``WavePDE``\n"
+                ":param rho: density\n:type rho: ``Data``\n"
+                ":param source: source orientation on ``DiracDeltaFunctions`` "
+                "or empty ``Data``\n"
+                ":param dt: time step size\n:type dt: ``float``")
+        .def("setInitialValues", &speckley::WaveStepper::setInitialValues,
+                (arg("u0"), arg("v0")),
+                "Sets initial displacement and velocity")
+        .def("setConstraint", &speckley::WaveStepper::setConstraint, args("q"),
+                "Components where ``q`` is positive are not accelerated")
+        .def("setReceivers", &speckley::setWaveStepperReceivers,
+                args("receivers"),
+                "Sets the receiver locations as a list of coordinate tuples")
+        .def("run", &speckley::runWaveStepper, (arg("wavelet"),
+                arg("receiverInterval")=1, arg("snapshotInterval")=0),
+                "Performs one time step per entry of ``wavelet`` which holds "
+                "the source amplitudes.\n"
+                ":return: tuple of receiver traces (one list of receiver "
+                "values every ``receiverInterval`` steps) and displacement "
+                "snapshots (every ``snapshotInterval`` steps)")
+        .def("getDisplacement", &speckley::WaveStepper::getDisplacement)
+        .def("getVelocity", &speckley::WaveStepper::getVelocity)
+        .def("getTime", &speckley::WaveStepper::getTime)
+        .def("getNumSteps", &speckley::WaveStepper::getNumSteps)
+        .def("getTimeStepSize", &speckley::WaveStepper::getTimeStepSize);
 }
 
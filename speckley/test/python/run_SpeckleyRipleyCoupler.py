@@ -230,6 +230,35 @@ class Test_ripleyCoupler(unittest.TestCase):
                 self.assertLess(Lsup(a), 1e-10,
                         error_message.format(labels[i], order, Lsup(a)))
 
+    def checkTransposed(self, s, r):
+        x = s.getX()
+        sdata = interpolate(x[0]*x[0] + x[1], Function(s))
+        rdata = r.getX()[1] - r.getX()[0]
+        forward = interpolate(sdata, Function(r))
+        # the cached operator has to give the same result again
+        self.assertEqual(Lsup(forward - interpolate(sdata, Function(r))), 0.)
+        adjoint = s.interpolateAcrossTransposed(rdata)
+        self.assertEqual(adjoint.getFunctionSpace(), Function(s))
+        lhs = sum([a*b for a, b in zip(forward.toListOfTuples(),
+                                       rdata.toListOfTuples())])
+        rhs = sum([a*b for a, b in zip(sdata.toListOfTuples(),
+                                       adjoint.toListOfTuples())])
+        self.assertLess(abs(lhs - rhs), 1e-10*abs(lhs))
+
+    @unittest.skipIf(getMPISizeWorld() > 1, "requires a single rank")
+    def test_Rectangle_transposed(self):
+        for order in range(2,11):
+            coupler = SpeckleyToRipley(2, (2*order, order), order=order,
+                    lengths=[3.,2.])
+            self.checkTransposed(coupler.getSpeckley(), coupler.getRipley())
+
+    @unittest.skipIf(getMPISizeWorld() > 1, "requires a single rank")
+    def test_Brick_transposed(self):
+        for order in range(2,11):
+            coupler = SpeckleyToRipley(3, (2*order, order, order),
+                    order=order, lengths=[3.,2.,2.])
+            self.checkTransposed(coupler.getSpeckley(), coupler.getRipley())
+
     def test_mismatch_errors(self):
         ranks = getMPISizeWorld()
         r = rRectangle(2*ranks - 1, 2, l0=1., d0=ranks)
@@ -26,7 +26,7 @@ __url__="https://launchpad.net/escript-finley"
 import esys.escriptcore.utestselect as unittest
 from esys.escriptcore.testing import *
 from esys.escript import *
-from esys.speckley import Rectangle, Brick
+from esys.speckley import Rectangle, Brick, WaveStepper
 from esys.escript.linearPDEs import LameEquation, LinearPDESystem, WavePDE, LinearSinglePDE
 from esys.downunder import HTIWave, VTIWave, Ricker
 
@@ -241,6 +241,42 @@ class SpeckleyWaveAssemblerTestBase(unittest.TestCase):
             self.run_HTI_assembly(domain)
             self.run_VTI_assembly(domain)
 
+    def test_WaveStepper(self):
+        dt = 1e-3
+        wavelet = [1., 2., 3., 2., 1.]
+        for domain in self.domains:
+            dim = domain.getDim()
+            c = []
+            for name, value in [("c11", 11.), ("c23", 23.), ("c13", 13.),
+                    ("c33", 33.), ("c44", 44.), ("c66", 66.)]:
+                c.append((name, Scalar(value, ReducedFunction(domain))))
+            rho = Scalar(2., Function(domain))
+            r = Vector(0., DiracDeltaFunctions(domain))
+            r.setTaggedValue("source", [1.,0.,0.][:dim])
+
+            # reference solution using the downunder scheme
+            pde = WavePDE(domain, c)
+            pde.getSolverOptions().setSolverMethod(SolverOptions.HRZ_LUMPING)
+            pde.setSymmetryOn()
+            pde.setValue(D=rho*kronecker(dim))
+            u = Vector(0., Solution(domain))
+            v = Vector(0., Solution(domain))
+            for w in wavelet:
+                pde.setValue(du=grad(u), y_dirac=r*w)
+                v += dt*pde.getSolution()
+                u += dt*v
+
+            stepper = WaveStepper(domain, c, rho, r, dt)
+            stepper.setReceivers([tuple([0.]*dim)])
+            traces, snapshots = stepper.run(wavelet[:2], 1, 2)
+            traces2, snapshots2 = stepper.run(wavelet[2:], 1, 2)
+            self.assertEqual(len(traces)+len(traces2), len(wavelet))
+            self.assertEqual(len(snapshots)+len(snapshots2), 2)
+            self.assertEqual(stepper.getNumSteps(), len(wavelet))
+            self.assertLess(Lsup(stepper.getDisplacement()-u), 1e-10*Lsup(u))
+            self.assertLess(Lsup(stepper.getVelocity()-v), 1e-10*Lsup(v))
+            self.assertGreater(abs(traces2[-1][0][0]), 0.)
+
 class Test_SpeckleyWaveAssembler2D(SpeckleyWaveAssemblerTestBase):
     def setUp(self):
         self.domains = []
@@ -25,6 +25,7 @@ __url__="https://launchpad.net/escript-finley"
 
 import os
 import sys
+import numpy as np
 import esys.escriptcore.utestselect as unittest
 from esys.escriptcore.testing import *
 from esys.escript import *
@@ -717,6 +718,115 @@ class Test_Speckley(unittest.TestCase):
                     "averaging failure for mixed-splits "\
                     + "(dims %d,%d) in order %d"%(dim1,dim2,order))
 
+class Test_SpeckleySumFactorization(unittest.TestCase):
+    """
+    compares the element kernels with dense reference values computed
+    from Gauss-Lobatto-Legendre quadrature for a few orders. The
+    previous per-order kernels evaluated the same sums, so these values
+    also guard against regressions in the shared kernels.
+    """
+    TOLERANCE = 1e-9
+    ORDERS = (2, 3, 5, 8, 10)
+
+    def getGLL(self, order):
+        P = np.polynomial.legendre.Legendre.basis(order)
+        x = np.concatenate(([-1.], np.sort(P.deriv().roots().real), [1.]))
+        p = P(x)
+        w = 2./(order*(order+1)*p**2)
+        D = np.zeros((order+1, order+1))
+        for i in range(order+1):
+            for j in range(order+1):
+                if i != j:
+                    D[i,j] = p[i]/(p[j]*(x[i]-x[j]))
+        D[0,0] = -order*(order+1)/4.
+        D[order,order] = order*(order+1)/4.
+        return x, w, D
+
+    def getReference(self, order, NE, L, func):
+        """
+        returns the function values at all quadrature points with shape
+        (NE[0],Q,NE[1],Q,...), the gradient and the element means
+        """
+        x, w, D = self.getGLL(order)
+        Q = order+1
+        dim = len(NE)
+        h = [L[d]/NE[d] for d in range(dim)]
+        coords = [(np.arange(NE[d])[:,None]*h[d] + (x+1)/2.*h[d]).ravel()
+                  for d in range(dim)]
+        X = np.meshgrid(*coords, indexing='ij')
+        shape = sum([[NE[d], Q] for d in range(dim)], [])
+        F = func(np, X).reshape(shape)
+        grads = []
+        for d in range(dim):
+            G = np.tensordot(D, F, axes=([1], [2*d+1]))*2./h[d]
+            grads.append(np.moveaxis(G, 0, 2*d+1))
+        means = F
+        for d in range(dim):
+            means = np.tensordot(means, w/2., axes=([d+1], [0]))
+        integral = np.prod(h)*np.sum(means)
+        return F, grads, means, integral
+
+    def checkClose(self, value, ref, what, order):
+        err = abs(value-ref)/max(abs(ref), 1.)
+        self.assertLess(err, self.TOLERANCE, "%s failed for order %d: %s != %s"
+                %(what, order, value, ref))
+
+    def checkKernels(self, dom, order, NE, L, func):
+        F, grads, means, integral = self.getReference(order, NE, L, func)
+
+        # integrals with several components, complex values and reductions
+        u = func(None, Function(dom).getX())
+        v = u*[1., 2.] + [0., 1.]
+        res = integrate(v)
+        self.checkClose(res[0], integral, "integral of component 0", order)
+        self.checkClose(res[1], 2*integral + np.prod(L), "integral of component 1", order)
+        self.checkClose(integrate(u*(1+2j)), integral*(1+2j), "complex integral", order)
+        r = interpolate(v, ReducedFunction(dom))
+        self.checkClose(sup(r[0]), means.max(), "reduction maximum", order)
+        self.checkClose(inf(r[0]), means.min(), "reduction minimum", order)
+        self.checkClose(sup(r[1]), 2*means.max()+1, "reduction maximum", order)
+
+        # gradients of nodal data
+        g = grad(func(None, dom.getX()))
+        gc = grad(func(None, dom.getX())*(1-1j))
+        cellVolume = np.prod(L)/np.prod(NE)
+        w = self.getGLL(order)[1]
+        for d in range(len(NE)):
+            G = grads[d]
+            self.checkClose(sup(g[d]), G.max(), "gradient maximum %d"%d, order)
+            self.checkClose(inf(g[d]), G.min(), "gradient minimum %d"%d, order)
+            Gint = G
+            for k in range(len(NE)):
+                Gint = np.tensordot(Gint, w/2., axes=([k+1], [0]))
+            Gint = cellVolume*np.sum(Gint)
+            self.checkClose(integrate(g[d]), Gint, "gradient integral %d"%d, order)
+            self.checkClose(integrate(gc[d]), Gint*(1-1j), "complex gradient integral %d"%d, order)
+
+    def test_Rectangle(self):
+        ranks = getMPISizeWorld()
+        def func(mod, X):
+            if mod is None:
+                return sin(X[0]+0.3)*exp(0.5*X[1])
+            return mod.sin(X[0]+0.3)*mod.exp(0.5*X[1])
+        for order in self.ORDERS:
+            NE = (3, 2*ranks)
+            L = (2.5, 1.5*ranks)
+            dom = Rectangle(order, NE[0], NE[1], l0=L[0], l1=L[1], d1=ranks)
+            self.checkKernels(dom, order, NE, L, func)
+
+    def test_Brick(self):
+        ranks = getMPISizeWorld()
+        def func(mod, X):
+            if mod is None:
+                return sin(X[0]+0.3)*exp(0.5*X[1])*cos(0.7*X[2])
+            return mod.sin(X[0]+0.3)*mod.exp(0.5*X[1])*mod.cos(0.7*X[2])
+        for order in self.ORDERS:
+            NE = (2, 2*ranks, 3)
+            L = (1.5, 2.*ranks, 2.5)
+            dom = Brick(order, NE[0], NE[1], NE[2], l0=L[0], l1=L[1], l2=L[2],
+                        d1=ranks)
+            self.checkKernels(dom, order, NE, L, func)
+
 if __name__ == '__main__':
     run_tests(__name__, exit_on_failure=True)
 
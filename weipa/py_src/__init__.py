@@ -124,7 +124,8 @@ def saveSilo(filename, domain=None, write_meshdata=False, time=0., cycle=0,
     return dataset.saveSilo(filename)
 
 def saveVTK(filename, domain=None, metadata='', metadata_schema=None,
-        write_meshdata=False, time=0., cycle=0, **data):
+        write_meshdata=False, time=0., cycle=0, encoding='ascii',
+        compression=0, split_by_rank=False, **data):
     """
     Writes `Data` objects and their mesh to a file using the VTK XML file
     format.
@@ -172,6 +173,18 @@ def saveVTK(filename, domain=None, metadata='', metadata_schema=None,
     :type time: ``float``
     :param cycle: the cycle (or timestep) of the data
     :type cycle: ``int``
+    :param encoding: encoding of the data arrays, one of 'ascii', 'binary'
+                     (inline base64) or 'appended' (raw binary at the end of
+                     the file)
+    :type encoding: ``str``
+    :param compression: zlib compression level (1-9) for binary encodings,
+                        0 disables compression. On more than one rank
+                        compression requires ``split_by_rank``.
+    :type compression: ``int``
+    :param split_by_rank: if True, every rank writes its own piece and rank 0
+                          writes a parallel index file with extension '.pvtu'
+                          which references the pieces
+    :type split_by_rank: ``bool``
     :note: All data objects have to be defined on the same domain. They may not
            be in the same `FunctionSpace` but not all combinations of
            `FunctionSpace` s can be written to a single VTK file.
@@ -192,8 +205,301 @@ def saveVTK(filename, domain=None, metadata='', metadata_schema=None,
             ss=metadata_schema
     dataset.setMetadataSchemaString(ss.strip(), ms.strip())
     dataset.setSaveMeshData(write_meshdata)
+    _setVTKOptions(dataset, encoding, compression, split_by_rank)
     return dataset.saveVTK(filename)
 
+def _setVTKOptions(dataset, encoding, compression, split_by_rank):
+    """
+    Sets the VTK array encoding and file layout of an esys.weipa dataset.
+    """
+    from .weipacpp import VTKEncoding
+    encodings = { 'ascii': VTKEncoding.ASCII, 'binary': VTKEncoding.BINARY,
+                  'appended': VTKEncoding.APPENDED }
+    if not encoding in encodings:
+        raise ValueError("Unknown VTK encoding '%s'"%encoding)
+    dataset.setVTKEncoding(encodings[encoding], compression)
+    dataset.setVTKSplitByRank(split_by_rank)
+
+def saveHDF5(filename, domain=None, time=0., cycle=0, append=False,
+        compression=0, **data):
+    """
+    Writes `Data` objects and their mesh to an HDF5 file and an XDMF file
+    describing its contents which can be loaded by ParaView or VisIt.
+
+    The mesh is stored once and every call with ``append=True`` adds the data
+    of a new time step to the same file so a time series is stored in a
+    single HDF5 file. All ranks write into the same file which requires a
+    parallel HDF5 library when running with more than one MPI rank.
+
+    Example::
+
+        for n in range(num_steps):
+            ...
+            saveHDF5("solution", time=t, cycle=n, append=(n>0), u=u)
+
+    :param filename: name of the output files without extension ('.h5' and
+                     '.xmf' are added)
+    :type filename: ``str``
+    :param domain: domain of the `Data` objects. If not specified, the domain
+                   of the given `Data` objects is used.
+    :type domain: `escript.Domain`
+    :param time: the timestamp of the data
+    :type time: ``float``
+    :param cycle: the cycle (or timestep) of the data
+    :type cycle: ``int``
+    :param append: if True the data is added as a new time step to an
+                   existing file, otherwise the file is replaced
+    :type append: ``bool``
+    :param compression: deflate level (1-9) of the chunked datasets, 0
+                        disables compression
+    :type compression: ``int``
+    :keyword <name>: writes the assigned value to the file using <name> as
+                     identifier
+    :note: All data objects have to be defined on the same domain but they may
+           be defined on separate `FunctionSpace` s.
+    """
+
+    dataset = createDataset(domain, **data)
+    dataset.setCycleAndTime(cycle, time)
+    return dataset.saveHDF5(filename, append, compression)
+
+class DatasetWriter(object):
+    """
+    Writes a series of time steps of `Data` objects defined on the same
+    static domain.
+
+    Unlike `saveSilo`, `saveVTK` and `saveHDF5` which convert the domain on
+    every call, the writer converts the domain once and keeps it together
+    with the sample ordering of each `FunctionSpace` for all steps.
+    Silo files reference the mesh stored in the first file, and only
+    variables whose values changed since the previous step are written to
+    Silo and HDF5 files while unchanged variables reference the values
+    written before. VTK files always contain the mesh and all variables.
+
+    Example::
+
+        writer=DatasetWriter("solution", format="silo")
+        for n in range(num_steps):
+            ...
+            writer.write(time=t, u=u, rho=rho)
+
+    writes "solution.0000.silo", "solution.0001.silo", etc. where the mesh
+    and ``rho`` (if it does not change) are only stored in the first file.
+
+    With ``asynchronous=True`` the data is converted and written on a
+    background thread while the simulation continues. `write` then only takes
+    a snapshot of the `Data` objects which shares the values with the
+    originals until they are modified. On more than one MPI rank writes are
+    always synchronous.
+
+    Instead of or in addition to the full data the writer can store reduced
+    data which is extracted in parallel on the ranks owning it, see
+    `addSlice`, `addRegion`, `setSubsampling` and `addProbes`. For
+    example::
+
+        writer=DatasetWriter("solution", format="vtk", full_output=False)
+        writer.addSlice(axis=2, position=-100.)
+        writer.addProbes([(0.,0.,-50.), (100.,0.,-50.)])
+
+    writes "solution_slice0.0000.vtu", ... and appends the probe values to
+    "solution_probes.csv". Reduced data is always written in VTK format (and
+    as comma separated values for probes) and is not supported by
+    asynchronous writers.
+    """
+
+    SILO, VTK, HDF5 = 'silo', 'vtk', 'hdf5'
+
+    def __init__(self, filename, format=SILO, domain=None,
+            write_meshdata=False, encoding='ascii', compression=0,
+            split_by_rank=False, asynchronous=False, max_pending=2,
+            full_output=True):
+        """
+        :param filename: base name of the output files. The cycle number and
+                         the file extension are appended for Silo and VTK
+                         while HDF5 stores all steps in one file. Silo files
+                         of one series must be in the same directory.
+        :type filename: ``str``
+        :param format: one of 'silo', 'vtk' or 'hdf5'
+        :type format: ``str``
+        :param domain: domain of the `Data` objects. If not specified, the
+                       domain of the `Data` objects of the first step is used.
+        :type domain: `escript.Domain`
+        :param write_meshdata: whether to save mesh-related data such as
+                               element identifiers, ownership etc.
+        :type write_meshdata: ``bool``
+        :param encoding: VTK array encoding, see `saveVTK`
+        :type encoding: ``str``
+        :param compression: compression level for VTK and HDF5 output, see
+                            `saveVTK` and `saveHDF5`
+        :type compression: ``int``
+        :param split_by_rank: whether VTK output is split into one piece per
+                              rank, see `saveVTK`
+        :type split_by_rank: ``bool``
+        :param asynchronous: whether to write on a background thread
+        :type asynchronous: ``bool``
+        :param max_pending: maximum number of asynchronous writes that may
+                            be pending before `write` blocks
+        :type max_pending: ``int``
+        :param full_output: whether to write the full data in addition to
+                            the reduced data
+        :type full_output: ``bool``
+        """
+        if not format in (self.SILO, self.VTK, self.HDF5):
+            raise ValueError("Unknown file format '%s'"%format)
+        self.__filename=filename
+        self.__format=format
+        self.__domain=domain
+        self.__write_meshdata=write_meshdata
+        self.__encoding=encoding
+        self.__compression=compression
+        self.__split_by_rank=split_by_rank
+        self.__asynchronous=asynchronous
+        self.__max_pending=max_pending
+        self.__full_output=full_output
+        self.__slices=[]
+        self.__regions=[]
+        self.__stride=0
+        self.__probes=[]
+        self.__dataset=None
+        self.__N=0
+
+    def __checkReduction(self):
+        if self.__asynchronous:
+            raise ValueError("Reduced output is not supported by asynchronous writers")
+
+    def addSlice(self, axis, position):
+        """
+        Adds an axis-aligned slice to the output of every step. Nodal values
+        are interpolated linearly onto the slice.
+
+        :param axis: the coordinate direction normal to the slice (0,1 or 2)
+        :type axis: ``int``
+        :param position: the coordinate value of the slice
+        :type position: ``float``
+        """
+        self.__checkReduction()
+        self.__slices.append((axis, position))
+
+    def addRegion(self, box):
+        """
+        Adds the elements whose centre lies in a box to the output of every
+        step.
+
+        :param box: the lower and upper bounds per dimension, e.g.
+                    ``[(x0,x1), (y0,y1)]``
+        :type box: ``list`` of ``tuple``
+        """
+        self.__checkReduction()
+        bounds=[b for r in box for b in r]
+        if len(bounds) not in (4, 6):
+            raise ValueError("Region box must have two or three dimensions")
+        self.__regions.append(bounds)
+
+    def setSubsampling(self, stride):
+        """
+        Writes the nodal values at every ``stride``-th grid line of a ripley
+        or speckley domain as VTK image data for every step.
+
+        :param stride: the subsampling factor, 0 disables subsampled output
+        :type stride: ``int``
+        """
+        self.__checkReduction()
+        self.__stride=stride
+
+    def addProbes(self, points):
+        """
+        Adds probe locations. The nodal values at the nodes closest to the
+        probes are appended to a file with comma separated values at every
+        step.
+
+        :param points: the probe coordinates
+        :type points: ``list`` of ``tuple``
+        """
+        self.__checkReduction()
+        self.__probes.extend(points)
+        if self.__dataset is not None:
+            for p in points:
+                self.__dataset.addProbe(*p)
+
+    def getDomain(self):
+        """
+        Returns the domain of the written data or None before the first step.
+        """
+        return self.__domain
+
+    def getNumSteps(self):
+        """
+        Returns the number of steps written so far.
+        """
+        return self.__N
+
+    def flush(self):
+        """
+        Waits until all asynchronous writes have completed. Failed writes
+        are reported by raising an exception.
+        """
+        if self.__asynchronous and self.__dataset is not None:
+            self.__dataset.flush()
+
+    def write(self, time=0., cycle=None, **data):
+        """
+        Writes `Data` objects as a new time step.
+
+        :param time: the timestamp of the data
+        :type time: ``float``
+        :param cycle: the cycle of the data, defaults to the number of steps
+                      written before
+        :type cycle: ``int``
+        :keyword <name>: writes the assigned value using <name> as identifier
+        :note: All data objects have to be defined on the domain of the
+               writer.
+        """
+        from .weipacpp import AsyncWriter, EscriptDataset
+        domain,new_data=interpolateEscriptData(self.__domain, data)
+        if self.__dataset is None:
+            if self.__asynchronous:
+                self.__dataset=AsyncWriter(self.__max_pending)
+            else:
+                self.__dataset=EscriptDataset()
+                self.__dataset.setPersistent(True)
+            self.__dataset.setDomain(domain)
+            self.__dataset.setSaveMeshData(self.__write_meshdata)
+            _setVTKOptions(self.__dataset, self.__encoding,
+                           self.__compression, self.__split_by_rank)
+            for p in self.__probes:
+                self.__dataset.addProbe(*p)
+            self.__domain=domain
+        elif not self.__asynchronous:
+            self.__dataset.clearData()
+        for n,d in sorted(new_data.items()):
+            self.__dataset.addData(d, n, "")
+        if cycle is None:
+            cycle=self.__N
+        self.__dataset.setCycleAndTime(cycle, time)
+
+        if self.__full_output and self.__format == self.HDF5:
+            self.__dataset.saveHDF5(self.__filename, self.__N>0,
+                                    self.__compression)
+        elif self.__full_output:
+            filename="%s.%04d"%(self.__filename, self.__N)
+            if self.__format == self.SILO:
+                self.__dataset.saveSilo(filename)
+            else:
+                self.__dataset.saveVTK(filename)
+        for i,(axis,position) in enumerate(self.__slices):
+            self.__dataset.saveVTKSlice("%s_slice%d.%04d"%(self.__filename,
+                                        i, self.__N), axis, position)
+        for i,box in enumerate(self.__regions):
+            self.__dataset.saveVTKRegion("%s_region%d.%04d"%(self.__filename,
+                                         i, self.__N), *box)
+        if self.__stride > 0:
+            self.__dataset.saveVTKSubsampled("%s_sub.%04d"%(self.__filename,
+                                             self.__N), self.__stride)
+        if len(self.__probes) > 0:
+            self.__dataset.saveProbes(self.__filename+"_probes.csv",
+                                      self.__N>0)
+        self.__N += 1
+
 def saveVoxet(filename, **data):
     """
     Writes `Data` objects to a file using the GOCAD Voxet file format as
@@ -0,0 +1,290 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#include <weipa/AsyncWriter.h>
+#include <weipa/WeipaException.h>
+
+#include <escript/Data.h>
+
+#include <iostream>
+
+using namespace std;
+
+namespace weipa {
+
+namespace {
+    enum { SILO_FILE, VTK_FILE, HDF5_FILE };
+}
+
+/// a queued write with its data snapshots and settings
+struct AsyncWriter::Job {
+    vector<escript::Data> data;
+    StringVec names, units;
+    int format;
+    string fileName;
+    bool append;
+    int compressionLevel;
+    int cycle;
+    double time;
+    string mdSchema, mdString;
+    bool wantsMeshVars;
+    VTKEncoding vtkEncoding;
+    int vtkCompression;
+    bool vtkSplitByRank;
+};
+
+//
+// Constructor
+//
+AsyncWriter::AsyncWriter(int maxPending) :
+    next(new Job),
+    cycle(0),
+    time(0.),
+    wantsMeshVars(false),
+    vtkEncoding(VTK_ASCII),
+    vtkCompression(0),
+    vtkSplitByRank(false),
+    asynchronous(false),
+    maxPending(maxPending),
+    active(0),
+    stopping(false)
+{
+    if (maxPending < 1)
+        throw WeipaException("AsyncWriter: at least one write must be allowed to be pending");
+}
+
+//
+// Destructor
+//
+AsyncWriter::~AsyncWriter()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    // the worker completes all queued writes before it exits
+    jobAdded.notify_all();
+    if (worker.joinable())
+        worker.join();
+    if (!errors.empty())
+        cerr << "WARNING: AsyncWriter: " << errors;
+}
+
+//
+//
+//
+bool AsyncWriter::setDomain(const escript::AbstractDomain* domain)
+{
+    if (!dataset.setDomain(domain))
+        return false;
+    dataset.setPersistent(true);
+
+    int mpiSize = 1;
+#if WEIPA_HAVE_MPI
+    MPI_Comm_size(dataset.getMPIComm(), &mpiSize);
+#endif
+    asynchronous = (mpiSize == 1);
+    return true;
+}
+
+//
+//
+//
+void AsyncWriter::addData(escript::Data& data, const string name,
+                          const string units)
+{
+    // the snapshot shares the values with 'data' until either of them is
+    // modified. Lazy data is evaluated here so the worker only reads values.
+    escript::Data snapshot(data);
+    snapshot.resolve();
+    next->data.push_back(snapshot);
+    next->names.push_back(name);
+    next->units.push_back(units);
+}
+
+//
+//
+//
+void AsyncWriter::setVTKEncoding(VTKEncoding encoding, int compressionLevel)
+{
+    // the dataset may be in use by the worker so only validate here
+    EscriptDataset().setVTKEncoding(encoding, compressionLevel);
+    vtkEncoding = encoding;
+    vtkCompression = compressionLevel;
+}
+
+//
+//
+//
+void AsyncWriter::saveSilo(const string fileName)
+{
+    submit(SILO_FILE, fileName, false, 0);
+}
+
+//
+//
+//
+void AsyncWriter::saveVTK(const string fileName)
+{
+    submit(VTK_FILE, fileName, false, 0);
+}
+
+//
+//
+//
+void AsyncWriter::saveHDF5(const string fileName, bool append,
+                           int compressionLevel)
+{
+    if (compressionLevel < 0 || compressionLevel > 9)
+        throw WeipaException("AsyncWriter::saveHDF5 Compression level must be between 0 and 9");
+    submit(HDF5_FILE, fileName, append, compressionLevel);
+}
+
+//
+//
+//
+void AsyncWriter::flush()
+{
+    string msg;
+    {
+        unique_lock<mutex> lock(queueMutex);
+        jobDone.wait(lock, [this] { return queue.empty() && active == 0; });
+        msg.swap(errors);
+    }
+    releaseJobs();
+    if (!msg.empty())
+        throw WeipaException("AsyncWriter: "+msg);
+}
+
+//
+//
+//
+int AsyncWriter::getNumPending()
+{
+    lock_guard<mutex> lock(queueMutex);
+    return queue.size() + active;
+}
+
+//
+// Queues the data added since the last call with the current settings
+//
+void AsyncWriter::submit(int format, const string& fileName, bool append,
+                         int compressionLevel)
+{
+    if (dataset.getConvertedDomain().size() == 0)
+        throw WeipaException("AsyncWriter: setDomain() must be called before writing");
+
+    Job_ptr job(next);
+    next.reset(new Job);
+    job->format = format;
+    job->fileName = fileName;
+    job->append = append;
+    job->compressionLevel = compressionLevel;
+    job->cycle = cycle;
+    job->time = time;
+    job->mdSchema = mdSchema;
+    job->mdString = mdString;
+    job->wantsMeshVars = wantsMeshVars;
+    job->vtkEncoding = vtkEncoding;
+    job->vtkCompression = vtkCompression;
+    job->vtkSplitByRank = vtkSplitByRank;
+
+    releaseJobs();
+    if (!asynchronous) {
+        process(*job);
+        return;
+    }
+
+    unique_lock<mutex> lock(queueMutex);
+    if (!worker.joinable())
+        worker = thread(&AsyncWriter::run, this);
+    jobDone.wait(lock, [this] {
+            return (int)queue.size() + active < maxPending; });
+    queue.push_back(job);
+    jobAdded.notify_one();
+}
+
+//
+// Converts and writes the data of one job. Only called by the worker thread
+// unless writes are synchronous.
+//
+void AsyncWriter::process(Job& job)
+{
+    dataset.clearData();
+    for (size_t i = 0; i < job.data.size(); i++)
+        dataset.addData(job.data[i], job.names[i], job.units[i]);
+    dataset.setCycleAndTime(job.cycle, job.time);
+    dataset.setMetadataSchemaString(job.mdSchema, job.mdString);
+    dataset.setSaveMeshData(job.wantsMeshVars);
+    dataset.setVTKEncoding(job.vtkEncoding, job.vtkCompression);
+    dataset.setVTKSplitByRank(job.vtkSplitByRank);
+
+    if (job.format == SILO_FILE) {
+        if (!dataset.saveSilo(job.fileName))
+            throw WeipaException("Could not write Silo file");
+    } else if (job.format == VTK_FILE) {
+        dataset.saveVTK(job.fileName);
+    } else {
+        dataset.saveHDF5(job.fileName, job.append, job.compressionLevel);
+    }
+}
+
+//
+// Worker thread main loop
+//
+void AsyncWriter::run()
+{
+    unique_lock<mutex> lock(queueMutex);
+    while (true) {
+        jobAdded.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            break;
+        Job_ptr job = queue.front();
+        queue.pop_front();
+        active = 1;
+        lock.unlock();
+
+        string error;
+        try {
+            process(*job);
+        } catch (const exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "unknown error";
+        }
+
+        lock.lock();
+        if (!error.empty())
+            errors += job->fileName + ": " + error + "\n";
+        active = 0;
+        done.push_back(job);
+        jobDone.notify_all();
+    }
+}
+
+//
+// Releases the snapshots of completed writes on the calling thread
+//
+void AsyncWriter::releaseJobs()
+{
+    vector<Job_ptr> finished;
+    lock_guard<mutex> lock(queueMutex);
+    finished.swap(done);
+}
+
+} // namespace weipa
+
@@ -0,0 +1,147 @@
+
+/*****************************************************************************
+*
+* Copyright (c) 2003-2020 by The University of Queensland
+* http://www.uq.edu.au
+*
+* Primary Business: Queensland, Australia
+* Licensed under the Apache License, version 2.0
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+* Development 2012-2013 by School of Earth Sciences
+* Development from 2014-2017 by Centre for Geoscience Computing (GeoComp)
+* Development from 2019 by School of Earth and Environmental Sciences
+**
+*****************************************************************************/
+
+#ifndef __WEIPA_ASYNCWRITER_H__
+#define __WEIPA_ASYNCWRITER_H__
+
+#include <weipa/EscriptDataset.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace escript {
+    class AbstractDomain;
+    class Data;
+}
+
+namespace weipa {
+
+/// \brief Writes time steps of escript data on a background thread.
+//
+/// This class provides the interface of EscriptDataset for writing a series
+/// of time steps on a static domain, but the conversion and output of the
+/// data take place on a dedicated thread so the caller can continue with the
+/// simulation. addData() only takes a snapshot of the data which shares the
+/// values with the original (escript copies them on the next write access).
+/// Each save call queues a write of all data added since the previous save.
+/// If the maximum number of queued writes is reached the save call blocks
+/// until the oldest write has completed.
+///
+/// The domain is converted once by setDomain() on the calling thread and
+/// reused for all writes, see EscriptDataset::setPersistent().
+///
+/// \note escript only requests MPI_THREAD_FUNNELED so writes on more than one
+///       MPI rank are performed synchronously on the calling thread.
+class WEIPA_DLL_API AsyncWriter
+{
+public:
+    /// \brief Constructor with the maximum number of queued writes.
+    AsyncWriter(int maxPending=2);
+
+    /// \brief Destructor. Waits for all queued writes to complete.
+    ~AsyncWriter();
+
+    /// \brief Converts the escript domain all data must be defined on. This
+    ///        method must be called once before any other.
+    bool setDomain(const escript::AbstractDomain* domain);
+
+    /// \brief Adds a snapshot of an escript data instance to the next write.
+    void addData(escript::Data& data, const std::string name,
+                 const std::string units = "");
+
+    /// \brief Sets the cycle number and time value of the next write.
+    void setCycleAndTime(int c, double t) { cycle=c; time=t; }
+
+    /// \brief Sets a metadata schema and content, see EscriptDataset.
+    void setMetadataSchemaString(const std::string schema,
+                                 const std::string metadata)
+        { mdSchema=schema; mdString=metadata; }
+
+    /// \brief Enables/Disables saving of mesh-related data
+    void setSaveMeshData(bool flag) { wantsMeshVars=flag; }
+
+    /// \brief Sets the encoding and compression of VTK data arrays, see
+    ///        EscriptDataset::setVTKEncoding().
+    void setVTKEncoding(VTKEncoding encoding, int compressionLevel=0);
+
+    /// \brief Enables/Disables writing one VTK piece per rank.
+    void setVTKSplitByRank(bool flag) { vtkSplitByRank=flag; }
+
+    /// \brief Queues a write of the current data to a Silo file.
+    void saveSilo(const std::string fileName);
+
+    /// \brief Queues a write of the current data to a VTK file.
+    void saveVTK(const std::string fileName);
+
+    /// \brief Queues a write of the current data to an HDF5 file, see
+    ///        EscriptDataset::saveHDF5().
+    void saveHDF5(const std::string fileName, bool append=false,
+                  int compressionLevel=0);
+
+    /// \brief Waits until all queued writes have completed.
+    ///
+    /// Errors of writes that failed since the last call are reported by
+    /// throwing a WeipaException.
+    void flush();
+
+    /// \brief Returns the number of writes that have not completed yet.
+    int getNumPending();
+
+    /// \brief Returns true if writes are performed on a background thread.
+    bool isAsynchronous() const { return asynchronous; }
+
+private:
+    struct Job;
+    typedef boost::shared_ptr<Job> Job_ptr;
+
+    void submit(int format, const std::string& fileName, bool append,
+                int compressionLevel);
+    void process(Job& job);
+    void run();
+    void releaseJobs();
+
+    EscriptDataset dataset;
+    /// holds the data snapshots for the next write
+    Job_ptr next;
+    int cycle;
+    double time;
+    std::string mdSchema, mdString;
+    bool wantsMeshVars;
+    VTKEncoding vtkEncoding;
+    int vtkCompression;
+    bool vtkSplitByRank;
+    bool asynchronous;
+
+    int maxPending;
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable jobAdded, jobDone;
+    std::deque<Job_ptr> queue;
+    /// completed jobs are released by the calling thread as their data
+    /// snapshots may hold references to Python objects
+    std::vector<Job_ptr> done;
+    int active;
+    bool stopping;
+    std::string errors;
+};
+
+} // namespace weipa
+
+#endif // __WEIPA_ASYNCWRITER_H__
+
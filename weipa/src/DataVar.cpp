@@ -104,7 +104,8 @@ void DataVar::cleanup()
 //
 //
 //
-bool DataVar::initFromEscript(escript::Data& escriptData, const_DomainChunk_ptr dom)
+bool DataVar::initFromEscript(escript::Data& escriptData, const_DomainChunk_ptr dom,
+                              SampleOrder* order)
 {
 #ifndef VISIT_PLUGIN
     cleanup();
@@ -187,7 +188,7 @@ bool DataVar::initFromEscript(escript::Data& escriptData, const_DomainChunk_ptr
         }
         delete[] tempData;
 
-        initialized = reorderSamples();
+        initialized = reorderSamples(order);
     }
 
     return initialized;
@@ -501,11 +502,17 @@ float* DataVar::averageData(const float* src, size_t stride)
 // IDs. This is used to have data arrays ordered according to the underlying
 // mesh (i.e. DataID[i]==MeshNodeID[i])
 //
-bool DataVar::reorderSamples()
+bool DataVar::reorderSamples(SampleOrder* order)
 {
     if (numSamples == 0)
         return true;
 
+    // the permutation only depends on the sample IDs which don't change for
+    // a static mesh
+    const bool sameIDs = (order && order->sampleID == sampleID);
+    if (order && !sameIDs)
+        order->sampleID = sampleID;
+
     const IntVec* requiredIDs = NULL;
     int requiredNumSamples = 0;
     int cellFactor = 1;
@@ -541,18 +548,30 @@ bool DataVar::reorderSamples()
         return false;
     }
 
-    IndexMap sampleID2idx = buildIndexMap();
+    // the number of required samples changes when ghost zones are removed
+    const bool useOrder = (sameIDs && !order->srcIndex.empty() &&
+            order->srcIndex.size()*cellFactor == requiredIDs->size());
+    IntVec newIndex;
+    if (!useOrder) {
+        IndexMap sampleID2idx = buildIndexMap();
+        IntVec::const_iterator idIt = requiredIDs->begin();
+        for (; idIt != requiredIDs->end(); idIt+=cellFactor) {
+            newIndex.push_back(sampleID2idx.find(*idIt)->second);
+        }
+        if (order)
+            order->srcIndex = newIndex;
+    }
+    const IntVec& srcIndex = (useOrder ? order->srcIndex : newIndex);
     numSamples = requiredNumSamples;
 
     // now filter the data
     for (size_t i=0; i < dataArray.size(); i++) {
         float* c = new float[numSamples];
         const float* src = dataArray[i];
-        IntVec::const_iterator idIt = requiredIDs->begin();
+        IntVec::const_iterator idxIt = srcIndex.begin();
         size_t destIdx = 0;
-        for (; idIt != requiredIDs->end(); idIt+=cellFactor, destIdx+=cellFactor) {
-            size_t srcIdx = sampleID2idx.find(*idIt)->second;
-            copy(&src[srcIdx], &src[srcIdx+cellFactor], &c[destIdx]);
+        for (; idxIt != srcIndex.end(); idxIt++, destIdx+=cellFactor) {
+            copy(&src[*idxIt], &src[*idxIt+cellFactor], &c[destIdx]);
         }
         delete[] dataArray[i];
         dataArray[i] = c;
@@ -572,6 +591,28 @@ int DataVar::getNumberOfComponents() const
     return (rank == 0 ? 1 : accumulate(shape.begin(), shape.end(), 0));
 }
 
+//
+// FNV-1a over the shape and the raw bytes of the values
+//
+size_t DataVar::getChecksum() const
+{
+    size_t hash = 2166136261U;
+    const size_t prime = 16777619U;
+    IntVec header(shape);
+    header.push_back(numSamples);
+    header.push_back(centering);
+    const unsigned char* bytes = (const unsigned char*)&header[0];
+    for (size_t i=0; i<header.size()*sizeof(int); i++)
+        hash = (hash ^ bytes[i]) * prime;
+
+    for (size_t c=0; c<dataArray.size(); c++) {
+        bytes = (const unsigned char*)dataArray[c];
+        for (size_t i=0; i<numSamples*sizeof(float); i++)
+            hash = (hash ^ bytes[i]) * prime;
+    }
+    return hash;
+}
+
 //
 //
 //
@@ -684,6 +725,61 @@ void DataVar::writeToVTK(ostream& os, int ownIndex)
     }
 }
 
+//
+//
+//
+void DataVar::sampleToVector(FloatVec& values, int index)
+{
+    // index is -1 for dummy samples, see sampleToStream()
+    if (rank == 0) {
+        values.push_back(index < 0 ? 0.f : dataArray[0][index]);
+    } else if (rank == 1) {
+        for (int c = 0; c < 3; c++) {
+            values.push_back(index < 0 || c >= shape[0] ?
+                    0.f : dataArray[c][index]);
+        }
+    } else if (rank == 2) {
+        const int n = (shape[1] < 3 ? 2 : 3);
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                values.push_back(index < 0 || i >= n || j >= n ?
+                        0.f : dataArray[i*n+j][index]);
+            }
+        }
+    }
+}
+
+//
+//
+//
+void DataVar::getVTKValues(FloatVec& values, int ownIndex, bool allNodes)
+{
+    if (numSamples == 0)
+        return;
+
+    if (isNodeCentered()) {
+        // see writeToVTK() regarding the ordering
+        const IntVec& requiredIDs = domain->getNodes()->getNodeIDs();
+        const IntVec& nodeGNI = domain->getNodes()->getGlobalNodeIndices();
+        const IntVec& nodeDist = domain->getNodes()->getNodeDistribution();
+        int firstId = nodeDist[ownIndex];
+        int lastId = nodeDist[ownIndex+1];
+        IndexMap sampleID2idx = buildIndexMap();
+        for (size_t i=0; i<nodeGNI.size(); i++) {
+            if (allNodes || (firstId <= nodeGNI[i] && nodeGNI[i] < lastId)) {
+                IndexMap::const_iterator it = sampleID2idx.find(requiredIDs[i]);
+                int idx = (it==sampleID2idx.end() ? -1 : (int)it->second);
+                sampleToVector(values, idx);
+            }
+        }
+    } else {
+        int toWrite = domain->getElementsByName(meshName)->getNumElements();
+        for (int i=0; i<toWrite; i++) {
+            sampleToVector(values, i);
+        }
+    }
+}
+
 ///////////////////////////////
 // SILO related methods follow
 ///////////////////////////////
@@ -30,6 +30,16 @@ namespace escript {
 
 namespace weipa {
 
+/// \brief Holds the permutation applied by DataVar::reorderSamples() so that
+///        further data on the same function space can be reordered without
+///        rebuilding the sample ID mapping.
+struct SampleOrder {
+    IntVec sampleID;    /// sample IDs the permutation was computed for
+    IntVec srcIndex;    /// index of the first sample of each required ID
+};
+
+typedef std::map<int, SampleOrder> SampleOrderCache;
+
 /// \brief A class that provides functionality to read an escript data object
 /// from a dump file or an escript::Data instance and write that data in Silo
 /// or VTK XML formats.
@@ -47,9 +57,13 @@ public:
 
     /// \brief Initialises values and IDs from an escript::Data instance.
     ///
+    /// If order is given it is used to reorder the samples provided it was
+    /// computed for the same sample IDs, otherwise it is updated.
+    ///
     /// \return true if a valid instance of expanded data was supplied,
     ///         false if the initialisation was unsuccessful.
-    bool initFromEscript(escript::Data& escriptData, const_DomainChunk_ptr dom);
+    bool initFromEscript(escript::Data& escriptData, const_DomainChunk_ptr dom,
+                         SampleOrder* order = NULL);
 
     /// \brief Initialises with integral mesh data like IDs or tags.
     bool initFromMeshData(const_DomainChunk_ptr dom, const IntVec& data,
@@ -72,6 +86,13 @@ public:
     /// \brief Writes the data values to ostream in VTK text format.
     void writeToVTK(std::ostream& os, int ownIndex);
 
+    /// \brief Appends the data values in VTK order to a vector, padding
+    ///        vectors to 3 and tensors to 3x3 components.
+    ///
+    /// Node centered data is written for the nodes owned by block ownIndex
+    /// unless allNodes is true in which case all local nodes are included.
+    void getVTKValues(FloatVec& values, int ownIndex, bool allNodes=false);
+
     /// \brief Returns the rank of the data.
     int getRank() const { return rank; }
 
@@ -117,6 +138,10 @@ public:
     /// \brief Returns the total number of components (sum of shape elements).
     int getNumberOfComponents() const;
 
+    /// \brief Returns a checksum over shape and values of this variable which
+    ///        is used to detect whether it changed between time steps.
+    size_t getChecksum() const;
+
 private:
     void cleanup();
 
@@ -136,11 +161,14 @@ private:
     ///
     /// \return true if the function space is supported and the number of
     ///         elements or nodes matches the number of data samples.
-    bool reorderSamples();
+    bool reorderSamples(SampleOrder* order = NULL);
 
     /// \brief Outputs sample at index to output stream in VTK XML format
     void sampleToStream(std::ostream& os, int index);
 
+    /// \brief Appends sample at index to values in VTK order
+    void sampleToVector(FloatVec& values, int index);
+
     bool initialized;
     const_DomainChunk_ptr domain;
     std::string varName;
@@ -49,11 +49,26 @@
 using escript::FileWriter;
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <numeric> // for std::accumulate
 #include <sstream> // for std::ostringstream
 
+#ifdef ESYS_HAVE_BOOST_IO
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#endif
+
+#ifdef ESYS_HAVE_HDF5
+#include <hdf5.h>
+#endif
+
 #if ESYS_HAVE_SILO
 #include <silo.h>
 
@@ -70,6 +85,332 @@ namespace weipa {
 
 const char* MESH_VARS = "mesh_vars/";
 
+/// \brief One VTK data array holding the local values in binary form
+struct VTKArray {
+    enum Section { POINTS, CELLS, POINT_DATA, CELL_DATA };
+    std::string name;
+    std::string type;
+    int numComps;
+    Section section;
+    std::vector<char> bytes;
+};
+
+namespace {
+
+// uncompressed size of the blocks of compressed VTK arrays
+const size_t VTK_BLOCK_SIZE = 1<<16;
+
+const char BASE64_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+bool isLittleEndian()
+{
+    const int one = 1;
+    return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+template<typename T>
+void setArray(VTKArray& array, const std::string& name,
+              const std::string& type, int numComps, VTKArray::Section section,
+              const std::vector<T>& values)
+{
+    array.name = name;
+    array.type = type;
+    array.numComps = numComps;
+    array.section = section;
+    array.bytes.resize(values.size()*sizeof(T));
+    if (!values.empty())
+        memcpy(&array.bytes[0], &values[0], array.bytes.size());
+}
+
+void putUInt64(std::vector<char>& buf, uint64_t value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), bytes, bytes+sizeof(uint64_t));
+}
+
+void base64Encode(ostream& os, const char* data, size_t len)
+{
+    char quad[4];
+    size_t i = 0;
+    for (; i+2 < len; i += 3) {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(data+i);
+        quad[0] = BASE64_CHARS[b[0] >> 2];
+        quad[1] = BASE64_CHARS[((b[0] & 0x03) << 4) | (b[1] >> 4)];
+        quad[2] = BASE64_CHARS[((b[1] & 0x0f) << 2) | (b[2] >> 6)];
+        quad[3] = BASE64_CHARS[b[2] & 0x3f];
+        os.write(quad, 4);
+    }
+    if (i < len) {
+        const unsigned char b0 = data[i];
+        const unsigned char b1 = (i+1 < len ? data[i+1] : 0);
+        quad[0] = BASE64_CHARS[b0 >> 2];
+        quad[1] = BASE64_CHARS[((b0 & 0x03) << 4) | (b1 >> 4)];
+        quad[2] = (i+1 < len ? BASE64_CHARS[(b1 & 0x0f) << 2] : '=');
+        quad[3] = '=';
+        os.write(quad, 4);
+    }
+}
+
+void base64Encode(ostream& os, const std::vector<char>& data)
+{
+    if (!data.empty())
+        base64Encode(os, &data[0], data.size());
+}
+
+/// Prepares the binary header of an array. If level>0 the values are
+/// zlib-compressed in blocks as expected by vtkZLibDataCompressor and the
+/// compressed blocks are returned in 'compressed'.
+void encodeBinary(const std::vector<char>& bytes, int level,
+                  std::vector<char>& header, std::vector<char>& compressed)
+{
+    header.clear();
+    compressed.clear();
+    if (level <= 0) {
+        putUInt64(header, bytes.size());
+        return;
+    }
+#ifdef ESYS_HAVE_BOOST_IO
+    const size_t numBlocks = (bytes.size()+VTK_BLOCK_SIZE-1) / VTK_BLOCK_SIZE;
+    const size_t lastSize = bytes.size() - (numBlocks > 0 ?
+                                (numBlocks-1)*VTK_BLOCK_SIZE : 0);
+    putUInt64(header, numBlocks);
+    putUInt64(header, VTK_BLOCK_SIZE);
+    putUInt64(header, numBlocks > 0 ? lastSize : 0);
+    for (size_t b = 0; b < numBlocks; b++) {
+        const size_t size = (b+1 < numBlocks ? VTK_BLOCK_SIZE : lastSize);
+        const size_t before = compressed.size();
+        boost::iostreams::filtering_ostream os;
+        os.push(boost::iostreams::zlib_compressor(
+                    boost::iostreams::zlib_params(level)));
+        os.push(boost::iostreams::back_inserter(compressed));
+        boost::iostreams::write(os, &bytes[b*VTK_BLOCK_SIZE], size);
+        // flush the compressor before the size is known
+        os.reset();
+        putUInt64(header, compressed.size()-before);
+    }
+#endif
+}
+
+template<typename T, typename P>
+void writeAsciiValues(ostream& os, const std::vector<char>& bytes,
+                      int numComps)
+{
+    const size_t num = bytes.size()/sizeof(T);
+    const T* values = reinterpret_cast<const T*>(bytes.empty() ? NULL : &bytes[0]);
+    for (size_t i = 0; i < num; i++) {
+        os << static_cast<P>(values[i]);
+        os << ((i+1) % numComps == 0 ? '\n' : ' ');
+    }
+}
+
+void writeAsciiArray(ostream& os, const VTKArray& array)
+{
+    if (array.type == "Float32")
+        writeAsciiValues<float, float>(os, array.bytes, array.numComps);
+    else if (array.type == "Int32")
+        writeAsciiValues<int, int>(os, array.bytes, array.numComps);
+    else
+        writeAsciiValues<unsigned char, int>(os, array.bytes, array.numComps);
+}
+
+#if WEIPA_HAVE_MPI
+/// Base64-encodes the local part of an array that is distributed over all
+/// ranks of comm such that the encoded parts can be concatenated in rank
+/// order. Every rank encodes full 3-byte groups starting in its range using
+/// up to two leading bytes of the following ranks. The header passed on
+/// rank 0 is prepended so it is encoded in the same stream as the values.
+void base64EncodeOrdered(ostream& os, const std::vector<char>& header,
+                         const std::vector<char>& values, MPI_Comm comm)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    std::vector<char> joined;
+    if (rank == 0 && !header.empty()) {
+        joined.reserve(header.size()+values.size());
+        joined.insert(joined.end(), header.begin(), header.end());
+        joined.insert(joined.end(), values.begin(), values.end());
+    }
+    const std::vector<char>& bytes = (joined.empty() ? values : joined);
+    long long info[3] = { (long long)bytes.size(), 0, 0 };
+    for (size_t i = 0; i < 2 && i < bytes.size(); i++)
+        info[i+1] = static_cast<unsigned char>(bytes[i]);
+    std::vector<long long> allInfo(3*size);
+    MPI_Allgather(info, 3, MPI_LONG_LONG, &allInfo[0], 3, MPI_LONG_LONG, comm);
+
+    long long start = 0, total = 0;
+    for (int r = 0; r < size; r++) {
+        if (r < rank)
+            start += allInfo[3*r];
+        total += allInfo[3*r];
+    }
+    const long long end = start + bytes.size();
+    const long long first = (start+2)/3*3;
+    const long long last = std::min((end+2)/3*3, total);
+    if (first >= last)
+        return;
+
+    std::vector<char> buffer;
+    if (first < end)
+        buffer.assign(bytes.begin()+(first-start), bytes.end());
+    // complete the last group with bytes from the next ranks
+    for (int r = rank+1; r < size && (long long)buffer.size() < last-first; r++) {
+        for (long long i = 0; i < std::min(allInfo[3*r], 2LL) &&
+                (long long)buffer.size() < last-first; i++) {
+            buffer.push_back(static_cast<char>(allInfo[3*r+1+i]));
+        }
+    }
+    base64Encode(os, buffer);
+}
+#endif
+
+#ifdef ESYS_HAVE_HDF5
+// maximum number of rows per chunk of HDF5 datasets
+const hsize_t HDF5_CHUNK_ROWS = 1<<14;
+
+/// Creates a chunked (numRows x numCols) dataset and writes the local rows
+/// [firstRow, firstRow+localRows) into it. Must be called by all ranks.
+bool writeHDF5Array(hid_t loc, const string& name, hid_t memType,
+                    hid_t fileType, const void* data, hsize_t numRows,
+                    hsize_t numCols, hsize_t firstRow, hsize_t localRows,
+                    int compression, hid_t xfer)
+{
+    hsize_t dims[2] = { numRows, numCols };
+    hid_t fileSpace = H5Screate_simple(2, dims, NULL);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    if (numRows > 0) {
+        hsize_t chunk[2] = { std::min(numRows, HDF5_CHUNK_ROWS), numCols };
+        H5Pset_chunk(dcpl, 2, chunk);
+        if (compression > 0)
+            H5Pset_deflate(dcpl, compression);
+    }
+    hid_t dset = H5Dcreate2(loc, name.c_str(), fileType, fileSpace,
+                            H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Pclose(dcpl);
+    if (dset < 0) {
+        H5Sclose(fileSpace);
+        return false;
+    }
+
+    hsize_t count[2] = { localRows, numCols };
+    hid_t memSpace = H5Screate_simple(2, count, NULL);
+    if (localRows > 0) {
+        hsize_t start[2] = { firstRow, 0 };
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, NULL, count,
+                            NULL);
+    } else {
+        // ranks without data still take part in the collective write
+        H5Sselect_none(fileSpace);
+        H5Sselect_none(memSpace);
+    }
+    const float dummy = 0.f;
+    herr_t err = H5Dwrite(dset, memType, memSpace, fileSpace, xfer,
+                          localRows > 0 ? data : &dummy);
+    H5Sclose(memSpace);
+    H5Sclose(fileSpace);
+    H5Dclose(dset);
+    return (err >= 0);
+}
+
+void putHDF5Attribute(hid_t obj, const char* name, hid_t type,
+                      const void* value)
+{
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(obj, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, type, value);
+    H5Aclose(attr);
+    H5Sclose(space);
+}
+
+void putHDF5Attribute(hid_t obj, const char* name, const string& value)
+{
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, value.length()+1);
+    putHDF5Attribute(obj, name, type, value.c_str());
+    H5Tclose(type);
+}
+
+void getHDF5Attribute(hid_t obj, const char* name, hid_t type, void* value)
+{
+    hid_t attr = H5Aopen(obj, name, H5P_DEFAULT);
+    H5Aread(attr, type, value);
+    H5Aclose(attr);
+}
+
+string getHDF5Attribute(hid_t obj, const char* name)
+{
+    hid_t attr = H5Aopen(obj, name, H5P_DEFAULT);
+    hid_t type = H5Aget_type(attr);
+    vector<char> value(H5Tget_size(type)+1, 0);
+    H5Aread(attr, type, &value[0]);
+    H5Tclose(type);
+    H5Aclose(attr);
+    return string(&value[0]);
+}
+
+/// returns the dimensions of a 2D dataset
+void getHDF5Dims(hid_t loc, const string& name, hsize_t dims[2])
+{
+    hid_t dset = H5Dopen2(loc, name.c_str(), H5P_DEFAULT);
+    hid_t space = H5Dget_space(dset);
+    H5Sget_simple_extent_dims(space, dims, NULL);
+    H5Sclose(space);
+    H5Dclose(dset);
+}
+
+herr_t collectLinkNames(hid_t, const char* name, const H5L_info_t*, void* data)
+{
+    static_cast<StringVec*>(data)->push_back(name);
+    return 0;
+}
+
+StringVec getHDF5LinkNames(hid_t loc)
+{
+    StringVec names;
+    H5Literate(loc, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &names);
+    return names;
+}
+
+const char* xdmfTopologyType(int zoneType)
+{
+    switch (zoneType) {
+        case ZONETYPE_BEAM: return "Polyline";
+        case ZONETYPE_HEX: return "Hexahedron";
+        case ZONETYPE_POLYGON: return "Polygon";
+        case ZONETYPE_QUAD: return "Quadrilateral";
+        case ZONETYPE_TET: return "Tetrahedron";
+        case ZONETYPE_TRIANGLE: return "Triangle";
+    }
+    return "Mixed";
+}
+#endif // ESYS_HAVE_HDF5
+
+#if !defined VISIT_PLUGIN && (defined USE_RIPLEY || defined USE_SPECKLEY)
+// retrieves origin, element size and global number of elements of a regular
+// grid
+template<typename GridDomain>
+bool getGridParameters(const GridDomain* domain, double* origin,
+                       double* spacing, int* NE)
+{
+    const boost::python::tuple params = domain->getGridParameters();
+    for (int d=0; d<3; d++) {
+        if (d < domain->getDim()) {
+            origin[d] = boost::python::extract<double>(params[0][d]);
+            spacing[d] = boost::python::extract<double>(params[1][d]);
+            NE[d] = boost::python::extract<int>(params[2][d]);
+        } else {
+            origin[d] = 0.;
+            spacing[d] = 1.;
+            NE[d] = 0;
+        }
+    }
+    return true;
+}
+#endif
+
+} // anonymous namespace
+
 //
 // Default constructor
 //
@@ -78,6 +419,11 @@ EscriptDataset::EscriptDataset() :
     time(0.),
     externalDomain(false),
     wantsMeshVars(false),
+    persistent(false),
+    vtkEncoding(VTK_ASCII),
+    vtkCompression(0),
+    vtkSplitByRank(false),
+    haveGrid(false),
     mpiRank(0),
     mpiSize(1)
 {
@@ -92,6 +438,11 @@ EscriptDataset::EscriptDataset(MPI_Comm comm) :
     time(0.),
     externalDomain(false),
     wantsMeshVars(false),
+    persistent(false),
+    vtkEncoding(VTK_ASCII),
+    vtkCompression(0),
+    vtkSplitByRank(false),
+    haveGrid(false),
     mpiComm(comm)
 {
     MPI_Comm_rank(mpiComm, &mpiRank);
@@ -165,6 +516,9 @@ bool EscriptDataset::setDomain(const escript::AbstractDomain* domain)
                 if (mpiSize > 1)
                     dom->reorderGhostZones(mpiRank);
                 domainChunks.push_back(dom);
+                haveGrid = getGridParameters(
+                        dynamic_cast<const ripley::RipleyDomain*>(domain),
+                        gridOrigin, gridSpacing, gridNE);
             } else {
                 cerr << "Error initializing domain!" << endl;
                 myError = 2;
@@ -178,6 +532,9 @@ bool EscriptDataset::setDomain(const escript::AbstractDomain* domain)
                 if (mpiSize > 1)
                     dom->reorderGhostZones(mpiRank);
                 domainChunks.push_back(dom);
+                haveGrid = getGridParameters(
+                        dynamic_cast<const speckley::SpeckleyDomain*>(domain),
+                        gridOrigin, gridSpacing, gridNE);
             } else {
                 cerr << "Error initializing domain!" << endl;
                 myError = 2;
@@ -232,7 +589,9 @@ bool EscriptDataset::addData(escript::Data& data, const string name,
         vi.units = units;
 
         DataVar_ptr var(new DataVar(vi.varName));
-        if (var->initFromEscript(data, domainChunks[0])) {
+        SampleOrder& order =
+            sampleOrders[data.getFunctionSpace().getTypeCode()];
+        if (var->initFromEscript(data, domainChunks[0], &order)) {
             vi.dataChunks.push_back(var);
             updateSampleDistribution(vi);
             vi.valid = true;
@@ -329,6 +688,25 @@ bool EscriptDataset::saveSilo(string fileName, bool useMultiMesh)
         fileName+=".silo";
     }
 
+    // files of a persistent series reference each other by name only
+    string localName(fileName);
+    const size_t slash = localName.find_last_of('/');
+    if (slash != string::npos)
+        localName.erase(0, slash+1);
+
+    // variables that did not change since the last save are referenced.
+    // This is collective so it must happen before the ranks take turns
+    // writing below.
+    vector<string> varFiles(variables.size());
+    const SavedVarMap previousVars(persistent ? siloVars : SavedVarMap());
+    if (persistent) {
+        for (size_t i = 0; i < variables.size(); i++) {
+            if (variables[i].valid &&
+                    !checkVarChanged(variables[i], siloVars, localName, ""))
+                varFiles[i] = siloVars[variables[i].varName].fileName;
+        }
+    }
+
     if (mpiSize > 1) {
 #if WEIPA_HAVE_MPI
         baton = PMPIO_Init(NUM_SILO_FILES, PMPIO_WRITE,
@@ -362,6 +740,9 @@ bool EscriptDataset::saveSilo(string fileName, bool useMultiMesh)
 
     if (!dbfile) {
         cerr << "Could not create Silo file." << endl;
+        // nothing was written so later files must not refer to this one
+        if (persistent)
+            siloVars = previousVars;
         if (mpiSize > 1) {
 #if WEIPA_HAVE_MPI
             PMPIO_HandOffBaton(baton, dbfile);
@@ -402,6 +783,7 @@ bool EscriptDataset::saveSilo(string fileName, bool useMultiMesh)
         for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
             // do not attempt to write this variable if previous steps failed
             if (!viIt->valid) continue;
+            if (!varFiles[viIt-variables.begin()].empty()) continue;
             DataVar_ptr var = viIt->dataChunks[idx];
             if (!var->writeToSilo(dbfile, siloPath, viIt->units)) {
                 cerr << "Error writing block " << idx << " of '"
@@ -428,10 +810,11 @@ bool EscriptDataset::saveSilo(string fileName, bool useMultiMesh)
             for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
                 if (!viIt->valid) continue;
                 DataVar_ptr var = viIt->dataChunks[0];
+                const string& varFile = varFiles[viIt-variables.begin()];
                 if (var->getRank() < 2)
-                    putSiloMultiVar(dbfile, *viIt);
+                    putSiloMultiVar(dbfile, *viIt, false, varFile);
                 else
-                    putSiloMultiTensor(dbfile, *viIt);
+                    putSiloMultiTensor(dbfile, *viIt, varFile);
             }
         }
 
@@ -474,6 +857,14 @@ bool EscriptDataset::saveSilo(string fileName, bool useMultiMesh)
         DBClose(dbfile);
     }
 
+    // subsequent files of a persistent series use the mesh of this file
+    if (persistent && !externalDomain) {
+        for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++) {
+            (*domIt)->setSiloPath(localName + ":" + (*domIt)->getSiloPath());
+        }
+        externalDomain = true;
+    }
+
     return true;
 
 #else // !ESYS_HAVE_SILO
@@ -489,46 +880,16 @@ void EscriptDataset::saveVTK(string fileName)
 {
     if (domainChunks.size() == 0)
         throw WeipaException("EscriptDataset::saveVTK No data was passed to saveVTK");
-
-    map<string,VarVector> varsPerMesh;
+    if (vtkCompression > 0 && mpiSize > 1 && !vtkSplitByRank)
+        throw WeipaException("EscriptDataset::saveVTK Compressed output on more than one rank requires split files");
 
     // determine meshes and variables to write
-    VarVector::iterator viIt;
-    for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
-        // skip empty variable
-        int numSamples = accumulate(viIt->sampleDistribution.begin(),
-                viIt->sampleDistribution.end(), 0);
-        if (numSamples == 0 || !viIt->valid) {
-            continue;
-        }
-        string meshName = viIt->dataChunks[0]->getMeshName();
-
-        // ranks with 0 samples can't know the correct mesh name.
-        // We assume rank 0 always has samples, if this turns out to be a
-        // wrong assumption then a bit more work is needed to get the correct
-        // mesh name to all ranks.
-#if WEIPA_HAVE_MPI
-        if (mpiSize > 1) {
-            char name[100];
-            if (mpiRank == 0) {
-                strncpy(&name[0], meshName.c_str(), 100);
-            }
-
-            MPI_Bcast(name, 100, MPI_CHAR, 0, mpiComm);
-            meshName = name;
-        }
-#endif
+    map<string,VarVector> varsPerMesh;
+    getVariablesPerMesh(varsPerMesh);
 
-        map<string,VarVector>::iterator it = varsPerMesh.find(meshName);
-        if (it != varsPerMesh.end()) {
-            it->second.push_back(*viIt);
-        } else {
-            VarVector v;
-            v.push_back(*viIt);
-            varsPerMesh[meshName] = v;
-        }
+    if (fileName.length() > 5 && fileName.compare(fileName.length()-5, 5, ".pvtu") == 0) {
+        fileName = fileName.substr(0, fileName.length()-5)+".vtu";
     }
-
     if (fileName.length() < 5 || fileName.compare(fileName.length()-4, 4, ".vtu") != 0) {
         fileName+=".vtu";
     }
@@ -555,136 +916,793 @@ void EscriptDataset::saveVTK(string fileName)
 //
 //
 //
-void EscriptDataset::setMeshLabels(const string x, const string y, const string z)
+void EscriptDataset::saveVTKSlice(string fileName, int axis, double position)
 {
-    meshLabels.clear();
-    meshLabels.push_back(x);
-    meshLabels.push_back(y);
-    if (z.length()>0)
-        meshLabels.push_back(z);
+    if (axis < 0 || axis > 2)
+        throw WeipaException("EscriptDataset::saveVTKSlice Invalid axis");
+    saveVTKfiltered(fileName, axis, position, NULL);
 }
 
 //
 //
 //
-void EscriptDataset::setMeshUnits(const string x, const string y, const string z)
+void EscriptDataset::saveVTKRegion(string fileName, double x0, double x1,
+                                   double y0, double y1, double z0, double z1)
 {
-    meshUnits.clear();
-    meshUnits.push_back(x);
-    meshUnits.push_back(y);
-    if (z.length()>0)
-        meshUnits.push_back(z);
+    const double box[6] = { x0, x1, y0, y1, z0, z1 };
+    saveVTKfiltered(fileName, -1, 0., box);
 }
 
 //
+// Writes the nodal variables at every stride-th grid point of a ripley or
+// speckley domain. Every rank selects its owned points and rank 0 writes the
+// assembled image.
 //
-//
-void EscriptDataset::saveVTKsingle(const string& fileName,
-                                   const string& meshName,
-                                   const VarVector& vars)
+void EscriptDataset::saveVTKSubsampled(string fileName, int stride)
 {
-#ifndef VISIT_PLUGIN
-    VarVector nodalVars, cellVars;
-    VarVector::const_iterator viIt;
-    for (viIt = vars.begin(); viIt != vars.end(); viIt++) {
-        const DataChunks& varChunks = viIt->dataChunks;
-        if (varChunks[0]->isNodeCentered()) {
-            nodalVars.push_back(*viIt);
-        } else {
-            cellVars.push_back(*viIt);
-        }
+    if (domainChunks.size() == 0)
+        throw WeipaException("EscriptDataset::saveVTKSubsampled No data was passed to saveVTKSubsampled");
+    if (!haveGrid)
+        throw WeipaException("EscriptDataset::saveVTKSubsampled Subsampling is only supported for ripley and speckley domains");
+    if (stride < 1)
+        throw WeipaException("EscriptDataset::saveVTKSubsampled Stride must be positive");
+
+    if (fileName.length() < 5 || fileName.compare(fileName.length()-4, 4, ".vti") != 0) {
+        fileName+=".vti";
     }
 
-    if (wantsMeshVars) {
-        // add mesh variables if requested
-        for (viIt = meshVariables.begin(); viIt != meshVariables.end(); viIt++) {
-            DataVar_ptr var = viIt->dataChunks[0];
-            if (meshName == var->getMeshName()) {
-                VarInfo vi = *viIt;
-                vi.varName = string(MESH_VARS)+vi.varName;
-                if (var->isNodeCentered()) {
-                    nodalVars.push_back(vi);
-                } else {
-                    cellVars.push_back(vi);
-                }
-            }
+    NodeData_ptr nodes = domainChunks[0]->getNodes();
+    const int numNodes = nodes->getNumNodes();
+    const int numDims = nodes->getNumDims();
+    const CoordArray& coords = nodes->getCoords();
+    const IntVec& nodeGNI = nodes->getGlobalNodeIndices();
+    const IntVec& nodeDist = nodes->getNodeDistribution();
+    const int blockNum = (mpiSize>1 ? mpiRank : 0);
+    const int firstId = (numNodes > 0 ? nodeDist[blockNum] : 0);
+    const int lastId = (numNodes > 0 ? nodeDist[blockNum+1] : 0);
+
+    int numPoints[3] = { 1, 1, 1 };
+    for (int d=0; d<numDims; d++)
+        numPoints[d] = gridNE[d]/stride+1;
+    const int gNumPoints = numPoints[0]*numPoints[1]*numPoints[2];
+
+    // select owned nodes on the grid lines, speckley nodes within elements
+    // are skipped
+    IntVec selected, pointIndex;
+    for (int i=0; i<numNodes; i++) {
+        if (nodeGNI[i] < firstId || nodeGNI[i] >= lastId)
+            continue;
+        int index = 0;
+        bool keep = true;
+        for (int d=numDims-1; d>=0 && keep; d--) {
+            const double x = (coords[d][i]-gridOrigin[d])/gridSpacing[d];
+            const int k = static_cast<int>(floor(x+.5));
+            keep = (fabs(x-k) < 1e-3 && k%stride == 0 && k/stride < numPoints[d]);
+            index = index*numPoints[d]+k/stride;
+        }
+        if (keep) {
+            selected.push_back(i);
+            pointIndex.push_back(index);
         }
     }
 
-    DomainChunks::iterator domIt;
-    int gNumPoints;
-    int gNumCells = 0;
-    int gCellSizeAndType[2] = { 0, 0 };
-
-    boost::scoped_ptr<FileWriter> fw(NULL);
+    VarVector nodalVars;
+    VarVector::const_iterator viIt;
+    for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
+        if (viIt->valid && viIt->dataChunks[0]->isNodeCentered())
+            nodalVars.push_back(*viIt);
+    }
 
-    if (mpiSize > 1) {
+    int numSelected = selected.size();
+    IntVec counts(mpiSize, numSelected), displs(mpiSize, 0);
+    IntVec gPointIndex(pointIndex);
 #if WEIPA_HAVE_MPI
-        fw.reset(new FileWriter(mpiComm));
-        domainChunks[0]->removeGhostZones(mpiRank);
-        ElementData_ptr elements = domainChunks[0]->getElementsByName(meshName);
-        int myNumCells = 0;
-        if (elements) {
-            myNumCells = elements->getNumElements();
-        }
-        MPI_Reduce(&myNumCells, &gNumCells, 1, MPI_INT, MPI_SUM, 0, mpiComm);
+    if (mpiSize > 1) {
+        MPI_Gather(&numSelected, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, mpiComm);
+        for (int r=1; r<mpiSize; r++)
+            displs[r] = displs[r-1]+counts[r-1];
+        gPointIndex.resize(mpiRank == 0 ? displs[mpiSize-1]+counts[mpiSize-1] : 0);
+        MPI_Gatherv(pointIndex.empty() ? NULL : &pointIndex[0], numSelected,
+                MPI_INT, gPointIndex.empty() ? NULL : &gPointIndex[0],
+                &counts[0], &displs[0], MPI_INT, 0, mpiComm);
+    }
+#endif
 
-        int myCellSizeAndType[2] = { 0, 0 };
-        if (elements) {
-            myCellSizeAndType[0] = elements->getNodesPerElement();
-            myCellSizeAndType[1] = elements->getType();
+    vector<VTKArray> arrays;
+    for (viIt = nodalVars.begin(); viIt != nodalVars.end(); viIt++) {
+        const int rank = viIt->dataChunks[0]->getRank();
+        const int numComps = (rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+        FloatVec values, localValues;
+        viIt->dataChunks[0]->getVTKValues(values, blockNum, true);
+        for (int i=0; i<numSelected; i++) {
+            localValues.insert(localValues.end(),
+                    values.begin()+selected[i]*numComps,
+                    values.begin()+(selected[i]+1)*numComps);
+        }
+        FloatVec gValues(localValues);
+#if WEIPA_HAVE_MPI
+        if (mpiSize > 1) {
+            IntVec valueCounts(counts), valueDispls(displs);
+            for (int r=0; r<mpiSize; r++) {
+                valueCounts[r] *= numComps;
+                valueDispls[r] *= numComps;
+            }
+            gValues.resize(gPointIndex.size()*numComps);
+            MPI_Gatherv(localValues.empty() ? NULL : &localValues[0],
+                    numSelected*numComps, MPI_FLOAT,
+                    gValues.empty() ? NULL : &gValues[0], &valueCounts[0],
+                    &valueDispls[0], MPI_FLOAT, 0, mpiComm);
         }
-
-        // rank 0 needs to know element type and size but it's possible that
-        // this information is only available on other ranks (value=0) so
-        // retrieve it
-        MPI_Reduce(&myCellSizeAndType, &gCellSizeAndType, 2, MPI_INT, MPI_MAX,
-                0, mpiComm);
 #endif
-    } else {
-        fw.reset(new FileWriter());
-        int idx = 0;
-        for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++, idx++) {
-            if (domainChunks.size() > 1)
-                (*domIt)->removeGhostZones(idx);
-            ElementData_ptr elements = (*domIt)->getElementsByName(meshName);
-            gNumCells += elements->getNumElements();
-            if (gCellSizeAndType[0] == 0)
-                gCellSizeAndType[0] = elements->getNodesPerElement();
-            if (gCellSizeAndType[1] == 0)
-                gCellSizeAndType[1] = elements->getType();
+        if (mpiRank == 0) {
+            FloatVec image(gNumPoints*numComps, 0.f);
+            for (size_t i=0; i<gPointIndex.size(); i++) {
+                copy(gValues.begin()+i*numComps, gValues.begin()+(i+1)*numComps,
+                     image.begin()+gPointIndex[i]*numComps);
+            }
+            arrays.push_back(VTKArray());
+            setArray(arrays.back(), viIt->varName, "Float32", numComps,
+                     VTKArray::POINT_DATA, image);
         }
     }
 
-    gNumPoints = domainChunks[0]->getNodes()->getGlobalNumNodes();
+    int error = 0;
+    if (mpiRank == 0) {
+        ostringstream extent, grid;
+        extent << " Extent=\"0 " << numPoints[0]-1 << " 0 " << numPoints[1]-1
+            << " 0 " << numPoints[2]-1 << "\"";
+        grid << " WholeExtent=\"0 " << numPoints[0]-1 << " 0 "
+            << numPoints[1]-1 << " 0 " << numPoints[2]-1 << "\" Origin=\""
+            << gridOrigin[0] << " " << gridOrigin[1] << " " << gridOrigin[2]
+            << "\" Spacing=\"" << gridSpacing[0]*stride << " "
+            << gridSpacing[1]*stride << " " << gridSpacing[2]*stride << "\"";
+        if (!saveVTKarrays(fileName, arrays, gNumPoints, 0, false,
+                           "ImageData", grid.str(), extent.str()))
+            error = 1;
+    }
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1)
+        MPI_Bcast(&error, 1, MPI_INT, 0, mpiComm);
+#endif
+    if (error)
+        throw WeipaException("EscriptDataset::saveVTKSubsampled Could not write file "+fileName);
+}
 
-    ostringstream oss;
-    oss.setf(ios_base::scientific, ios_base::floatfield);
+//
+//
+//
+void EscriptDataset::addProbe(double x, double y, double z)
+{
+    probes.push_back(x);
+    probes.push_back(y);
+    probes.push_back(z);
+}
 
-    if (!fw->openFile(fileName)) {
-        throw WeipaException("EscriptDataset::saveVTKsingle Could not open file ");
+//
+// Writes the values of the nodal variables at the owned node closest to
+// each probe. The rank with the closest node contributes the values.
+//
+void EscriptDataset::saveProbes(string fileName, bool append)
+{
+    if (domainChunks.size() == 0)
+        throw WeipaException("EscriptDataset::saveProbes No data was passed to saveProbes");
+
+    NodeData_ptr nodes = domainChunks[0]->getNodes();
+    const int numNodes = nodes->getNumNodes();
+    const int numDims = nodes->getNumDims();
+    const CoordArray& coords = nodes->getCoords();
+    const IntVec& nodeGNI = nodes->getGlobalNodeIndices();
+    const IntVec& nodeDist = nodes->getNodeDistribution();
+    const int blockNum = (mpiSize>1 ? mpiRank : 0);
+    const int firstId = (numNodes > 0 ? nodeDist[blockNum] : 0);
+    const int lastId = (numNodes > 0 ? nodeDist[blockNum+1] : 0);
+    const int numProbes = probes.size()/3;
+
+    // (distance, rank) pairs for MPI_MINLOC
+    struct DistRank { double dist; int rank; };
+    vector<DistRank> local(numProbes), closest(numProbes);
+    IntVec probeNode(numProbes, -1);
+    for (int p=0; p<numProbes; p++) {
+        local[p].dist = numeric_limits<double>::max();
+        local[p].rank = mpiRank;
+        for (int i=0; i<numNodes; i++) {
+            if (nodeGNI[i] < firstId || nodeGNI[i] >= lastId)
+                continue;
+            double dist = 0.;
+            for (int d=0; d<numDims; d++)
+                dist += (coords[d][i]-probes[3*p+d])*(coords[d][i]-probes[3*p+d]);
+            if (dist < local[p].dist) {
+                local[p].dist = dist;
+                probeNode[p] = i;
+            }
+        }
+        closest[p] = local[p];
+    }
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1 && numProbes > 0) {
+        MPI_Allreduce(&local[0], &closest[0], numProbes, MPI_DOUBLE_INT,
+                      MPI_MINLOC, mpiComm);
     }
-
-    if (mpiRank == 0) {
-#ifdef _DEBUG
-        cout << meshName << ": pts=" << gNumPoints << ", cells=" << gNumCells
-            << ", cellsize=" << gCellSizeAndType[0] << ", type="
-            << gCellSizeAndType[1] << ", numNodalVars=" << nodalVars.size()
-            << ", numCellVars=" << cellVars.size()
-            << endl;
 #endif
 
-        oss << "<?xml version=\"1.0\"?>" << endl;
-        oss << "<VTKFile type=\"UnstructuredGrid\" version=\"0.1\"";
-        if (mdSchema.length()>0) {
-            oss << " " << mdSchema;
-        }
-        oss << ">" << endl;
-        if (mdString.length()>0) {
-            oss << "<MetaData>" << endl << mdString << endl
-                << "</MetaData>" << endl;
-        }
-        oss << "<UnstructuredGrid>" << endl;
+    // column names and value indices of the nodal variables, VTK padding of
+    // vectors and tensors is removed again
+    StringVec columns;
+    vector<pair<DataVar_ptr,int> > sources;
+    VarVector::const_iterator viIt;
+    for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
+        if (!viIt->valid || !viIt->dataChunks[0]->isNodeCentered())
+            continue;
+        DataVar_ptr var = viIt->dataChunks[0];
+        const IntVec& shape = var->getShape();
+        const int rank = var->getRank();
+        const int n0 = (rank > 0 ? shape[0] : 1);
+        const int n1 = (rank > 1 ? shape[1] : 1);
+        for (int i=0; i<n0; i++) {
+            for (int j=0; j<n1; j++) {
+                ostringstream name;
+                name << viIt->varName;
+                if (rank > 0)
+                    name << "_" << i;
+                if (rank > 1)
+                    name << j;
+                columns.push_back(name.str());
+                sources.push_back(make_pair(var, rank > 1 ? 3*i+j : i));
+            }
+        }
+    }
+    const int numColumns = columns.size();
+
+    FloatVec values(numProbes*numColumns, 0.f);
+    DataVar_ptr lastVar;
+    FloatVec varValues;
+    int numComps = 1;
+    for (int c=0; c<numColumns; c++) {
+        if (sources[c].first != lastVar) {
+            lastVar = sources[c].first;
+            const int rank = lastVar->getRank();
+            numComps = (rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+            varValues.clear();
+            lastVar->getVTKValues(varValues, blockNum, true);
+        }
+        for (int p=0; p<numProbes; p++) {
+            if (closest[p].rank == mpiRank && probeNode[p] >= 0) {
+                values[p*numColumns+c] =
+                    varValues[probeNode[p]*numComps+sources[c].second];
+            }
+        }
+    }
+
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1 && !values.empty()) {
+        MPI_Reduce(mpiRank == 0 ? MPI_IN_PLACE : &values[0], &values[0],
+                   values.size(), MPI_FLOAT, MPI_SUM, 0, mpiComm);
+    }
+#endif
+
+    int error = 0;
+    if (mpiRank == 0) {
+        ofstream ofs(fileName.c_str(), append ? ios_base::app : ios_base::trunc);
+        ofs.setf(ios_base::scientific, ios_base::floatfield);
+        ofs.precision(8);
+        if (!append) {
+            ofs << "cycle,time,probe,x,y,z";
+            for (int c=0; c<numColumns; c++)
+                ofs << "," << columns[c];
+            ofs << endl;
+        }
+        for (int p=0; p<numProbes; p++) {
+            ofs << cycle << "," << time << "," << p << "," << probes[3*p]
+                << "," << probes[3*p+1] << "," << probes[3*p+2];
+            for (int c=0; c<numColumns; c++)
+                ofs << "," << values[p*numColumns+c];
+            ofs << endl;
+        }
+        ofs.close();
+        if (ofs.fail())
+            error = 1;
+    }
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1)
+        MPI_Bcast(&error, 1, MPI_INT, 0, mpiComm);
+#endif
+    if (error)
+        throw WeipaException("EscriptDataset::saveProbes Could not write file "+fileName);
+}
+
+//
+//
+//
+void EscriptDataset::saveHDF5(string fileName, bool append,
+                              int compressionLevel)
+{
+#ifdef ESYS_HAVE_HDF5
+    if (domainChunks.size() == 0)
+        throw WeipaException("EscriptDataset::saveHDF5 No data was passed to saveHDF5");
+    if (compressionLevel < 0 || compressionLevel > 9)
+        throw WeipaException("EscriptDataset::saveHDF5 Compression level must be between 0 and 9");
+#ifndef H5_HAVE_PARALLEL
+    if (mpiSize > 1)
+        throw WeipaException("EscriptDataset::saveHDF5 HDF5 library does not support parallel output");
+#endif
+
+    if (fileName.length() > 3 && fileName.compare(fileName.length()-3, 3, ".h5") == 0) {
+        fileName = fileName.substr(0, fileName.length()-3);
+    } else if (fileName.length() > 4 && fileName.compare(fileName.length()-4, 4, ".xmf") == 0) {
+        fileName = fileName.substr(0, fileName.length()-4);
+    }
+    const string h5Name(fileName+".h5");
+
+    map<string,VarVector> varsPerMesh;
+    getVariablesPerMesh(varsPerMesh);
+    if (varsPerMesh.empty()) {
+        // no valid variables so just write default mesh
+        varsPerMesh["Elements"] = VarVector();
+    }
+
+    // every rank writes the nodes and elements it owns
+    int startBlock = 0;
+    if (mpiSize > 1) {
+        domainChunks[0]->removeGhostZones(mpiRank);
+        startBlock = mpiRank;
+    } else if (domainChunks.size() > 1) {
+        for (size_t idx = 0; idx < domainChunks.size(); idx++)
+            domainChunks[idx]->removeGhostZones(idx);
+    }
+
+    // owned nodes are written sorted by global index, nodePos holds the row
+    // of each owned node in local order
+    const IntVec& firstDist = domainChunks[0]->getNodes()->getNodeDistribution();
+    const int gNumPoints = domainChunks[0]->getNodes()->getGlobalNumNodes();
+    const int firstNode = (firstDist.empty() ? 0 : firstDist[startBlock]);
+    const int lastNode = (firstDist.empty() ? 0 :
+            firstDist[startBlock+domainChunks.size()]);
+    IntVec nodePos;
+    FloatVec points(3*(lastNode-firstNode), 0.f);
+    int blockNum = startBlock;
+    DomainChunks::iterator domIt;
+    for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++, blockNum++) {
+        NodeData_ptr nodes = (*domIt)->getNodes();
+        const int numNodes = nodes->getNumNodes();
+        if (numNodes == 0)
+            continue;
+        const CoordArray& coords = nodes->getCoords();
+        const IntVec& nodeGNI = nodes->getGlobalNodeIndices();
+        const IntVec& nodeDist = nodes->getNodeDistribution();
+        for (int i=0; i<numNodes; i++) {
+            if (nodeDist[blockNum] <= nodeGNI[i] && nodeGNI[i] < nodeDist[blockNum+1]) {
+                const int row = nodeGNI[i]-firstNode;
+                nodePos.push_back(row);
+                points[3*row] = coords[0][i];
+                points[3*row+1] = coords[1][i];
+                if (nodes->getNumDims() == 3)
+                    points[3*row+2] = coords[2][i];
+            }
+        }
+    }
+
+    int error = 0;
+    hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    hid_t xfer = H5Pcreate(H5P_DATASET_XFER);
+#if WEIPA_HAVE_MPI && defined(H5_HAVE_PARALLEL)
+    if (mpiSize > 1) {
+        H5Pset_fapl_mpio(fapl, mpiComm, MPI_INFO_NULL);
+        H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
+    }
+#endif
+
+    int exists = 0;
+    if (append && mpiRank == 0) {
+        H5E_BEGIN_TRY {
+            exists = (H5Fis_hdf5(h5Name.c_str()) > 0 ? 1 : 0);
+        } H5E_END_TRY;
+    }
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1)
+        MPI_Bcast(&exists, 1, MPI_INT, 0, mpiComm);
+#endif
+    hid_t file = (exists ?
+            H5Fopen(h5Name.c_str(), H5F_ACC_RDWR, fapl) :
+            H5Fcreate(h5Name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl));
+    H5Pclose(fapl);
+    if (file < 0) {
+        H5Pclose(xfer);
+        throw WeipaException("EscriptDataset::saveHDF5 Could not open file "+h5Name);
+    }
+    // values saved before can only be linked if they are in this file
+    if (!exists)
+        hdf5Vars.clear();
+
+    // the nodes are only written once, appended steps must use the same mesh
+    hid_t meshGroup;
+    if (H5Lexists(file, "Mesh", H5P_DEFAULT) > 0) {
+        meshGroup = H5Gopen2(file, "Mesh", H5P_DEFAULT);
+        hsize_t dims[2];
+        getHDF5Dims(meshGroup, "Points", dims);
+        if (dims[0] != (hsize_t)gNumPoints)
+            error = 1;
+    } else {
+        meshGroup = H5Gcreate2(file, "Mesh", H5P_DEFAULT, H5P_DEFAULT,
+                               H5P_DEFAULT);
+        if (!writeHDF5Array(meshGroup, "Points", H5T_NATIVE_FLOAT,
+                    H5T_IEEE_F32LE, points.empty() ? NULL : &points[0],
+                    gNumPoints, 3, firstNode, lastNode-firstNode,
+                    compressionLevel, xfer))
+            error = 1;
+    }
+
+    // the file only holds the mesh and one group per step
+    hid_t stepGroup = -1;
+    char stepName[20];
+    if (!error) {
+        H5G_info_t rootInfo;
+        H5Gget_info(file, &rootInfo);
+        snprintf(stepName, 20, "Step_%06d", (int)rootInfo.nlinks-1);
+        stepGroup = H5Gcreate2(file, stepName, H5P_DEFAULT, H5P_DEFAULT,
+                               H5P_DEFAULT);
+        putHDF5Attribute(stepGroup, "Time", H5T_NATIVE_DOUBLE, &time);
+        putHDF5Attribute(stepGroup, "Cycle", H5T_NATIVE_INT, &cycle);
+    }
+
+    map<string,VarVector>::const_iterator vpmIt;
+    for (vpmIt=varsPerMesh.begin(); vpmIt!=varsPerMesh.end() && !error; vpmIt++) {
+        const string& meshName = vpmIt->first;
+        IntVec connectivity;
+        int myCellSizeAndType[2] = { 0, 0 };
+        for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++) {
+            ElementData_ptr el = (*domIt)->getElementsByName(meshName);
+            if (!el || el->getNumElements() == 0)
+                continue;
+            const IntVec& nodeList = el->getNodeList();
+            const IntVec& elGNI = el->getNodes()->getGlobalNodeIndices();
+            const int n = el->getNumElements()*el->getNodesPerElement();
+            for (int i=0; i<n; i++)
+                connectivity.push_back(elGNI[nodeList[i]]);
+            myCellSizeAndType[0] = el->getNodesPerElement();
+            myCellSizeAndType[1] = el->getType();
+        }
+        int cellSizeAndType[2] = { myCellSizeAndType[0], myCellSizeAndType[1] };
+        int numCells = (cellSizeAndType[0] > 0 ?
+                connectivity.size()/cellSizeAndType[0] : 0);
+        int gNumCells = numCells, firstCell = 0;
+#if WEIPA_HAVE_MPI
+        if (mpiSize > 1) {
+            MPI_Allreduce(myCellSizeAndType, cellSizeAndType, 2, MPI_INT,
+                          MPI_MAX, mpiComm);
+            MPI_Allreduce(&numCells, &gNumCells, 1, MPI_INT, MPI_SUM, mpiComm);
+            MPI_Exscan(&numCells, &firstCell, 1, MPI_INT, MPI_SUM, mpiComm);
+            if (mpiRank == 0)
+                firstCell = 0;
+        }
+#endif
+        if (cellSizeAndType[0] == 0)
+            continue;
+
+        if (H5Lexists(meshGroup, meshName.c_str(), H5P_DEFAULT) <= 0) {
+            hid_t group = H5Gcreate2(meshGroup, meshName.c_str(),
+                                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            putHDF5Attribute(group, "Type", H5T_NATIVE_INT,
+                             &cellSizeAndType[1]);
+            if (!writeHDF5Array(group, "Connectivity", H5T_NATIVE_INT,
+                        H5T_STD_I32LE,
+                        connectivity.empty() ? NULL : &connectivity[0],
+                        gNumCells, cellSizeAndType[0], firstCell, numCells,
+                        compressionLevel, xfer))
+                error = 1;
+            H5Gclose(group);
+        }
+
+        VarVector::const_iterator viIt;
+        for (viIt = vpmIt->second.begin(); viIt != vpmIt->second.end(); viIt++) {
+            // '/' would create a nested group
+            string name(viIt->varName);
+            std::replace(name.begin(), name.end(), '/', '_');
+            const string path = string(stepName)+"/"+name;
+            if (persistent &&
+                    !checkVarChanged(*viIt, hdf5Vars, h5Name, path)) {
+                // link to the unchanged values of a previous step
+                SavedVar& sv = hdf5Vars[viIt->varName];
+                const string prevStep = sv.path.substr(0, sv.path.find('/'));
+                if (H5Lexists(file, prevStep.c_str(), H5P_DEFAULT) > 0 &&
+                        H5Lexists(file, sv.path.c_str(), H5P_DEFAULT) > 0) {
+                    if (H5Lcreate_hard(file, sv.path.c_str(), stepGroup,
+                                name.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0) {
+                        error = 1;
+                        break;
+                    }
+                    continue;
+                }
+                sv.path = path;
+            }
+            const DataChunks& varChunks = viIt->dataChunks;
+            const bool nodal = varChunks[0]->isNodeCentered();
+            const int rank = varChunks[0]->getRank();
+            const int numComps = (rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+            FloatVec values;
+            int varBlock = startBlock;
+            DataChunks::const_iterator blockIt;
+            for (blockIt = varChunks.begin(); blockIt != varChunks.end(); blockIt++, varBlock++) {
+                (*blockIt)->getVTKValues(values, varBlock);
+            }
+            if (nodal) {
+                // same order as the points
+                FloatVec sorted(numComps*(lastNode-firstNode), 0.f);
+                for (size_t i=0; i<nodePos.size() && (i+1)*numComps<=values.size(); i++) {
+                    std::copy(&values[i*numComps], &values[(i+1)*numComps],
+                              &sorted[nodePos[i]*numComps]);
+                }
+                values.swap(sorted);
+            }
+            if (!writeHDF5Array(stepGroup, name, H5T_NATIVE_FLOAT,
+                        H5T_IEEE_F32LE, values.empty() ? NULL : &values[0],
+                        nodal ? gNumPoints : gNumCells, numComps,
+                        nodal ? firstNode : firstCell,
+                        values.size()/numComps, compressionLevel, xfer)) {
+                error = 1;
+                break;
+            }
+            hid_t dset = H5Dopen2(stepGroup, name.c_str(), H5P_DEFAULT);
+            putHDF5Attribute(dset, "Mesh", meshName);
+            putHDF5Attribute(dset, "Center", string(nodal ? "Node" : "Cell"));
+            H5Dclose(dset);
+        }
+    }
+
+    if (stepGroup >= 0)
+        H5Gclose(stepGroup);
+    H5Gclose(meshGroup);
+    H5Pclose(xfer);
+    if (H5Fclose(file) < 0)
+        error = 1;
+
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1) {
+        int localError = error;
+        MPI_Allreduce(&localError, &error, 1, MPI_INT, MPI_MAX, mpiComm);
+    }
+#endif
+    if (error)
+        throw WeipaException("EscriptDataset::saveHDF5 Could not write "+h5Name);
+
+    if (mpiRank == 0)
+        writeXDMF(h5Name, fileName+".xmf");
+#else // ESYS_HAVE_HDF5
+    throw WeipaException("EscriptDataset::saveHDF5 weipa was compiled without HDF5 support");
+#endif
+}
+
+//
+// Writes an XDMF file with one temporal collection per mesh which
+// references the datasets in the HDF5 file
+//
+void EscriptDataset::writeXDMF(const string& h5Name, const string& xmfName) const
+{
+#ifdef ESYS_HAVE_HDF5
+    hid_t file = H5Fopen(h5Name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file < 0)
+        throw WeipaException("EscriptDataset::writeXDMF Could not open file "+h5Name);
+
+    // data items are referenced relative to the XDMF file
+    string h5Ref(h5Name);
+    const size_t slash = h5Ref.find_last_of("/\\");
+    if (slash != string::npos)
+        h5Ref = h5Ref.substr(slash+1);
+
+    hid_t meshGroup = H5Gopen2(file, "Mesh", H5P_DEFAULT);
+    hsize_t pointDims[2];
+    getHDF5Dims(meshGroup, "Points", pointDims);
+    const StringVec steps(getHDF5LinkNames(file));
+    const StringVec meshes(getHDF5LinkNames(meshGroup));
+
+    ofstream ofs(xmfName.c_str());
+    ofs << "<?xml version=\"1.0\" ?>" << endl;
+    ofs << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>" << endl;
+    ofs << "<Xdmf Version=\"3.0\">" << endl << "<Domain>" << endl;
+    StringVec::const_iterator meshIt, stepIt;
+    for (meshIt = meshes.begin(); meshIt != meshes.end(); meshIt++) {
+        if (*meshIt == "Points")
+            continue;
+        hid_t group = H5Gopen2(meshGroup, meshIt->c_str(), H5P_DEFAULT);
+        int type;
+        hsize_t cellDims[2];
+        getHDF5Attribute(group, "Type", H5T_NATIVE_INT, &type);
+        getHDF5Dims(group, "Connectivity", cellDims);
+        H5Gclose(group);
+
+        ofs << "<Grid Name=\"" << *meshIt
+            << "\" GridType=\"Collection\" CollectionType=\"Temporal\">"
+            << endl;
+        for (stepIt = steps.begin(); stepIt != steps.end(); stepIt++) {
+            if (*stepIt == "Mesh")
+                continue;
+            hid_t step = H5Gopen2(file, stepIt->c_str(), H5P_DEFAULT);
+            double stepTime;
+            getHDF5Attribute(step, "Time", H5T_NATIVE_DOUBLE, &stepTime);
+            ofs << "<Grid Name=\"" << *meshIt << "_" << *stepIt
+                << "\" GridType=\"Uniform\">" << endl;
+            ofs << "<Time Value=\"" << setprecision(16) << stepTime << "\"/>"
+                << endl;
+            ofs << "<Topology TopologyType=\"" << xdmfTopologyType(type)
+                << "\" NumberOfElements=\"" << cellDims[0]
+                << "\" NodesPerElement=\"" << cellDims[1] << "\">" << endl;
+            ofs << "<DataItem Dimensions=\"" << cellDims[0] << " "
+                << cellDims[1] << "\" NumberType=\"Int\" Precision=\"4\" "
+                << "Format=\"HDF\">" << h5Ref << ":/Mesh/" << *meshIt
+                << "/Connectivity</DataItem>" << endl << "</Topology>" << endl;
+            ofs << "<Geometry GeometryType=\"XYZ\">" << endl;
+            ofs << "<DataItem Dimensions=\"" << pointDims[0]
+                << " 3\" NumberType=\"Float\" Precision=\"4\" "
+                << "Format=\"HDF\">" << h5Ref << ":/Mesh/Points</DataItem>"
+                << endl << "</Geometry>" << endl;
+
+            const StringVec vars(getHDF5LinkNames(step));
+            StringVec::const_iterator varIt;
+            for (varIt = vars.begin(); varIt != vars.end(); varIt++) {
+                hid_t dset = H5Dopen2(step, varIt->c_str(), H5P_DEFAULT);
+                const string varMesh(getHDF5Attribute(dset, "Mesh"));
+                const string center(getHDF5Attribute(dset, "Center"));
+                H5Dclose(dset);
+                if (varMesh != *meshIt)
+                    continue;
+                hsize_t dims[2];
+                getHDF5Dims(step, *varIt, dims);
+                ofs << "<Attribute Name=\"" << *varIt << "\" AttributeType=\""
+                    << (dims[1] == 1 ? "Scalar" : (dims[1] == 3 ? "Vector" : "Tensor"))
+                    << "\" Center=\"" << center << "\">" << endl;
+                ofs << "<DataItem Dimensions=\"" << dims[0] << " " << dims[1]
+                    << "\" NumberType=\"Float\" Precision=\"4\" "
+                    << "Format=\"HDF\">" << h5Ref << ":/" << *stepIt << "/"
+                    << *varIt << "</DataItem>" << endl << "</Attribute>" << endl;
+            }
+            H5Gclose(step);
+            ofs << "</Grid>" << endl;
+        }
+        ofs << "</Grid>" << endl;
+    }
+    ofs << "</Domain>" << endl << "</Xdmf>" << endl;
+    H5Gclose(meshGroup);
+    H5Fclose(file);
+    if (ofs.fail())
+        throw WeipaException("EscriptDataset::writeXDMF Could not write "+xmfName);
+#endif
+}
+
+//
+//
+//
+void EscriptDataset::setMeshLabels(const string x, const string y, const string z)
+{
+    meshLabels.clear();
+    meshLabels.push_back(x);
+    meshLabels.push_back(y);
+    if (z.length()>0)
+        meshLabels.push_back(z);
+}
+
+//
+//
+//
+void EscriptDataset::setMeshUnits(const string x, const string y, const string z)
+{
+    meshUnits.clear();
+    meshUnits.push_back(x);
+    meshUnits.push_back(y);
+    if (z.length()>0)
+        meshUnits.push_back(z);
+}
+
+//
+//
+//
+void EscriptDataset::setVTKEncoding(VTKEncoding encoding, int compressionLevel)
+{
+    if (compressionLevel < 0 || compressionLevel > 9)
+        throw WeipaException("EscriptDataset::setVTKEncoding Compression level must be between 0 and 9");
+    if (compressionLevel > 0 && encoding == VTK_ASCII)
+        throw WeipaException("EscriptDataset::setVTKEncoding ASCII output cannot be compressed");
+#ifndef ESYS_HAVE_BOOST_IO
+    if (compressionLevel > 0)
+        throw WeipaException("EscriptDataset::setVTKEncoding weipa was compiled without compression support");
+#endif
+    vtkEncoding = encoding;
+    vtkCompression = compressionLevel;
+}
+
+//
+//
+//
+void EscriptDataset::saveVTKsingle(const string& fileName,
+                                   const string& meshName,
+                                   const VarVector& vars)
+{
+#ifndef VISIT_PLUGIN
+    VarVector nodalVars, cellVars;
+    VarVector::const_iterator viIt;
+    splitVTKVars(meshName, vars, nodalVars, cellVars);
+
+    DomainChunks::iterator domIt;
+    int gNumPoints;
+    int gNumCells = 0;
+    int gCellSizeAndType[2] = { 0, 0 };
+
+    boost::scoped_ptr<FileWriter> fw(NULL);
+
+    if (mpiSize > 1) {
+#if WEIPA_HAVE_MPI
+        fw.reset(new FileWriter(mpiComm));
+        domainChunks[0]->removeGhostZones(mpiRank);
+        ElementData_ptr elements = domainChunks[0]->getElementsByName(meshName);
+        int myNumCells = 0;
+        if (elements) {
+            myNumCells = elements->getNumElements();
+        }
+        MPI_Reduce(&myNumCells, &gNumCells, 1, MPI_INT, MPI_SUM, 0, mpiComm);
+
+        int myCellSizeAndType[2] = { 0, 0 };
+        if (elements) {
+            myCellSizeAndType[0] = elements->getNodesPerElement();
+            myCellSizeAndType[1] = elements->getType();
+        }
+
+        // all ranks need to know element type and size but it's possible that
+        // this information is only available on some ranks (value=0) so
+        // retrieve it
+        MPI_Allreduce(&myCellSizeAndType, &gCellSizeAndType, 2, MPI_INT,
+                MPI_MAX, mpiComm);
+#endif
+    } else {
+        fw.reset(new FileWriter());
+        int idx = 0;
+        for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++, idx++) {
+            if (domainChunks.size() > 1)
+                (*domIt)->removeGhostZones(idx);
+            ElementData_ptr elements = (*domIt)->getElementsByName(meshName);
+            gNumCells += elements->getNumElements();
+            if (gCellSizeAndType[0] == 0)
+                gCellSizeAndType[0] = elements->getNodesPerElement();
+            if (gCellSizeAndType[1] == 0)
+                gCellSizeAndType[1] = elements->getType();
+        }
+    }
+
+    gNumPoints = domainChunks[0]->getNodes()->getGlobalNumNodes();
+
+    if (vtkSplitByRank) {
+        // a single process writes the whole mesh as one piece
+        vector<VTKArray> arrays;
+        getVTKArrays(meshName, nodalVars, cellVars, gCellSizeAndType[0],
+                     gCellSizeAndType[1], mpiSize>1, arrays);
+        saveVTKpieces(fileName, arrays);
+        return;
+    } else if (vtkEncoding != VTK_ASCII) {
+        vector<VTKArray> arrays;
+        getVTKArrays(meshName, nodalVars, cellVars, gCellSizeAndType[0],
+                     gCellSizeAndType[1], false, arrays);
+        int localPoints = arrays[0].bytes.size()/(3*sizeof(float));
+        int localCells = arrays[3].bytes.size();
+        if (!saveVTKarrays(fileName, arrays, localPoints, localCells, mpiSize>1))
+            throw WeipaException("EscriptDataset::saveVTKsingle Could not write file "+fileName);
+        return;
+    }
+
+    ostringstream oss;
+    oss.setf(ios_base::scientific, ios_base::floatfield);
+
+    if (!fw->openFile(fileName)) {
+        throw WeipaException("EscriptDataset::saveVTKsingle Could not open file ");
+    }
+
+    if (mpiRank == 0) {
+#ifdef _DEBUG
+        cout << meshName << ": pts=" << gNumPoints << ", cells=" << gNumCells
+            << ", cellsize=" << gCellSizeAndType[0] << ", type="
+            << gCellSizeAndType[1] << ", numNodalVars=" << nodalVars.size()
+            << ", numCellVars=" << cellVars.size()
+            << endl;
+#endif
+
+        writeVTKHeader(oss, "UnstructuredGrid", false);
+        oss << "<UnstructuredGrid>" << endl;
 
         // write time and cycle values
         oss << "<FieldData>" << endl;
@@ -831,6 +1849,705 @@ void EscriptDataset::writeVarToVTK(const VarInfo& varInfo, ostream& os)
     }
 }
 
+//
+// Writes the XML declaration, the VTKFile tag and the metadata
+//
+void EscriptDataset::writeVTKHeader(ostream& os, const string& type,
+                                    bool binary) const
+{
+    os << "<?xml version=\"1.0\"?>" << endl;
+    os << "<VTKFile type=\"" << type << "\"";
+    if (binary) {
+        os << " version=\"1.0\" byte_order=\""
+            << (isLittleEndian() ? "LittleEndian" : "BigEndian")
+            << "\" header_type=\"UInt64\"";
+        if (vtkCompression > 0)
+            os << " compressor=\"vtkZLibDataCompressor\"";
+    } else {
+        os << " version=\"0.1\"";
+    }
+    if (mdSchema.length()>0) {
+        os << " " << mdSchema;
+    }
+    os << ">" << endl;
+    if (mdString.length()>0) {
+        os << "<MetaData>" << endl << mdString << endl
+            << "</MetaData>" << endl;
+    }
+}
+
+//
+// Collects points, cells and variables of this rank in binary form.
+// If localPiece is true all local nodes are included and connectivity refers
+// to local node numbers, otherwise only owned nodes are included and
+// connectivity uses global node numbers.
+//
+void EscriptDataset::getVTKArrays(const string& meshName,
+                                  const VarVector& nodalVars,
+                                  const VarVector& cellVars,
+                                  int cellSize, int cellType,
+                                  bool localPiece, vector<VTKArray>& arrays)
+{
+    FloatVec points;
+    IntVec connectivity;
+    int numCells = 0;
+    int blockNum = (mpiSize>1 ? mpiRank : 0);
+    DomainChunks::iterator domIt;
+    for (domIt = domainChunks.begin(); domIt != domainChunks.end(); domIt++, blockNum++) {
+        NodeData_ptr nodes = (*domIt)->getNodes();
+        const int numNodes = nodes->getNumNodes();
+        const int numDims = nodes->getNumDims();
+        const CoordArray& coords = nodes->getCoords();
+        const IntVec& nodeGNI = nodes->getGlobalNodeIndices();
+        const IntVec& nodeDist = nodes->getNodeDistribution();
+        const int firstId = (numNodes > 0 ? nodeDist[blockNum] : 0);
+        const int lastId = (numNodes > 0 ? nodeDist[blockNum+1] : 0);
+        for (int i=0; i<numNodes; i++) {
+            if (localPiece || (firstId <= nodeGNI[i] && nodeGNI[i] < lastId)) {
+                points.push_back(coords[0][i]);
+                points.push_back(coords[1][i]);
+                points.push_back(numDims == 3 ? coords[2][i] : 0.f);
+            }
+        }
+
+        ElementData_ptr el = (*domIt)->getElementsByName(meshName);
+        if (!el || el->getNumElements() == 0)
+            continue;
+        const int numElements = el->getNumElements();
+        const IntVec& nodeList = el->getNodeList();
+        const IntVec& elGNI = el->getNodes()->getGlobalNodeIndices();
+        if (localPiece) {
+            // elements may refer to a different (e.g. reduced) node mesh
+            IndexMap gni2local;
+            if (el->getNodes() != nodes) {
+                for (int i=0; i<numNodes; i++)
+                    gni2local[nodeGNI[i]] = i;
+            }
+            for (int i=0; i<numElements*cellSize; i++) {
+                if (el->getNodes() == nodes)
+                    connectivity.push_back(nodeList[i]);
+                else
+                    connectivity.push_back(gni2local[elGNI[nodeList[i]]]);
+            }
+        } else {
+            for (int i=0; i<numElements*cellSize; i++)
+                connectivity.push_back(elGNI[nodeList[i]]);
+        }
+        numCells += numElements;
+    }
+
+    // offsets are global in a shared file
+    int firstCell = 0;
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1 && !localPiece) {
+        MPI_Exscan(&numCells, &firstCell, 1, MPI_INT, MPI_SUM, mpiComm);
+        if (mpiRank == 0)
+            firstCell = 0;
+    }
+#endif
+    IntVec offsets(numCells);
+    for (int i=0; i<numCells; i++)
+        offsets[i] = (firstCell+i+1)*cellSize;
+    vector<unsigned char> types(numCells, static_cast<unsigned char>(cellType));
+
+    arrays.resize(4);
+    setArray(arrays[0], "", "Float32", 3, VTKArray::POINTS, points);
+    setArray(arrays[1], "connectivity", "Int32", 1, VTKArray::CELLS, connectivity);
+    setArray(arrays[2], "offsets", "Int32", 1, VTKArray::CELLS, offsets);
+    setArray(arrays[3], "types", "UInt8", 1, VTKArray::CELLS, types);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const VarVector& vars = (pass == 0 ? nodalVars : cellVars);
+        VarVector::const_iterator viIt;
+        for (viIt = vars.begin(); viIt != vars.end(); viIt++) {
+            const DataChunks& varChunks = viIt->dataChunks;
+            const int rank = varChunks[0]->getRank();
+            const int numComps = (rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+            FloatVec values;
+            int varBlock = (mpiSize>1 ? mpiRank : 0);
+            DataChunks::const_iterator blockIt;
+            for (blockIt = varChunks.begin(); blockIt != varChunks.end(); blockIt++, varBlock++) {
+                (*blockIt)->getVTKValues(values, varBlock, localPiece);
+            }
+            arrays.push_back(VTKArray());
+            setArray(arrays.back(), viIt->varName, "Float32", numComps,
+                     pass == 0 ? VTKArray::POINT_DATA : VTKArray::CELL_DATA,
+                     values);
+        }
+    }
+}
+
+//
+// Sorts the variables of a mesh into nodal and cell variables and adds the
+// mesh variables if requested
+//
+void EscriptDataset::splitVTKVars(const string& meshName,
+                                  const VarVector& vars,
+                                  VarVector& nodalVars,
+                                  VarVector& cellVars) const
+{
+    VarVector::const_iterator viIt;
+    for (viIt = vars.begin(); viIt != vars.end(); viIt++) {
+        const DataChunks& varChunks = viIt->dataChunks;
+        if (varChunks[0]->isNodeCentered()) {
+            nodalVars.push_back(*viIt);
+        } else {
+            cellVars.push_back(*viIt);
+        }
+    }
+
+    if (wantsMeshVars) {
+        // add mesh variables if requested
+        for (viIt = meshVariables.begin(); viIt != meshVariables.end(); viIt++) {
+            DataVar_ptr var = viIt->dataChunks[0];
+            if (meshName == var->getMeshName()) {
+                VarInfo vi = *viIt;
+                vi.varName = string(MESH_VARS)+vi.varName;
+                if (var->isNodeCentered()) {
+                    nodalVars.push_back(vi);
+                } else {
+                    cellVars.push_back(vi);
+                }
+            }
+        }
+    }
+}
+
+//
+// Collects the part of the mesh of this rank which is either within box
+// (if box is not NULL) or the intersection with the plane x[axis]=position.
+// Only owned cells are considered. Points are local to this rank so
+// connectivity is offset by the points of lower ranks unless localPiece is
+// true. Returns false if the mesh cannot be sliced.
+//
+bool EscriptDataset::getFilteredVTKArrays(const string& meshName,
+                                          const VarVector& nodalVars,
+                                          const VarVector& cellVars,
+                                          int axis, double position,
+                                          const double* box, bool localPiece,
+                                          vector<VTKArray>& arrays)
+{
+    // edges of the supported cell types by local node numbers
+    static const int triEdges[] = { 0,1, 1,2, 2,0 };
+    static const int quadEdges[] = { 0,1, 1,2, 2,3, 3,0 };
+    static const int tetEdges[] = { 0,1, 1,2, 2,0, 0,3, 1,3, 2,3 };
+    static const int hexEdges[] = { 0,1, 1,2, 2,3, 3,0, 4,5, 5,6, 6,7, 7,4,
+                                    0,4, 1,5, 2,6, 3,7 };
+
+    FloatVec points;
+    IntVec connectivity, offsets;
+    vector<unsigned char> types;
+    vector<FloatVec> pointValues(nodalVars.size()), cellValues(cellVars.size());
+    IntVec nodalComps, cellComps;
+    for (size_t v=0; v<nodalVars.size(); v++) {
+        const int rank = nodalVars[v].dataChunks[0]->getRank();
+        nodalComps.push_back(rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+    }
+    for (size_t v=0; v<cellVars.size(); v++) {
+        const int rank = cellVars[v].dataChunks[0]->getRank();
+        cellComps.push_back(rank == 0 ? 1 : (rank == 1 ? 3 : 9));
+    }
+
+    bool ok = true;
+    int blockNum = (mpiSize>1 ? mpiRank : 0);
+    for (size_t chunk = 0; chunk < domainChunks.size(); chunk++, blockNum++) {
+        ElementData_ptr el = domainChunks[chunk]->getElementsByName(meshName);
+        if (!el || el->getNumElements() == 0)
+            continue;
+        NodeData_ptr nodes = domainChunks[chunk]->getNodes();
+        NodeData_ptr elNodes = el->getNodes();
+        const int numDims = nodes->getNumDims();
+        const int cellSize = el->getNodesPerElement();
+        const int numOwned = el->getNumElements()-el->getGhostCount();
+        const IntVec& nodeList = el->getNodeList();
+        const IntVec& elGNI = elNodes->getGlobalNodeIndices();
+        const CoordArray& coords = elNodes->getCoords();
+
+        // elements may refer to a different (e.g. reduced) node mesh than
+        // the one nodal values are defined on
+        IntVec elNode2node(elNodes->getNumNodes());
+        if (elNodes == nodes) {
+            for (size_t i=0; i<elNode2node.size(); i++)
+                elNode2node[i] = i;
+        } else {
+            IndexMap gni2local;
+            const IntVec& nodeGNI = nodes->getGlobalNodeIndices();
+            for (int i=0; i<nodes->getNumNodes(); i++)
+                gni2local[nodeGNI[i]] = i;
+            for (size_t i=0; i<elNode2node.size(); i++)
+                elNode2node[i] = gni2local[elGNI[i]];
+        }
+
+        vector<FloatVec> nodeVals(nodalVars.size()), cellVals(cellVars.size());
+        for (size_t v=0; v<nodalVars.size(); v++)
+            nodalVars[v].dataChunks[chunk]->getVTKValues(nodeVals[v], blockNum, true);
+        for (size_t v=0; v<cellVars.size(); v++)
+            cellVars[v].dataChunks[chunk]->getVTKValues(cellVals[v], blockNum);
+
+        const int* edges = NULL;
+        int numEdges = 0;
+        if (!box) {
+            switch (el->getType()) {
+                case ZONETYPE_TRIANGLE: edges = triEdges; numEdges = 3; break;
+                case ZONETYPE_QUAD: edges = quadEdges; numEdges = 4; break;
+                case ZONETYPE_TET: edges = tetEdges; numEdges = 6; break;
+                case ZONETYPE_HEX: edges = hexEdges; numEdges = 12; break;
+                default: ok = false; break;
+            }
+            if (!ok || axis >= numDims) {
+                ok = false;
+                break;
+            }
+        }
+
+        // new point index of element nodes (region) or of cut edges (slice)
+        IndexMap nodeIndex;
+        map<pair<int,int>, int> edgeIndex;
+        for (int e=0; e<numOwned; e++) {
+            const int* cell = &nodeList[e*cellSize];
+            IntVec cellPoints;
+            if (box) {
+                bool inside = true;
+                for (int d=0; d<numDims && inside; d++) {
+                    double centre = 0.;
+                    for (int j=0; j<cellSize; j++)
+                        centre += coords[d][cell[j]];
+                    centre /= cellSize;
+                    inside = (box[2*d] <= centre && centre <= box[2*d+1]);
+                }
+                if (!inside)
+                    continue;
+                for (int j=0; j<cellSize; j++) {
+                    IndexMap::const_iterator it = nodeIndex.find(cell[j]);
+                    if (it != nodeIndex.end()) {
+                        cellPoints.push_back(it->second);
+                        continue;
+                    }
+                    const int idx = points.size()/3;
+                    nodeIndex[cell[j]] = idx;
+                    for (int d=0; d<3; d++)
+                        points.push_back(d < numDims ? coords[d][cell[j]] : 0.f);
+                    const int node = elNode2node[cell[j]];
+                    for (size_t v=0; v<nodalVars.size(); v++) {
+                        const int nc = nodalComps[v];
+                        pointValues[v].insert(pointValues[v].end(),
+                                nodeVals[v].begin()+node*nc,
+                                nodeVals[v].begin()+(node+1)*nc);
+                    }
+                    cellPoints.push_back(idx);
+                }
+                types.push_back(static_cast<unsigned char>(el->getType()));
+            } else {
+                // half-open test so a plane through a node cuts each edge at
+                // most once
+                for (int k=0; k<numEdges; k++) {
+                    const int a = cell[edges[2*k]], b = cell[edges[2*k+1]];
+                    const double da = coords[axis][a]-position;
+                    const double db = coords[axis][b]-position;
+                    if (!((da <= 0. && db > 0.) || (da > 0. && db <= 0.)))
+                        continue;
+                    const pair<int,int> key(min(elGNI[a], elGNI[b]),
+                                            max(elGNI[a], elGNI[b]));
+                    map<pair<int,int>, int>::const_iterator it = edgeIndex.find(key);
+                    if (it != edgeIndex.end()) {
+                        cellPoints.push_back(it->second);
+                        continue;
+                    }
+                    const int idx = points.size()/3;
+                    edgeIndex[key] = idx;
+                    const double t = da/(da-db);
+                    for (int d=0; d<3; d++) {
+                        points.push_back(d < numDims ?
+                                (1.-t)*coords[d][a]+t*coords[d][b] : 0.f);
+                    }
+                    const int na = elNode2node[a], nb = elNode2node[b];
+                    for (size_t v=0; v<nodalVars.size(); v++) {
+                        const int nc = nodalComps[v];
+                        for (int c=0; c<nc; c++) {
+                            pointValues[v].push_back((1.-t)*nodeVals[v][na*nc+c]
+                                    + t*nodeVals[v][nb*nc+c]);
+                        }
+                    }
+                    cellPoints.push_back(idx);
+                }
+                if (numDims == 2) {
+                    // a line cuts a convex cell in exactly two edges
+                    if (cellPoints.size() != 2)
+                        continue;
+                    types.push_back(VTK_LINE);
+                } else {
+                    if (cellPoints.size() < 3)
+                        continue;
+                    // order the polygon vertices by angle around the centre
+                    const int u = (axis+1)%3, w = (axis+2)%3;
+                    double cu = 0., cw = 0.;
+                    for (size_t j=0; j<cellPoints.size(); j++) {
+                        cu += points[3*cellPoints[j]+u];
+                        cw += points[3*cellPoints[j]+w];
+                    }
+                    cu /= cellPoints.size();
+                    cw /= cellPoints.size();
+                    vector<pair<double,int> > angles;
+                    for (size_t j=0; j<cellPoints.size(); j++) {
+                        angles.push_back(make_pair(atan2(
+                                points[3*cellPoints[j]+w]-cw,
+                                points[3*cellPoints[j]+u]-cu), cellPoints[j]));
+                    }
+                    sort(angles.begin(), angles.end());
+                    for (size_t j=0; j<angles.size(); j++)
+                        cellPoints[j] = angles[j].second;
+                    types.push_back(VTK_POLYGON);
+                }
+            }
+            connectivity.insert(connectivity.end(), cellPoints.begin(),
+                                cellPoints.end());
+            offsets.push_back(connectivity.size());
+            for (size_t v=0; v<cellVars.size(); v++) {
+                const int nc = cellComps[v];
+                cellValues[v].insert(cellValues[v].end(),
+                        cellVals[v].begin()+e*nc, cellVals[v].begin()+(e+1)*nc);
+            }
+        }
+    }
+
+    // point indices and offsets are global in a shared file
+    int firstPoint = 0, firstOffset = 0;
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1 && !localPiece) {
+        int counts[2] = { static_cast<int>(points.size()/3),
+                          static_cast<int>(connectivity.size()) };
+        int first[2] = { 0, 0 };
+        MPI_Exscan(counts, first, 2, MPI_INT, MPI_SUM, mpiComm);
+        if (mpiRank > 0) {
+            firstPoint = first[0];
+            firstOffset = first[1];
+        }
+    }
+#endif
+    for (size_t i=0; i<connectivity.size(); i++)
+        connectivity[i] += firstPoint;
+    for (size_t i=0; i<offsets.size(); i++)
+        offsets[i] += firstOffset;
+
+    arrays.resize(4);
+    setArray(arrays[0], "", "Float32", 3, VTKArray::POINTS, points);
+    setArray(arrays[1], "connectivity", "Int32", 1, VTKArray::CELLS, connectivity);
+    setArray(arrays[2], "offsets", "Int32", 1, VTKArray::CELLS, offsets);
+    setArray(arrays[3], "types", "UInt8", 1, VTKArray::CELLS, types);
+    for (size_t v=0; v<nodalVars.size(); v++) {
+        arrays.push_back(VTKArray());
+        setArray(arrays.back(), nodalVars[v].varName, "Float32", nodalComps[v],
+                 VTKArray::POINT_DATA, pointValues[v]);
+    }
+    for (size_t v=0; v<cellVars.size(); v++) {
+        arrays.push_back(VTKArray());
+        setArray(arrays.back(), cellVars[v].varName, "Float32", cellComps[v],
+                 VTKArray::CELL_DATA, cellValues[v]);
+    }
+    return ok;
+}
+
+//
+// Writes a slice (box==NULL) or a region of the dataset, one file per mesh
+// as in saveVTK()
+//
+void EscriptDataset::saveVTKfiltered(string fileName, int axis,
+                                     double position, const double* box)
+{
+    if (domainChunks.size() == 0)
+        throw WeipaException("EscriptDataset::saveVTKfiltered No data was passed to saveVTKfiltered");
+    if (vtkCompression > 0 && mpiSize > 1 && !vtkSplitByRank)
+        throw WeipaException("EscriptDataset::saveVTKfiltered Compressed output on more than one rank requires split files");
+
+    map<string,VarVector> varsPerMesh;
+    getVariablesPerMesh(varsPerMesh);
+    if (varsPerMesh.empty())
+        varsPerMesh["Elements"] = VarVector();
+
+    if (fileName.length() > 5 && fileName.compare(fileName.length()-5, 5, ".pvtu") == 0) {
+        fileName = fileName.substr(0, fileName.length()-5)+".vtu";
+    }
+    if (fileName.length() < 5 || fileName.compare(fileName.length()-4, 4, ".vtu") != 0) {
+        fileName+=".vtu";
+    }
+    const string filePrefix(fileName.substr(0, fileName.length()-4));
+    const bool prependMeshName = (varsPerMesh.size()>1);
+    const bool localPiece = (mpiSize>1 && vtkSplitByRank);
+
+    map<string,VarVector>::const_iterator vpmIt;
+    for (vpmIt=varsPerMesh.begin(); vpmIt!=varsPerMesh.end(); vpmIt++) {
+        const string newName(prependMeshName ?
+                filePrefix+"_"+vpmIt->first+".vtu" : fileName);
+        VarVector nodalVars, cellVars;
+        splitVTKVars(vpmIt->first, vpmIt->second, nodalVars, cellVars);
+        vector<VTKArray> arrays;
+        int error = (getFilteredVTKArrays(vpmIt->first, nodalVars, cellVars,
+                    axis, position, box, localPiece, arrays) ? 0 : 1);
+#if WEIPA_HAVE_MPI
+        if (mpiSize > 1) {
+            int localError = error;
+            MPI_Allreduce(&localError, &error, 1, MPI_INT, MPI_MAX, mpiComm);
+        }
+#endif
+        if (error) {
+            if (box)
+                throw WeipaException("EscriptDataset::saveVTKRegion Cannot extract region of mesh "+vpmIt->first);
+            throw WeipaException("EscriptDataset::saveVTKSlice Cannot slice mesh "+vpmIt->first);
+        }
+
+        if (vtkSplitByRank) {
+            saveVTKpieces(newName, arrays);
+        } else {
+            const int numPoints = arrays[0].bytes.size()/(3*sizeof(float));
+            const int numCells = arrays[3].bytes.size();
+            if (!saveVTKarrays(newName, arrays, numPoints, numCells, mpiSize>1))
+                throw WeipaException("EscriptDataset::saveVTKfiltered Could not write file "+newName);
+        }
+    }
+}
+
+//
+// Writes an UnstructuredGrid file using the current binary encoding. If
+// collective is true all ranks write their part of the arrays into one file,
+// otherwise the calling rank writes a file on its own. Other dataset types
+// are written if gridType and the attributes of the grid and piece elements
+// are given.
+//
+bool EscriptDataset::saveVTKarrays(const string& fileName,
+                                   vector<VTKArray>& arrays, int numPoints,
+                                   int numCells, bool collective,
+                                   const string& gridType,
+                                   const string& gridAttributes,
+                                   const string& pieceAttributes)
+{
+    const bool appended = (vtkEncoding == VTK_APPENDED);
+    const bool binary = (vtkEncoding != VTK_ASCII);
+    const bool isRoot = (!collective || mpiRank == 0);
+    const size_t numArrays = arrays.size();
+
+    // encoded headers and (compressed) payloads; compression is only
+    // supported for non-collective writes so all headers are known locally
+    vector<vector<char> > headers(numArrays), payloads(numArrays);
+    vector<long long> sizes(numArrays);
+    for (size_t i=0; i<numArrays; i++)
+        sizes[i] = arrays[i].bytes.size();
+    int gNumPoints = numPoints, gNumCells = numCells;
+#if WEIPA_HAVE_MPI
+    if (collective) {
+        MPI_Allreduce(MPI_IN_PLACE, &sizes[0], numArrays, MPI_LONG_LONG,
+                      MPI_SUM, mpiComm);
+        MPI_Allreduce(&numPoints, &gNumPoints, 1, MPI_INT, MPI_SUM, mpiComm);
+        MPI_Allreduce(&numCells, &gNumCells, 1, MPI_INT, MPI_SUM, mpiComm);
+    }
+#endif
+    for (size_t i=0; i<numArrays; i++) {
+        if (vtkCompression > 0) {
+            encodeBinary(arrays[i].bytes, vtkCompression, headers[i], payloads[i]);
+        } else {
+            putUInt64(headers[i], sizes[i]);
+        }
+    }
+
+    boost::scoped_ptr<FileWriter> fw(NULL);
+#if WEIPA_HAVE_MPI
+    if (collective)
+        fw.reset(new FileWriter(mpiComm));
+    else
+#endif
+        fw.reset(new FileWriter());
+    int error = (fw->openFile(fileName, 0, appended) ? 0 : 1);
+    ostringstream oss;
+    oss.setf(ios_base::scientific, ios_base::floatfield);
+    oss.precision(8);
+
+    if (isRoot) {
+        writeVTKHeader(oss, gridType, binary);
+        oss << "<" << gridType << gridAttributes << ">" << endl;
+        oss << "<FieldData>" << endl;
+        oss << "<DataArray Name=\"TIME\" type=\"Float64\" format=\"ascii\" NumberOfTuples=\"1\">" << endl;
+        oss << time << endl;
+        oss << "</DataArray>" << endl;
+        oss << "<DataArray Name=\"CYCLE\" type=\"Int32\" format=\"ascii\" NumberOfTuples=\"1\">" << endl;
+        oss << cycle << endl;
+        oss << "</DataArray>" << endl << "</FieldData>" << endl;
+        if (pieceAttributes.empty()) {
+            oss << "<Piece NumberOfPoints=\"" << gNumPoints
+                << "\" NumberOfCells=\"" << gNumCells << "\">" << endl;
+        } else {
+            oss << "<Piece" << pieceAttributes << ">" << endl;
+        }
+    }
+
+    const char* sectionNames[] = { "Points", "Cells", "PointData", "CellData" };
+    int section = -1;
+    long long appendedOffset = 0;
+    for (size_t i=0; i<numArrays; i++) {
+        const VTKArray& array = arrays[i];
+        if (isRoot) {
+            if (array.section != section) {
+                if (section >= 0)
+                    oss << "</" << sectionNames[section] << ">" << endl;
+                section = array.section;
+                oss << "<" << sectionNames[section] << ">" << endl;
+            }
+            oss << "<DataArray";
+            if (!array.name.empty())
+                oss << " Name=\"" << array.name << "\"";
+            oss << " type=\"" << array.type << "\" NumberOfComponents=\""
+                << array.numComps << "\" format=\""
+                << (appended ? "appended" : (binary ? "binary" : "ascii"))
+                << "\"";
+            if (appended) {
+                oss << " offset=\"" << appendedOffset << "\"/>" << endl;
+                appendedOffset += headers[i].size() +
+                    (vtkCompression > 0 ? (long long)payloads[i].size() : sizes[i]);
+                continue;
+            }
+            oss << ">" << endl;
+            // VTK decodes the header of compressed data on its own but
+            // expects the header and values of uncompressed data in one
+            // base64 stream
+            if (binary && vtkCompression > 0)
+                base64Encode(oss, headers[i]);
+        }
+        if (appended)
+            continue;
+
+        if (!binary) {
+            writeAsciiArray(oss, array);
+        } else if (vtkCompression > 0) {
+            base64Encode(oss, payloads[i]);
+        } else {
+            const vector<char> noHeader;
+            const vector<char>& header = (isRoot ? headers[i] : noHeader);
+#if WEIPA_HAVE_MPI
+            if (collective) {
+                base64EncodeOrdered(oss, header, array.bytes, mpiComm);
+            } else
+#endif
+            {
+                vector<char> joined(header);
+                joined.insert(joined.end(), array.bytes.begin(), array.bytes.end());
+                base64Encode(oss, joined);
+            }
+        }
+        if (!fw->writeOrdered(oss))
+            error = 1;
+        if (isRoot) {
+            if (binary)
+                oss << endl;
+            oss << "</DataArray>" << endl;
+        }
+    }
+
+    if (isRoot) {
+        if (section >= 0)
+            oss << "</" << sectionNames[section] << ">" << endl;
+        oss << "</Piece>" << endl << "</" << gridType << ">" << endl;
+        if (appended)
+            oss << "<AppendedData encoding=\"raw\">" << endl << "_";
+        if (!fw->writeShared(oss))
+            error = 1;
+    }
+
+    if (appended) {
+        for (size_t i=0; i<numArrays; i++) {
+            // rank 0 writes first so the header precedes all data
+            if (isRoot)
+                oss.write(&headers[i][0], headers[i].size());
+            const vector<char>& data = (vtkCompression > 0 ? payloads[i] :
+                                        arrays[i].bytes);
+            if (!data.empty())
+                oss.write(&data[0], data.size());
+            if (!fw->writeOrdered(oss))
+                error = 1;
+        }
+        if (isRoot)
+            oss << endl << "</AppendedData>" << endl;
+    }
+
+    if (isRoot) {
+        oss << "</VTKFile>" << endl;
+        if (!fw->writeShared(oss))
+            error = 1;
+    }
+    fw->close();
+
+#if WEIPA_HAVE_MPI
+    if (collective) {
+        int localError = error;
+        MPI_Allreduce(&localError, &error, 1, MPI_INT, MPI_MAX, mpiComm);
+    }
+#endif
+    return (error == 0);
+}
+
+//
+// Writes one file per rank and a parallel index file on rank 0
+//
+void EscriptDataset::saveVTKpieces(const string& fileName,
+                                   vector<VTKArray>& arrays)
+{
+    const string prefix(fileName.substr(0, fileName.length()-4));
+    string baseName(prefix);
+    const size_t slash = baseName.find_last_of("/\\");
+    if (slash != string::npos)
+        baseName = baseName.substr(slash+1);
+
+    const int numPoints = arrays[0].bytes.size()/(3*sizeof(float));
+    const int numCells = arrays[3].bytes.size();
+
+    char pieceName[16];
+    snprintf(pieceName, 16, "_%04d.vtu", mpiRank);
+    int error = (saveVTKarrays(prefix+pieceName, arrays, numPoints, numCells,
+                               false) ? 0 : 1);
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1) {
+        int localError = error;
+        MPI_Allreduce(&localError, &error, 1, MPI_INT, MPI_MAX, mpiComm);
+    }
+#endif
+    if (error)
+        throw WeipaException("EscriptDataset::saveVTKpieces Could not write pieces of "+prefix);
+
+    if (mpiRank == 0) {
+        ofstream ofs((prefix+".pvtu").c_str());
+        writeVTKHeader(ofs, "PUnstructuredGrid", vtkEncoding != VTK_ASCII);
+        ofs << "<PUnstructuredGrid GhostLevel=\"0\">" << endl;
+        const char* sectionNames[] = { "PPoints", "PCells", "PPointData", "PCellData" };
+        int section = -1;
+        for (size_t i=0; i<arrays.size(); i++) {
+            if (arrays[i].section != section) {
+                if (section >= 0)
+                    ofs << "</" << sectionNames[section] << ">" << endl;
+                section = arrays[i].section;
+                ofs << "<" << sectionNames[section] << ">" << endl;
+            }
+            ofs << "<PDataArray";
+            if (!arrays[i].name.empty())
+                ofs << " Name=\"" << arrays[i].name << "\"";
+            ofs << " type=\"" << arrays[i].type << "\" NumberOfComponents=\""
+                << arrays[i].numComps << "\"/>" << endl;
+        }
+        if (section >= 0)
+            ofs << "</" << sectionNames[section] << ">" << endl;
+        for (int r=0; r<mpiSize; r++) {
+            snprintf(pieceName, 16, "_%04d.vtu", r);
+            ofs << "<Piece Source=\"" << baseName << pieceName << "\"/>" << endl;
+        }
+        ofs << "</PUnstructuredGrid>" << endl << "</VTKFile>" << endl;
+        ofs.close();
+        if (ofs.fail())
+            error = 1;
+    }
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1)
+        MPI_Bcast(&error, 1, MPI_INT, 0, mpiComm);
+#endif
+    if (error)
+        throw WeipaException("EscriptDataset::saveVTKpieces Could not write "+prefix+".pvtu");
+}
+
 //
 // Sets the domain from dump files.
 //
@@ -1025,6 +2742,48 @@ void EscriptDataset::convertMeshVariables()
     }
 }
 
+//
+// Groups all valid, non-empty variables by the name of their mesh
+//
+void EscriptDataset::getVariablesPerMesh(map<string,VarVector>& varsPerMesh)
+{
+    VarVector::iterator viIt;
+    for (viIt = variables.begin(); viIt != variables.end(); viIt++) {
+        // skip empty variable
+        int numSamples = accumulate(viIt->sampleDistribution.begin(),
+                viIt->sampleDistribution.end(), 0);
+        if (numSamples == 0 || !viIt->valid) {
+            continue;
+        }
+        string meshName = viIt->dataChunks[0]->getMeshName();
+
+        // ranks with 0 samples can't know the correct mesh name.
+        // We assume rank 0 always has samples, if this turns out to be a
+        // wrong assumption then a bit more work is needed to get the correct
+        // mesh name to all ranks.
+#if WEIPA_HAVE_MPI
+        if (mpiSize > 1) {
+            char name[100];
+            if (mpiRank == 0) {
+                strncpy(&name[0], meshName.c_str(), 100);
+            }
+
+            MPI_Bcast(name, 100, MPI_CHAR, 0, mpiComm);
+            meshName = name;
+        }
+#endif
+
+        map<string,VarVector>::iterator it = varsPerMesh.find(meshName);
+        if (it != varsPerMesh.end()) {
+            it->second.push_back(*viIt);
+        } else {
+            VarVector v;
+            v.push_back(*viIt);
+            varsPerMesh[meshName] = v;
+        }
+    }
+}
+
 // retrieves the number of samples at each block - used to determine which
 // blocks contribute to given variable if any.
 void EscriptDataset::updateSampleDistribution(VarInfo& vi)
@@ -1048,6 +2807,36 @@ void EscriptDataset::updateSampleDistribution(VarInfo& vi)
     vi.sampleDistribution = sampleDist;
 }
 
+// returns whether the values of a variable differ from the ones it was last
+// saved with. If so, the given location is recorded for the new values.
+// Must be called on all ranks.
+bool EscriptDataset::checkVarChanged(const VarInfo& vi, SavedVarMap& saved,
+                                     const string& fileName,
+                                     const string& path)
+{
+    size_t checksum = vi.dataChunks.size();
+    DataChunks::const_iterator it;
+    for (it = vi.dataChunks.begin(); it != vi.dataChunks.end(); it++) {
+        checksum = checksum*31 + (*it)->getChecksum();
+    }
+
+    SavedVarMap::const_iterator svIt = saved.find(vi.varName);
+    int changed = (svIt == saved.end() || svIt->second.checksum != checksum);
+#if WEIPA_HAVE_MPI
+    if (mpiSize > 1) {
+        int myChanged = changed;
+        MPI_Allreduce(&myChanged, &changed, 1, MPI_INT, MPI_MAX, mpiComm);
+    }
+#endif
+    if (changed) {
+        SavedVar& sv = saved[vi.varName];
+        sv.checksum = checksum;
+        sv.fileName = fileName;
+        sv.path = path;
+    }
+    return changed;
+}
+
 //
 //
 //
@@ -1120,14 +2909,16 @@ void EscriptDataset::putSiloMultiMesh(DBfile* dbfile, const string& meshName)
 //
 //
 void EscriptDataset::putSiloMultiVar(DBfile* dbfile, const VarInfo& vi,
-                                     bool useMeshFile)
+                                     bool useMeshFile, const string& varFile)
 {
 #if ESYS_HAVE_SILO
     vector<int> vartypes;
     vector<string> tempstrings;
     vector<char*> varnames;
     string pathPrefix;
-    if (useMeshFile) {
+    if (!varFile.empty()) {
+        pathPrefix = varFile + ":";
+    } else if (useMeshFile) {
         int ppIndex = domainChunks[0]->getSiloPath().find(':');
         if (ppIndex != string::npos) {
             pathPrefix = domainChunks[0]->getSiloPath().substr(0, ppIndex+1);
@@ -1175,7 +2966,8 @@ void EscriptDataset::putSiloMultiVar(DBfile* dbfile, const VarInfo& vi,
 //
 //
 //
-void EscriptDataset::putSiloMultiTensor(DBfile* dbfile, const VarInfo& vi)
+void EscriptDataset::putSiloMultiTensor(DBfile* dbfile, const VarInfo& vi,
+                                        const string& varFile)
 {
 #if ESYS_HAVE_SILO
     string tensorDir = vi.varName+string("_comps/");
@@ -1200,6 +2992,8 @@ void EscriptDataset::putSiloMultiTensor(DBfile* dbfile, const VarInfo& vi)
             for (size_t idx = 0; idx < vi.sampleDistribution.size(); idx++) {
                 if (vi.sampleDistribution[idx] > 0) {
                     stringstream siloPath;
+                    if (!varFile.empty())
+                        siloPath << varFile << ":";
                     siloPath << "/block";
                     int prevWidth = siloPath.width(4);
                     char prevFill = siloPath.fill('0');
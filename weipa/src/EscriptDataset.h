@@ -19,6 +19,7 @@
 #define __WEIPA_ESCRIPTDATASET_H__
 
 #include <weipa/weipa.h>
+#include <weipa/DataVar.h>
 
 #include <ostream>
 
@@ -45,6 +46,15 @@ struct VarInfo {
 
 typedef std::vector<VarInfo> VarVector;
 
+struct VTKArray;
+
+/// \brief Encodings for VTK data arrays
+typedef enum {
+    VTK_ASCII,      // text
+    VTK_BINARY,     // inline base64 encoded
+    VTK_APPENDED    // raw binary in the AppendedData section
+} VTKEncoding;
+
 
 /// \brief Represents an escript dataset including a domain and data variables
 ///        for one timestep.
@@ -88,6 +98,14 @@ public:
     bool addData(escript::Data& data, const std::string name,
                  const std::string units = "");
 
+    /// \brief Removes all variables but keeps the converted domain so the
+    ///        dataset can be reused for the next time step of a simulation
+    ///        with a static mesh.
+    ///
+    /// Data added afterwards reuses the sample ordering computed for
+    /// previous data on the same function space.
+    void clearData() { variables.clear(); }
+
     /// \brief Loads domain and variables from escript NetCDF files.
     ///
     /// \param domainFilePattern a printf-style pattern for the domain file
@@ -133,12 +151,86 @@ public:
     /// \brief Enables/Disables saving of mesh-related data
     void setSaveMeshData(bool flag) { wantsMeshVars=flag; }
 
+    /// \brief Enables/Disables persistent output for a dataset that is
+    ///        reused for several time steps via clearData().
+    ///
+    /// If enabled, the first call to saveSilo() writes the mesh and all
+    /// subsequent Silo files reference it. saveSilo() and saveHDF5() only
+    /// write variables whose values changed since they were last saved and
+    /// reference the previous values otherwise. Silo files of one series
+    /// must be stored in the same directory. VTK output is not affected.
+    void setPersistent(bool flag) { persistent=flag; }
+
+    /// \brief Sets the encoding of VTK data arrays and the zlib compression
+    ///        level (1-9) for binary encodings, 0 disables compression.
+    /// \note Compressed output on more than one rank requires split files,
+    ///       see setVTKSplitByRank().
+    void setVTKEncoding(VTKEncoding encoding, int compressionLevel=0);
+
+    /// \brief Enables/Disables writing one VTK piece per rank plus a
+    ///        parallel (.pvtu) index file instead of a single shared file.
+    void setVTKSplitByRank(bool flag) { vtkSplitByRank=flag; }
+
     /// \brief Saves the dataset in the Silo file format.
     bool saveSilo(const std::string fileName, bool useMultiMesh=true);
 
     /// \brief Saves the dataset in the VTK XML file format.
+    ///
+    /// If split files were requested the name of each piece is the file name
+    /// with the rank appended, and the index file has the extension .pvtu.
     void saveVTK(const std::string fileName);
 
+    /// \brief Saves an axis-aligned slice through the dataset in the VTK XML
+    ///        file format.
+    ///
+    /// The cells are cut by the plane (line in 2D) on which coordinate axis
+    /// equals position. Nodal variables are interpolated linearly along the
+    /// cut edges and cell variables are taken from the cut cell. Every rank
+    /// computes the slice of the cells it owns. The output is written like
+    /// saveVTK() output and requires linear cells.
+    void saveVTKSlice(const std::string fileName, int axis, double position);
+
+    /// \brief Saves the cells whose centre lies within the box
+    ///        [x0,x1]x[y0,y1]x[z0,z1] in the VTK XML file format.
+    ///
+    /// The z range is ignored for two-dimensional domains.
+    void saveVTKRegion(const std::string fileName, double x0, double x1,
+                       double y0, double y1, double z0=0., double z1=0.);
+
+    /// \brief Saves the nodal variables at every stride-th grid line of a
+    ///        ripley or speckley domain as VTK ImageData (.vti) file.
+    ///
+    /// Each rank selects the grid points it owns and rank 0 assembles and
+    /// writes the reduced grid. Cell variables are not included.
+    void saveVTKSubsampled(const std::string fileName, int stride);
+
+    /// \brief Adds a probe location for saveProbes(). Probes are kept when
+    ///        clearData() is called.
+    void addProbe(double x, double y, double z=0.);
+
+    /// \brief Removes all probe locations.
+    void clearProbes() { probes.clear(); }
+
+    /// \brief Writes the nodal variables at the probe locations as comma
+    ///        separated values, one line per probe.
+    ///
+    /// The values are taken from the owned node closest to each probe. If
+    /// append is true the lines are added to an existing file, otherwise the
+    /// file is replaced and starts with a header line.
+    void saveProbes(const std::string fileName, bool append=false);
+
+    /// \brief Saves the dataset in the HDF5 file format and writes an XDMF
+    ///        index which describes all time steps stored in the file.
+    ///
+    /// The mesh is written once, every call adds a group with the variables
+    /// of the current cycle. If append is false an existing file is replaced.
+    /// All ranks write their part of the data collectively into a single
+    /// file which requires a parallel HDF5 build if there is more than one
+    /// rank. compressionLevel (0-9) sets the deflate level of the chunked
+    /// datasets.
+    void saveHDF5(const std::string fileName, bool append=false,
+                  int compressionLevel=0);
+
     /// \brief Returns the dataset's converted domain so it can be reused.
     DomainChunks getConvertedDomain() { return domainChunks; }
 
@@ -156,28 +248,74 @@ public:
         getMPIComm() { return mpiComm; }
 
 private:
+    /// checksum and location of the values a variable was last saved with
+    struct SavedVar {
+        size_t checksum;
+        std::string fileName;
+        std::string path;
+    };
+    typedef std::map<std::string, SavedVar> SavedVarMap;
+
     bool loadDomain(const std::string filePattern, int nChunks);
     bool setExternalDomain(const DomainChunks& domain);
     bool loadData(const std::string filePattern, const std::string name,
                   const std::string units);
 
     void convertMeshVariables();
+    void getVariablesPerMesh(std::map<std::string,VarVector>& varsPerMesh);
+    void writeXDMF(const std::string& h5Name, const std::string& xmfName) const;
     void updateSampleDistribution(VarInfo& vi);
     void putSiloMultiMesh(DBfile* dbfile, const std::string& meshName);
-    void putSiloMultiTensor(DBfile* dbfile, const VarInfo& vi);
+    bool checkVarChanged(const VarInfo& vi, SavedVarMap& saved,
+                         const std::string& fileName, const std::string& path);
+    void putSiloMultiTensor(DBfile* dbfile, const VarInfo& vi,
+                            const std::string& varFile = "");
     void putSiloMultiVar(DBfile* dbfile, const VarInfo& vi,
-                         bool useMeshFile = false);
+                         bool useMeshFile = false,
+                         const std::string& varFile = "");
     void saveVTKsingle(const std::string& fileName,
                        const std::string& meshName, const VarVector& vars);
     void writeVarToVTK(const VarInfo& varInfo, std::ostream& os);
+    void writeVTKHeader(std::ostream& os, const std::string& type,
+                        bool binary) const;
+    void splitVTKVars(const std::string& meshName, const VarVector& vars,
+                      VarVector& nodalVars, VarVector& cellVars) const;
+    void getVTKArrays(const std::string& meshName, const VarVector& nodalVars,
+                      const VarVector& cellVars, int cellSize, int cellType,
+                      bool localPiece, std::vector<VTKArray>& arrays);
+    bool getFilteredVTKArrays(const std::string& meshName,
+                              const VarVector& nodalVars,
+                              const VarVector& cellVars, int axis,
+                              double position, const double* box,
+                              bool localPiece, std::vector<VTKArray>& arrays);
+    void saveVTKfiltered(std::string fileName, int axis, double position,
+                         const double* box);
+    bool saveVTKarrays(const std::string& fileName,
+                       std::vector<VTKArray>& arrays, int numPoints,
+                       int numCells, bool collective,
+                       const std::string& gridType = "UnstructuredGrid",
+                       const std::string& gridAttributes = "",
+                       const std::string& pieceAttributes = "");
+    void saveVTKpieces(const std::string& fileName,
+                       std::vector<VTKArray>& arrays);
 
     int cycle;
     double time;
     std::string mdSchema, mdString;
     StringVec meshLabels, meshUnits;
-    bool externalDomain, wantsMeshVars;
+    bool externalDomain, wantsMeshVars, persistent;
+    VTKEncoding vtkEncoding;
+    int vtkCompression;
+    bool vtkSplitByRank;
     DomainChunks domainChunks;
     VarVector variables, meshVariables;
+    SampleOrderCache sampleOrders;
+    SavedVarMap siloVars, hdf5Vars;
+    /// origin, spacing and number of elements of ripley and speckley grids
+    bool haveGrid;
+    double gridOrigin[3], gridSpacing[3];
+    int gridNE[3];
+    std::vector<double> probes;
     int mpiRank, mpiSize;
 #if WEIPA_HAVE_MPI
     MPI_Comm mpiComm;
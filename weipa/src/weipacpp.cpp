@@ -17,6 +17,7 @@
 
 #include <escript/Data.h>
 
+#include <weipa/AsyncWriter.h>
 #include <weipa/EscriptDataset.h>
 #include <weipa/VisItControl.h>
 
@@ -35,16 +36,47 @@ BOOST_PYTHON_MODULE(weipacpp)
   docstring_options docopt(true,true,false);
 #endif
 
+    enum_<weipa::VTKEncoding>("VTKEncoding")
+        .value("ASCII", weipa::VTK_ASCII)
+        .value("BINARY", weipa::VTK_BINARY)
+        .value("APPENDED", weipa::VTK_APPENDED);
+
     class_<weipa::EscriptDataset>("EscriptDataset","Represents an escript dataset including a domain and data variables for one timestep. It is used for exporting", init<>())
         .def("setDomain", &weipa::EscriptDataset::setDomain)
         .def("addData", &weipa::EscriptDataset::addData, (arg("data"), arg("name"), arg("units")=""))
+        .def("clearData", &weipa::EscriptDataset::clearData)
         .def("setCycleAndTime", &weipa::EscriptDataset::setCycleAndTime, args("cycle","time"))
         .def("setMeshLabels", &weipa::EscriptDataset::setMeshLabels, (arg("x"),arg("y"),arg("z")=""))
         .def("setMeshUnits", &weipa::EscriptDataset::setMeshUnits, (arg("x"),arg("y"),arg("z")=""))
         .def("setMetadataSchemaString", &weipa::EscriptDataset::setMetadataSchemaString, (arg("schema")="", arg("metadata")=""))
         .def("setSaveMeshData", &weipa::EscriptDataset::setSaveMeshData)
+        .def("setPersistent", &weipa::EscriptDataset::setPersistent, args("flag"))
         .def("saveSilo", &weipa::EscriptDataset::saveSilo, (arg("filename"), arg("useMultimesh")=true))
-        .def("saveVTK", &weipa::EscriptDataset::saveVTK, args("filename"));
+        .def("setVTKEncoding", &weipa::EscriptDataset::setVTKEncoding, (arg("encoding"), arg("compressionLevel")=0))
+        .def("setVTKSplitByRank", &weipa::EscriptDataset::setVTKSplitByRank, args("flag"))
+        .def("saveVTK", &weipa::EscriptDataset::saveVTK, args("filename"))
+        .def("saveVTKSlice", &weipa::EscriptDataset::saveVTKSlice, args("filename","axis","position"))
+        .def("saveVTKRegion", &weipa::EscriptDataset::saveVTKRegion, (arg("filename"), arg("x0"), arg("x1"), arg("y0"), arg("y1"), arg("z0")=0., arg("z1")=0.))
+        .def("saveVTKSubsampled", &weipa::EscriptDataset::saveVTKSubsampled, args("filename","stride"))
+        .def("addProbe", &weipa::EscriptDataset::addProbe, (arg("x"), arg("y"), arg("z")=0.))
+        .def("clearProbes", &weipa::EscriptDataset::clearProbes)
+        .def("saveProbes", &weipa::EscriptDataset::saveProbes, (arg("filename"), arg("append")=false))
+        .def("saveHDF5", &weipa::EscriptDataset::saveHDF5, (arg("filename"), arg("append")=false, arg("compressionLevel")=0));
+
+    class_<weipa::AsyncWriter, boost::noncopyable>("AsyncWriter","Writes time steps of escript data on a static domain on a background thread while the caller continues", init<int>((arg("maxPending")=2)))
+        .def("setDomain", &weipa::AsyncWriter::setDomain)
+        .def("addData", &weipa::AsyncWriter::addData, (arg("data"), arg("name"), arg("units")=""))
+        .def("setCycleAndTime", &weipa::AsyncWriter::setCycleAndTime, args("cycle","time"))
+        .def("setMetadataSchemaString", &weipa::AsyncWriter::setMetadataSchemaString, (arg("schema")="", arg("metadata")=""))
+        .def("setSaveMeshData", &weipa::AsyncWriter::setSaveMeshData)
+        .def("setVTKEncoding", &weipa::AsyncWriter::setVTKEncoding, (arg("encoding"), arg("compressionLevel")=0))
+        .def("setVTKSplitByRank", &weipa::AsyncWriter::setVTKSplitByRank, args("flag"))
+        .def("saveSilo", &weipa::AsyncWriter::saveSilo, args("filename"))
+        .def("saveVTK", &weipa::AsyncWriter::saveVTK, args("filename"))
+        .def("saveHDF5", &weipa::AsyncWriter::saveHDF5, (arg("filename"), arg("append")=false, arg("compressionLevel")=0))
+        .def("flush", &weipa::AsyncWriter::flush, "Waits until all queued writes have completed")
+        .def("getNumPending", &weipa::AsyncWriter::getNumPending)
+        .def("isAsynchronous", &weipa::AsyncWriter::isAsynchronous);
 
     // VisIt Control
     def("visitInitialize", weipa::VisItControl::initialize, (arg("simFile"), arg("comment")=""));
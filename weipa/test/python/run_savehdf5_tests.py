@@ -0,0 +1,208 @@
+
+##############################################################################
+#
+# Copyright (c) 2003-2020 by The University of Queensland
+# http://www.uq.edu.au
+#
+# Primary Business: Queensland, Australia
+# Licensed under the Apache License, version 2.0
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Development until 2012 by Earth Systems Science Computational Center (ESSCC)
+# Development 2012-2013 by School of Earth Sciences
+# Development from 2014 by Centre for Geoscience Computing (GeoComp)
+#
+##############################################################################
+
+from __future__ import print_function, division
+
+__copyright__="""Copyright (c) 2003-2020 by The University of Queensland
+http://www.uq.edu.au
+Primary Business: Queensland, Australia"""
+__license__="""Licensed under the Apache License, version 2.0
+http://www.apache.org/licenses/LICENSE-2.0"""
+__url__="https://launchpad.net/escript-finley"
+
+import os
+import esys.escriptcore.utestselect as unittest
+from esys.escriptcore.testing import *
+from xml.dom import minidom
+from esys.escript import ContinuousFunction, ReducedFunction, \
+            getMPIRankWorld, getMPISizeWorld, hasFeature
+from esys.weipa import saveHDF5, DatasetWriter
+
+try:
+    import h5py
+    HAVE_H5PY=True
+except ImportError:
+    HAVE_H5PY=False
+try:
+    from esys import ripley
+    HAVE_RIPLEY=True
+except ImportError:
+    HAVE_RIPLEY=False
+
+try:
+    WEIPA_WORKDIR=os.environ['WEIPA_WORKDIR']
+except KeyError:
+    WEIPA_WORKDIR='.'
+
+@unittest.skipIf(not hasFeature('hdf5'), "weipa was compiled without HDF5")
+@unittest.skipIf(not HAVE_RIPLEY, "ripley module not available")
+class Test_Ripley_SaveHDF5(unittest.TestCase):
+    TOL = 1e-5
+
+    def setUp(self):
+        self.dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8),
+                                  d0=getMPISizeWorld())
+        self.base=os.path.join(WEIPA_WORKDIR, "out_ripley_2D_hdf5")
+
+    def write_steps(self, compression=0):
+        x=ContinuousFunction(self.dom).getX()
+        xc=ReducedFunction(self.dom).getX()
+        for n in range(3):
+            saveHDF5(self.base, time=0.5*n, cycle=n, append=(n>0),
+                     compression=compression, data_s=x[0]*(n+1),
+                     data_v=x*(n+1), cell_s=xc[0]*(n+1))
+
+    def check_xdmf(self):
+        doc=minidom.parse(self.base+".xmf").documentElement
+        self.assertEqual(doc.tagName, 'Xdmf')
+        collections=[g for g in doc.getElementsByTagName('Grid')
+                        if g.getAttribute('GridType')=='Collection']
+        self.assertEqual(len(collections), 1)
+        steps=[g for g in collections[0].getElementsByTagName('Grid')]
+        self.assertEqual(len(steps), 3)
+        for n,step in enumerate(steps):
+            time=step.getElementsByTagName('Time')[0].getAttribute('Value')
+            self.assertAlmostEqual(float(time), 0.5*n)
+            topo=step.getElementsByTagName('Topology')[0]
+            self.assertEqual(topo.getAttribute('TopologyType'), 'Quadrilateral')
+            self.assertEqual(int(topo.getAttribute('NumberOfElements')), 33)
+            attrs=dict((a.getAttribute('Name'), a) for a in
+                        step.getElementsByTagName('Attribute'))
+            self.assertEqual(sorted(attrs.keys()), ['cell_s','data_s','data_v'])
+            self.assertEqual(attrs['data_s'].getAttribute('Center'), 'Node')
+            self.assertEqual(attrs['data_v'].getAttribute('AttributeType'), 'Vector')
+            self.assertEqual(attrs['cell_s'].getAttribute('Center'), 'Cell')
+
+    def check_hdf5(self):
+        f=h5py.File(self.base+".h5", 'r')
+        points=f['/Mesh/Points'][:]
+        conn=f['/Mesh/Elements/Connectivity'][:]
+        self.assertEqual(points.shape, (48,3))
+        self.assertEqual(conn.shape, (33,4))
+        # the mesh is stored once for all steps
+        self.assertEqual(sorted(f.keys()), ['Mesh','Step_000000',
+                                            'Step_000001','Step_000002'])
+        for n in range(3):
+            step=f['Step_%06d'%n]
+            self.assertEqual(step.attrs['Cycle'], n)
+            s=step['data_s'][:]
+            v=step['data_v'][:]
+            c=step['cell_s'][:]
+            for i in range(len(points)):
+                self.assertAlmostEqual(s[i][0], (n+1)*points[i][0], delta=self.TOL*(n+1)*10)
+                self.assertAlmostEqual(v[i][1], (n+1)*points[i][1], delta=self.TOL*(n+1)*10)
+                self.assertEqual(v[i][2], 0.)
+            for e in range(len(conn)):
+                centre=sum(points[j][0] for j in conn[e])/4.
+                self.assertAlmostEqual(c[e][0], (n+1)*centre, delta=self.TOL*(n+1)*10)
+        f.close()
+
+    def test_ripley_2D_steps(self):
+        self.write_steps()
+        if getMPIRankWorld()==0:
+            self.check_xdmf()
+            if HAVE_H5PY:
+                self.check_hdf5()
+
+    def test_ripley_2D_steps_compressed(self):
+        self.write_steps(compression=4)
+        if getMPIRankWorld()==0:
+            self.check_xdmf()
+            if HAVE_H5PY:
+                self.check_hdf5()
+                f=h5py.File(self.base+".h5", 'r')
+                self.assertEqual(f['/Mesh/Points'].compression, 'gzip')
+                f.close()
+
+    def test_ripley_2D_replace(self):
+        self.write_steps()
+        x=ContinuousFunction(self.dom).getX()
+        saveHDF5(self.base, data_s=x[0])
+        if getMPIRankWorld()==0:
+            doc=minidom.parse(self.base+".xmf").documentElement
+            self.assertEqual(len(doc.getElementsByTagName('Time')), 1)
+
+
+@unittest.skipIf(not hasFeature('hdf5'), "weipa was compiled without HDF5")
+@unittest.skipIf(not HAVE_RIPLEY, "ripley module not available")
+class Test_Ripley_DatasetWriter(unittest.TestCase):
+    def setUp(self):
+        self.dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8),
+                                  d0=getMPISizeWorld())
+        self.base=os.path.join(WEIPA_WORKDIR, "out_ripley_2D_writer")
+
+    def test_unknown_format(self):
+        self.assertRaises(ValueError, DatasetWriter, self.base, format="xyz")
+
+    def test_ripley_2D_hdf5(self):
+        writer=DatasetWriter(self.base, format=DatasetWriter.HDF5)
+        x=ContinuousFunction(self.dom).getX()
+        xc=ReducedFunction(self.dom).getX()
+        for n in range(3):
+            writer.write(time=0.5*n, data_s=x[0]*(n+1), cell_s=xc[0])
+        self.assertEqual(writer.getNumSteps(), 3)
+        self.assertEqual(writer.getDomain(), self.dom)
+        if getMPIRankWorld()==0:
+            doc=minidom.parse(self.base+".xmf").documentElement
+            steps=[g for g in doc.getElementsByTagName('Grid')
+                        if g.getAttribute('GridType')=='Uniform']
+            self.assertEqual(len(steps), 3)
+            for step in steps:
+                names=sorted(a.getAttribute('Name') for a in
+                            step.getElementsByTagName('Attribute'))
+                self.assertEqual(names, ['cell_s','data_s'])
+            if HAVE_H5PY:
+                f=h5py.File(self.base+".h5", 'r')
+                # unchanged values are stored once and linked
+                self.assertEqual(f['Step_000000/cell_s'].id,
+                                 f['Step_000002/cell_s'].id)
+                self.assertNotEqual(f['Step_000000/data_s'].id,
+                                    f['Step_000002/data_s'].id)
+                self.assertEqual(f['Step_000002'].attrs['Cycle'], 2)
+                f.close()
+
+    def test_ripley_2D_hdf5_async(self):
+        writer=DatasetWriter(self.base, format=DatasetWriter.HDF5,
+                             asynchronous=True, max_pending=1)
+        x=ContinuousFunction(self.dom).getX()
+        d=x[0]*1.
+        for n in range(3):
+            writer.write(time=0.5*n, data_s=d)
+            # the writer works on a snapshot of the values
+            d*=2.
+        writer.flush()
+        self.assertEqual(writer.getNumSteps(), 3)
+        if getMPIRankWorld()==0 and HAVE_H5PY:
+            f=h5py.File(self.base+".h5", 'r')
+            points=f['/Mesh/Points'][:]
+            for n in range(3):
+                s=f['Step_%06d/data_s'%n][:]
+                for i in range(len(points)):
+                    self.assertAlmostEqual(s[i][0], 2**n*points[i][0],
+                                           delta=1e-5*2**n*10)
+            f.close()
+
+    def test_ripley_2D_other_domain(self):
+        writer=DatasetWriter(self.base, format=DatasetWriter.HDF5)
+        writer.write(data_s=ContinuousFunction(self.dom).getX()[0])
+        other=ripley.Rectangle(n0=5, n1=3, d0=getMPISizeWorld())
+        self.assertRaises(ValueError, writer.write,
+                          data_s=ContinuousFunction(other).getX()[0])
+
+
+if __name__ == '__main__':
+    run_tests(__name__, exit_on_failure=True)
+
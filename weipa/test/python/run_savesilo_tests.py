@@ -30,8 +30,9 @@ from esys.escript import ContinuousFunction, Function, ReducedFunction,\
             FunctionOnBoundary, ReducedFunctionOnBoundary,\
             FunctionOnContactZero, ReducedFunctionOnContactZero,\
             FunctionOnContactOne, ReducedFunctionOnContactOne,\
-            Solution, ReducedSolution, getMPISizeWorld
-from esys.weipa import saveSilo
+            Solution, ReducedSolution, getMPIRankWorld, getMPISizeWorld,\
+            hasFeature
+from esys.weipa import saveSilo, DatasetWriter
 
 try:
     import Silo
@@ -1517,6 +1518,44 @@ class Test_Ripley_SaveSilo(SiloSaver):
                                            data_t=x[0]*[[11.,12.,13.],[21.,22.,23.],[31.,32.,33.]])
 
 
+@unittest.skipIf(not hasFeature('silo'), "weipa was compiled without Silo")
+@unittest.skipIf(not HAVE_RIPLEY, "ripley module not available")
+class Test_Ripley_DatasetWriter(unittest.TestCase):
+    def setUp(self):
+        self.dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8),
+                                  d0=getMPISizeWorld())
+        self.base=os.path.join(WEIPA_WORKDIR, "out_ripley_2D_writer")
+
+    def test_ripley_2D_silo(self):
+        # the persistent writer must also work when the ranks take turns
+        # writing the Silo file
+        writer=DatasetWriter(self.base, format=DatasetWriter.SILO)
+        x=ContinuousFunction(self.dom).getX()
+        xc=ReducedFunction(self.dom).getX()
+        for n in range(3):
+            writer.write(time=0.5*n, data_s=x[0]*(n+1), cell_s=xc[0])
+        self.assertEqual(writer.getNumSteps(), 3)
+        if getMPIRankWorld()!=0:
+            return
+        files=["%s.%04d.silo"%(self.base, n) for n in range(3)]
+        for f in files:
+            self.assertTrue(os.path.isfile(f), "%s was not written"%f)
+        if HAVE_SILO and getMPISizeWorld()==1:
+            first=SiloReader()
+            self.assertTrue(first.open(files[0]))
+            first.setDir('block0000')
+            self.assertTrue(len(first.getElementNames())>0)
+            self.assertEqual(sorted(first.getData().keys()), ['cell_s','data_s'])
+            first.close()
+            # later steps reference the mesh and unchanged values
+            last=SiloReader()
+            self.assertTrue(last.open(files[2]))
+            last.setDir('block0000')
+            self.assertEqual(last.getElementNames(), [])
+            self.assertEqual(list(last.getData().keys()), ['data_s'])
+            last.close()
+
+
 if __name__ == '__main__':
     run_tests(__name__, exit_on_failure=True)
 
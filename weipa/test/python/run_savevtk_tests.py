@@ -23,7 +23,7 @@ __license__="""Licensed under the Apache License, version 2.0
 http://www.apache.org/licenses/LICENSE-2.0"""
 __url__="https://launchpad.net/escript-finley"
 
-import os, math
+import base64, os, math, struct, zlib
 import esys.escriptcore.utestselect as unittest
 from esys.escriptcore.testing import *
 from xml.dom import minidom
@@ -31,8 +31,9 @@ from esys.escript import ContinuousFunction, Function, ReducedFunction,\
             FunctionOnBoundary, ReducedFunctionOnBoundary,\
             FunctionOnContactZero, ReducedFunctionOnContactZero,\
             FunctionOnContactOne, ReducedFunctionOnContactOne,\
-            Solution, ReducedSolution, getMPISizeWorld
-from esys.weipa import saveVTK
+            Solution, ReducedSolution, getMPIRankWorld, getMPISizeWorld,\
+            hasFeature
+from esys.weipa import saveVTK, DatasetWriter
 
 try:
     from esys import dudley
@@ -50,6 +51,13 @@ try:
 except:
     ripleyInstalled = False
 
+try:
+    import vtk
+    from vtk.util.numpy_support import vtk_to_numpy
+    vtkInstalled = True
+except:
+    vtkInstalled = False
+
 try:
      WEIPA_TEST_MESHES=os.environ['WEIPA_TEST_MESHES']
 except KeyError:
@@ -67,9 +75,21 @@ class VTKParser():
     def __init__(self):
         self.doc=None
 
+    TYPES = { 'Float32':'f', 'Float64':'d', 'Int32':'i', 'Int64':'q',
+              'UInt8':'B' }
+
     def parse(self, filename):
-        # load file and remove superfluous whitespace
-        dom=minidom.parse(filename)
+        # split off raw appended data which is not valid XML
+        contents=open(filename, 'rb').read()
+        appended=b''
+        pos=contents.find(b'<AppendedData')
+        if pos>=0:
+            start=contents.index(b'_', pos)+1
+            appended=contents[start:]
+            contents=contents[:pos]+b'</VTKFile>'
+        dom=minidom.parseString(contents)
+        self.decodeArrays(dom, appended)
+        # remove superfluous whitespace
         dom=minidom.parseString(dom.toxml()
                 .replace('>\n','>').replace('\n<','<').replace('\n',' '))
         self.doc = dom.documentElement
@@ -77,6 +97,63 @@ class VTKParser():
         return self.doc.tagName=='VTKFile' and \
                self.doc.getAttribute('type')=='UnstructuredGrid'
 
+    def decodeArrays(self, dom, appended):
+        """
+        Replaces the contents of binary and appended data arrays by their
+        values in ascii format.
+        """
+        root=dom.documentElement
+        order='>' if root.getAttribute('byte_order')=='BigEndian' else '<'
+        compressed=root.hasAttribute('compressor')
+        for d in dom.getElementsByTagName('DataArray'):
+            fmt=d.getAttribute('format')
+            if fmt=='binary':
+                text=''.join(c.data for c in d.childNodes).strip()
+                if compressed:
+                    # the header of compressed data is encoded on its own
+                    numBlocks=struct.unpack(order+'Q', base64.b64decode(text[:32])[:8])[0]
+                    headerChars=4*((8*(3+numBlocks)+2)//3)
+                    header=base64.b64decode(text[:headerChars])
+                    data=base64.b64decode(text[headerChars:])
+                else:
+                    # header and values of uncompressed data form one stream
+                    raw=base64.b64decode(text)
+                    header=raw[:8]
+                    data=raw[8:]
+            elif fmt=='appended':
+                offset=int(d.getAttribute('offset'))
+                if compressed:
+                    numBlocks=struct.unpack(order+'Q', appended[offset:offset+8])[0]
+                    header=appended[offset:offset+8*(3+numBlocks)]
+                else:
+                    header=appended[offset:offset+8]
+                data=appended[offset+len(header):]
+            else:
+                continue
+            if compressed:
+                numBlocks=struct.unpack(order+'Q', header[:8])[0]
+                sizes=struct.unpack(order+'%dQ'%numBlocks, header[24:])
+                values=b''
+                pos=0
+                for size in sizes:
+                    values+=zlib.decompress(data[pos:pos+size])
+                    pos+=size
+            else:
+                values=data[:struct.unpack(order+'Q', header)[0]]
+            t=self.TYPES[d.getAttribute('type')]
+            num=len(values)//struct.calcsize(t)
+            values=struct.unpack(order+'%d%s'%(num,t), values)
+            # use the same precision as the ascii writer so values can be
+            # compared to the reference files
+            if t in 'fd':
+                text=' '.join('%e'%v for v in values)
+            else:
+                text=' '.join(map(str, values))
+            while d.hasChildNodes():
+                d.removeChild(d.firstChild)
+            d.appendChild(dom.createTextNode(text))
+            d.setAttribute('format', 'ascii')
+
     def getTimeAndCycle(self):
         time=None
         cycle=None
@@ -288,6 +365,53 @@ class Test_VTKSaver(unittest.TestCase):
             out=os.path.join(WEIPA_WORKDIR, outFileBase+".vtu")
             self.compareVTKfiles(out, ref)
 
+    def check_vtk_encoded(self, reference, encoding, compression=0,
+                          split_by_rank=False, **data):
+        outFileBase="out_%s_%s%d"%(reference, encoding, compression)
+        out=os.path.join(WEIPA_WORKDIR, outFileBase)
+        saveVTK(out, write_meshdata=True, encoding=encoding,
+                compression=compression, split_by_rank=split_by_rank, **data)
+        ref=os.path.join(WEIPA_TEST_MESHES, reference+".vtu")
+        if split_by_rank:
+            index=minidom.parse(out+".pvtu").documentElement
+            self.assertEqual(index.getAttribute('type'), 'PUnstructuredGrid')
+            pieces=index.getElementsByTagName('Piece')
+            self.assertEqual(len(pieces), getMPISizeWorld())
+            out=os.path.join(WEIPA_WORKDIR, pieces[0].getAttribute('Source'))
+        else:
+            out+=".vtu"
+        self.compareVTKfiles(out, ref)
+        if vtkInstalled:
+            self.compareWithVTKReader(out)
+
+    def compareWithVTKReader(self, filename):
+        """
+        checks that VTK's own reader decodes the arrays of an encoded file
+        to the same values as the parser above.
+        """
+        p=VTKParser()
+        p.parse(filename)
+        reader=vtk.vtkXMLUnstructuredGridReader()
+        reader.SetFileName(filename)
+        reader.Update()
+        grid=reader.GetOutput()
+        nPoints, nCells=p.getNumPointsAndCells()
+        self.assertEqual(grid.GetNumberOfPoints(), nPoints)
+        self.assertEqual(grid.GetNumberOfCells(), nCells)
+        identity=dict((i,[i]) for i in range(max(nPoints, nCells)))
+        points=vtk_to_numpy(grid.GetPoints().GetData()).tolist()
+        self.assertTrue(self.compareDataWithMap(points, p.getPoints(), identity),
+                "VTK reader: points in %s do not match"%filename)
+        for data, pdata in ((grid.GetPointData(), p.getPointData()),
+                            (grid.GetCellData(), p.getCellData())):
+            for name, values in pdata.items():
+                array=data.GetArray(name)
+                self.assertNotEqual(array, None,
+                        "VTK reader: array '%s' missing in %s"%(name, filename))
+                v=vtk_to_numpy(array).tolist()
+                self.assertTrue(self.compareDataWithMap(v, values, identity),
+                        "VTK reader: array '%s' in %s does not match"%(name, filename))
+
 
 @unittest.skipIf(not finleyInstalled, "Skipping finley saveVTK tests since finley not installed")
 class Test_Finley_SaveVTK(Test_VTKSaver):
@@ -1556,6 +1680,36 @@ class Test_Ripley_SaveVTK(Test_VTKSaver):
      self.check_vtk("ripley_2D_boundary", data_s=x[0], data_v=x[0]*[1.,2.],
                                           data_t=x[0]*[[11.,12.],[21.,22.]])
 
+  def test_ripley_2D_ContinuousFunction_binary(self):
+     dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+     x=ContinuousFunction(dom).getX()
+     self.check_vtk_encoded("ripley_2D_node", "binary", data_s=x[0],
+                            data_v=x[0]*[1.,2.], data_t=x[0]*[[11.,12.],[21.,22.]])
+
+  def test_ripley_2D_Function_appended(self):
+     dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+     x=Function(dom).getX()
+     self.check_vtk_encoded("ripley_2D_cell", "appended", data_s=x[0],
+                            data_v=x[0]*[1.,2.], data_t=x[0]*[[11.,12.],[21.,22.]])
+
+  @unittest.skipIf(getMPISizeWorld()>1 or not hasFeature('unzip'),
+        "Compressed output requires zlib support and split files in parallel")
+  def test_ripley_2D_ContinuousFunction_compressed(self):
+     dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+     x=ContinuousFunction(dom).getX()
+     for encoding in ("binary", "appended"):
+         self.check_vtk_encoded("ripley_2D_node", encoding, compression=6,
+                                data_s=x[0], data_v=x[0]*[1.,2.],
+                                data_t=x[0]*[[11.,12.],[21.,22.]])
+
+  @unittest.skipIf(getMPISizeWorld()>1, "Pieces only match the reference on one rank")
+  def test_ripley_2D_Function_split(self):
+     dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+     x=Function(dom).getX()
+     self.check_vtk_encoded("ripley_2D_cell", "appended", split_by_rank=True,
+                            data_s=x[0], data_v=x[0]*[1.,2.],
+                            data_t=x[0]*[[11.,12.],[21.,22.]])
+
   # === Ripley 3D =============================================================
 
   def test_ripley_3D_ContinuousFunction(self):
@@ -1601,6 +1755,98 @@ class Test_Ripley_SaveVTK(Test_VTKSaver):
                                           data_t=x[0]*[[11.,12.,13.],[21.,22.,23.],[31.,32.,33.]])
 
 
+@unittest.skipIf(not ripleyInstalled, "Skipping ripley reduced output tests since ripley not installed")
+class Test_Ripley_ReducedVTK(unittest.TestCase):
+    TOL = 1e-5
+
+    def setUp(self):
+        self.base=os.path.join(WEIPA_WORKDIR, "out_ripley_reduced")
+
+    def test_ripley_3D_slice(self):
+        dom=ripley.Brick(n0=11, n1=3, n2=2, l0=(-2.5,7.0), l1=(1.2,3.8), l2=4., d0=getMPISizeWorld(), d1=1, d2=1)
+        x=ContinuousFunction(dom).getX()
+        xc=Function(dom).getX()
+        writer=DatasetWriter(self.base, format=DatasetWriter.VTK,
+                             full_output=False)
+        writer.addSlice(axis=2, position=1.3)
+        writer.write(data_s=x[0]+x[2], cell_s=xc[0])
+        if getMPIRankWorld()==0:
+            reader=VTKParser()
+            self.assertTrue(reader.parse(self.base+"_slice0.0000.vtu"))
+            numPoints,numCells=reader.getNumPointsAndCells()
+            self.assertEqual(numCells, 33)
+            self.assertEqual(set(reader.getCellTypes()), set([7]))
+            points=reader.getPoints()
+            data=reader.getPointData()['data_s']
+            for p,v in zip(points, data):
+                self.assertAlmostEqual(p[2], 1.3, delta=self.TOL)
+                self.assertAlmostEqual(v, p[0]+1.3, delta=self.TOL*10)
+            self.assertEqual(len(reader.getCellData()['cell_s']), 33)
+
+    def test_ripley_2D_region(self):
+        dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+        x=ContinuousFunction(dom).getX()
+        writer=DatasetWriter(self.base, format=DatasetWriter.VTK,
+                             full_output=False)
+        writer.addRegion([(0.,4.), (1.2,3.8)])
+        writer.write(data_s=x[0])
+        if getMPIRankWorld()==0:
+            reader=VTKParser()
+            self.assertTrue(reader.parse(self.base+"_region0.0000.vtu"))
+            numPoints,numCells=reader.getNumPointsAndCells()
+            self.assertEqual(numCells, 12)
+            conn=reader.getCellConnectivity()
+            points=reader.getPoints()
+            for e in range(numCells):
+                centre=sum(points[i][0] for i in conn[4*e:4*e+4])/4.
+                self.assertTrue(0. <= centre <= 4.)
+            for p,v in zip(points, reader.getPointData()['data_s']):
+                self.assertAlmostEqual(v, p[0], delta=self.TOL*10)
+
+    def test_ripley_2D_subsampled(self):
+        dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+        x=ContinuousFunction(dom).getX()
+        writer=DatasetWriter(self.base, format=DatasetWriter.VTK,
+                             full_output=False)
+        writer.setSubsampling(2)
+        writer.write(data_s=x[0])
+        if getMPIRankWorld()==0:
+            doc=minidom.parse(self.base+"_sub.0000.vti").documentElement
+            self.assertEqual(doc.getAttribute('type'), 'ImageData')
+            image=doc.getElementsByTagName('ImageData')[0]
+            self.assertEqual(image.getAttribute('WholeExtent'), '0 5 0 1 0 0')
+            spacing=list(map(float, image.getAttribute('Spacing').split()))
+            self.assertAlmostEqual(spacing[0], 2*10.5/11, delta=self.TOL)
+            array=doc.getElementsByTagName('DataArray')[-1]
+            self.assertEqual(array.getAttribute('Name'), 'data_s')
+            values=list(map(float, array.childNodes[0].data.split()))
+            self.assertEqual(len(values), 12)
+            for i,v in enumerate(values):
+                self.assertAlmostEqual(v, -2.5+(i%6)*spacing[0], delta=self.TOL*10)
+
+    def test_ripley_2D_probes(self):
+        dom=ripley.Rectangle(n0=11, n1=3, l0=(-2.5,8.0), l1=(1.2,3.8), d0=getMPISizeWorld())
+        x=ContinuousFunction(dom).getX()
+        writer=DatasetWriter(self.base, format=DatasetWriter.VTK,
+                             full_output=False)
+        writer.addProbes([(-2.5,1.2), (8.,3.8)])
+        for n in range(2):
+            writer.write(time=0.5*n, data_v=x*(n+1))
+        if getMPIRankWorld()==0:
+            lines=open(self.base+"_probes.csv").read().split()
+            self.assertEqual(lines[0], 'cycle,time,probe,x,y,z,data_v_0,data_v_1')
+            self.assertEqual(len(lines), 5)
+            values=[list(map(float, l.split(','))) for l in lines[1:]]
+            self.assertAlmostEqual(values[0][6], -2.5, delta=self.TOL*10)
+            self.assertAlmostEqual(values[3][0], 1)
+            self.assertAlmostEqual(values[3][6], 16., delta=self.TOL*10)
+            self.assertAlmostEqual(values[3][7], 7.6, delta=self.TOL*10)
+
+    def test_asynchronous(self):
+        writer=DatasetWriter(self.base, asynchronous=True)
+        self.assertRaises(ValueError, writer.addSlice, 0, 0.)
+
+
 
 if __name__ == '__main__':
     run_tests(__name__, exit_on_failure=True)